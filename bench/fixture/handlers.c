@@ -0,0 +1,68 @@
+#include <stdlib.h>
+
+#include "http.h"
+#include "websockets.h"
+#include "json.h"
+
+/*
+ * Обработчики тестового приложения для bench. Делают минимум работы,
+ * чтобы замер показывал стоимость сервера, а не приложения
+ */
+
+void bench_plain(httpctx_t* ctx) {
+    ctx->response->add_headern(ctx->response, "Content-Type", 12, "text/plain", 10);
+    ctx->response->send_datan(ctx->response, "ok", 2);
+}
+
+// Тело запроса как есть
+void bench_echo(httpctx_t* ctx) {
+    char* payload = ctx->request->get_payload(ctx->request);
+    if (payload == NULL) {
+        ctx->response->send_default(ctx->response, 400);
+        return;
+    }
+
+    ctx->response->add_headern(ctx->response, "Content-Type", 12, "application/json", 16);
+    ctx->response->send_data(ctx->response, payload);
+
+    free(payload);
+}
+
+// Разбор JSON из тела и ответ новым документом
+void bench_json(httpctx_t* ctx) {
+    json_doc_t* payload = ctx->request->get_payload_json(ctx->request);
+    json_doc_t* document = json_root_create_object();
+    if (document == NULL) {
+        json_free(payload);
+        ctx->response->send_default(ctx->response, 500);
+        return;
+    }
+
+    json_token_t* root = json_root(document);
+    json_object_set(root, "status", json_create_string("ok"));
+    json_object_set(root, "size", json_create_number(payload != NULL ? json_object_size(json_root(payload)) : 0));
+
+    ctx->response->send_json(ctx->response, document);
+
+    json_free(document);
+    json_free(payload);
+}
+
+void bench_ws(httpctx_t* ctx) {
+    switch_to_websockets(ctx);
+}
+
+// Обработчик websocket по умолчанию: текст кадра обратно клиенту
+void bench_ws_echo(wsctx_t* ctx) {
+    websockets_protocol_default_t* protocol = (websockets_protocol_default_t*)ctx->request->protocol;
+
+    char* payload = protocol->get_payload(protocol);
+    if (payload == NULL) {
+        ctx->response->send_textn(ctx->response, "", 0);
+        return;
+    }
+
+    ctx->response->send_text(ctx->response, payload);
+
+    free(payload);
+}
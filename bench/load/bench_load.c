@@ -0,0 +1,937 @@
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+/*
+ * Генератор нагрузки для замеров на одной машине через loopback.
+ *
+ * Каждый поток обслуживает свою долю соединений через poll и держит на
+ * каждом до pipeline запросов в полёте. Задержка считается от постановки
+ * запроса в очередь отправки до получения последнего байта ответа; без
+ * keep-alive в неё входят connect и TLS-рукопожатие. Итог - одна строка
+ * JSON в stdout.
+ */
+
+#define BENCH_PIPELINE_MAX 256
+#define BENCH_READ_SIZE 65536
+// Гистограмма в наносекундах: 32 корзины на каждую степень двойки
+#define BENCH_SUB_BITS 5
+#define BENCH_SUB (1 << BENCH_SUB_BITS)
+#define BENCH_BUCKETS ((64 - BENCH_SUB_BITS + 1) * BENCH_SUB)
+
+typedef enum {
+    BENCH_HEAD = 0,
+    BENCH_BODY,
+    BENCH_CHUNK_SIZE,
+    BENCH_CHUNK_DATA,
+    BENCH_WS_HEAD,
+    BENCH_WS_DATA,
+    BENCH_WS_CONTROL
+} bench_state_e;
+
+typedef struct {
+    const char* host;
+    const char* port;
+    const char* method;
+    const char* path;
+    const char* scenario;
+    int threads;
+    int connections;
+    int duration;
+    int pipeline;
+    int keepalive;
+    int tls;
+    int websocket;
+    size_t body_size;
+} bench_options_t;
+
+typedef struct {
+    uint64_t buckets[BENCH_BUCKETS];
+    uint64_t count;
+    uint64_t max;
+} bench_histogram_t;
+
+typedef struct {
+    int fd;
+    SSL* ssl;
+
+    char* out;
+    size_t out_size;
+    size_t out_offset;
+    size_t out_capacity;
+
+    char* in;
+    size_t in_size;
+    size_t in_capacity;
+
+    bench_state_e state;
+    uint64_t skip;
+    int status;
+
+    uint64_t sent_at[BENCH_PIPELINE_MAX];
+    int head;
+    int inflight;
+} bench_conn_t;
+
+typedef struct {
+    pthread_t thread;
+    int connections;
+    bench_conn_t* conns;
+    bench_histogram_t histogram;
+    uint64_t requests;
+    uint64_t errors;
+    uint64_t bytes_in;
+} bench_thread_t;
+
+static bench_options_t __options = {
+    .host = "127.0.0.1",
+    .port = "8080",
+    .method = "GET",
+    .path = "/",
+    .scenario = "custom",
+    .threads = 1,
+    .connections = 1,
+    .duration = 10,
+    .pipeline = 1,
+    .keepalive = 1,
+    .tls = 0,
+    .websocket = 0,
+    .body_size = 0
+};
+
+static struct addrinfo* __addr = NULL;
+static SSL_CTX* __ssl_ctx = NULL;
+static char* __request = NULL;
+static size_t __request_size = 0;
+static uint64_t __deadline = 0;
+
+static uint64_t __now_ns(void);
+static void __usage(const char* name);
+static int __parse_options(int argc, char* argv[]);
+static int __build_request(void);
+static int __histogram_bucket(uint64_t value);
+static uint64_t __histogram_value(int bucket);
+static void __histogram_record(bench_histogram_t* histogram, uint64_t value);
+static uint64_t __histogram_quantile(bench_histogram_t* histogram, double quantile);
+static int __conn_open(bench_conn_t* conn);
+static void __conn_close(bench_conn_t* conn);
+static int __conn_handshake_ws(bench_conn_t* conn);
+static int __conn_enqueue(bench_conn_t* conn);
+static int __conn_flush(bench_conn_t* conn);
+static int __conn_read(bench_thread_t* thread, bench_conn_t* conn);
+static int __conn_parse(bench_thread_t* thread, bench_conn_t* conn);
+static int __conn_complete(bench_thread_t* thread, bench_conn_t* conn);
+static int __conn_restart(bench_thread_t* thread, bench_conn_t* conn, int failed);
+static ssize_t __io_read(bench_conn_t* conn, char* buffer, size_t size);
+static ssize_t __io_write(bench_conn_t* conn, const char* buffer, size_t size);
+static int __blocking_read_head(bench_conn_t* conn);
+static int __blocking_write(bench_conn_t* conn, const char* buffer, size_t size);
+static void* __thread_run(void* arg);
+static void __print_report(bench_thread_t* threads, double elapsed);
+
+int main(int argc, char* argv[]) {
+    signal(SIGPIPE, SIG_IGN);
+
+    if (!__parse_options(argc, argv))
+        return EXIT_FAILURE;
+
+    struct addrinfo hints = {
+        .ai_family = AF_UNSPEC,
+        .ai_socktype = SOCK_STREAM
+    };
+    const int r = getaddrinfo(__options.host, __options.port, &hints, &__addr);
+    if (r != 0) {
+        fprintf(stderr, "bench_load: resolve %s:%s failed: %s\n", __options.host, __options.port, gai_strerror(r));
+        return EXIT_FAILURE;
+    }
+
+    if (__options.tls) {
+        __ssl_ctx = SSL_CTX_new(TLS_client_method());
+        if (__ssl_ctx == NULL) {
+            fprintf(stderr, "bench_load: create ssl context failed\n");
+            return EXIT_FAILURE;
+        }
+        // Замеры идут на самоподписанном сертификате
+        SSL_CTX_set_verify(__ssl_ctx, SSL_VERIFY_NONE, NULL);
+    }
+
+    if (!__build_request())
+        return EXIT_FAILURE;
+
+    bench_thread_t* threads = calloc(__options.threads, sizeof * threads);
+    if (threads == NULL) {
+        fprintf(stderr, "bench_load: alloc memory for threads failed\n");
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 0; i < __options.threads; i++) {
+        threads[i].connections = __options.connections / __options.threads
+            + (i < __options.connections % __options.threads);
+    }
+
+    const uint64_t started_at = __now_ns();
+    __deadline = started_at + (uint64_t)__options.duration * 1000000000ULL;
+
+    for (int i = 0; i < __options.threads; i++) {
+        if (pthread_create(&threads[i].thread, NULL, __thread_run, &threads[i]) != 0) {
+            fprintf(stderr, "bench_load: start thread failed\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (int i = 0; i < __options.threads; i++)
+        pthread_join(threads[i].thread, NULL);
+
+    const double elapsed = (double)(__now_ns() - started_at) / 1e9;
+    __print_report(threads, elapsed);
+
+    free(threads);
+    free(__request);
+    freeaddrinfo(__addr);
+    if (__ssl_ctx != NULL)
+        SSL_CTX_free(__ssl_ctx);
+
+    return EXIT_SUCCESS;
+}
+
+uint64_t __now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void __usage(const char* name) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -h host        server address (127.0.0.1)\n"
+        "  -p port        server port (8080)\n"
+        "  -t threads     generator threads (1)\n"
+        "  -c conns       connections, split between threads (1)\n"
+        "  -d seconds     test duration (10)\n"
+        "  -n depth       pipelined requests per connection (1)\n"
+        "  -K             no keep-alive: new connection per request\n"
+        "  -s             TLS\n"
+        "  -m method      request method (GET)\n"
+        "  -u path        request path (/)\n"
+        "  -b bytes       JSON request body size (0)\n"
+        "  -w             websocket echo: upgrade on path, then text frames of -b bytes\n"
+        "  -l name        scenario name for the report\n",
+        name);
+}
+
+int __parse_options(int argc, char* argv[]) {
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "h:p:t:c:d:n:Ksm:u:b:wl:")) != -1) {
+        switch (opt) {
+        case 'h': __options.host = optarg; break;
+        case 'p': __options.port = optarg; break;
+        case 't': __options.threads = atoi(optarg); break;
+        case 'c': __options.connections = atoi(optarg); break;
+        case 'd': __options.duration = atoi(optarg); break;
+        case 'n': __options.pipeline = atoi(optarg); break;
+        case 'K': __options.keepalive = 0; break;
+        case 's': __options.tls = 1; break;
+        case 'm': __options.method = optarg; break;
+        case 'u': __options.path = optarg; break;
+        case 'b': __options.body_size = strtoul(optarg, NULL, 10); break;
+        case 'w': __options.websocket = 1; break;
+        case 'l': __options.scenario = optarg; break;
+        default:
+            __usage(argv[0]);
+            return 0;
+        }
+    }
+
+    if (__options.threads < 1 || __options.connections < 1 || __options.duration < 1) {
+        fprintf(stderr, "bench_load: threads, connections and duration must be >= 1\n");
+        return 0;
+    }
+    if (__options.pipeline < 1 || __options.pipeline > BENCH_PIPELINE_MAX) {
+        fprintf(stderr, "bench_load: pipeline depth must be 1..%d\n", BENCH_PIPELINE_MAX);
+        return 0;
+    }
+    if (__options.threads > __options.connections)
+        __options.threads = __options.connections;
+
+    // Без keep-alive соединение несёт один запрос
+    if (!__options.keepalive) {
+        __options.pipeline = 1;
+        if (__options.websocket) {
+            fprintf(stderr, "bench_load: websocket requires keep-alive\n");
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * Запрос собирается один раз и копируется в очередь отправки целиком.
+ * Websocket-кадр маскируется нулевым ключом: по RFC 6455 маска
+ * обязательна, а нулевой ключ оставляет данные как есть
+ */
+int __build_request(void) {
+    const size_t body_size = __options.body_size;
+    char* body = malloc(body_size + 1);
+    if (body == NULL) {
+        fprintf(stderr, "bench_load: alloc memory for body failed\n");
+        return 0;
+    }
+
+    if (body_size >= 11) {
+        memcpy(body, "{\"data\":\"", 9);
+        memset(body + 9, 'x', body_size - 11);
+        memcpy(body + body_size - 2, "\"}", 2);
+    }
+    else {
+        memset(body, ' ', body_size);
+    }
+
+    if (__options.websocket) {
+        unsigned char head[14];
+        size_t head_size = 0;
+        head[head_size++] = 0x81;
+        if (body_size < 126) {
+            head[head_size++] = 0x80 | (unsigned char)body_size;
+        }
+        else if (body_size <= 0xFFFF) {
+            head[head_size++] = 0x80 | 126;
+            head[head_size++] = (unsigned char)(body_size >> 8);
+            head[head_size++] = (unsigned char)body_size;
+        }
+        else {
+            head[head_size++] = 0x80 | 127;
+            for (int i = 7; i >= 0; i--)
+                head[head_size++] = (unsigned char)((uint64_t)body_size >> (i * 8));
+        }
+        memset(head + head_size, 0, 4);
+        head_size += 4;
+
+        __request_size = head_size + body_size;
+        __request = malloc(__request_size);
+        if (__request == NULL) {
+            free(body);
+            fprintf(stderr, "bench_load: alloc memory for request failed\n");
+            return 0;
+        }
+
+        memcpy(__request, head, head_size);
+        memcpy(__request + head_size, body, body_size);
+        free(body);
+
+        return 1;
+    }
+
+    char head[1024];
+    int head_size = snprintf(head, sizeof(head),
+        "%s %s HTTP/1.1\r\n"
+        "Host: %s\r\n"
+        "Connection: %s\r\n",
+        __options.method, __options.path, __options.host,
+        __options.keepalive ? "keep-alive" : "close");
+
+    if (body_size > 0)
+        head_size += snprintf(head + head_size, sizeof(head) - head_size,
+            "Content-Type: application/json\r\n"
+            "Content-Length: %zu\r\n",
+            body_size);
+
+    head_size += snprintf(head + head_size, sizeof(head) - head_size, "\r\n");
+    if (head_size >= (int)sizeof(head)) {
+        free(body);
+        fprintf(stderr, "bench_load: request head is too long\n");
+        return 0;
+    }
+
+    __request_size = head_size + body_size;
+    __request = malloc(__request_size);
+    if (__request == NULL) {
+        free(body);
+        fprintf(stderr, "bench_load: alloc memory for request failed\n");
+        return 0;
+    }
+
+    memcpy(__request, head, head_size);
+    memcpy(__request + head_size, body, body_size);
+    free(body);
+
+    return 1;
+}
+
+int __histogram_bucket(uint64_t value) {
+    if (value < BENCH_SUB)
+        return (int)value;
+
+    const int msb = 63 - __builtin_clzll(value);
+    const int shift = msb - BENCH_SUB_BITS;
+
+    return (shift + 1) * BENCH_SUB + (int)((value >> shift) & (BENCH_SUB - 1));
+}
+
+// Середина корзины
+uint64_t __histogram_value(int bucket) {
+    if (bucket < BENCH_SUB)
+        return (uint64_t)bucket;
+
+    const int shift = bucket / BENCH_SUB - 1;
+    const uint64_t low = (uint64_t)(BENCH_SUB + bucket % BENCH_SUB) << shift;
+
+    return low + ((1ULL << shift) >> 1);
+}
+
+void __histogram_record(bench_histogram_t* histogram, uint64_t value) {
+    histogram->buckets[__histogram_bucket(value)]++;
+    histogram->count++;
+    if (value > histogram->max)
+        histogram->max = value;
+}
+
+uint64_t __histogram_quantile(bench_histogram_t* histogram, double quantile) {
+    if (histogram->count == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t)(quantile * (double)histogram->count);
+    if (rank >= histogram->count)
+        rank = histogram->count - 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < BENCH_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen > rank) {
+            const uint64_t value = __histogram_value(i);
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+
+    return histogram->max;
+}
+
+/*
+ * Соединение и рукопожатия выполняются в блокирующем режиме, обмен
+ * запросами - в неблокирующем
+ */
+int __conn_open(bench_conn_t* conn) {
+    conn->fd = socket(__addr->ai_family, SOCK_STREAM, 0);
+    if (conn->fd < 0)
+        return 0;
+
+    const int on = 1;
+    setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    if (connect(conn->fd, __addr->ai_addr, __addr->ai_addrlen) != 0)
+        goto failed;
+
+    if (__ssl_ctx != NULL) {
+        conn->ssl = SSL_new(__ssl_ctx);
+        if (conn->ssl == NULL)
+            goto failed;
+
+        SSL_set_fd(conn->ssl, conn->fd);
+        SSL_set_tlsext_host_name(conn->ssl, __options.host);
+        if (SSL_connect(conn->ssl) != 1)
+            goto failed;
+    }
+
+    if (__options.websocket && !__conn_handshake_ws(conn))
+        goto failed;
+
+    if (fcntl(conn->fd, F_SETFL, fcntl(conn->fd, F_GETFL, 0) | O_NONBLOCK) != 0)
+        goto failed;
+
+    conn->state = __options.websocket ? BENCH_WS_HEAD : BENCH_HEAD;
+    conn->in_size = 0;
+    conn->out_size = 0;
+    conn->out_offset = 0;
+    conn->skip = 0;
+    conn->head = 0;
+    conn->inflight = 0;
+
+    return 1;
+
+    failed:
+
+    __conn_close(conn);
+
+    return 0;
+}
+
+void __conn_close(bench_conn_t* conn) {
+    if (conn->ssl != NULL) {
+        SSL_free(conn->ssl);
+        conn->ssl = NULL;
+    }
+    if (conn->fd >= 0) {
+        close(conn->fd);
+        conn->fd = -1;
+    }
+}
+
+int __conn_handshake_ws(bench_conn_t* conn) {
+    char request[1024];
+    const int size = snprintf(request, sizeof(request),
+        "GET %s HTTP/1.1\r\n"
+        "Host: %s\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "\r\n",
+        __options.path, __options.host);
+
+    if (size >= (int)sizeof(request))
+        return 0;
+
+    if (!__blocking_write(conn, request, size))
+        return 0;
+
+    return __blocking_read_head(conn) == 101;
+}
+
+int __blocking_write(bench_conn_t* conn, const char* buffer, size_t size) {
+    size_t offset = 0;
+    while (offset < size) {
+        const ssize_t written = __io_write(conn, buffer + offset, size - offset);
+        if (written <= 0)
+            return 0;
+
+        offset += written;
+    }
+
+    return 1;
+}
+
+// Ответ на upgrade читается побайтно, чтобы не захватить первый кадр
+int __blocking_read_head(bench_conn_t* conn) {
+    char head[4096];
+    size_t size = 0;
+
+    while (size < sizeof(head) - 1) {
+        const ssize_t readed = __io_read(conn, head + size, 1);
+        if (readed <= 0)
+            return 0;
+
+        size++;
+        if (size >= 4 && memcmp(head + size - 4, "\r\n\r\n", 4) == 0) {
+            head[size] = 0;
+            if (size < 12 || strncmp(head, "HTTP/1.1 ", 9) != 0)
+                return 0;
+
+            return atoi(head + 9);
+        }
+    }
+
+    return 0;
+}
+
+int __conn_enqueue(bench_conn_t* conn) {
+    if (conn->out_size + __request_size > conn->out_capacity) {
+        size_t capacity = conn->out_capacity > 0 ? conn->out_capacity : 4096;
+        while (capacity < conn->out_size + __request_size)
+            capacity *= 2;
+
+        char* out = realloc(conn->out, capacity);
+        if (out == NULL)
+            return 0;
+
+        conn->out = out;
+        conn->out_capacity = capacity;
+    }
+
+    memcpy(conn->out + conn->out_size, __request, __request_size);
+    conn->out_size += __request_size;
+
+    const int slot = (conn->head + conn->inflight) % BENCH_PIPELINE_MAX;
+    conn->sent_at[slot] = __now_ns();
+    conn->inflight++;
+
+    return 1;
+}
+
+// -1 - ошибка, 0 - сокет занят, 1 - очередь отправлена
+int __conn_flush(bench_conn_t* conn) {
+    while (conn->out_offset < conn->out_size) {
+        const ssize_t written = __io_write(conn, conn->out + conn->out_offset, conn->out_size - conn->out_offset);
+        if (written < 0)
+            return errno == EAGAIN ? 0 : -1;
+        if (written == 0)
+            return -1;
+
+        conn->out_offset += written;
+    }
+
+    conn->out_offset = 0;
+    conn->out_size = 0;
+
+    return 1;
+}
+
+int __conn_read(bench_thread_t* thread, bench_conn_t* conn) {
+    while (1) {
+        if (conn->in_capacity - conn->in_size < BENCH_READ_SIZE) {
+            const size_t capacity = conn->in_size + BENCH_READ_SIZE;
+            char* in = realloc(conn->in, capacity);
+            if (in == NULL)
+                return -1;
+
+            conn->in = in;
+            conn->in_capacity = capacity;
+        }
+
+        const ssize_t readed = __io_read(conn, conn->in + conn->in_size, conn->in_capacity - conn->in_size);
+        if (readed < 0)
+            return errno == EAGAIN ? 0 : -1;
+        if (readed == 0)
+            return -1;
+
+        conn->in_size += readed;
+        thread->bytes_in += readed;
+
+        const int r = __conn_parse(thread, conn);
+        if (r != 1)
+            return r;
+    }
+}
+
+/*
+ * Разбор потока ответов без копирования тел: заголовки ищутся в буфере,
+ * тело и куски chunked пропускаются по счётчику.
+ * -1 - ошибка, 1 - продолжать чтение, 2 - соединение закрыто по ответу
+ */
+int __conn_parse(bench_thread_t* thread, bench_conn_t* conn) {
+    size_t pos = 0;
+
+    while (pos < conn->in_size) {
+        char* data = conn->in + pos;
+        const size_t size = conn->in_size - pos;
+
+        if (conn->state == BENCH_BODY || conn->state == BENCH_CHUNK_DATA
+            || conn->state == BENCH_WS_DATA || conn->state == BENCH_WS_CONTROL) {
+            const size_t part = conn->skip < size ? conn->skip : size;
+            pos += part;
+            conn->skip -= part;
+            if (conn->skip > 0)
+                break;
+
+            if (conn->state == BENCH_CHUNK_DATA) {
+                conn->state = BENCH_CHUNK_SIZE;
+                continue;
+            }
+            if (conn->state == BENCH_WS_CONTROL) {
+                conn->state = BENCH_WS_HEAD;
+                continue;
+            }
+
+            const int r = __conn_complete(thread, conn);
+            if (r != 1) {
+                conn->in_size = 0;
+                return r;
+            }
+            continue;
+        }
+
+        if (conn->state == BENCH_WS_HEAD) {
+            if (size < 2)
+                break;
+
+            const unsigned char* frame = (const unsigned char*)data;
+            uint64_t length = frame[1] & 0x7F;
+            size_t head_size = 2;
+            if (length == 126) {
+                if (size < 4) break;
+                length = ((uint64_t)frame[2] << 8) | frame[3];
+                head_size = 4;
+            }
+            else if (length == 127) {
+                if (size < 10) break;
+                length = 0;
+                for (int i = 0; i < 8; i++)
+                    length = (length << 8) | frame[2 + i];
+                head_size = 10;
+            }
+
+            const int opcode = frame[0] & 0x0F;
+            pos += head_size;
+            conn->skip = length;
+            conn->status = 200;
+            if (opcode == 0x08)
+                return -1;
+
+            // Служебные кадры не отвечают на запросы
+            if (opcode == 0x09 || opcode == 0x0A) {
+                conn->state = BENCH_WS_CONTROL;
+                continue;
+            }
+
+            conn->state = BENCH_WS_DATA;
+            continue;
+        }
+
+        const char* end = memmem(data, size, "\r\n", 2);
+        if (end == NULL)
+            break;
+
+        if (conn->state == BENCH_CHUNK_SIZE) {
+            const uint64_t chunk = strtoull(data, NULL, 16);
+            pos += end - data + 2;
+            // Завершающий кусок и пустая строка после него
+            conn->skip = chunk + 2;
+            conn->state = chunk == 0 ? BENCH_BODY : BENCH_CHUNK_DATA;
+            continue;
+        }
+
+        const char* head_end = memmem(data, size, "\r\n\r\n", 4);
+        if (head_end == NULL)
+            break;
+
+        if (size < 12 || strncmp(data, "HTTP/1.", 7) != 0)
+            return -1;
+
+        conn->status = atoi(data + 9);
+        conn->skip = 0;
+        conn->state = BENCH_BODY;
+
+        for (const char* line = memmem(data, size, "\r\n", 2) + 2; line < head_end; ) {
+            const char* line_end = memmem(line, head_end + 2 - line, "\r\n", 2);
+            if (strncasecmp(line, "Content-Length:", 15) == 0)
+                conn->skip = strtoull(line + 15, NULL, 10);
+            else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0 && memmem(line, line_end - line, "chunked", 7) != NULL)
+                conn->state = BENCH_CHUNK_SIZE;
+
+            line = line_end + 2;
+        }
+
+        pos += head_end - data + 4;
+        if (conn->state == BENCH_BODY && conn->skip == 0) {
+            const int r = __conn_complete(thread, conn);
+            if (r != 1) {
+                conn->in_size = 0;
+                return r;
+            }
+        }
+    }
+
+    memmove(conn->in, conn->in + pos, conn->in_size - pos);
+    conn->in_size -= pos;
+
+    return 1;
+}
+
+int __conn_complete(bench_thread_t* thread, bench_conn_t* conn) {
+    if (conn->inflight == 0)
+        return -1;
+
+    const uint64_t now = __now_ns();
+    __histogram_record(&thread->histogram, now - conn->sent_at[conn->head]);
+    conn->head = (conn->head + 1) % BENCH_PIPELINE_MAX;
+    conn->inflight--;
+
+    if (conn->status >= 200 && conn->status < 400)
+        thread->requests++;
+    else
+        thread->errors++;
+
+    conn->state = __options.websocket ? BENCH_WS_HEAD : BENCH_HEAD;
+
+    if (!__options.keepalive)
+        return 2;
+
+    if (now < __deadline && !__conn_enqueue(conn))
+        return -1;
+
+    return 1;
+}
+
+ssize_t __io_read(bench_conn_t* conn, char* buffer, size_t size) {
+    if (conn->ssl == NULL)
+        return read(conn->fd, buffer, size);
+
+    const int r = SSL_read(conn->ssl, buffer, (int)size);
+    if (r > 0)
+        return r;
+
+    const int error = SSL_get_error(conn->ssl, r);
+    if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+        errno = EAGAIN;
+        return -1;
+    }
+    if (error == SSL_ERROR_ZERO_RETURN)
+        return 0;
+
+    errno = EIO;
+    return -1;
+}
+
+ssize_t __io_write(bench_conn_t* conn, const char* buffer, size_t size) {
+    if (conn->ssl == NULL)
+        return write(conn->fd, buffer, size);
+
+    const int r = SSL_write(conn->ssl, buffer, (int)size);
+    if (r > 0)
+        return r;
+
+    const int error = SSL_get_error(conn->ssl, r);
+    if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    errno = EIO;
+    return -1;
+}
+
+/*
+ * Соединение с ошибкой или закрытое после ответа открывается заново;
+ * запросы в полёте на нём считаются ошибками
+ */
+int __conn_restart(bench_thread_t* thread, bench_conn_t* conn, int failed) {
+    if (failed)
+        thread->errors += conn->inflight > 0 ? conn->inflight : 1;
+
+    __conn_close(conn);
+    if (__now_ns() >= __deadline)
+        return 0;
+
+    const uint64_t started_at = __now_ns();
+    if (!__conn_open(conn)) {
+        thread->errors++;
+        return 0;
+    }
+
+    for (int i = 0; i < __options.pipeline; i++)
+        if (!__conn_enqueue(conn))
+            return 0;
+
+    // Без keep-alive задержка включает connect и рукопожатие
+    if (!__options.keepalive)
+        conn->sent_at[conn->head] = started_at;
+
+    return 1;
+}
+
+void* __thread_run(void* arg) {
+    bench_thread_t* thread = arg;
+
+    thread->conns = calloc(thread->connections, sizeof(bench_conn_t));
+    struct pollfd* fds = calloc(thread->connections, sizeof(struct pollfd));
+    if (thread->conns == NULL || fds == NULL) {
+        free(thread->conns);
+        free(fds);
+        thread->errors++;
+        return NULL;
+    }
+
+    for (int i = 0; i < thread->connections; i++) {
+        thread->conns[i].fd = -1;
+        __conn_restart(thread, &thread->conns[i], 0);
+    }
+
+    while (__now_ns() < __deadline) {
+        for (int i = 0; i < thread->connections; i++) {
+            bench_conn_t* conn = &thread->conns[i];
+            if (conn->fd < 0 && !__conn_restart(thread, conn, 0)) {
+                fds[i].fd = -1;
+                continue;
+            }
+
+            const int r = __conn_flush(conn);
+            if (r < 0 && !__conn_restart(thread, conn, 1)) {
+                fds[i].fd = -1;
+                continue;
+            }
+
+            fds[i].fd = conn->fd;
+            fds[i].events = POLLIN | (conn->out_size > 0 ? POLLOUT : 0);
+            fds[i].revents = 0;
+        }
+
+        const int remaining_ms = (int)((__deadline - __now_ns()) / 1000000);
+        const int n = poll(fds, thread->connections, remaining_ms < 100 ? remaining_ms : 100);
+        if (n < 0 && errno != EINTR)
+            break;
+        if (n <= 0)
+            continue;
+
+        for (int i = 0; i < thread->connections; i++) {
+            bench_conn_t* conn = &thread->conns[i];
+            if (fds[i].fd < 0 || fds[i].revents == 0)
+                continue;
+
+            if (fds[i].revents & (POLLIN | POLLERR | POLLHUP)) {
+                const int r = __conn_read(thread, conn);
+                if (r < 0)
+                    __conn_restart(thread, conn, 1);
+                else if (r == 2)
+                    __conn_restart(thread, conn, 0);
+            }
+        }
+    }
+
+    for (int i = 0; i < thread->connections; i++) {
+        __conn_close(&thread->conns[i]);
+        free(thread->conns[i].in);
+        free(thread->conns[i].out);
+    }
+
+    free(thread->conns);
+    free(fds);
+
+    return NULL;
+}
+
+void __print_report(bench_thread_t* threads, double elapsed) {
+    bench_histogram_t* histogram = calloc(1, sizeof * histogram);
+    if (histogram == NULL) {
+        fprintf(stderr, "bench_load: alloc memory for report failed\n");
+        return;
+    }
+
+    uint64_t requests = 0, errors = 0, bytes_in = 0;
+    for (int i = 0; i < __options.threads; i++) {
+        requests += threads[i].requests;
+        errors += threads[i].errors;
+        bytes_in += threads[i].bytes_in;
+
+        for (int j = 0; j < BENCH_BUCKETS; j++)
+            histogram->buckets[j] += threads[i].histogram.buckets[j];
+        histogram->count += threads[i].histogram.count;
+        if (threads[i].histogram.max > histogram->max)
+            histogram->max = threads[i].histogram.max;
+    }
+
+    printf("{\"scenario\":\"%s\",\"threads\":%d,\"connections\":%d,\"pipeline\":%d,"
+           "\"keepalive\":%s,\"tls\":%s,\"websocket\":%s,\"body_bytes\":%zu,\"duration_s\":%.3f,"
+           "\"requests\":%llu,\"errors\":%llu,\"rps\":%.1f,\"read_bytes_per_s\":%.1f,"
+           "\"latency_us\":{\"p50\":%.1f,\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f}}\n",
+        __options.scenario, __options.threads, __options.connections, __options.pipeline,
+        __options.keepalive ? "true" : "false",
+        __options.tls ? "true" : "false",
+        __options.websocket ? "true" : "false",
+        __options.body_size, elapsed,
+        (unsigned long long)requests, (unsigned long long)errors,
+        (double)requests / elapsed, (double)bytes_in / elapsed,
+        (double)__histogram_quantile(histogram, 0.50) / 1000.0,
+        (double)__histogram_quantile(histogram, 0.99) / 1000.0,
+        (double)__histogram_quantile(histogram, 0.999) / 1000.0,
+        (double)histogram->max / 1000.0);
+
+    free(histogram);
+}
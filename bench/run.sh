@@ -0,0 +1,95 @@
+#!/bin/sh
+#
+# Прогон сценариев bench на loopback.
+#
+#   run.sh <cwfr> <libbench_fixture.so> <bench_load> <workdir>
+#
+# Поднимает cwfr с тестовым приложением, прогоняет матрицу сценариев и
+# пишет по строке JSON на сценарий в stdout и <workdir>/results.jsonl.
+# Параметры берутся из окружения:
+#   BENCH_DURATION     секунд на сценарий (10)
+#   BENCH_CONNECTIONS  соединений (64)
+#   BENCH_THREADS      потоков генератора (2)
+#   BENCH_WORKERS      потоков цикла событий сервера (2)
+#   BENCH_HANDLERS     потоков обработчиков сервера (2)
+#   BENCH_PORT         порт без TLS (18080), TLS - следующий
+#   BENCH_SCENARIOS    имена сценариев через пробел (все)
+
+set -eu
+
+CWFR=$1
+FIXTURE=$2
+LOAD=$3
+WORKDIR=$4
+
+DURATION=${BENCH_DURATION:-10}
+CONNECTIONS=${BENCH_CONNECTIONS:-64}
+THREADS=${BENCH_THREADS:-2}
+WORKERS=${BENCH_WORKERS:-2}
+HANDLERS=${BENCH_HANDLERS:-2}
+PORT=${BENCH_PORT:-18080}
+TLS_PORT=$((PORT + 1))
+SCENARIOS=${BENCH_SCENARIOS:-"plain plain_pipeline plain_close static_small static_large json_1k json_64k echo_16k tls_plain tls_close tls_json_1k ws_echo ws_echo_tls"}
+
+SOURCE_DIR=$(cd "$(dirname "$0")" && pwd)
+RESULTS="$WORKDIR/results.jsonl"
+
+mkdir -p "$WORKDIR/www" "$WORKDIR/tmp"
+
+if [ ! -f "$WORKDIR/cert.pem" ]; then
+    openssl req -x509 -newkey rsa:2048 -nodes -days 365 -subj "/CN=127.0.0.1" \
+        -keyout "$WORKDIR/key.pem" -out "$WORKDIR/cert.pem" >/dev/null 2>&1
+fi
+
+printf 'ok' > "$WORKDIR/www/small.txt"
+head -c 1048576 /dev/zero | tr '\0' 'x' > "$WORKDIR/www/large.bin"
+
+sed -e "s|@WORKDIR@|$WORKDIR|g" \
+    -e "s|@FIXTURE@|$FIXTURE|g" \
+    -e "s|@PORT@|$PORT|g" \
+    -e "s|@TLS_PORT@|$TLS_PORT|g" \
+    -e "s|@WORKERS@|$WORKERS|g" \
+    -e "s|@THREADS@|$HANDLERS|g" \
+    "$SOURCE_DIR/fixture/config.json" > "$WORKDIR/config.json"
+
+"$CWFR" -c "$WORKDIR/config.json" > "$WORKDIR/server.log" 2>&1 &
+SERVER=$!
+trap 'kill $SERVER 2>/dev/null; wait $SERVER 2>/dev/null || true' EXIT INT TERM
+
+# Сервер готов, когда отвечает на /plain
+i=0
+until "$LOAD" -p "$PORT" -u /plain -d 1 -l ready 2>/dev/null | grep -q '"requests":[1-9]'; do
+    i=$((i + 1))
+    if [ $i -ge 20 ] || ! kill -0 $SERVER 2>/dev/null; then
+        echo "bench: server did not start, see $WORKDIR/server.log" >&2
+        exit 1
+    fi
+    sleep 0.5
+done
+
+: > "$RESULTS"
+
+run() {
+    name=$1
+    shift
+    case " $SCENARIOS " in
+        *" $name "*) ;;
+        *) return 0 ;;
+    esac
+
+    "$LOAD" -t "$THREADS" -c "$CONNECTIONS" -d "$DURATION" -l "$name" "$@" | tee -a "$RESULTS"
+}
+
+run plain          -p "$PORT" -u /plain
+run plain_pipeline -p "$PORT" -u /plain -n 16
+run plain_close    -p "$PORT" -u /plain -K
+run static_small   -p "$PORT" -u /small.txt
+run static_large   -p "$PORT" -u /large.bin
+run json_1k        -p "$PORT" -u /json -m POST -b 1024
+run json_64k       -p "$PORT" -u /json -m POST -b 65536
+run echo_16k       -p "$PORT" -u /echo -m POST -b 16384
+run tls_plain      -p "$TLS_PORT" -s -u /plain
+run tls_close      -p "$TLS_PORT" -s -u /plain -K
+run tls_json_1k    -p "$TLS_PORT" -s -u /json -m POST -b 1024
+run ws_echo        -p "$PORT" -u /ws -w -b 128
+run ws_echo_tls    -p "$TLS_PORT" -s -u /ws -w -b 128
@@ -0,0 +1,58 @@
+#-- Try to find Brotli encoder headers and library.
+#
+# Usage of this module as follows:
+#
+#     find_package(Brotli)
+#
+# Variables defined by this module:
+#
+#  Brotli_FOUND               System has Brotli library/headers.
+#  Brotli_LIBRARIES           The Brotli encoder and common libraries.
+#  Brotli_DEC_LIBRARY         The Brotli decoder library (tests only).
+#  Brotli_INCLUDE_DIRS        The location of Brotli headers.
+
+find_path(Brotli_INCLUDE_DIR brotli/encode.h
+    HINTS
+    /usr
+    /usr/local
+    PATH_SUFFIXES include
+)
+
+find_library(Brotli_ENC_LIBRARY brotlienc
+    HINTS
+    /usr
+    /usr/lib/
+    PATH SUFFIXES lib
+)
+
+find_library(Brotli_COMMON_LIBRARY brotlicommon
+    HINTS
+    /usr
+    /usr/lib/
+    PATH SUFFIXES lib
+)
+
+find_library(Brotli_DEC_LIBRARY brotlidec
+    HINTS
+    /usr
+    /usr/lib/
+    PATH SUFFIXES lib
+)
+
+set(Brotli_INCLUDE_DIRS ${Brotli_INCLUDE_DIR})
+set(Brotli_LIBRARIES ${Brotli_ENC_LIBRARY} ${Brotli_COMMON_LIBRARY})
+
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(Brotli DEFAULT_MSG Brotli_ENC_LIBRARY Brotli_COMMON_LIBRARY Brotli_INCLUDE_DIR)
+
+if(Brotli_FOUND)
+  message(STATUS "Brotli found")
+endif()
+
+mark_as_advanced(
+    Brotli_INCLUDE_DIR
+    Brotli_ENC_LIBRARY
+    Brotli_COMMON_LIBRARY
+    Brotli_DEC_LIBRARY
+)
@@ -0,0 +1,41 @@
+#-- Try to find Zstandard headers and library.
+#
+# Usage of this module as follows:
+#
+#     find_package(Zstd)
+#
+# Variables defined by this module:
+#
+#  Zstd_FOUND                 System has zstd library/headers.
+#  Zstd_LIBRARY               The zstd library.
+#  Zstd_INCLUDE_DIRS          The location of zstd headers.
+
+find_path(Zstd_INCLUDE_DIR zstd.h
+    HINTS
+    /usr
+    /usr/local
+    PATH_SUFFIXES include
+)
+
+find_library(Zstd_LIBRARY zstd
+    HINTS
+    /usr
+    /usr/lib/
+    PATH SUFFIXES lib
+)
+
+set(Zstd_INCLUDE_DIRS ${Zstd_INCLUDE_DIR})
+set(Zstd_LIBRARIES ${Zstd_LIBRARY})
+
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(Zstd DEFAULT_MSG Zstd_LIBRARY Zstd_INCLUDE_DIR)
+
+if(Zstd_FOUND)
+  message(STATUS "Zstd found")
+endif()
+
+mark_as_advanced(
+    Zstd_INCLUDE_DIR
+    Zstd_LIBRARY
+)
@@ -28,6 +28,8 @@ typedef struct dbresultquery {
     db_table_cell_t* fields;
     db_table_cell_t* table;
 
+    size_t bytes; // учтено в memstat: структура, таблицы ячеек и значения
+
     struct dbresultquery* next;
 } dbresultquery_t;
 
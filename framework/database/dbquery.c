@@ -8,6 +8,7 @@
 #include "appconfig.h"
 #include "str.h"
 #include "log.h"
+#include "probes.h"
 #include "dbquery.h"
 #include "model.h"
 #include "dbresult.h"
@@ -265,7 +266,9 @@ dbresult_t* dbquery(const char* dbid, const char* format, array_t* params) {
         return NULL;
     }
 
+    CWFR_PROBE(db_query_start, dbid, str_get(result_query));
     dbresult_t* result = connection->execute_params(connection, str_get(result_query), ud.bind);
+    CWFR_PROBE(db_query_end, dbid, result != NULL && result->ok);
 
     str_free(result_query);
     array_free(ud.bind);   // borrowed wrappers, no field free
@@ -303,7 +306,11 @@ dbresult_t* dbprepared(const char* dbid, const char* name, const char* sql, arra
         if (!ok) return NULL;
     }
 
-    return connection->execute_prepared(connection, name, params);
+    CWFR_PROBE(db_query_start, dbid, name);
+    dbresult_t* result = connection->execute_prepared(connection, name, params);
+    CWFR_PROBE(db_query_end, dbid, result != NULL && result->ok);
+
+    return result;
 }
 
 
@@ -319,7 +326,11 @@ dbresult_t* dbquery_params(const char* dbid, const char* sql, array_t* ordered_p
         return NULL;
     }
 
-    return connection->execute_params(connection, sql, ordered_params);
+    CWFR_PROBE(db_query_start, dbid, sql);
+    dbresult_t* result = connection->execute_params(connection, sql, ordered_params);
+    CWFR_PROBE(db_query_end, dbid, result != NULL && result->ok);
+
+    return result;
 }
 
 dbresult_t* dbtable_exist(const char* dbid, const char* table) {
@@ -4,8 +4,10 @@
 #include <string.h>
 
 #include "dbresult.h"
+#include "memstat.h"
 
 db_table_cell_t* __dbresult_field(dbresult_t* result, const char* field);
+static void __dbresult_query_account(dbresultquery_t* query, size_t bytes);
 
 
 dbresult_t* dbresult_create(void) {
@@ -31,6 +33,7 @@ dbresultquery_t* dbresult_query_create(int rows, int cols) {
     query->current_col = 0;
     query->fields = malloc(cols * sizeof(db_table_cell_t));
     query->table = malloc(rows * cols * sizeof(db_table_cell_t));
+    query->bytes = 0;
     query->next = NULL;
 
     if (query->fields == NULL || query->table == NULL) {
@@ -38,12 +41,17 @@ dbresultquery_t* dbresult_query_create(int rows, int cols) {
         return NULL;
     }
 
+    query->bytes = sizeof * query + (size_t)(cols + rows * cols) * sizeof(db_table_cell_t);
+    memstat_add(MEMSTAT_DBRESULT, query->bytes);
+
     return query;
 }
 
 void dbresult_query_free(dbresultquery_t* query) {
     if (query == NULL) return;
 
+    memstat_sub(MEMSTAT_DBRESULT, query->bytes);
+
     if (query->fields) {
         explicit_bzero(query->fields, query->cols * sizeof(db_table_cell_t));
         free(query->fields);
@@ -78,13 +86,17 @@ int dbresult_cell_create(db_table_cell_t* cell, const char* string, size_t lengt
 }
 
 void dbresult_query_value_insert(dbresultquery_t* query, const char* string, size_t length, int row, int col) {
-    dbresult_cell_create(&query->table[row * query->cols + col], string, length);
+    db_table_cell_t* cell = &query->table[row * query->cols + col];
+
+    if (dbresult_cell_create(cell, string, length) == 0 && cell->value != NULL)
+        __dbresult_query_account(query, length + 1);
 }
 
 void dbresult_query_field_insert(dbresultquery_t* query, const char* string, int col) {
     size_t length = strlen(string);
 
-    dbresult_cell_create(&query->fields[col], string, length);
+    if (dbresult_cell_create(&query->fields[col], string, length) == 0 && query->fields[col].value != NULL)
+        __dbresult_query_account(query, length + 1);
 }
 
 int dbresult_ok(dbresult_t* result) {
@@ -285,3 +297,8 @@ int dbresult_col_first(dbresult_t* result) {
 
     return 1;
 }
+
+void __dbresult_query_account(dbresultquery_t* query, size_t bytes) {
+    query->bytes += bytes;
+    memstat_add(MEMSTAT_DBRESULT, bytes);
+}
@@ -118,6 +118,18 @@ void __connection_free(void* connection) {
     free(conn);
 }
 
+// Integer replies (INCR, EVAL returning a number) carry no string; they are
+// rendered in decimal into `buffer` so callers read every reply as text.
+static const char* __redis_reply_value(const redisReply* reply, char* buffer, size_t size, size_t* length) {
+    if (reply->type == REDIS_REPLY_INTEGER) {
+        *length = (size_t)snprintf(buffer, size, "%lld", (long long)reply->integer);
+        return buffer;
+    }
+
+    *length = reply->len;
+    return reply->str;
+}
+
 // Map a successful redisReply into `result`: a single unnamed column, one row
 // per array element (REDIS_REPLY_ARRAY) or a single row otherwise. Returns 1 on
 // success, 0 on allocation failure. Shared by __query and __execute_params.
@@ -138,13 +150,11 @@ static int __redis_fill_result(redisReply* reply, dbresult_t* result) {
     dbresult_query_field_insert(query, "", col);
 
     for (int row = 0; row < rows; row++) {
-        size_t length = reply->len;
-        const char* value = reply->str;
+        const redisReply* element = reply->type == REDIS_REPLY_ARRAY ? reply->element[row] : reply;
 
-        if (rows > 1) {
-            length = reply->element[row]->len;
-            value = reply->element[row]->str;
-        }
+        char buffer[32];
+        size_t length = 0;
+        const char* value = __redis_reply_value(element, buffer, sizeof(buffer), &length);
 
         dbresult_query_value_insert(query, value, length, row, col);
     }
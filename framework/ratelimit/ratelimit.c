@@ -0,0 +1,318 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "log.h"
+#include "appconfig.h"
+#include "ratelimit.h"
+#include "ratelimiter.h"
+
+#define RATELIMIT_NS 1000000000ULL
+
+typedef struct ratelimitentry {
+    uint64_t tokens;               // Без хранилища - токены bucket'а, иначе остаток аренды
+    uint64_t stamp_ns;             // Без хранилища - время пополнения, иначе конец аренды или отказа
+    uint64_t last_access_ns;
+    int denied;                    // До stamp_ns хранилище не спрашивается
+} ratelimitentry_t;
+
+static uint64_t __now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * RATELIMIT_NS + (uint64_t)ts.tv_nsec;
+}
+
+// FNV-1a: ключ выбирает часть, внутри части поиск по дереву
+static ratelimitshard_t* __shard_of(ratelimit_t* limiter, const char* key) {
+    uint32_t hash = 2166136261U;
+    for (const unsigned char* p = (const unsigned char*)key; *p != '\0'; p++) {
+        hash ^= *p;
+        hash *= 16777619U;
+    }
+
+    return &limiter->shards[hash & (RATELIMIT_SHARDS - 1)];
+}
+
+// Время, за которое bucket накапливает tokens токенов
+static uint64_t __refill_ns(const ratelimitconfig_t* config, uint64_t tokens) {
+    return tokens * RATELIMIT_NS / config->rate;
+}
+
+/*
+ * Проверяет несколько записей от курсора и удаляет не тронутые дольше
+ * idle_timeout_s: часть не ждёт обхода всего дерева. Удаление перевешивает
+ * узлы, не копируя их, поэтому курсор на следующий узел остаётся верным.
+ */
+static void __shard_cleanup(ratelimit_t* limiter, ratelimitshard_t* shard, uint64_t now) {
+    const uint64_t idle_ns = (uint64_t)limiter->config.idle_timeout_s * RATELIMIT_NS;
+    map_iterator_t it = { .map = shard->entries, .node = shard->cleanup_node };
+
+    for (int step = 0; step < RATELIMIT_CLEANUP_STEP; step++) {
+        if (!map_iterator_valid(it)) {
+            it = map_begin(shard->entries);
+            if (!map_iterator_valid(it)) break;
+        }
+
+        map_iterator_t next = map_next(it);
+        const ratelimitentry_t* entry = map_iterator_value(it);
+
+        // now снимается до блокировки части, время записи может быть больше него
+        if (now > entry->last_access_ns && now - entry->last_access_ns > idle_ns)
+            map_erase(shard->entries, map_iterator_key(it));
+
+        it = next;
+    }
+
+    shard->cleanup_node = map_iterator_valid(it) ? it.node : NULL;
+}
+
+static ratelimitentry_t* __shard_entry(ratelimit_t* limiter, ratelimitshard_t* shard, const char* key, uint64_t now) {
+    __shard_cleanup(limiter, shard, now);
+
+    ratelimitentry_t* entry = map_find(shard->entries, key);
+    if (entry != NULL) return entry;
+
+    entry = malloc(sizeof * entry);
+    if (entry == NULL) return NULL;
+
+    entry->tokens = limiter->store == NULL ? limiter->config.burst : 0;
+    entry->stamp_ns = now;
+    entry->last_access_ns = now;
+    entry->denied = 0;
+
+    if (map_insert(shard->entries, key, entry) == -1) {
+        free(entry);
+        return NULL;
+    }
+
+    return entry;
+}
+
+static void __entry_refill(ratelimitentry_t* entry, const ratelimitconfig_t* config, uint64_t now) {
+    if (now <= entry->stamp_ns) return;
+
+    const uint64_t elapsed_ns = now - entry->stamp_ns;
+    const uint64_t tokens = (elapsed_ns / RATELIMIT_NS) * config->rate
+        + ((elapsed_ns % RATELIMIT_NS) * config->rate) / RATELIMIT_NS;
+
+    if (tokens == 0) return;
+
+    if (entry->tokens + tokens >= config->burst) {
+        entry->tokens = config->burst;
+        entry->stamp_ns = now;
+        return;
+    }
+
+    // Дробная часть токена не теряется: время сдвигается ровно на добавленные токены
+    entry->tokens += tokens;
+    entry->stamp_ns += __refill_ns(config, tokens);
+}
+
+static int __take_local(ratelimit_t* limiter, ratelimitshard_t* shard, const char* key, uint32_t tokens, uint64_t now) {
+    spinlock_lock(&shard->locked);
+
+    ratelimitentry_t* entry = __shard_entry(limiter, shard, key, now);
+    if (entry == NULL) {
+        spinlock_unlock(&shard->locked);
+        log_error("ratelimit_take: can't create entry for %s\n", limiter->name);
+        return 1;
+    }
+
+    __entry_refill(entry, &limiter->config, now);
+    entry->last_access_ns = now;
+
+    int allowed = 0;
+    if (entry->tokens >= tokens) {
+        entry->tokens -= tokens;
+        allowed = 1;
+    }
+
+    spinlock_unlock(&shard->locked);
+
+    return allowed;
+}
+
+/*
+ * Сначала тратится аренда. Когда её не хватает, новая партия берётся
+ * из хранилища без блокировки части: сетевой запрос не задерживает
+ * другие ключи. Параллельные запросы одного ключа могут арендовать
+ * одновременно, лишние токены остаются в аренде.
+ */
+static int __take_leased(ratelimit_t* limiter, ratelimitshard_t* shard, const char* key, uint32_t tokens, uint64_t now) {
+    const ratelimitconfig_t* config = &limiter->config;
+
+    spinlock_lock(&shard->locked);
+
+    ratelimitentry_t* entry = __shard_entry(limiter, shard, key, now);
+    if (entry == NULL) {
+        spinlock_unlock(&shard->locked);
+        log_error("ratelimit_take: can't create entry for %s\n", limiter->name);
+        return 1;
+    }
+
+    entry->last_access_ns = now;
+
+    if (now < entry->stamp_ns) {
+        if (entry->tokens >= tokens) {
+            entry->tokens -= tokens;
+            spinlock_unlock(&shard->locked);
+            return 1;
+        }
+
+        if (entry->denied) {
+            spinlock_unlock(&shard->locked);
+            return 0;
+        }
+    }
+    else {
+        // Неистраченный остаток истёкшей аренды пропадает
+        entry->tokens = 0;
+        entry->denied = 0;
+    }
+
+    spinlock_unlock(&shard->locked);
+
+    const uint32_t count = config->lease > tokens ? config->lease : tokens;
+    int64_t granted = limiter->store->lease(limiter->store, limiter, key, count);
+    const int unreachable = granted < 0;
+
+    // Без хранилища процесс сам выдаёт себе партию: лимит держится
+    // приблизительно, а хранилище спрашивается раз на партию, а не на запрос
+    if (unreachable)
+        granted = count;
+
+    now = __now_ns();
+
+    spinlock_lock(&shard->locked);
+
+    entry = __shard_entry(limiter, shard, key, now);
+    if (entry == NULL) {
+        spinlock_unlock(&shard->locked);
+        log_error("ratelimit_take: can't create entry for %s\n", limiter->name);
+        return 1;
+    }
+
+    if (now >= entry->stamp_ns || entry->denied)
+        entry->tokens = 0;
+
+    entry->tokens += (uint64_t)granted;
+    entry->last_access_ns = now;
+
+    int allowed = 0;
+    if (entry->tokens >= tokens) {
+        entry->tokens -= tokens;
+        entry->stamp_ns = now + __refill_ns(config, count);
+        entry->denied = 0;
+        allowed = 1;
+    }
+    else {
+        entry->stamp_ns = now + __refill_ns(config, tokens);
+        entry->denied = 1;
+    }
+
+    spinlock_unlock(&shard->locked);
+
+    if (unreachable)
+        log_error("ratelimit_take: store of %s unreachable, lease granted locally\n", limiter->name);
+
+    return allowed;
+}
+
+ratelimit_t* ratelimit_create(const char* name, const ratelimitconfig_t* config, ratelimitstore_t* store) {
+    if (name == NULL || config == NULL || config->rate == 0 || config->burst == 0) {
+        if (store != NULL) store->free(store);
+        return NULL;
+    }
+
+    ratelimit_t* limiter = aligned_alloc(64, sizeof(ratelimit_t));
+    if (limiter == NULL) {
+        if (store != NULL) store->free(store);
+        return NULL;
+    }
+
+    memset(limiter, 0, sizeof(ratelimit_t));
+
+    limiter->config = *config;
+    limiter->store = store;
+    limiter->name = strdup(name);
+    if (limiter->name == NULL) {
+        ratelimit_free(limiter);
+        return NULL;
+    }
+
+    if (limiter->config.lease == 0)
+        limiter->config.lease = 1;
+
+    for (int i = 0; i < RATELIMIT_SHARDS; i++) {
+        ratelimitshard_t* shard = &limiter->shards[i];
+
+        atomic_flag_clear(&shard->locked);
+        shard->cleanup_node = NULL;
+        shard->entries = map_create_ex(map_compare_string, map_copy_string, free, NULL, free);
+        if (shard->entries == NULL) {
+            ratelimit_free(limiter);
+            return NULL;
+        }
+    }
+
+    return limiter;
+}
+
+void ratelimit_free(ratelimit_t* limiter) {
+    if (limiter == NULL) return;
+
+    for (int i = 0; i < RATELIMIT_SHARDS; i++)
+        if (limiter->shards[i].entries != NULL)
+            map_free(limiter->shards[i].entries);
+
+    if (limiter->store != NULL)
+        limiter->store->free(limiter->store);
+
+    free(limiter->name);
+    free(limiter);
+}
+
+int ratelimit_take(ratelimit_t* limiter, const char* key, uint32_t tokens) {
+    if (limiter == NULL || key == NULL) return 1;
+
+    ratelimitshard_t* shard = __shard_of(limiter, key);
+    const uint64_t now = __now_ns();
+
+    if (limiter->store == NULL)
+        return __take_local(limiter, shard, key, tokens, now);
+
+    return __take_leased(limiter, shard, key, tokens, now);
+}
+
+size_t ratelimit_size(ratelimit_t* limiter) {
+    if (limiter == NULL) return 0;
+
+    size_t size = 0;
+    for (int i = 0; i < RATELIMIT_SHARDS; i++) {
+        ratelimitshard_t* shard = &limiter->shards[i];
+
+        spinlock_lock(&shard->locked);
+        size += map_size(shard->entries);
+        spinlock_unlock(&shard->locked);
+    }
+
+    return size;
+}
+
+ratelimit_t* ratelimit_find(const char* name) {
+    if (name == NULL) return NULL;
+    if (appconfig() == NULL || appconfig()->ratelimits == NULL) return NULL;
+
+    return map_find(appconfig()->ratelimits, name);
+}
+
+int ratelimit_allow(const char* name, const char* key) {
+    ratelimit_t* limiter = ratelimit_find(name);
+    if (limiter == NULL) {
+        log_error("ratelimit_allow: limiter %s not found\n", name != NULL ? name : "(null)");
+        return 1;
+    }
+
+    return ratelimit_take(limiter, key, 1);
+}
@@ -0,0 +1,114 @@
+#ifndef __RATELIMIT__
+#define __RATELIMIT__
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <linux/limits.h>
+
+#include "map.h"
+
+#define RATELIMIT_SHARDS 16 // Степень двойки
+#define RATELIMIT_CLEANUP_STEP 4 // Записей, проверяемых за одно обращение
+
+typedef enum {
+    RATELIMIT_DRIVER_MEMORY = 0,
+    RATELIMIT_DRIVER_REDIS,
+} ratelimit_driver_e;
+
+/**
+ * @brief Token bucket of one limit: `burst` tokens, refilled at `rate` per second.
+ */
+typedef struct ratelimitconfig {
+    uint32_t burst;                // Ёмкость bucket'а
+    uint32_t rate;                 // Токенов в секунду
+    uint32_t lease;                // Токенов за одно обращение к общему хранилищу
+    uint32_t idle_timeout_s;       // Записи без обращений дольше удаляются
+    char host_id[NAME_MAX];        // База общего хранилища (redis)
+} ratelimitconfig_t;
+
+typedef struct ratelimit ratelimit_t;
+
+/**
+ * @brief Store of buckets shared by all processes and nodes.
+ */
+typedef struct ratelimitstore {
+    /**
+     * @brief Takes up to `count` tokens from the shared bucket of `key`.
+     * @param limiter Limiter the bucket belongs to.
+     * @param key Identity the bucket is kept for.
+     * @param count Tokens wanted.
+     * @return Tokens granted (0..count), or -1 if the store is unreachable.
+     */
+    int64_t(*lease)(struct ratelimitstore* store, ratelimit_t* limiter, const char* key, uint32_t count);
+
+    void(*free)(struct ratelimitstore* store);
+} ratelimitstore_t;
+
+typedef struct ratelimitshard {
+    atomic_flag locked;
+    map_t* entries;                // key -> ratelimitentry_t*
+    map_node_t* cleanup_node;      // Следующая запись для проверки, NULL - с начала
+} __attribute__((aligned(64))) ratelimitshard_t;
+
+/**
+ * Rate limiter keyed by an arbitrary string (API key, user id, ...).
+ *
+ * Without a store the buckets live in this process. With a store each
+ * process leases tokens from the shared bucket in batches of `lease` and
+ * spends them locally, so most requests cost no round trip; the limit
+ * is then exceeded by no more than the leases not yet spent. A lease
+ * expires after the time the bucket needs to refill it, and a denied
+ * key is not asked for again until the requested tokens could have
+ * been refilled.
+ */
+struct ratelimit {
+    char* name;
+    ratelimitconfig_t config;
+    ratelimitstore_t* store;       // NULL - лимит только в этом процессе
+    ratelimitshard_t shards[RATELIMIT_SHARDS];
+};
+
+/**
+ * @brief Creates a limiter.
+ * @param name Limiter name, part of the keys in the shared store.
+ * @param config Bucket parameters.
+ * @param store Shared store or NULL; owned by the limiter in every outcome.
+ * @return Limiter, or NULL on invalid config or allocation failure.
+ */
+ratelimit_t* ratelimit_create(const char* name, const ratelimitconfig_t* config, ratelimitstore_t* store);
+void ratelimit_free(ratelimit_t* limiter);
+
+/**
+ * @brief Takes `tokens` tokens from the bucket of `key`.
+ * @return 1 if the request is allowed, 0 if the limit is exceeded.
+ */
+int ratelimit_take(ratelimit_t* limiter, const char* key, uint32_t tokens);
+
+/**
+ * @brief Number of keys kept locally (for statistics and tests).
+ */
+size_t ratelimit_size(ratelimit_t* limiter);
+
+/**
+ * @brief Finds a limiter from the "ratelimits" section of the config.
+ */
+ratelimit_t* ratelimit_find(const char* name);
+
+/**
+ * @brief Takes one token of `key` from the configured limiter `name`.
+ *
+ * Intended for middlewares:
+ *
+ *     if (!ratelimit_allow("api", api_key)) {
+ *         ctx->response->send_default(ctx->response, 429);
+ *         return 0;
+ *     }
+ *
+ * @return 1 if allowed or the limiter is not configured, 0 if the limit is exceeded.
+ */
+int ratelimit_allow(const char* name, const char* key);
+
+ratelimitstore_t* ratelimitredis_init(void);
+
+#endif
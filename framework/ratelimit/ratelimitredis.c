@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "db.h"
+#include "model.h"
+#include "ratelimit.h"
+
+/*
+ * Bucket хранится в хеше {tokens, stamp} и пополняется по часам Redis,
+ * поэтому расхождение часов узлов на лимит не влияет. Скрипт выполняется
+ * атомарно: узлы не могут получить один и тот же токен.
+ */
+static const char* __script =
+    "local burst = tonumber(ARGV[1]) "
+    "local rate = tonumber(ARGV[2]) "
+    "local count = tonumber(ARGV[3]) "
+    "local time = redis.call('TIME') "
+    "local now = tonumber(time[1]) * 1000000 + tonumber(time[2]) "
+    "local bucket = redis.call('HMGET', KEYS[1], 'tokens', 'stamp') "
+    "local tokens = tonumber(bucket[1]) or burst "
+    "local stamp = tonumber(bucket[2]) or now "
+    "if now > stamp then tokens = math.min(burst, tokens + (now - stamp) * rate / 1000000) end "
+    "local granted = math.min(count, math.floor(tokens)) "
+    "redis.call('HSET', KEYS[1], 'tokens', string.format('%.6f', tokens - granted), 'stamp', string.format('%.0f', now)) "
+    "redis.call('PEXPIRE', KEYS[1], math.ceil(burst * 1000 / rate) + 1000) "
+    "return granted";
+
+static int64_t __lease(ratelimitstore_t* store, ratelimit_t* limiter, const char* key, uint32_t count);
+static void __free(ratelimitstore_t* store);
+
+ratelimitstore_t* ratelimitredis_init(void) {
+    ratelimitstore_t* store = malloc(sizeof * store);
+    if (store == NULL) return NULL;
+
+    store->lease = __lease;
+    store->free = __free;
+
+    return store;
+}
+
+int64_t __lease(ratelimitstore_t* store, ratelimit_t* limiter, const char* key, uint32_t count) {
+    (void)store;
+
+    const size_t size = strlen("cwfr:ratelimit:") + strlen(limiter->name) + 1 + strlen(key) + 1;
+    char* bucket_key = malloc(size);
+    if (bucket_key == NULL) return -1;
+
+    snprintf(bucket_key, size, "cwfr:ratelimit:%s:%s", limiter->name, key);
+
+    array_t* params = array_create();
+    if (params == NULL) {
+        free(bucket_key);
+        return -1;
+    }
+
+    mparams_fill_array(params,
+        mparam_text(script, __script),
+        mparam_text(key, bucket_key),
+        mparam_bigint(burst, (long long)limiter->config.burst),
+        mparam_bigint(rate, (long long)limiter->config.rate),
+        mparam_bigint(count, (long long)count)
+    );
+
+    dbresult_t* result = dbquery(limiter->config.host_id, "EVAL :script 1 :key :burst :rate :count", params);
+    array_free(params);
+    free(bucket_key);
+
+    int64_t granted = -1;
+
+    if (!dbresult_ok(result))
+        goto failed;
+
+    const db_table_cell_t* field = dbresult_field(result, NULL);
+    if (field == NULL || field->value == NULL)
+        goto failed;
+
+    granted = strtoll(field->value, NULL, 10);
+    if (granted < 0 || granted > count)
+        granted = -1;
+
+    failed:
+
+    dbresult_free(result);
+
+    return granted;
+}
+
+void __free(ratelimitstore_t* store) {
+    free(store);
+}
@@ -9,6 +9,7 @@
 #include "taskmanager.h"
 #include "signal/signal.h"
 #include "log.h"
+#include "profiler.h"
 
 static inline taskmanager_t* __manager(void) {
     appconfig_t* config = appconfig();
@@ -38,7 +39,8 @@ static void __task_free(void* arg) {
 }
 
 static void* __async_worker(void* arg) {
-    signal_block_usr1();
+    signal_block_reload();
+    profiler_thread_init();
 
     appconfig_t* config = arg;
     taskmanager_t* manager = config->taskmanager;
@@ -118,7 +120,8 @@ static void __execute_scheduled_task(scheduled_task_entry_t* entry) {
 }
 
 static void* __scheduler_worker(void* arg) {
-    signal_block_usr1();
+    signal_block_reload();
+    profiler_thread_init();
 
     appconfig_t* config = arg;
     taskmanager_t* manager = config->taskmanager;
@@ -5,6 +5,8 @@
 #include <linux/limits.h>
 
 #include "appconfig.h"
+#include "log.h"
+#include "memstat.h"
 #include "viewparser.h"
 #include "viewstore.h"
 #include "view.h"
@@ -59,6 +61,11 @@ char* __view_render(json_doc_t* document, const char* storage_name, const char*
     viewstore_unlock(viewstore);
 
     if (view == NULL) {
+        if (memstat_should_shed(MEMSTAT_VIEWSTORE)) {
+            log_error("__view_render: memory limit of viewstore reached, %s not parsed\n", path);
+            return NULL;
+        }
+
         viewparser_t* parser = viewparser_init(storage_name, path);
         if (parser == NULL) return NULL;
 
@@ -75,6 +75,7 @@ typedef struct view_copy_tags {
 typedef struct view {
     char* path;
     view_tag_t* root_tag;
+    size_t bytes; // учтено в memstat: структуры тегов, путь и сам view
     struct view* next;
 } view_t;
 
@@ -4,9 +4,11 @@
 #include "viewstore.h"
 #include "log.h"
 #include "helpers.h"
+#include "memstat.h"
 
 static view_t* __viewstore_view_create(view_tag_t* tag, const char* path);
 static void __viewstore_view_free(view_t* view);
+static size_t __viewstore_tag_size(const view_tag_t* tag);
 
 /**
  * Create a new view store.
@@ -119,8 +121,11 @@ view_t* __viewstore_view_create(view_tag_t* tag, const char* path) {
 
     strcpy(view->path, path);
     view->root_tag = tag;
+    view->bytes = sizeof * view + strlen(path) + 1 + __viewstore_tag_size(tag);
     view->next = NULL;
 
+    memstat_add(MEMSTAT_VIEWSTORE, view->bytes);
+
     return view;
 }
 
@@ -133,6 +138,8 @@ view_t* __viewstore_view_create(view_tag_t* tag, const char* path) {
 void __viewstore_view_free(view_t* view) {
     if (view == NULL) return;
 
+    memstat_sub(MEMSTAT_VIEWSTORE, view->bytes);
+
     if (view->path != NULL)
         free(view->path);
 
@@ -142,6 +149,39 @@ void __viewstore_view_free(view_t* view) {
     free(view);
 }
 
+/**
+ * Size of a tag and its subtree. Dynamic buffers of the tags are counted by
+ * bufferdata itself.
+ *
+ * @param tag The tag.
+ * @return size_t Bytes held by the tag structures.
+ */
+size_t __viewstore_tag_size(const view_tag_t* tag) {
+    size_t size = 0;
+
+    for (; tag != NULL; tag = tag->next) {
+        switch (tag->type) {
+        case VIEW_TAGTYPE_COND_IF:
+        case VIEW_TAGTYPE_COND_ELSEIF:
+        case VIEW_TAGTYPE_COND_ELSE:
+            size += sizeof(view_condition_item_t);
+            break;
+        case VIEW_TAGTYPE_LOOP:
+            size += sizeof(view_loop_t);
+            break;
+        case VIEW_TAGTYPE_INC:
+            size += sizeof(view_include_t);
+            break;
+        default:
+            size += sizeof(view_tag_t);
+        }
+
+        size += __viewstore_tag_size(tag->child);
+    }
+
+    return size;
+}
+
 /**
  * Lock the view store.
  *
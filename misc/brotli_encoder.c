@@ -0,0 +1,110 @@
+#include "log.h"
+#include "brotli_encoder.h"
+
+#ifdef Brotli_FOUND
+#include <brotli/encode.h>
+
+// Окно 512 КБ: для сжатия на лету важнее память на ответ, чем доли процента
+#define BROTLI_ENCODER_LGWIN 19
+#endif
+
+int brotli_encoder_enabled(void) {
+#ifdef Brotli_FOUND
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+void brotli_encoder_init(brotli_encoder_t* encoder) {
+    encoder->state = NULL;
+    encoder->next_in = NULL;
+    encoder->avail_in = 0;
+    encoder->avail_out = 0;
+    encoder->status = 0;
+    encoder->finished = 0;
+}
+
+int brotli_encoder_start(brotli_encoder_t* encoder, int quality) {
+#ifdef Brotli_FOUND
+    brotli_encoder_free(encoder);
+
+    encoder->state = BrotliEncoderCreateInstance(NULL, NULL, NULL);
+    if (encoder->state == NULL) {
+        log_error("brotli_encoder_start: can't create encoder\n");
+        return 0;
+    }
+
+    if (!BrotliEncoderSetParameter(encoder->state, BROTLI_PARAM_QUALITY, (uint32_t)quality) ||
+        !BrotliEncoderSetParameter(encoder->state, BROTLI_PARAM_LGWIN, BROTLI_ENCODER_LGWIN)) {
+        brotli_encoder_free(encoder);
+        return 0;
+    }
+
+    return 1;
+#else
+    (void)encoder;
+    (void)quality;
+    return 0;
+#endif
+}
+
+void brotli_encoder_set_in(brotli_encoder_t* encoder, const char* data, size_t length) {
+    encoder->next_in = (const uint8_t*)data;
+    encoder->avail_in = length;
+}
+
+size_t brotli_encoder_compress(brotli_encoder_t* encoder, char* out, size_t out_length, int end) {
+#ifdef Brotli_FOUND
+    uint8_t* next_out = (uint8_t*)out;
+    encoder->avail_out = out_length;
+
+    /* FLUSH выдаёт всё, что накоплено, как и Z_SYNC_FLUSH у gzip:
+     * каждый кусок тела уходит клиенту без задержки. */
+    const BrotliEncoderOperation op = end ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_FLUSH;
+    if (!BrotliEncoderCompressStream(encoder->state, op, &encoder->avail_in, &encoder->next_in, &encoder->avail_out, &next_out, NULL)) {
+        encoder->status = -1;
+        return 0;
+    }
+
+    encoder->finished = BrotliEncoderIsFinished(encoder->state);
+
+    return out_length - encoder->avail_out;
+#else
+    (void)out;
+    (void)out_length;
+    (void)end;
+    encoder->status = -1;
+    return 0;
+#endif
+}
+
+void brotli_encoder_free(brotli_encoder_t* encoder) {
+#ifdef Brotli_FOUND
+    if (encoder->state != NULL)
+        BrotliEncoderDestroyInstance(encoder->state);
+#endif
+
+    brotli_encoder_init(encoder);
+}
+
+size_t brotli_encoder_bound(size_t length) {
+#ifdef Brotli_FOUND
+    return BrotliEncoderMaxCompressedSize(length);
+#else
+    (void)length;
+    return 0;
+#endif
+}
+
+int brotli_encoder_has_error(brotli_encoder_t* encoder) {
+    return encoder->status < 0;
+}
+
+int brotli_encoder_is_end(brotli_encoder_t* encoder) {
+    return encoder->finished;
+}
+
+int brotli_encoder_want_continue(brotli_encoder_t* encoder) {
+    return encoder->avail_out == 0;
+}
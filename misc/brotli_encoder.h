@@ -0,0 +1,34 @@
+#ifndef __BROTLI_ENCODER__
+#define __BROTLI_ENCODER__
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct BrotliEncoderStateStruct;
+
+/**
+ * Потоковое сжатие brotli с интерфейсом gzip_deflate.
+ * Без подключённой библиотеки (-DBrotli_FOUND) brotli_encoder_enabled()
+ * возвращает 0, а инициализация завершается ошибкой.
+ */
+typedef struct brotli_encoder {
+    struct BrotliEncoderStateStruct* state;
+    const uint8_t* next_in;
+    size_t avail_in;
+    size_t avail_out;
+    int status;                    // 0 - ok, -1 - ошибка
+    int finished;
+} brotli_encoder_t;
+
+int brotli_encoder_enabled(void);
+void brotli_encoder_init(brotli_encoder_t* encoder);
+int brotli_encoder_start(brotli_encoder_t* encoder, int quality);
+void brotli_encoder_set_in(brotli_encoder_t* encoder, const char* data, size_t length);
+size_t brotli_encoder_compress(brotli_encoder_t* encoder, char* out, size_t out_length, int end);
+void brotli_encoder_free(brotli_encoder_t* encoder);
+size_t brotli_encoder_bound(size_t length);
+int brotli_encoder_has_error(brotli_encoder_t* encoder);
+int brotli_encoder_is_end(brotli_encoder_t* encoder);
+int brotli_encoder_want_continue(brotli_encoder_t* encoder);
+
+#endif
@@ -2,6 +2,7 @@
 #include <string.h>
 
 #include "bufferdata.h"
+#include "memstat.h"
 
 // Максимум полезных байт в static_buffer (один байт под терминатор)
 #define BUFFERDATA_CAPACITY (BUFFERDATA_SIZE - 1)
@@ -54,8 +55,10 @@ void bufferdata_clear(bufferdata_t* buffer) {
 
     bufferdata_reset(buffer);
 
-    if (buffer->dynamic_buffer != NULL)
+    if (buffer->dynamic_buffer != NULL) {
+        memstat_sub(MEMSTAT_BUFFERS, buffer->dbuffer_size);
         free(buffer->dynamic_buffer);
+    }
 
     buffer->dynamic_buffer = NULL;
     buffer->dbuffer_size = 0;
@@ -91,6 +94,7 @@ int bufferdata_move(bufferdata_t* buffer) {
         char* data = realloc(buffer->dynamic_buffer, dbuffer_length + 1);
         if (data == NULL) return 0;
 
+        memstat_add(MEMSTAT_BUFFERS, dbuffer_length + 1 - buffer->dbuffer_size);
         buffer->dbuffer_size = dbuffer_length + 1;
         buffer->dynamic_buffer = data;
     }
@@ -149,6 +153,8 @@ int bufferdata_move_data_to_start(bufferdata_t* buffer, size_t offset, size_t si
         char* data = realloc(buffer->dynamic_buffer, size + 1);
         if (data == NULL) return 0;
 
+        memstat_sub(MEMSTAT_BUFFERS, buffer->dbuffer_size);
+        memstat_add(MEMSTAT_BUFFERS, size + 1);
         buffer->dbuffer_size = size + 1;
         buffer->dynamic_buffer = data;
         buffer->dynamic_buffer[size] = 0;
@@ -1,6 +1,9 @@
 #include <string.h>
 
 #include "bufo.h"
+#include "memstat.h"
+
+static void __bufo_account(bufo_t* buf, size_t allocated);
 
 bufo_t* bufo_create(void) {
     bufo_t* buf = malloc(sizeof * buf);
@@ -14,6 +17,7 @@ bufo_t* bufo_create(void) {
 void bufo_init(bufo_t* buf) {
     buf->data = NULL;
     buf->capacity = 0;
+    buf->allocated = 0;
 
     bufo_flush(buf);
 }
@@ -27,6 +31,7 @@ void bufo_clear(bufo_t* buf) {
     if (buf->data != NULL)
         free(buf->data);
 
+    __bufo_account(buf, 0);
     bufo_init(buf);
 }
 
@@ -49,6 +54,7 @@ void bufo_free(bufo_t* buf) {
     if (buf->data != NULL)
         free(buf->data);
 
+    __bufo_account(buf, 0);
     free(buf);
 }
 
@@ -112,6 +118,7 @@ int bufo_alloc(bufo_t* buf, size_t capacity) {
         return 0;
 
     buf->capacity = capacity;
+    __bufo_account(buf, capacity);
 
     return 1;
 }
@@ -140,10 +147,23 @@ int bufo_ensure_capacity(bufo_t* buf, size_t capacity) {
 
     buf->data = new_data;
     buf->capacity = new_capacity;
+    __bufo_account(buf, new_capacity);
 
     return 1;
 }
 
+/*
+ * Передаёт буферу владение уже выделенной памятью. Прежние данные
+ * освобождаются.
+ */
+void bufo_attach(bufo_t* buf, char* data, size_t capacity) {
+    bufo_clear(buf);
+
+    buf->data = data;
+    buf->capacity = capacity;
+    __bufo_account(buf, data != NULL ? capacity : 0);
+}
+
 ssize_t bufo_append(bufo_t* buf, const char* data, size_t size) {
     if (buf->is_proxy)
         return 0;
@@ -179,3 +199,12 @@ void bufo_reset_pos(bufo_t* buf) {
 void bufo_reset_size(bufo_t* buf) {
     buf->size = 0;
 }
+
+void __bufo_account(bufo_t* buf, size_t allocated) {
+    if (allocated > buf->allocated)
+        memstat_add(MEMSTAT_BODIES, allocated - buf->allocated);
+    else
+        memstat_sub(MEMSTAT_BODIES, buf->allocated - allocated);
+
+    buf->allocated = allocated;
+}
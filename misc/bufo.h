@@ -10,6 +10,7 @@ typedef struct bufo {
     size_t capacity;
     size_t size;
     size_t pos;
+    size_t allocated;              // Учтено в memstat, у прокси всегда 0
 
     unsigned is_proxy : 1;
     unsigned is_last : 1;
@@ -28,6 +29,7 @@ size_t bufo_move_front_pos(bufo_t* buf, size_t size);
 void bufo_set_size(bufo_t* buf, size_t size);
 int bufo_alloc(bufo_t* buf, size_t size);
 int bufo_ensure_capacity(bufo_t* buf, size_t capacity);
+void bufo_attach(bufo_t* buf, char* data, size_t capacity);
 ssize_t bufo_append(bufo_t* buf, const char* data, size_t size);
 void bufo_reset_pos(bufo_t* buf);
 void bufo_reset_size(bufo_t* buf);
@@ -0,0 +1,141 @@
+#include <stdlib.h>
+
+#include "log.h"
+#include "epoch.h"
+
+static int __epoch_reclaim(epoch_t* epoch, int wait);
+static void __epoch_advance(epoch_t* epoch);
+static void __epoch_free_list(epoch_retired_t* item);
+
+void epoch_init(epoch_t* epoch) {
+    atomic_init(&epoch->current, 2);
+    atomic_init(&epoch->readers[0], 0);
+    atomic_init(&epoch->readers[1], 0);
+    atomic_init(&epoch->pending, 0);
+    pthread_mutex_init(&epoch->mutex, NULL);
+    epoch->retired = NULL;
+}
+
+void epoch_destroy(epoch_t* epoch) {
+    pthread_mutex_lock(&epoch->mutex);
+    epoch_retired_t* item = epoch->retired;
+    epoch->retired = NULL;
+    atomic_store(&epoch->pending, 0);
+    pthread_mutex_unlock(&epoch->mutex);
+
+    __epoch_free_list(item);
+}
+
+unsigned long epoch_enter(epoch_t* epoch) {
+    const unsigned long token = atomic_load(&epoch->current);
+    atomic_fetch_add(&epoch->readers[token & 1], 1);
+
+    return token;
+}
+
+unsigned long epoch_hold(epoch_t* epoch, unsigned long token) {
+    atomic_fetch_add(&epoch->readers[token & 1], 1);
+
+    return token;
+}
+
+void epoch_exit(epoch_t* epoch, unsigned long token) {
+    atomic_fetch_sub(&epoch->readers[token & 1], 1);
+
+    // освобождение не должно задерживать читателя: занято - освободит другой
+    if (atomic_load(&epoch->pending) > 0)
+        __epoch_reclaim(epoch, 0);
+}
+
+void epoch_retire(epoch_t* epoch, void* ptr, void(*free_cb)(void*)) {
+    if (ptr == NULL) return;
+
+    epoch_retired_t* item = malloc(sizeof * item);
+    if (item == NULL) {
+        // лучше потерять версию, чем освободить её под читателем
+        log_error("epoch_retire: alloc memory failed, version leaked\n");
+        return;
+    }
+
+    item->ptr = ptr;
+    item->free = free_cb;
+
+    pthread_mutex_lock(&epoch->mutex);
+    item->target = atomic_load(&epoch->current) + 2;
+    item->next = epoch->retired;
+    epoch->retired = item;
+    atomic_fetch_add(&epoch->pending, 1);
+    pthread_mutex_unlock(&epoch->mutex);
+
+    __epoch_reclaim(epoch, 1);
+}
+
+int epoch_reclaim(epoch_t* epoch) {
+    return __epoch_reclaim(epoch, 1);
+}
+
+int epoch_pending(epoch_t* epoch) {
+    return atomic_load(&epoch->pending);
+}
+
+int __epoch_reclaim(epoch_t* epoch, int wait) {
+    if (wait)
+        pthread_mutex_lock(&epoch->mutex);
+    else if (pthread_mutex_trylock(&epoch->mutex) != 0)
+        return 0;
+
+    __epoch_advance(epoch);
+    __epoch_advance(epoch);
+
+    const unsigned long current = atomic_load(&epoch->current);
+    epoch_retired_t* ready = NULL;
+    epoch_retired_t** link = &epoch->retired;
+    int count = 0;
+
+    while (*link != NULL) {
+        epoch_retired_t* item = *link;
+        if (item->target > current) {
+            link = &item->next;
+            continue;
+        }
+
+        *link = item->next;
+        item->next = ready;
+        ready = item;
+        count++;
+    }
+
+    atomic_fetch_sub(&epoch->pending, count);
+    pthread_mutex_unlock(&epoch->mutex);
+
+    __epoch_free_list(ready);
+
+    return count;
+}
+
+/*
+ * Переход из эпохи N в N+1 допустим, когда закончились чтения эпохи N-1.
+ * Счётчики чередуются по чётности, поэтому новые читатели эпохи N
+ * не мешают проверке. Без ожидающих версий эпоха стоит на месте.
+ */
+void __epoch_advance(epoch_t* epoch) {
+    if (epoch->retired == NULL) return;
+
+    const unsigned long current = atomic_load(&epoch->current);
+    if (atomic_load(&epoch->readers[(current - 1) & 1]) != 0)
+        return;
+
+    atomic_store(&epoch->current, current + 1);
+}
+
+void __epoch_free_list(epoch_retired_t* item) {
+    while (item != NULL) {
+        epoch_retired_t* next = item->next;
+
+        if (item->free != NULL)
+            item->free(item->ptr);
+
+        free(item);
+        item = next;
+    }
+}
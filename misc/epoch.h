@@ -0,0 +1,88 @@
+#ifndef __EPOCH__
+#define __EPOCH__
+
+#include <stdatomic.h>
+#include <pthread.h>
+
+/**
+ * Epoch - отложенное освобождение разделяемых данных, которые читаются
+ * без блокировок (схема RCU).
+ *
+ * Писатель атомарно подменяет указатель на новую версию и передаёт старую
+ * в epoch_retire. Читатель обращается к данным между epoch_enter и
+ * epoch_exit. Версия освобождается, когда завершились все чтения, начатые
+ * до её снятия: для этого эпоха должна дважды продвинуться, а продвижение
+ * ждёт, пока не закончатся чтения предыдущей эпохи.
+ *
+ * Метка чтения не привязана к потоку: её можно получить в одном потоке и
+ * вернуть в другом, поэтому чтение может длиться всё время обработки
+ * запроса, включая ожидание в очереди обработчиков.
+ */
+
+typedef struct epoch_retired {
+    void* ptr;
+    void(*free)(void*);
+    unsigned long target;          // Эпоха, начиная с которой можно освободить
+    struct epoch_retired* next;
+} epoch_retired_t;
+
+typedef struct epoch {
+    atomic_ulong current;
+    atomic_long readers[2];        // Читатели чётных и нечётных эпох
+    atomic_int pending;            // Ожидающие освобождения версии
+    pthread_mutex_t mutex;
+    epoch_retired_t* retired;
+} epoch_t;
+
+// Начинаем с эпохи 2: у предыдущей (1) читателей заведомо нет
+#define EPOCH_INITIALIZER { \
+    .current = 2, \
+    .readers = { 0, 0 }, \
+    .pending = 0, \
+    .mutex = PTHREAD_MUTEX_INITIALIZER, \
+    .retired = NULL \
+}
+
+void epoch_init(epoch_t* epoch);
+
+/**
+ * Освобождает все ожидающие версии без учёта читателей.
+ * Только при остановке, когда читателей уже нет
+ */
+void epoch_destroy(epoch_t* epoch);
+
+/**
+ * Начало чтения
+ * @return метка, которую нужно передать в epoch_exit
+ */
+unsigned long epoch_enter(epoch_t* epoch);
+
+/**
+ * Ещё одна метка той же эпохи, что и token. Допустимо, только пока чтение
+ * с меткой token не завершено: так новая метка защищает всё, что уже
+ * прочитано под исходной
+ */
+unsigned long epoch_hold(epoch_t* epoch, unsigned long token);
+
+/**
+ * Завершение чтения. Последний читатель эпохи освобождает версии,
+ * для которых истёк период ожидания
+ */
+void epoch_exit(epoch_t* epoch, unsigned long token);
+
+/**
+ * Передаёт снятую версию на отложенное освобождение.
+ * Новая версия должна быть опубликована до вызова
+ */
+void epoch_retire(epoch_t* epoch, void* ptr, void(*free_cb)(void*));
+
+/**
+ * Продвигает эпоху, насколько позволяют читатели, и освобождает
+ * готовые версии
+ * @return количество освобождённых версий
+ */
+int epoch_reclaim(epoch_t* epoch);
+
+int epoch_pending(epoch_t* epoch);
+
+#endif
@@ -1,12 +1,23 @@
+#include <stdlib.h>
 #include <string.h>
 
 #include "log.h"
 #include "gzip.h"
 
+typedef struct gzip_pool {
+    gzip_t* items[GZIP_POOL_SIZE];
+    size_t count;
+} gzip_pool_t;
+
+static _Thread_local gzip_pool_t __pool = {0};
+
+static void __gzip_destroy(gzip_t* gzip);
+
 int gzip_init(gzip_t* gzip) {
     memset(&gzip->stream, 0, sizeof(z_stream));
     gzip->is_deflate_init = -1;
     gzip->status_code = Z_OK;
+    gzip->level = 0;
 
     return 1;
 }
@@ -21,14 +32,19 @@ int gzip_free(gzip_t* gzip) {
 }
 
 int gzip_deflate_init(gzip_t* const gzip) {
+    return gzip_deflate_init_level(gzip, Z_BEST_SPEED);
+}
+
+int gzip_deflate_init_level(gzip_t* const gzip, const int level) {
     z_stream* const stream = &gzip->stream;
     gzip->is_deflate_init = 0;
+    gzip->level = level;
 
     stream->zalloc = Z_NULL;
     stream->zfree = Z_NULL;
     stream->opaque = Z_NULL;
 
-    if (deflateInit2(stream, Z_BEST_SPEED, Z_DEFLATED, MAX_WBITS + 16, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+    if (deflateInit2(stream, level, Z_DEFLATED, MAX_WBITS + 16, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
         return 0;
 
     return 1;
@@ -69,6 +85,77 @@ int gzip_deflate_has_error(gzip_t* gzip) {
     return gzip->status_code < 0;
 }
 
+gzip_t* gzip_deflate_acquire(const int level) {
+    gzip_pool_t* pool = &__pool;
+
+    // Сначала поток с тем же уровнем: после deflateReset он готов к работе
+    for (size_t i = pool->count; i > 0; i--) {
+        gzip_t* gzip = pool->items[i - 1];
+        if (gzip->level != level) continue;
+
+        pool->items[i - 1] = pool->items[pool->count - 1];
+        pool->count--;
+
+        return gzip;
+    }
+
+    /* Поток с другим уровнем: deflateParams на потоке без данных
+     * только меняет параметры, без сброса буферов. */
+    if (pool->count > 0) {
+        gzip_t* gzip = pool->items[--pool->count];
+        if (deflateParams(&gzip->stream, level, Z_DEFAULT_STRATEGY) == Z_OK) {
+            gzip->level = level;
+            return gzip;
+        }
+
+        __gzip_destroy(gzip);
+    }
+
+    gzip_t* gzip = malloc(sizeof * gzip);
+    if (gzip == NULL) return NULL;
+
+    gzip_init(gzip);
+    if (!gzip_deflate_init_level(gzip, level)) {
+        log_error("gzip_deflate_acquire: deflate init error\n");
+        free(gzip);
+        return NULL;
+    }
+
+    return gzip;
+}
+
+void gzip_deflate_release(gzip_t* gzip) {
+    if (gzip == NULL) return;
+
+    gzip_pool_t* pool = &__pool;
+    if (gzip->is_deflate_init != 0 || pool->count == GZIP_POOL_SIZE) {
+        __gzip_destroy(gzip);
+        return;
+    }
+
+    if (deflateReset(&gzip->stream) != Z_OK) {
+        __gzip_destroy(gzip);
+        return;
+    }
+
+    gzip->status_code = Z_OK;
+    pool->items[pool->count++] = gzip;
+}
+
+void gzip_pool_free(void) {
+    gzip_pool_t* pool = &__pool;
+
+    for (size_t i = 0; i < pool->count; i++)
+        __gzip_destroy(pool->items[i]);
+
+    pool->count = 0;
+}
+
+void __gzip_destroy(gzip_t* gzip) {
+    gzip_free(gzip);
+    free(gzip);
+}
+
 int gzip_inflate_init(gzip_t* gzip, const char* compress_data, const size_t compress_length) {
     z_stream* stream = &gzip->stream;
     if (gzip->is_deflate_init == -1) {
@@ -4,10 +4,12 @@
 #include <zlib.h>
 
 #define GZIP_BUFFER 16384
+#define GZIP_POOL_SIZE 4
 
 typedef struct gzip {
     int is_deflate_init; // -1 nothing, 0 deflate, 1 inflate
     int status_code;
+    int level;
     z_stream stream;
 } gzip_t;
 
@@ -15,11 +17,23 @@ int gzip_init(gzip_t* gzip);
 int gzip_free(gzip_t* gzip);
 
 int gzip_deflate_init(gzip_t* gzip);
+int gzip_deflate_init_level(gzip_t* gzip, const int level);
 size_t gzip_deflate(gzip_t* gzip, const char* compress_data, const size_t compress_length, const int end);
 void gzip_set_in(gzip_t* gzip, const char* data, size_t length);
 int gzip_deflate_free(gzip_t* gzip);
 int gzip_deflate_has_error(gzip_t* gzip);
 
+/*
+ * Пул deflate-потоков потока выполнения. Состояние deflate занимает сотни
+ * килобайт, поэтому вместо deflateInit2/deflateEnd на каждый ответ поток
+ * берётся из пула и возвращается в него после deflateReset.
+ * До GZIP_POOL_SIZE свободных потоков хранится на каждый поток выполнения,
+ * gzip_pool_free освобождает их при завершении потока.
+ */
+gzip_t* gzip_deflate_acquire(const int level);
+void gzip_deflate_release(gzip_t* gzip);
+void gzip_pool_free(void);
+
 int gzip_inflate_init(gzip_t* gzip, const char* compress_data, const size_t compress_length);
 size_t gzip_inflate(gzip_t* gzip, const char* data, const size_t length);
 int gzip_inflate_free(gzip_t* gzip);
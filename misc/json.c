@@ -6,6 +6,7 @@
 
 #include "log.h"
 #include "json.h"
+#include "memstat.h"
 
 // Type-generic min функция (C11)
 static inline int min_int(int a, int b) { return a < b ? a : b; }
@@ -79,8 +80,11 @@ memory_block_t* memory_block_create(size_t element_size, size_t capacity) {
 
     block->capacity = capacity;
     block->used_count = 0;
+    block->memory_size = sizeof * block + memory_size;
     block->next = NULL;
 
+    memstat_add(MEMSTAT_JSON, block->memory_size);
+
     // Инициализируем free-list: создаём цепочку всех слотов
     // Каждый слот указывает на следующий: slot[0] -> slot[1] -> ... -> slot[N-1] -> NULL
     // Используем element_size для вычисления позиций слотов
@@ -103,6 +107,7 @@ memory_block_t* memory_block_create(size_t element_size, size_t capacity) {
 void memory_block_destroy(memory_block_t* block) {
     if (block == NULL) return;
 
+    memstat_sub(MEMSTAT_JSON, block->memory_size);
     free(block->memory);
     free(block);
 }
@@ -14,6 +14,7 @@ typedef struct memory_block {
     void* free_list;                 // Односвязный список свободных слотов
     size_t capacity;                 // Общее количество слотов
     size_t used_count;               // Количество используемых слотов
+    size_t memory_size;              // Учтено в memstat вместе со структурой блока
     struct memory_block* next;       // Следующий блок в списке
 } memory_block_t;
 
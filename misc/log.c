@@ -1,23 +1,179 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <syslog.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "log.h"
+#include "threadring.h"
 #include "appconfig.h"
 
+// Записей в кольце потока, степень двойки
+#define LOG_RING_RECORDS 256
+// Длина сообщения в записи; длинные сообщения обрезаются
+#define LOG_MESSAGE_SIZE 480
+// Пачка строк, которую фоновый поток пишет в файл одним вызовом
+#define LOG_BATCH_SIZE 65536
+// Без сигналов от потоков фоновый поток просыпается с этим интервалом, мс
+#define LOG_IDLE_TIMEOUT_MS 100
+// "2026-01-01 00:00:00.000 [warning] "
+#define LOG_PREFIX_SIZE 48
+
+typedef struct log_record {
+    int priority;
+    unsigned int length;
+    struct timespec time;
+    char message[LOG_MESSAGE_SIZE];
+} log_record_t;
+
+// Кольцо одного потока, head и tail считают записи
+typedef struct log_ring {
+    threadring_t base;
+    log_record_t records[LOG_RING_RECORDS];
+} log_ring_t;
+
+static void log_message(int priority, const char* format, va_list args);
+static void __log_write_sync(int priority, const char* format, va_list args);
+static void __log_push(int priority, const char* format, va_list args);
+static void* __log_writer(void* arg);
+static size_t __log_drain(void);
+static int __log_open_file(const char* path);
+static size_t __log_format_prefix(char* out, const struct timespec* time, int priority);
+static size_t __log_format_line(char* out, size_t size, const struct timespec* time, int priority, const char* message, size_t length);
+static void __log_write_all(int fd, const char* data, size_t size);
+
+static threadrings_t __log_rings = THREADRINGS_INITIALIZER;
+static __thread threadring_t* __log_ring = NULL;
+
+static atomic_bool __log_async = 0;
+static atomic_bool __log_stop = 0;
+static atomic_bool __log_reopen = 0;
+static atomic_int __log_fd = -1;
+static atomic_ullong __log_dropped = 0;
+static int __log_atexit = 0;
+static pthread_t __log_thread;
+// Запуск, остановка и путь к файлу
+static pthread_mutex_t __log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char* __log_path = NULL;
+
+static const char* __log_levels[] = {
+    "emerg", "alert", "crit", "error", "warning", "notice", "info", "debug"
+};
+
 void log_init() {
     openlog(NULL, LOG_CONS | LOG_NDELAY, LOG_USER);
 }
 
 void log_close() {
+    log_async_stop();
+
+    const int fd = atomic_exchange(&__log_fd, -1);
+    if (fd != -1)
+        close(fd);
+
     closelog();
 }
 
-void log_reinit() {
-    log_close();
-    log_init();
+// Вызывается из обработчика сигнала: только атомарный флаг и write,
+// файл переоткрывает фоновый поток
+void log_reopen(void) {
+    atomic_store(&__log_reopen, 1);
+    threadrings_wakeup(&__log_rings);
 }
 
-static void log_message(int priority, const char* format, va_list args) {
+int log_async_start(const char* file) {
+    int result = 0;
+    char* path = NULL;
+
+    pthread_mutex_lock(&__log_mutex);
+
+    if (file != NULL) {
+        path = strdup(file);
+        if (path == NULL) goto failed;
+    }
+
+    free(__log_path);
+    __log_path = path;
+
+    // Файл открывает уже работающий фоновый поток
+    if (atomic_load(&__log_async)) {
+        atomic_store(&__log_reopen, 1);
+        threadrings_wakeup(&__log_rings);
+        result = 1;
+        goto failed;
+    }
+
+    // Файл открывается здесь, просьба о переоткрытии без фонового потока не нужна
+    atomic_store(&__log_reopen, 0);
+
+    if (!__log_open_file(__log_path))
+        goto failed;
+
+    if (!threadrings_open(&__log_rings))
+        goto failed;
+
+    atomic_store(&__log_stop, 0);
+    if (pthread_create(&__log_thread, NULL, __log_writer, NULL) != 0) {
+        threadrings_close(&__log_rings);
+        goto failed;
+    }
+
+    pthread_setname_np(__log_thread, "Server log");
+
+    if (!__log_atexit)
+        __log_atexit = atexit(log_async_stop) == 0;
+
+    atomic_store(&__log_async, 1);
+
+    result = 1;
+
+    failed:
+
+    pthread_mutex_unlock(&__log_mutex);
+
+    return result;
+}
+
+void log_async_stop(void) {
+    pthread_mutex_lock(&__log_mutex);
+
+    if (atomic_load(&__log_rings.wakeup_fd) == -1) {
+        pthread_mutex_unlock(&__log_mutex);
+        return;
+    }
+
+    atomic_store(&__log_async, 0);
+    atomic_store(&__log_stop, 1);
+    threadrings_wakeup(&__log_rings);
+
+    const pthread_t thread = __log_thread;
+
+    // Фоновый поток берёт мьютекс при смене файла
+    pthread_mutex_unlock(&__log_mutex);
+
+    pthread_join(thread, NULL);
+
+    pthread_mutex_lock(&__log_mutex);
+    threadrings_close(&__log_rings);
+    pthread_mutex_unlock(&__log_mutex);
+}
+
+void log_sync(void) {
+    atomic_store(&__log_async, 0);
+}
+
+unsigned long long log_dropped(void) {
+    return atomic_load(&__log_dropped);
+}
+
+void log_message(int priority, const char* format, va_list args) {
     env_t* environment = env();
     if (environment == NULL) return;
 
@@ -25,7 +181,214 @@ static void log_message(int priority, const char* format, va_list args) {
 
     if (priority > environment->main.log.level) return;
 
-    vsyslog(priority, format, args);
+    if (atomic_load_explicit(&__log_async, memory_order_acquire))
+        __log_push(priority, format, args);
+    else
+        __log_write_sync(priority, format, args);
+}
+
+void __log_write_sync(int priority, const char* format, va_list args) {
+    const int fd = atomic_load(&__log_fd);
+    if (fd == -1) {
+        vsyslog(priority, format, args);
+        return;
+    }
+
+    char message[LOG_MESSAGE_SIZE];
+    const int length = vsnprintf(message, sizeof(message), format, args);
+    if (length < 0) return;
+
+    struct timespec time;
+    clock_gettime(CLOCK_REALTIME, &time);
+
+    char line[LOG_PREFIX_SIZE + LOG_MESSAGE_SIZE + 1];
+    const size_t size = __log_format_line(line, sizeof(line), &time, priority, message, (size_t)length < sizeof(message) ? (size_t)length : sizeof(message) - 1);
+
+    __log_write_all(fd, line, size);
+}
+
+void __log_push(int priority, const char* format, va_list args) {
+    log_ring_t* ring = (log_ring_t*)(__log_ring != NULL ? __log_ring : threadrings_attach(&__log_rings, &__log_ring, sizeof(log_ring_t)));
+    if (ring == NULL) return;
+
+    const unsigned long head = atomic_load_explicit(&ring->base.head, memory_order_relaxed);
+    const unsigned long tail = atomic_load_explicit(&ring->base.tail, memory_order_acquire);
+    if (head - tail >= LOG_RING_RECORDS) {
+        atomic_fetch_add_explicit(&ring->base.dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    log_record_t* record = &ring->records[head & (LOG_RING_RECORDS - 1)];
+    record->priority = priority;
+    clock_gettime(CLOCK_REALTIME, &record->time);
+
+    const int length = vsnprintf(record->message, LOG_MESSAGE_SIZE, format, args);
+    if (length < 0)
+        record->length = 0;
+    else
+        record->length = length < LOG_MESSAGE_SIZE ? (unsigned int)length : LOG_MESSAGE_SIZE - 1;
+
+    atomic_store_explicit(&ring->base.head, head + 1, memory_order_release);
+
+    threadrings_notify(&__log_rings);
+}
+
+void* __log_writer(void* arg) {
+    (void)arg;
+
+    threadrings_writer_sigmask();
+
+    while (1) {
+        if (atomic_exchange(&__log_reopen, 0)) {
+            pthread_mutex_lock(&__log_mutex);
+            char* path = __log_path != NULL ? strdup(__log_path) : NULL;
+            pthread_mutex_unlock(&__log_mutex);
+
+            if (!__log_open_file(path))
+                syslog(LOG_ERR, "log: can't open %s: %s", path, strerror(errno));
+
+            free(path);
+        }
+
+        const int stop = atomic_load(&__log_stop);
+        const size_t records = __log_drain();
+        threadrings_collect(&__log_rings);
+
+        if (stop) break;
+        if (records > 0) continue;
+
+        // Смена файла и остановка будят через eventfd, он остаётся взведённым до poll
+        threadrings_sleep(&__log_rings, LOG_IDLE_TIMEOUT_MS, 1);
+    }
+
+    return NULL;
+}
+
+/*
+ * Забирает записи всех колец. В файл строки уходят пачками,
+ * в syslog - по одной, но уже из фонового потока.
+ */
+size_t __log_drain(void) {
+    static char batch[LOG_BATCH_SIZE];
+    size_t batch_size = 0;
+    size_t records = 0;
+    unsigned long long dropped = 0;
+    const int fd = atomic_load(&__log_fd);
+
+    for (threadring_t* base = atomic_load(&__log_rings.rings); base != NULL; base = base->next) {
+        const log_ring_t* ring = (const log_ring_t*)base;
+        unsigned long tail = atomic_load_explicit(&base->tail, memory_order_relaxed);
+        const unsigned long head = atomic_load_explicit(&base->head, memory_order_acquire);
+
+        for (; tail != head; tail++) {
+            const log_record_t* record = &ring->records[tail & (LOG_RING_RECORDS - 1)];
+
+            if (fd == -1)
+                syslog(record->priority, "%.*s", (int)record->length, record->message);
+            else {
+                if (LOG_BATCH_SIZE - batch_size < LOG_PREFIX_SIZE + LOG_MESSAGE_SIZE + 1) {
+                    __log_write_all(fd, batch, batch_size);
+                    batch_size = 0;
+                }
+
+                batch_size += __log_format_line(batch + batch_size, LOG_BATCH_SIZE - batch_size, &record->time, record->priority, record->message, record->length);
+            }
+
+            records++;
+        }
+
+        atomic_store_explicit(&base->tail, tail, memory_order_release);
+
+        dropped += threadring_dropped(base);
+    }
+
+    if (dropped > 0) {
+        atomic_fetch_add(&__log_dropped, dropped);
+
+        char message[64];
+        const int length = snprintf(message, sizeof(message), "log: %llu messages dropped, ring is full", dropped);
+
+        if (fd == -1)
+            syslog(LOG_WARNING, "%s", message);
+        else {
+            struct timespec time;
+            clock_gettime(CLOCK_REALTIME, &time);
+
+            if (LOG_BATCH_SIZE - batch_size < LOG_PREFIX_SIZE + sizeof(message) + 1) {
+                __log_write_all(fd, batch, batch_size);
+                batch_size = 0;
+            }
+
+            batch_size += __log_format_line(batch + batch_size, LOG_BATCH_SIZE - batch_size, &time, LOG_WARNING, message, length);
+        }
+    }
+
+    if (batch_size > 0)
+        __log_write_all(fd, batch, batch_size);
+
+    return records;
+}
+
+// path == NULL - запись в syslog
+int __log_open_file(const char* path) {
+    int fd = -1;
+    if (path != NULL) {
+        fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        if (fd == -1) return 0;
+    }
+
+    const int old = atomic_exchange(&__log_fd, fd);
+    if (old != -1)
+        close(old);
+
+    return 1;
+}
+
+size_t __log_format_prefix(char* out, const struct timespec* time, int priority) {
+    // Фоновый поток пишет строки по порядку, секунды форматируются раз в секунду
+    static __thread time_t cached_second = -1;
+    static __thread char cached[24];
+
+    if (time->tv_sec != cached_second) {
+        struct tm tm;
+        localtime_r(&time->tv_sec, &tm);
+        strftime(cached, sizeof(cached), "%Y-%m-%d %H:%M:%S", &tm);
+        cached_second = time->tv_sec;
+    }
+
+    const char* level = priority >= LOG_EMERG && priority <= LOG_DEBUG ? __log_levels[priority] : "unknown";
+    const int size = snprintf(out, LOG_PREFIX_SIZE, "%s.%03ld [%s] ", cached, time->tv_nsec / 1000000, level);
+
+    return size > 0 && size < LOG_PREFIX_SIZE ? (size_t)size : 0;
+}
+
+// Строка файла журнала; перевод строки в конце сообщения не удваивается
+size_t __log_format_line(char* out, size_t size, const struct timespec* time, int priority, const char* message, size_t length) {
+    while (length > 0 && (message[length - 1] == '\n' || message[length - 1] == '\r'))
+        length--;
+
+    if (size < LOG_PREFIX_SIZE + length + 1)
+        return 0;
+
+    size_t pos = __log_format_prefix(out, time, priority);
+    memcpy(out + pos, message, length);
+    pos += length;
+    out[pos++] = '\n';
+
+    return pos;
+}
+
+void __log_write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        const ssize_t writed = write(fd, data, size);
+        if (writed < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+
+        data += writed;
+        size -= (size_t)writed;
+    }
 }
 
 void log_emerg(const char* format, ...) {
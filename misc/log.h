@@ -3,11 +3,49 @@
 
 #include <stdarg.h>
 
+/**
+ * Журнал. Уровень проверяется до форматирования сообщения.
+ *
+ * До log_async_start и после log_async_stop сообщения пишутся сразу
+ * в вызывающем потоке. В асинхронном режиме поток только форматирует
+ * сообщение в собственное кольцо; фоновый поток забирает записи всех колец
+ * и пишет их пачками в файл или в syslog. Если кольцо заполнено, сообщение
+ * отбрасывается и учитывается в log_dropped - поток никогда не ждёт журнал.
+ */
+
 void log_init();
 
 void log_close();
 
-void log_reinit();
+/**
+ * Переоткрыть файл журнала после внешней ротации. Безопасна в обработчике
+ * сигнала: файл переоткрывает фоновый поток, без него запрос игнорируется
+ */
+void log_reopen(void);
+
+/**
+ * Запуск фоновой записи. file - путь к файлу журнала или NULL для syslog.
+ * Повторный вызов только меняет место записи.
+ * @return 1 при успехе, 0 если файл не открыть или поток не запустить
+ */
+int log_async_start(const char* file);
+
+/**
+ * Остановка фоновой записи: накопленные сообщения дописываются,
+ * дальше запись синхронная
+ */
+void log_async_stop(void);
+
+/**
+ * Немедленный переход на синхронную запись без ожидания фонового потока.
+ * Для обработчиков сигналов, после которых процесс завершается
+ */
+void log_sync(void);
+
+/**
+ * Число отброшенных из-за переполнения колец сообщений
+ */
+unsigned long long log_dropped(void);
 
 void log_emerg(const char*, ...);
 
@@ -25,4 +63,4 @@ void log_info(const char*, ...);
 
 void log_debug(const char*, ...);
 
-#endif
\ No newline at end of file
+#endif
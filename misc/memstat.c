@@ -0,0 +1,190 @@
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "memstat.h"
+#include "threadshard.h"
+
+/*
+ * Счётчики одного потока. Пишет только поток-владелец, поэтому достаточно
+ * relaxed-операций. Набор завершившегося потока не удаляется и сохраняет
+ * значения: память, выделенная в нём, может быть освобождена другим потоком.
+ */
+typedef struct memstat_shard {
+    threadshard_t base;
+    atomic_llong bytes[MEMSTAT_COUNT];
+} memstat_shard_t;
+
+static const char* __names[MEMSTAT_COUNT] = {
+    "connections", "buffers", "bodies", "json", "viewstore", "dbresult", "broadcast", "httpclient"
+};
+
+static threadshards_t __shards = THREADSHARDS_INITIALIZER;
+static _Thread_local threadshard_t* __shard = NULL;
+
+static atomic_size_t __limits[MEMSTAT_COUNT + 1] = {0};
+static atomic_bool __limited = 0;
+static atomic_ullong __shed[MEMSTAT_COUNT] = {0};
+
+// Суммы на момент __cached_at для проверки лимитов
+static atomic_size_t __cached[MEMSTAT_COUNT + 1] = {0};
+static atomic_ullong __cached_at = 0;
+
+static void __change(memstat_subsystem_e subsystem, long long bytes);
+static void __sum(size_t* bytes, size_t* total);
+static void __refresh(void);
+static unsigned long long __now_ms(void);
+static size_t __rss(void);
+
+void memstat_add(memstat_subsystem_e subsystem, size_t bytes) {
+    __change(subsystem, (long long)bytes);
+}
+
+void memstat_sub(memstat_subsystem_e subsystem, size_t bytes) {
+    __change(subsystem, -(long long)bytes);
+}
+
+const char* memstat_name(memstat_subsystem_e subsystem) {
+    if (subsystem >= MEMSTAT_COUNT) return "total";
+
+    return __names[subsystem];
+}
+
+int memstat_find(const char* name) {
+    if (name == NULL) return -1;
+    if (strcmp(name, "total") == 0) return MEMSTAT_TOTAL;
+
+    for (int i = 0; i < MEMSTAT_COUNT; i++)
+        if (strcmp(__names[i], name) == 0)
+            return i;
+
+    return -1;
+}
+
+void memstat_snapshot(memstat_stats_t* stats) {
+    __sum(stats->bytes, &stats->total);
+
+    for (int i = 0; i < MEMSTAT_COUNT; i++) {
+        stats->limits[i] = atomic_load_explicit(&__limits[i], memory_order_relaxed);
+        stats->shed[i] = atomic_load_explicit(&__shed[i], memory_order_relaxed);
+    }
+
+    stats->total_limit = atomic_load_explicit(&__limits[MEMSTAT_TOTAL], memory_order_relaxed);
+    stats->rss = __rss();
+}
+
+void memstat_set_limit(int subsystem, size_t bytes) {
+    if (subsystem < 0 || subsystem > MEMSTAT_TOTAL) return;
+
+    atomic_store(&__limits[subsystem], bytes);
+
+    int limited = 0;
+    for (int i = 0; i <= MEMSTAT_TOTAL; i++)
+        if (atomic_load(&__limits[i]) > 0)
+            limited = 1;
+
+    // Новый лимит проверяется по свежим суммам
+    atomic_store(&__cached_at, 0);
+    atomic_store(&__limited, limited);
+}
+
+void memstat_reset_limits(void) {
+    for (int i = 0; i <= MEMSTAT_TOTAL; i++)
+        atomic_store(&__limits[i], 0);
+
+    atomic_store(&__limited, 0);
+}
+
+int memstat_should_shed(memstat_subsystem_e subsystem) {
+    if (!atomic_load_explicit(&__limited, memory_order_relaxed)) return 0;
+    if (subsystem >= MEMSTAT_COUNT) return 0;
+
+    __refresh();
+
+    const size_t limit = atomic_load_explicit(&__limits[subsystem], memory_order_relaxed);
+    const size_t total_limit = atomic_load_explicit(&__limits[MEMSTAT_TOTAL], memory_order_relaxed);
+
+    const int exceeded = (limit > 0 && atomic_load_explicit(&__cached[subsystem], memory_order_relaxed) >= limit)
+        || (total_limit > 0 && atomic_load_explicit(&__cached[MEMSTAT_TOTAL], memory_order_relaxed) >= total_limit);
+
+    if (exceeded)
+        atomic_fetch_add_explicit(&__shed[subsystem], 1, memory_order_relaxed);
+
+    return exceeded;
+}
+
+void __change(memstat_subsystem_e subsystem, long long bytes) {
+    if (subsystem >= MEMSTAT_COUNT || bytes == 0) return;
+
+    memstat_shard_t* shard = (memstat_shard_t*)(__shard != NULL ? __shard : threadshards_attach(&__shards, &__shard, sizeof(memstat_shard_t)));
+    if (shard == NULL) return;
+
+    atomic_llong* counter = &shard->bytes[subsystem];
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + bytes, memory_order_relaxed);
+}
+
+void __sum(size_t* bytes, size_t* total) {
+    long long sums[MEMSTAT_COUNT] = {0};
+
+    for (threadshard_t* base = atomic_load(&__shards.shards); base != NULL; base = base->next)
+        for (int i = 0; i < MEMSTAT_COUNT; i++)
+            sums[i] += atomic_load_explicit(&((memstat_shard_t*)base)->bytes[i], memory_order_relaxed);
+
+    *total = 0;
+    for (int i = 0; i < MEMSTAT_COUNT; i++) {
+        // Наборы читаются не одновременно: освобождение может попасть в сумму раньше выделения
+        bytes[i] = sums[i] > 0 ? (size_t)sums[i] : 0;
+        *total += bytes[i];
+    }
+}
+
+void __refresh(void) {
+    const unsigned long long now = __now_ms();
+    unsigned long long cached_at = atomic_load_explicit(&__cached_at, memory_order_relaxed);
+
+    if (cached_at != 0 && now - cached_at < MEMSTAT_REFRESH_MS) return;
+
+    // Пересчитывает один поток, остальные пользуются прежними суммами
+    if (!atomic_compare_exchange_strong(&__cached_at, &cached_at, now)) return;
+
+    size_t bytes[MEMSTAT_COUNT];
+    size_t total = 0;
+    __sum(bytes, &total);
+
+    for (int i = 0; i < MEMSTAT_COUNT; i++)
+        atomic_store_explicit(&__cached[i], bytes[i], memory_order_relaxed);
+
+    atomic_store_explicit(&__cached[MEMSTAT_TOTAL], total, memory_order_relaxed);
+}
+
+unsigned long long __now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+
+    // Не ноль: ноль означает, что суммы ещё не считались
+    return (unsigned long long)ts.tv_sec * 1000ULL + (unsigned long long)ts.tv_nsec / 1000000ULL + 1;
+}
+
+size_t __rss(void) {
+    const int fd = open("/proc/self/statm", O_RDONLY);
+    if (fd == -1) return 0;
+
+    char data[128];
+    const ssize_t size = read(fd, data, sizeof(data) - 1);
+    close(fd);
+
+    if (size <= 0) return 0;
+    data[size] = 0;
+
+    unsigned long pages = 0;
+    unsigned long resident = 0;
+    if (sscanf(data, "%lu %lu", &pages, &resident) != 2) return 0;
+
+    const long page_size = sysconf(_SC_PAGESIZE);
+
+    return (size_t)resident * (size_t)(page_size > 0 ? page_size : 4096);
+}
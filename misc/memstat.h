@@ -0,0 +1,78 @@
+#ifndef __MEMSTAT__
+#define __MEMSTAT__
+
+#include <stddef.h>
+
+/**
+ * Учёт памяти по подсистемам.
+ *
+ * Каждый поток пишет в свой набор счётчиков без атомарных read-modify-write,
+ * при чтении наборы всех потоков суммируются. Освобождение может случиться
+ * в другом потоке, чем выделение, поэтому счётчик отдельного потока бывает
+ * отрицательным, сумма - нет.
+ *
+ * Учитываются только крупные долгоживущие объекты: структуры соединений
+ * и парсеров (с встроенным статическим буфером bufferdata), динамические
+ * буферы bufferdata, буферы bufo_t, блоки памяти json, шаблоны viewstore,
+ * таблицы dbresult, очереди broadcast и пул соединений httpclient.
+ */
+
+typedef enum {
+    MEMSTAT_CONNECTIONS = 0,       // connection_t, контекст и парсер
+    MEMSTAT_BUFFERS,               // Динамические буферы bufferdata_t
+    MEMSTAT_BODIES,                // bufo_t: тела ответов и буферы фильтров
+    MEMSTAT_JSON,                  // Блоки менеджера токенов json
+    MEMSTAT_VIEWSTORE,             // Разобранные шаблоны
+    MEMSTAT_DBRESULT,              // Таблицы результатов запросов к БД
+    MEMSTAT_BROADCAST,             // Каналы, подписчики и сообщения в очередях
+    MEMSTAT_HTTPCLIENT,            // Пул соединений httpclient
+    MEMSTAT_COUNT
+} memstat_subsystem_e;
+
+// Номер общего лимита в memstat_set_limit
+#define MEMSTAT_TOTAL MEMSTAT_COUNT
+
+// Как часто пересчитываются суммы для проверки лимитов
+#define MEMSTAT_REFRESH_MS 10
+
+typedef struct memstat_stats {
+    size_t bytes[MEMSTAT_COUNT];
+    size_t limits[MEMSTAT_COUNT];
+    unsigned long long shed[MEMSTAT_COUNT];
+    size_t total;
+    size_t total_limit;
+    size_t rss;                    // Резидентная память процесса, 0 если недоступно
+} memstat_stats_t;
+
+void memstat_add(memstat_subsystem_e subsystem, size_t bytes);
+void memstat_sub(memstat_subsystem_e subsystem, size_t bytes);
+
+const char* memstat_name(memstat_subsystem_e subsystem);
+
+/**
+ * @return номер подсистемы, MEMSTAT_TOTAL для "total" или -1
+ */
+int memstat_find(const char* name);
+
+void memstat_snapshot(memstat_stats_t* stats);
+
+/**
+ * Мягкий лимит подсистемы или общий (MEMSTAT_TOTAL), 0 - без лимита.
+ */
+void memstat_set_limit(int subsystem, size_t bytes);
+void memstat_reset_limits(void);
+
+/**
+ * Превышен ли лимит подсистемы или общий лимит. Вызывается перед созданием
+ * нового объекта; при положительном ответе вызывающий отказывается от него,
+ * отказ засчитывается подсистеме. Суммы пересчитываются не чаще раза
+ * в MEMSTAT_REFRESH_MS, без лимитов проверка ничего не стоит.
+ *
+ * Точки отказа: connections - приём соединения; bodies, buffers, json,
+ * dbresult - запрос до обработчика (503); viewstore - разбор нового
+ * шаблона; broadcast - сообщение в очередь; httpclient - возврат
+ * соединения в пул.
+ */
+int memstat_should_shed(memstat_subsystem_e subsystem);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef __PROBES__
+#define __PROBES__
+
+/**
+ * Статические точки трассировки USDT (провайдер cwfr) для bpftrace/perf.
+ *
+ * Собираются с -DINCLUDE_USDT=yes при наличии <sys/sdt.h> (systemtap-sdt-dev).
+ * Точка - одна инструкция nop и запись в секции .note.stapsdt; пока трассировщик
+ * не подключён, кроме nop ничего не выполняется. Без INCLUDE_USDT макрос пуст.
+ * Аргументы должны быть уже вычисленными значениями: они вычисляются и без
+ * трассировщика.
+ *
+ * Точки (аргументы по порядку):
+ *   conn_accept        fd, remote_ip, remote_port
+ *   conn_close         fd
+ *   request_parsed     fd, method, path, parse_ns
+ *   handler_enqueue    fd, priority
+ *   handler_dequeue    fd, wait_ns
+ *   handler_start      fd, path
+ *   handler_end        fd, duration_ns
+ *   response_complete  fd, status, bytes, duration_ns
+ *   db_query_start     dbid, sql или имя подготовленного запроса
+ *   db_query_end       dbid, ok
+ *   broadcast_send     broadcast_name, size
+ *   tls_handshake      fd, resumed, duration_ns
+ *
+ * Пример: bpftrace -e 'usdt:./cwfr:cwfr:handler_end { @us = hist(arg1 / 1000); }'
+ */
+
+#ifdef CWFR_USDT
+#include <sys/sdt.h>
+
+#define CWFR_PROBE(name, ...) STAP_PROBEV(cwfr, name, __VA_ARGS__)
+#else
+#define CWFR_PROBE(name, ...) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,170 @@
+#define _GNU_SOURCE
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "threadring.h"
+
+static void __ring_release(void* arg);
+static int __key_create(threadrings_t* rings);
+
+threadring_t* threadrings_attach(threadrings_t* rings, threadring_t** local, size_t size) {
+    if (!__key_create(rings)) return NULL;
+
+    threadring_t* ring = malloc(size);
+    if (ring == NULL) return NULL;
+
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+    ring->reported = 0;
+    atomic_init(&ring->closed, 0);
+    ring->local = local;
+
+    threadring_t* head = atomic_load(&rings->rings);
+    do {
+        ring->next = head;
+    } while (!atomic_compare_exchange_weak(&rings->rings, &head, ring));
+
+    *local = ring;
+    pthread_setspecific(rings->key, ring);
+
+    return ring;
+}
+
+/*
+ * Освобождение дочитанных колец завершившихся потоков. Потоки только
+ * добавляют кольца в начало списка, поэтому звенья после первого меняет
+ * лишь фоновый поток.
+ */
+void threadrings_collect(threadrings_t* rings) {
+    threadring_t* prev = NULL;
+    threadring_t* ring = atomic_load(&rings->rings);
+
+    while (ring != NULL) {
+        threadring_t* next = ring->next;
+
+        if (!atomic_load(&ring->closed) || atomic_load(&ring->head) != atomic_load(&ring->tail)) {
+            prev = ring;
+            ring = next;
+            continue;
+        }
+
+        if (prev == NULL) {
+            threadring_t* expected = ring;
+            if (!atomic_compare_exchange_strong(&rings->rings, &expected, next)) {
+                // Перед кольцом добавились новые, ищем предыдущее звено
+                prev = expected;
+                while (prev->next != ring)
+                    prev = prev->next;
+
+                prev->next = next;
+            }
+        }
+        else
+            prev->next = next;
+
+        free(ring);
+        ring = next;
+    }
+}
+
+int threadrings_pending(threadrings_t* rings) {
+    for (threadring_t* ring = atomic_load(&rings->rings); ring != NULL; ring = ring->next)
+        if (atomic_load_explicit(&ring->head, memory_order_acquire) != atomic_load_explicit(&ring->tail, memory_order_relaxed))
+            return 1;
+
+    return 0;
+}
+
+unsigned long long threadring_dropped(threadring_t* ring) {
+    const unsigned long long dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+    const unsigned long long count = dropped - ring->reported;
+    ring->reported = dropped;
+
+    return count;
+}
+
+int threadrings_open(threadrings_t* rings) {
+    const int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd == -1) return 0;
+
+    atomic_store(&rings->sleeping, 0);
+    atomic_store(&rings->wakeup_fd, fd);
+
+    return 1;
+}
+
+void threadrings_close(threadrings_t* rings) {
+    const int fd = atomic_exchange(&rings->wakeup_fd, -1);
+    if (fd != -1)
+        close(fd);
+}
+
+void threadrings_wakeup(threadrings_t* rings) {
+    const int fd = atomic_load(&rings->wakeup_fd);
+    if (fd == -1) return;
+
+    const uint64_t value = 1;
+    if (write(fd, &value, sizeof(value)) < 0) {}
+}
+
+void threadrings_notify(threadrings_t* rings) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&rings->sleeping, memory_order_relaxed) && atomic_exchange(&rings->sleeping, 0))
+        threadrings_wakeup(rings);
+}
+
+void threadrings_sleep(threadrings_t* rings, int timeout_ms, int recheck) {
+    atomic_store(&rings->sleeping, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (recheck && threadrings_pending(rings)) {
+        atomic_store(&rings->sleeping, 0);
+        return;
+    }
+
+    struct pollfd pfd = { .fd = atomic_load(&rings->wakeup_fd), .events = POLLIN, .revents = 0 };
+    poll(&pfd, 1, timeout_ms);
+    atomic_store(&rings->sleeping, 0);
+
+    if (pfd.revents & POLLIN) {
+        uint64_t value = 0;
+        if (read(pfd.fd, &value, sizeof(value)) < 0) {}
+    }
+}
+
+void threadrings_writer_sigmask(void) {
+    sigset_t mask;
+    sigfillset(&mask);
+    sigdelset(&mask, SIGSEGV);
+    sigdelset(&mask, SIGBUS);
+    sigdelset(&mask, SIGFPE);
+    sigdelset(&mask, SIGILL);
+    sigdelset(&mask, SIGABRT);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+}
+
+// Кольцо завершившегося потока освобождает фоновый поток, дочитав его
+void __ring_release(void* arg) {
+    threadring_t* ring = arg;
+
+    *ring->local = NULL;
+    atomic_store(&ring->closed, 1);
+}
+
+// Ключ создаётся при первом кольце; дальше проверка обходится без мьютекса
+int __key_create(threadrings_t* rings) {
+    if (atomic_load_explicit(&rings->key_created, memory_order_acquire)) return 1;
+
+    pthread_mutex_lock(&rings->key_mutex);
+    if (!atomic_load_explicit(&rings->key_created, memory_order_relaxed)
+        && pthread_key_create(&rings->key, __ring_release) == 0)
+        atomic_store_explicit(&rings->key_created, 1, memory_order_release);
+    pthread_mutex_unlock(&rings->key_mutex);
+
+    return atomic_load_explicit(&rings->key_created, memory_order_acquire);
+}
@@ -0,0 +1,107 @@
+#ifndef __THREADRING__
+#define __THREADRING__
+
+#include <stdatomic.h>
+#include <pthread.h>
+
+/**
+ * Кольца потоков для фоновой записи (журнал, журнал доступа).
+ *
+ * Каждый поток пишет в собственное кольцо (head), читает его только
+ * фоновый поток (tail), поэтому обе стороны обходятся без блокировок.
+ * Формат записей задаёт пользователь: threadring_t - первое поле его
+ * структуры кольца. Кольцо завершившегося потока освобождает фоновый
+ * поток в threadrings_collect, дочитав его.
+ *
+ * Фоновый поток спит в threadrings_sleep; производитель будит его через
+ * threadrings_notify только если тот объявил сон, поэтому запись обычно
+ * обходится без системных вызовов.
+ */
+
+typedef struct threadring {
+    atomic_ulong head;
+    atomic_ulong tail;
+    atomic_ullong dropped;         // Отброшено при заполненном кольце
+    unsigned long long reported;   // Из них учтено фоновым потоком
+    atomic_bool closed;            // Поток-владелец завершился
+    struct threadring* next;
+    struct threadring** local;     // Переменная потока-владельца с этим кольцом
+} threadring_t;
+
+typedef struct threadrings {
+    _Atomic(threadring_t*) rings;
+    atomic_bool key_created;
+    pthread_key_t key;
+    pthread_mutex_t key_mutex;
+    atomic_bool sleeping;          // Фоновый поток объявил сон
+    atomic_int wakeup_fd;          // eventfd пробуждения, -1 - фоновый поток не запущен
+} threadrings_t;
+
+#define THREADRINGS_INITIALIZER { \
+    .rings = NULL, \
+    .key_created = 0, \
+    .key_mutex = PTHREAD_MUTEX_INITIALIZER, \
+    .sleeping = 0, \
+    .wakeup_fd = -1 \
+}
+
+/**
+ * Создаёт кольцо вызывающего потока и записывает его в *local
+ * @param local - переменная _Thread_local, обнуляется при завершении потока
+ * @param size - размер структуры кольца пользователя
+ * @return кольцо или NULL, если не хватило памяти
+ */
+threadring_t* threadrings_attach(threadrings_t* rings, threadring_t** local, size_t size);
+
+/**
+ * Освобождает дочитанные кольца завершившихся потоков. Только фоновый поток
+ */
+void threadrings_collect(threadrings_t* rings);
+
+/**
+ * 1 - в каком-либо кольце есть непрочитанные записи
+ */
+int threadrings_pending(threadrings_t* rings);
+
+/**
+ * Число отброшенных записей кольца с прошлого вызова. Только фоновый поток
+ */
+unsigned long long threadring_dropped(threadring_t* ring);
+
+/**
+ * Создаёт eventfd пробуждения перед запуском фонового потока
+ * @return 1 при успехе
+ */
+int threadrings_open(threadrings_t* rings);
+
+/**
+ * Закрывает eventfd после остановки фонового потока
+ */
+void threadrings_close(threadrings_t* rings);
+
+/**
+ * Будит фоновый поток. Безопасна в обработчике сигнала
+ */
+void threadrings_wakeup(threadrings_t* rings);
+
+/**
+ * Будит фоновый поток после публикации записи, если он объявил сон.
+ * Будит только первый записавший
+ */
+void threadrings_notify(threadrings_t* rings);
+
+/**
+ * Сон фонового потока до threadrings_wakeup или timeout_ms.
+ * @param recheck - после объявления сна проверить кольца: запись,
+ * опубликованная до объявления, не будет ждать таймера. 0 - записи копятся
+ * до таймера или явного пробуждения
+ */
+void threadrings_sleep(threadrings_t* rings, int timeout_ms, int recheck);
+
+/**
+ * Блокирует в вызывающем (фоновом) потоке сигналы, кроме аварийных:
+ * перезагрузку и завершение обрабатывают другие потоки
+ */
+void threadrings_writer_sigmask(void);
+
+#endif
@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "threadshard.h"
+
+static void __shard_release(void* arg);
+static int __key_create(threadshards_t* shards);
+
+threadshard_t* threadshards_attach(threadshards_t* shards, threadshard_t** local, size_t size) {
+    if (!__key_create(shards)) return NULL;
+
+    threadshard_t* shard = NULL;
+    for (threadshard_t* item = atomic_load(&shards->shards); item != NULL; item = item->next) {
+        _Bool expected = 0;
+        if (atomic_compare_exchange_strong(&item->owned, &expected, 1)) {
+            shard = item;
+            break;
+        }
+    }
+
+    if (shard == NULL) {
+        // Наборы соседних потоков не делят строку кэша
+        const size_t aligned_size = (size + THREADSHARD_ALIGN - 1) / THREADSHARD_ALIGN * THREADSHARD_ALIGN;
+        shard = aligned_alloc(THREADSHARD_ALIGN, aligned_size);
+        if (shard == NULL) return NULL;
+
+        memset(shard, 0, aligned_size);
+        atomic_init(&shard->owned, 1);
+
+        threadshard_t* head = atomic_load(&shards->shards);
+        do {
+            shard->next = head;
+        } while (!atomic_compare_exchange_weak(&shards->shards, &head, shard));
+    }
+
+    shard->local = local;
+    *local = shard;
+    pthread_setspecific(shards->key, shard);
+
+    return shard;
+}
+
+// Набор завершившегося потока свободен для следующего нового потока
+void __shard_release(void* arg) {
+    threadshard_t* shard = arg;
+
+    *shard->local = NULL;
+    atomic_store(&shard->owned, 0);
+}
+
+// Ключ создаётся при первом наборе; дальше проверка обходится без мьютекса
+int __key_create(threadshards_t* shards) {
+    if (atomic_load_explicit(&shards->key_created, memory_order_acquire)) return 1;
+
+    pthread_mutex_lock(&shards->key_mutex);
+    if (!atomic_load_explicit(&shards->key_created, memory_order_relaxed)
+        && pthread_key_create(&shards->key, __shard_release) == 0)
+        atomic_store_explicit(&shards->key_created, 1, memory_order_release);
+    pthread_mutex_unlock(&shards->key_mutex);
+
+    return atomic_load_explicit(&shards->key_created, memory_order_acquire);
+}
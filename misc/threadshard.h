@@ -0,0 +1,48 @@
+#ifndef __THREADSHARD__
+#define __THREADSHARD__
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/**
+ * Наборы счётчиков потоков (memstat, metrics).
+ *
+ * Каждый поток пишет в собственный набор, читатель суммирует все наборы
+ * списка. Набор завершившегося потока не удаляется и сохраняет значения,
+ * а переходит к следующему новому потоку, чтобы суммы не убывали.
+ * Формат счётчиков задаёт пользователь: threadshard_t - первое поле его
+ * структуры набора.
+ */
+
+#define THREADSHARD_ALIGN 64
+
+typedef struct threadshard {
+    atomic_bool owned;             // Набор занят живым потоком
+    struct threadshard* next;
+    struct threadshard** local;    // Переменная потока-владельца с этим набором
+} threadshard_t;
+
+typedef struct threadshards {
+    _Atomic(threadshard_t*) shards;
+    atomic_bool key_created;
+    pthread_key_t key;
+    pthread_mutex_t key_mutex;
+} threadshards_t;
+
+#define THREADSHARDS_INITIALIZER { \
+    .shards = NULL, \
+    .key_created = 0, \
+    .key_mutex = PTHREAD_MUTEX_INITIALIZER \
+}
+
+/**
+ * Закрепляет за вызывающим потоком свободный набор или создаёт новый,
+ * обнулённый и выровненный по THREADSHARD_ALIGN, и записывает его в *local
+ * @param local - переменная _Thread_local, обнуляется при завершении потока
+ * @param size - размер структуры набора пользователя
+ * @return набор или NULL, если не хватило памяти
+ */
+threadshard_t* threadshards_attach(threadshards_t* shards, threadshard_t** local, size_t size);
+
+#endif
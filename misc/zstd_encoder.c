@@ -0,0 +1,109 @@
+#include "log.h"
+#include "zstd_encoder.h"
+
+#ifdef Zstd_FOUND
+#include <zstd.h>
+#endif
+
+int zstd_encoder_enabled(void) {
+#ifdef Zstd_FOUND
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+void zstd_encoder_init(zstd_encoder_t* encoder) {
+    encoder->cctx = NULL;
+    encoder->next_in = NULL;
+    encoder->avail_in = 0;
+    encoder->avail_out = 0;
+    encoder->status = 0;
+    encoder->finished = 0;
+}
+
+int zstd_encoder_start(zstd_encoder_t* encoder, int level) {
+#ifdef Zstd_FOUND
+    zstd_encoder_free(encoder);
+
+    encoder->cctx = ZSTD_createCCtx();
+    if (encoder->cctx == NULL) {
+        log_error("zstd_encoder_start: can't create context\n");
+        return 0;
+    }
+
+    if (ZSTD_isError(ZSTD_CCtx_setParameter(encoder->cctx, ZSTD_c_compressionLevel, level))) {
+        zstd_encoder_free(encoder);
+        return 0;
+    }
+
+    return 1;
+#else
+    (void)encoder;
+    (void)level;
+    return 0;
+#endif
+}
+
+void zstd_encoder_set_in(zstd_encoder_t* encoder, const char* data, size_t length) {
+    encoder->next_in = data;
+    encoder->avail_in = length;
+}
+
+size_t zstd_encoder_compress(zstd_encoder_t* encoder, char* out, size_t out_length, int end) {
+#ifdef Zstd_FOUND
+    ZSTD_inBuffer input = { encoder->next_in, encoder->avail_in, 0 };
+    ZSTD_outBuffer output = { out, out_length, 0 };
+
+    // ZSTD_e_flush - аналог Z_SYNC_FLUSH: кусок тела уходит без задержки
+    const size_t remaining = ZSTD_compressStream2(encoder->cctx, &output, &input, end ? ZSTD_e_end : ZSTD_e_flush);
+    if (ZSTD_isError(remaining)) {
+        log_error("zstd_encoder_compress: %s\n", ZSTD_getErrorName(remaining));
+        encoder->status = -1;
+        return 0;
+    }
+
+    encoder->next_in += input.pos;
+    encoder->avail_in -= input.pos;
+    encoder->avail_out = out_length - output.pos;
+    encoder->finished = end && remaining == 0;
+
+    return output.pos;
+#else
+    (void)out;
+    (void)out_length;
+    (void)end;
+    encoder->status = -1;
+    return 0;
+#endif
+}
+
+void zstd_encoder_free(zstd_encoder_t* encoder) {
+#ifdef Zstd_FOUND
+    if (encoder->cctx != NULL)
+        ZSTD_freeCCtx(encoder->cctx);
+#endif
+
+    zstd_encoder_init(encoder);
+}
+
+size_t zstd_encoder_bound(size_t length) {
+#ifdef Zstd_FOUND
+    return ZSTD_compressBound(length);
+#else
+    (void)length;
+    return 0;
+#endif
+}
+
+int zstd_encoder_has_error(zstd_encoder_t* encoder) {
+    return encoder->status < 0;
+}
+
+int zstd_encoder_is_end(zstd_encoder_t* encoder) {
+    return encoder->finished;
+}
+
+int zstd_encoder_want_continue(zstd_encoder_t* encoder) {
+    return encoder->avail_out == 0;
+}
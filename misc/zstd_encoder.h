@@ -0,0 +1,33 @@
+#ifndef __ZSTD_ENCODER__
+#define __ZSTD_ENCODER__
+
+#include <stddef.h>
+
+struct ZSTD_CCtx_s;
+
+/**
+ * Потоковое сжатие zstd с интерфейсом gzip_deflate.
+ * Без подключённой библиотеки (-DZstd_FOUND) zstd_encoder_enabled()
+ * возвращает 0, а инициализация завершается ошибкой.
+ */
+typedef struct zstd_encoder {
+    struct ZSTD_CCtx_s* cctx;
+    const char* next_in;
+    size_t avail_in;
+    size_t avail_out;
+    int status;                    // 0 - ok, -1 - ошибка
+    int finished;
+} zstd_encoder_t;
+
+int zstd_encoder_enabled(void);
+void zstd_encoder_init(zstd_encoder_t* encoder);
+int zstd_encoder_start(zstd_encoder_t* encoder, int level);
+void zstd_encoder_set_in(zstd_encoder_t* encoder, const char* data, size_t length);
+size_t zstd_encoder_compress(zstd_encoder_t* encoder, char* out, size_t out_length, int end);
+void zstd_encoder_free(zstd_encoder_t* encoder);
+size_t zstd_encoder_bound(size_t length);
+int zstd_encoder_has_error(zstd_encoder_t* encoder);
+int zstd_encoder_is_end(zstd_encoder_t* encoder);
+int zstd_encoder_want_continue(zstd_encoder_t* encoder);
+
+#endif
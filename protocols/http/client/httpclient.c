@@ -50,6 +50,7 @@ int run_middlewares(struct middleware_item* middleware_item, void* ctx);
 // Self-invocation detection and direct handler call
 server_t* __httpclient_is_self_invocation(httpclient_t*);
 httpresponse_t* __httpclient_self_invoke(httpclient_t*, server_t*);
+static httpresponse_t* __httpclient_self_invoke_routing(httpclient_t*, server_t*, server_routing_t*, const char*);
 
 httpclient_t* httpclient_init(route_methods_e method, const char* url, int timeout) {
     httpclient_t* result = NULL;
@@ -755,10 +756,18 @@ httpresponse_t* __httpclient_self_invoke(httpclient_t* client, server_t* server)
         return client->response;
     }
 
+    const unsigned long token = server_routing_enter();
+    httpresponse_t* response = __httpclient_self_invoke_routing(client, server, server_routing(server), path);
+    server_routing_exit(token);
+
+    return response;
+}
+
+httpresponse_t* __httpclient_self_invoke_routing(httpclient_t* client, server_t* server, server_routing_t* routing, const char* path) {
     const int vector_struct_size = 6;
     const int substring_count = 20;
     const int vector_size = substring_count * vector_struct_size;
-    route_t* route = server->http.route;
+    route_t* route = routing->http.route;
     route_t* matched_route = NULL;
 
     while (route) {
@@ -804,7 +813,7 @@ httpresponse_t* __httpclient_self_invoke(httpclient_t* client, server_t* server)
     httpctx_t ctx;
     httpctx_init(&ctx, client->request, client->response);
 
-    if (run_middlewares(server->http.middleware, &ctx))
+    if (run_middlewares(routing->http.middleware, &ctx))
         handler(&ctx);
 
     httpctx_clear(&ctx);
@@ -10,6 +10,7 @@
 #include "httpclientpool.h"
 #include "connection.h"
 #include "log.h"
+#include "memstat.h"
 
 static connection_pool_t* global_pool = NULL;
 static pthread_once_t global_pool_once = PTHREAD_ONCE_INIT;
@@ -135,6 +136,7 @@ void httpclientpool_release(connection_pool_t* pool, const char* host, unsigned
         hc->connections = NULL;
         hc->count = 0;
         map_insert(pool->hosts, key, hc);
+        memstat_add(MEMSTAT_HTTPCLIENT, sizeof(host_connections_t));
     }
 
     // Check if this connection is already in the pool
@@ -153,8 +155,9 @@ void httpclientpool_release(connection_pool_t* pool, const char* host, unsigned
 
     // Cap per-host cached connections so a burst of outbound requests to one
     // host cannot grow fds without bound. If the host is already at the cap,
-    // close the incoming connection instead of pooling it.
-    if (hc->count >= POOL_MAX_CONNECTIONS_PER_HOST) {
+    // or the httpclient memory limit is reached, close the incoming connection
+    // instead of pooling it.
+    if (hc->count >= POOL_MAX_CONNECTIONS_PER_HOST || memstat_should_shed(MEMSTAT_HTTPCLIENT)) {
         pthread_mutex_unlock(&pool->mutex);
         free(key);
         connection->close(connection);
@@ -179,6 +182,7 @@ void httpclientpool_release(connection_pool_t* pool, const char* host, unsigned
     new_pc->next = hc->connections;
     hc->connections = new_pc;
     hc->count++;
+    memstat_add(MEMSTAT_HTTPCLIENT, sizeof * new_pc + sizeof(connection_t));
 
     pthread_mutex_unlock(&pool->mutex);
     free(key);
@@ -350,12 +354,16 @@ static void __host_connections_free(void* arg) {
         pc = next;
     }
 
+    memstat_sub(MEMSTAT_HTTPCLIENT, sizeof * hc);
     free(hc);
 }
 
+// Каждый снимаемый из пула элемент проходит здесь, структура освобождается следом
 static void __close_pooled_connection(pooled_connection_t* pc) {
     if (pc == NULL || pc->connection == NULL) return;
 
+    memstat_sub(MEMSTAT_HTTPCLIENT, sizeof * pc + sizeof(connection_t));
+
     connection_t* conn = pc->connection;
 
     if (conn->ssl != NULL) {
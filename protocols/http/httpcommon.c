@@ -7,6 +7,8 @@
 #include "base64.h"
 #include "httpcommon.h"
 
+static int __http_parse_qvalue(const char* value, size_t length);
+
 http_header_t* http_header_create(const char* key, size_t key_length, const char* value, size_t value_length) {
     http_header_t* header = malloc(sizeof * header);
     if (header == NULL) return NULL;
@@ -196,3 +198,81 @@ char* create_basic_auth_header(const char* first_value, const char* second_value
 
     return result;
 }
+
+int http_accept_encoding_weight(const char* value, size_t length, const char* coding) {
+    if (value == NULL || coding == NULL) return -1;
+
+    const size_t coding_length = strlen(coding);
+    const int is_gzip = cmpstrn_lower(coding, coding_length, "gzip", 4);
+    const char* end = value + length;
+    const char* pos = value;
+    int weight = -1;
+    int wildcard = -1;
+
+    while (pos < end) {
+        while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == ','))
+            pos++;
+
+        const char* token = pos;
+        while (pos < end && *pos != ',' && *pos != ';' && *pos != ' ' && *pos != '\t')
+            pos++;
+
+        const size_t token_length = pos - token;
+        int q = 1000;
+
+        // Параметры элемента: интересует только q
+        while (pos < end && *pos != ',') {
+            if (*pos != ';') {
+                pos++;
+                continue;
+            }
+
+            pos++;
+            while (pos < end && (*pos == ' ' || *pos == '\t'))
+                pos++;
+
+            const char* param = pos;
+            while (pos < end && *pos != ',' && *pos != ';')
+                pos++;
+
+            if (pos - param >= 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=')
+                q = __http_parse_qvalue(param + 2, pos - param - 2);
+        }
+
+        if (token_length == 0) continue;
+
+        if (token_length == 1 && token[0] == '*')
+            wildcard = q;
+        else if (cmpstrn_lower(token, token_length, coding, coding_length) ||
+                 (is_gzip && cmpstrn_lower(token, token_length, "x-gzip", 6)))
+            weight = q;
+    }
+
+    return weight != -1 ? weight : wildcard;
+}
+
+/*
+ * qvalue = ( "0" [ "." 0*3DIGIT ] ) / ( "1" [ "." 0*3("0") ] ).
+ * Некорректное значение трактуется как q=0: неизвестное лучше не выбирать.
+ */
+int __http_parse_qvalue(const char* value, size_t length) {
+    while (length > 0 && (value[length - 1] == ' ' || value[length - 1] == '\t'))
+        length--;
+
+    if (length == 0 || (value[0] != '0' && value[0] != '1'))
+        return 0;
+
+    int q = (value[0] - '0') * 1000;
+    if (length == 1) return q;
+    if (value[1] != '.' || length > 5) return 0;
+
+    int scale = 100;
+    for (size_t i = 2; i < length; i++) {
+        if (!isdigit((unsigned char)value[i])) return 0;
+
+        q += (value[i] - '0') * scale;
+        scale /= 10;
+    }
+
+    return q > 1000 ? 0 : q;
+}
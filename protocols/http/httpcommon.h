@@ -22,7 +22,9 @@ typedef enum http_version {
 
 typedef enum http_content_encoding {
     CE_NONE = 0,
-    CE_GZIP
+    CE_GZIP,
+    CE_BR,
+    CE_ZSTD
 } http_content_encoding_t;
 
 typedef enum http_trunsfer_encoding {
@@ -82,4 +84,13 @@ void http_ranges_free(http_ranges_t* ranges);
 
 char* create_basic_auth_header(const char* first_value, const char* second_value);
 
+/**
+ * Вес кодирования в значении Accept-Encoding (RFC 9110 §12.5.3).
+ * @param value - значение заголовка (может быть без нуль-терминатора)
+ * @param coding - имя кодирования ("br", "zstd", "gzip"); "gzip" совпадает и с "x-gzip"
+ * @return q-value в тысячных (1000 - q=1, 0 - явно запрещено)
+ *         или -1, если кодирование не указано и нет "*"
+ */
+int http_accept_encoding_weight(const char* value, size_t length, const char* coding);
+
 #endif
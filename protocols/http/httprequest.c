@@ -88,6 +88,8 @@ httprequest_t* httprequest_create(connection_t* connection) {
     request->content_encoding = CE_NONE;
     request->uri_length = 0;
     request->path_length = 0;
+    request->read_at = 0;
+    request->parsed_at = 0;
     request->uri = NULL;
     request->path = NULL;
     request->query_ = NULL;
@@ -248,6 +248,9 @@ typedef struct httprequest {
 
     size_t uri_length;
     size_t path_length;
+
+    uint64_t read_at;              // Начало разбора запроса, нс (metrics_now_ns)
+    uint64_t parsed_at;            // Запрос разобран, нс
 } httprequest_t;
 
 httprequest_t* httprequest_create(connection_t*);
@@ -264,5 +267,6 @@ int httprequest_allow_payload(httprequest_t*);
 int httpparser_set_uri(httprequest_t*, const char*, size_t);
 void httpparser_append_query(httprequest_t*, query_t*);
 httprequest_head_t httprequest_create_head(httprequest_t*);
+const char* httprequest_method_string(route_methods_e method);
 
 #endif
@@ -13,6 +13,7 @@
 #include "json.h"
 #include "appconfig.h"
 #include "mimetype.h"
+#include "httprequest.h"
 #include "httpresponse.h"
 #include "httpresponseparser.h"
 #include "storage.h"
@@ -42,9 +43,13 @@ static const char* __httpresponse_get_mimetype(const char* extension);
 
 static int __httpresponse_keepalive_enabled(httpresponse_t* response);
 static void __httpresponse_try_enable_gzip(httpresponse_t* response, const char* directive);
+static int __httpresponse_gzip_mimetype(const char* mimetype);
 static void __httpresponse_try_enable_te(httpresponse_t* response, const char* directive);
 static int __httpresponse_prepare_body(httpresponse_t* response, size_t length);
 static void __httpresponse_cookie_add(httpresponse_t* response, cookie_t cookie);
+static void __httpresponse_span_add(httpresponse_t* response, const char* name, uint64_t started_at);
+static void __httpresponse_timing_reset(httpresponse_t* response);
+static int __httpresponse_timing_append(char* out, size_t size, size_t* pos, const char* name, uint64_t from, uint64_t to);
 static void __httpresponse_payload_free(http_payload_t* payload);
 static void __httpresponse_init_payload(httpresponse_t* response);
 static void __httpresponse_payload_parse_plain(httpresponse_t* response);
@@ -55,6 +60,20 @@ static json_doc_t* __httpresponse_payload_json(httpresponse_t* response);
 
 static int __httpresponse_init_parser(httpresponse_t* response);
 static void __httpresponse_reset(httpresponse_t* response);
+static void __httpresponse_file_close(httpresponse_t* response);
+static void __httpresponse_file_entry_set(httpresponse_t* response, filecache_entry_t* entry, const filecache_entry_t* original, const char* coding);
+static filecache_entry_t* __httpresponse_file_variant(httpresponse_t* response, const filecache_entry_t* entry, const http_header_t* accept_encoding, const char** coding);
+static int __http_build_file_path(server_t* server, char* file_full_path, size_t file_full_path_size, const char* path, size_t length, size_t* pos);
+
+/* Заранее сжатые копии рядом с файлом. Порядок - предпочтение сервера при равных q. */
+static const struct {
+    const char* coding;
+    const char* extension;
+} __httpresponse_variants[] = {
+    { "br", ".br" },
+    { "zstd", ".zst" },
+    { "gzip", ".gz" }
+};
 
 void __httpresponse_view(httpresponse_t* response, json_doc_t* document, const char* storage_name, const char* path_format, ...);
 
@@ -102,11 +121,16 @@ httpresponse_t* httpresponse_create(connection_t* connection) {
     if (response == NULL) return NULL;
 
     response->status_code = 200;
+    response->started_at = metrics_now_ns();
+    response->metrics_route = METRICS_ROUTE_NONE;
+    __httpresponse_timing_reset(response);
     response->version = HTTP1_VER_NONE;
     response->transfer_encoding = TE_NONE;
     response->content_encoding = CE_NONE;
     response->content_length = 0;
     response->file_ = file_alloc();
+    response->file_entry = NULL;
+    response->file_content = NULL;
     response->header_ = NULL;
     response->last_header = NULL;
     response->filter = filters_create();
@@ -138,6 +162,7 @@ httpresponse_t* httpresponse_create(connection_t* connection) {
     response->send_filen = __httpresponse_filen;
     response->send_filef = __httpresponse_filef;
     response->add_cookie = __httpresponse_cookie_add;
+    response->add_span = __httpresponse_span_add;
     response->base.reset = (void(*)(void*))__httpresponse_reset;
     response->base.free = (void(*)(void*))httpresponse_free;
 
@@ -163,6 +188,7 @@ void __httpresponse_reset(httpresponse_t* response) {
      * httpresponse_has_payload() на переиспользованном keep-alive соединении
      * видит длину предыдущего ответа. */
     response->content_length = 0;
+    __httpresponse_timing_reset(response);
     response->event_again = 0;
     response->headers_sended = 0;
     response->range = 0;
@@ -173,7 +199,7 @@ void __httpresponse_reset(httpresponse_t* response) {
 
     __httpresponse_payload_free(&response->payload_);
 
-    response->file_.close(&response->file_);
+    __httpresponse_file_close(response);
 
     bufo_clear(&response->body);
 
@@ -216,33 +242,41 @@ void __httpresponse_file(httpresponse_t* response, const char* path) {
 void __httpresponse_filen(httpresponse_t* response, const char* path, size_t length) {
     connection_t* connection = response->connection;
     connection_server_ctx_t* ctx = connection->ctx;
-    char file_full_path[PATH_MAX];
-    const file_status_e status_code = http_get_file_full_path(ctx->server, file_full_path, PATH_MAX, path, length);
-    if (status_code != FILE_OK) {
+    filecache_entry_t* entry = http_get_file_entry(ctx->server, path, length);
+    if (entry == NULL || entry->status != FILECACHE_OK) {
+        filecache_release(entry);
         response->send_default(response, 404);
         return;
     }
 
-    http_response_file(response, file_full_path);
+    http_response_file_entry(response, entry);
 }
 
-file_status_e http_get_file_full_path(server_t* server, char* file_full_path, size_t file_full_path_size, const char* path, size_t length) {
-    size_t pos = 0;
+int __http_build_file_path(server_t* server, char* file_full_path, size_t file_full_path_size, const char* path, size_t length, size_t* pos) {
+    *pos = 0;
 
-    if (!data_appendn(file_full_path, &pos, file_full_path_size, server->root, server->root_length))
-        return FILE_NOTFOUND;
+    if (!data_appendn(file_full_path, pos, file_full_path_size, server->root, server->root_length))
+        return 0;
 
     if (path[0] != '/')
-        if (!data_appendn(file_full_path, &pos, file_full_path_size, "/", 1))
-            return FILE_NOTFOUND;
+        if (!data_appendn(file_full_path, pos, file_full_path_size, "/", 1))
+            return 0;
 
-    if (!data_appendn(file_full_path, &pos, file_full_path_size, path, length))
-        return FILE_NOTFOUND;
+    if (!data_appendn(file_full_path, pos, file_full_path_size, path, length))
+        return 0;
 
-    file_full_path[pos] = 0;
+    file_full_path[*pos] = 0;
+
+    return 1;
+}
+
+file_status_e http_get_file_full_path(server_t* server, char* file_full_path, size_t file_full_path_size, const char* path, size_t length) {
+    size_t pos = 0;
+
+    if (!__http_build_file_path(server, file_full_path, file_full_path_size, path, length, &pos))
+        return FILE_NOTFOUND;
 
     struct stat stat_obj;
-    // TODO: Optimize stat. Make cache.
     /* Любая ошибка stat (ENOENT, EACCES, ENOTDIR, ...) — файла нет; иначе
      * ниже читается неинициализированный stat_obj.st_mode. */
     if (stat(file_full_path, &stat_obj) == -1)
@@ -274,23 +308,185 @@ file_status_e http_get_file_full_path(server_t* server, char* file_full_path, si
     return FILE_OK;
 }
 
+/*
+ * Резолв статического файла через open file cache сервера. В отличие от
+ * http_get_file_full_path сразу возвращает открытый fd и метаданные:
+ * при попадании в кэш отдача файла не требует ни одного системного вызова.
+ * Возвращает запись с захваченной ссылкой (status != FILECACHE_OK для
+ * отсутствующих/запрещённых путей) или NULL, если путь не помещается в буфер.
+ */
+filecache_entry_t* http_get_file_entry(server_t* server, const char* path, size_t length) {
+    char file_full_path[PATH_MAX];
+    size_t pos = 0;
+
+    if (!__http_build_file_path(server, file_full_path, PATH_MAX, path, length, &pos))
+        return NULL;
+
+    const char* index = server->index != NULL ? server->index->value : NULL;
+
+    return filecache_get(server->filecache, file_full_path, index, appconfig()->mimetype);
+}
+
 void http_response_file(httpresponse_t* response, const char* file_full_path) {
-    response->file_ = file_open(file_full_path, O_RDONLY);
-    if (!response->file_.ok) {
+    http_response_file_negotiate(response, file_full_path, NULL);
+}
+
+void http_response_file_negotiate(httpresponse_t* response, const char* file_full_path, const http_header_t* accept_encoding) {
+    connection_t* connection = response->connection;
+    connection_server_ctx_t* ctx = connection->ctx;
+    filecache_entry_t* entry = filecache_get(ctx->server->filecache, file_full_path, NULL, appconfig()->mimetype);
+    if (entry == NULL || entry->status != FILECACHE_OK) {
+        filecache_release(entry);
         response->send_default(response, 404);
         return;
     }
 
-    const char* ext = file_extension(file_full_path);
-    const char* mimetype = __httpresponse_get_mimetype(ext);
-    const char* connection = __httpresponse_keepalive_enabled(response) ? "keep-alive" : "close";
-    response->add_headeru(response, "Connection", 10, connection, strlen(connection));
-    response->add_headeru(response, "Content-Type", 12, mimetype, strlen(mimetype));
+    http_response_file_entry_negotiate(response, entry, accept_encoding);
+}
+
+/*
+ * Забирает ссылку на entry. fd принадлежит записи кэша и разделяется
+ * между ответами: фильтры читают его только через pread.
+ */
+void http_response_file_entry(httpresponse_t* response, filecache_entry_t* entry) {
+    __httpresponse_file_entry_set(response, entry, entry, NULL);
+}
+
+/*
+ * Как http_response_file_entry, но при включённом server.precompressed
+ * и наличии рядом с файлом сжатой копии (file.br, file.zst, file.gz),
+ * допустимой по Accept-Encoding, отдаёт её. Копия отдаётся как есть:
+ * Range, ETag и 304 считаются по ней, сжатие на лету не выполняется.
+ */
+void http_response_file_entry_negotiate(httpresponse_t* response, filecache_entry_t* entry, const http_header_t* accept_encoding) {
+    connection_t* connection = response->connection;
+    connection_server_ctx_t* ctx = connection->ctx;
+    if (!ctx->server->precompressed) {
+        __httpresponse_file_entry_set(response, entry, entry, NULL);
+        return;
+    }
+
+    const char* coding = NULL;
+    filecache_entry_t* variant = __httpresponse_file_variant(response, entry, accept_encoding, &coding);
+
+    /* Ответ выбран по Accept-Encoding, даже если отдаётся исходный файл:
+     * без Vary общий кэш отдал бы его клиентам со сжатием и наоборот. */
+    response->add_headeru(response, "Vary", 4, "Accept-Encoding", 15);
+
+    if (variant == NULL) {
+        __httpresponse_file_entry_set(response, entry, entry, NULL);
+        return;
+    }
+
+    __httpresponse_file_entry_set(response, variant, entry, coding);
+    filecache_release(entry);
+}
+
+/*
+ * entry - отдаваемый файл (забирается ссылка), original - запрошенный файл,
+ * от которого берутся имя и Content-Type; coding != NULL для сжатой копии.
+ */
+void __httpresponse_file_entry_set(httpresponse_t* response, filecache_entry_t* entry, const filecache_entry_t* original, const char* coding) {
+    __httpresponse_file_close(response);
+
+    connection_t* connection = response->connection;
+    connection_server_ctx_t* ctx = connection->ctx;
+    const char* filename = strrchr(original->path, '/');
+    const char* mimetype = original->mimetype != NULL ? original->mimetype : "text/plain";
+    const size_t mimetype_length = original->mimetype != NULL ? original->mimetype_length : 10;
+    const int compress = coding == NULL && entry->size >= env()->main.gzip_min_length && __httpresponse_gzip_mimetype(mimetype);
+
+    response->file_entry = entry;
+    response->file_.fd = entry->fd;
+    response->file_.size = entry->size;
+    response->file_.mtime = entry->mtime;
+    response->file_.ok = 1;
+    response->file_.set_name(&response->file_, filename != NULL ? filename + 1 : original->path);
+
+    /* Горячий файл отдаётся из памяти: body становится прокси на общее
+     * содержимое, fd не используется фильтрами и чтений с диска нет. */
+    response->file_content = filecache_content_get(ctx->server->filecache, entry, compress);
+    if (response->file_content != NULL) {
+        bufo_clear(&response->body);
+        response->body.data = response->file_content->data;
+        response->body.capacity = response->file_content->size;
+        response->body.size = response->file_content->size;
+        response->body.is_proxy = 1;
+        response->file_.fd = -1;
+    }
+
+    const char* keep_alive = __httpresponse_keepalive_enabled(response) ? "keep-alive" : "close";
+    response->add_headeru(response, "Connection", 10, keep_alive, strlen(keep_alive));
+    response->add_headeru(response, "Content-Type", 12, mimetype, mimetype_length);
+
+    if (coding != NULL) {
+        response->add_headeru(response, "Content-Encoding", 16, coding, strlen(coding));
+
+        /* Content-Type из списка сжатия и Content-Encoding: gzip включают
+         * сжатие на лету; копия уже сжата и отдаётся с Content-Length. */
+        response->content_encoding = CE_NONE;
+        response->transfer_encoding = TE_NONE;
+    }
 
     if (!__httpresponse_prepare_body(response, response->file_.size))
         response->send_default(response, 500);
 }
 
+filecache_entry_t* __httpresponse_file_variant(httpresponse_t* response, const filecache_entry_t* entry, const http_header_t* accept_encoding, const char** coding) {
+    if (accept_encoding == NULL) return NULL;
+
+    connection_t* connection = response->connection;
+    connection_server_ctx_t* ctx = connection->ctx;
+    const size_t path_length = strlen(entry->path);
+    filecache_entry_t* best = NULL;
+    int best_weight = 0;
+    char path[PATH_MAX];
+
+    for (size_t i = 0; i < sizeof(__httpresponse_variants) / sizeof(__httpresponse_variants[0]); i++) {
+        const int weight = http_accept_encoding_weight(accept_encoding->value, accept_encoding->value_length, __httpresponse_variants[i].coding);
+        if (weight <= best_weight) continue;
+
+        const char* extension = __httpresponse_variants[i].extension;
+        const size_t extension_length = strlen(extension);
+        if (path_length + extension_length >= PATH_MAX) break;
+
+        memcpy(path, entry->path, path_length);
+        memcpy(path + path_length, extension, extension_length + 1);
+
+        // Отсутствие копии тоже кэшируется в open file cache
+        filecache_entry_t* variant = filecache_get(ctx->server->filecache, path, NULL, NULL);
+        if (variant == NULL || variant->status != FILECACHE_OK) {
+            filecache_release(variant);
+            continue;
+        }
+
+        filecache_release(best);
+        best = variant;
+        best_weight = weight;
+        *coding = __httpresponse_variants[i].coding;
+    }
+
+    return best;
+}
+
+void __httpresponse_file_close(httpresponse_t* response) {
+    if (response->file_content != NULL) {
+        bufo_clear(&response->body);
+        filecache_content_release(response->file_content);
+        response->file_content = NULL;
+    }
+
+    if (response->file_entry == NULL) {
+        response->file_.close(&response->file_);
+        return;
+    }
+
+    /* fd закрывает последний владелец записи, а не ответ. */
+    response->file_ = file_alloc();
+    filecache_release(response->file_entry);
+    response->file_entry = NULL;
+}
+
 void __httpresponse_filef(httpresponse_t* response, const char* storage_name, const char* path_format, ...) {
     char path[PATH_MAX];
     va_list args;
@@ -298,6 +494,7 @@ void __httpresponse_filef(httpresponse_t* response, const char* storage_name, co
     vsnprintf(path, sizeof(path), path_format, args);
     va_end(args);
 
+    __httpresponse_file_close(response);
     response->file_ = storage_file_get(storage_name, path);
     if (!response->file_.ok) {
         response->send_default(response, 404);
@@ -359,7 +556,7 @@ int __httpresponse_headern_add(httpresponse_t* response, const char* key, size_t
         data_size = response->file_.size;
 
     if (!response->range) {
-        if (cmpstr_lower(header->key, "Content-Type") && data_size >= 1024) {
+        if (cmpstr_lower(header->key, "Content-Type") && data_size >= env()->main.gzip_min_length) {
             __httpresponse_try_enable_gzip(response, header->value);
         }
         else if (cmpstr_lower(header->key, "Transfer-Encoding")) {
@@ -760,15 +957,22 @@ int __httpresponse_alloc_body(httpresponse_t* response, const char* data, size_t
 void __httpresponse_try_enable_gzip(httpresponse_t* response, const char* directive) {
     if (response->range) return;
 
+    if (__httpresponse_gzip_mimetype(directive)) {
+        response->content_encoding = CE_GZIP;
+        response->transfer_encoding = TE_CHUNKED;
+    }
+}
+
+int __httpresponse_gzip_mimetype(const char* mimetype) {
     env_gzip_str_t* item = env()->main.gzip;
     while (item != NULL) {
-        if (cmpstr_lower(item->mimetype, directive)) {
-            response->content_encoding = CE_GZIP;
-            response->transfer_encoding = TE_CHUNKED;
-            break;
-        }
+        if (cmpstr_lower(item->mimetype, mimetype))
+            return 1;
+
         item = item->next;
     }
+
+    return 0;
 }
 
 void __httpresponse_try_enable_te(httpresponse_t* response, const char* directive) {
@@ -1011,3 +1215,72 @@ json_doc_t* __httpresponse_payload_json(httpresponse_t* response) {
 
     return document;
 }
+
+uint64_t http_span_start(void) {
+    return metrics_now_ns();
+}
+
+void __httpresponse_span_add(httpresponse_t* response, const char* name, uint64_t started_at) {
+    if (response == NULL || name == NULL) return;
+    if (response->spans_count >= HTTP_SPANS_MAX) return;
+
+    const uint64_t now = metrics_now_ns();
+    http_span_t* span = &response->spans[response->spans_count];
+
+    // Имя попадает в заголовок как token (RFC 7230)
+    size_t length = 0;
+    for (; name[length] != 0 && length < HTTP_SPAN_NAME_SIZE - 1; length++) {
+        const char ch = name[length];
+        span->name[length] = isalnum((unsigned char)ch) || ch == '-' || ch == '_' || ch == '.' ? ch : '_';
+    }
+    if (length == 0) return;
+
+    span->name[length] = 0;
+    span->duration_ns = now > started_at ? now - started_at : 0;
+    response->spans_count++;
+}
+
+void __httpresponse_timing_reset(httpresponse_t* response) {
+    response->bytes_sent = 0;
+    response->enqueued_at = 0;
+    response->handler_started_at = 0;
+    response->handler_finished_at = 0;
+    response->first_byte_at = 0;
+    response->completed_at = 0;
+    response->spans_count = 0;
+    response->server_timing = 0;
+}
+
+size_t httpresponse_server_timing(httpresponse_t* response, httprequest_t* request, uint64_t now, char* out, size_t size) {
+    size_t pos = 0;
+
+    const uint64_t read_at = request != NULL ? request->read_at : 0;
+    const uint64_t parsed_at = request != NULL ? request->parsed_at : 0;
+
+    if (!__httpresponse_timing_append(out, size, &pos, "parse", read_at, parsed_at)) return 0;
+    if (!__httpresponse_timing_append(out, size, &pos, "queue", response->enqueued_at, response->handler_started_at)) return 0;
+    if (!__httpresponse_timing_append(out, size, &pos, "app", response->handler_started_at, response->handler_finished_at)) return 0;
+
+    for (unsigned int i = 0; i < response->spans_count; i++)
+        if (!__httpresponse_timing_append(out, size, &pos, response->spans[i].name, 1, 1 + response->spans[i].duration_ns)) return 0;
+
+    const uint64_t started_at = read_at != 0 ? read_at : response->started_at;
+    if (!__httpresponse_timing_append(out, size, &pos, "total", started_at, now)) return 0;
+
+    return pos;
+}
+
+// Фаза без начала или конца пропускается
+int __httpresponse_timing_append(char* out, size_t size, size_t* pos, const char* name, uint64_t from, uint64_t to) {
+    if (from == 0 || to == 0) return 1;
+
+    const uint64_t duration_us = to > from ? (to - from) / 1000 : 0;
+    const int length = snprintf(out + *pos, size - *pos, "%s%s;dur=%llu.%03llu",
+        *pos > 0 ? ", " : "", name, (unsigned long long)(duration_us / 1000), (unsigned long long)(duration_us % 1000));
+
+    if (length < 0 || (size_t)length >= size - *pos) return 0;
+
+    *pos += (size_t)length;
+
+    return 1;
+}
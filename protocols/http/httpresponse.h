@@ -8,6 +8,11 @@
 #include "json.h"
 #include "response.h"
 #include "http_filter.h"
+#include "metrics.h"
+
+// Собственные отрезки обработчика в Server-Timing
+#define HTTP_SPANS_MAX 8
+#define HTTP_SPAN_NAME_SIZE 32
 
 typedef enum {
     FILE_OK = 0,
@@ -30,6 +35,11 @@ typedef struct {
     const char* same_site;  /* "Strict", "Lax" or "None" (NULL to skip) */
 } cookie_t;
 
+typedef struct http_span {
+    char name[HTTP_SPAN_NAME_SIZE];
+    uint64_t duration_ns;
+} http_span_t;
+
 typedef struct httpresponse {
     response_t base;
 
@@ -199,6 +209,16 @@ typedef struct httpresponse {
      */
     void(*add_cookie)(struct httpresponse* response, cookie_t cookie);
 
+    /*
+     * Add a custom phase (database query, render...) to the request timing.
+     * Spans show up in the Server-Timing header and the access log.
+     * Spans over HTTP_SPANS_MAX are ignored.
+     * @param response - pointer to httpresponse
+     * @param name - span name, a token such as "db" or "render"
+     * @param started_at - span start taken with http_span_start()
+     */
+    void(*add_span)(struct httpresponse* response, const char* name, uint64_t started_at);
+
     /*
      * Get request body as string.
      * Returns a copy of data that must be freed with free().
@@ -226,21 +246,51 @@ typedef struct httpresponse {
 
     bufo_t body;
     file_t file_;
+    filecache_entry_t* file_entry; // Владелец file_.fd, если файл взят из open file cache
+    filecache_content_t* file_content; // Содержимое файла в памяти; body - прокси на него
 
     http_version_e version;
     http_payload_t payload_;
 
     short status_code;
 
+    uint64_t started_at;           // Начало обработки запроса, нс (metrics_now_ns)
+    unsigned int metrics_route;    // Маршрут в метриках, METRICS_ROUTE_NONE без обработчика
+    size_t bytes_sent;             // Отправлено байт вместе с заголовками
+
+    // Фазы ответа, нс (metrics_now_ns); 0 - фазы не было
+    uint64_t enqueued_at;          // Постановка в очередь обработчиков
+    uint64_t handler_started_at;
+    uint64_t handler_finished_at;
+    uint64_t first_byte_at;
+    uint64_t completed_at;
+    unsigned int spans_count;
+    http_span_t spans[HTTP_SPANS_MAX];
+
     unsigned transfer_encoding : 3;
     unsigned content_encoding : 2;
     unsigned event_again : 1;
     unsigned headers_sended : 1;
     unsigned range : 1;
     unsigned last_modified : 1;
+    unsigned server_timing : 1;    // Заголовок Server-Timing уже добавлен
 } httpresponse_t;
 
+struct httprequest;
+
 httpresponse_t* httpresponse_create(connection_t* connection);
+
+/**
+ * Начало отрезка для response->add_span
+ */
+uint64_t http_span_start(void);
+
+/**
+ * Значение заголовка Server-Timing: разбор, очередь, обработчик,
+ * отрезки обработчика и общее время до now, в миллисекундах
+ * @return длина значения, 0 если не поместилось
+ */
+size_t httpresponse_server_timing(httpresponse_t* response, struct httprequest* request, uint64_t now, char* out, size_t size);
 void httpresponse_free(void* arg);
 void httpresponse_redirect(httpresponse_t* response, const char* path, int status_code);
 http_ranges_t* httpresponse_init_ranges(void);
@@ -250,6 +300,10 @@ const char* httpresponse_status_string(int status_code);
 int httpresponse_has_payload(httpresponse_t* response);
 file_status_e http_get_file_full_path(server_t* server, char* file_full_path, size_t file_full_path_size, const char* path, size_t length);
 void http_response_file(httpresponse_t* response, const char* file_full_path);
+filecache_entry_t* http_get_file_entry(server_t* server, const char* path, size_t length);
+void http_response_file_entry(httpresponse_t* response, filecache_entry_t* entry);
+void http_response_file_negotiate(httpresponse_t* response, const char* file_full_path, const http_header_t* accept_encoding);
+void http_response_file_entry_negotiate(httpresponse_t* response, filecache_entry_t* entry, const http_header_t* accept_encoding);
 size_t httpresponse_status_length(int status_code);
 
 void httpresponse_default(httpresponse_t* response, int status_code);
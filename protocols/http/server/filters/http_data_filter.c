@@ -87,7 +87,7 @@ int __header(httprequest_t* request, httpresponse_t* response) {
     if (module->base.cont)
         goto cont;
 
-    if (response->file_.fd > -1)
+    if (response->file_.fd > -1 || response->file_content != NULL)
         if (!response->add_header(response, "Cache-Control", "no-cache"))
             return CWF_ERROR;
 
@@ -1,8 +1,14 @@
+#include <string.h>
+
 #include "http_gzip_filter.h"
 
 #include "log.h"
+#include "helpers.h"
+#include "appconfig.h"
 
 #define BUF_SIZE 16384
+// Больше этого сжатое тело не держится в памяти целиком, только поток
+#define ONESHOT_MAX_SIZE (1024 * 1024)
 
 static http_module_gzip_t* __create(void);
 static void __free(void* arg);
@@ -10,6 +16,35 @@ static void __reset(void* arg);
 static int __header(httprequest_t* request, httpresponse_t* response);
 static int __body(httprequest_t* request, httpresponse_t* response, bufo_t* parent_buf);
 static int __process(http_module_gzip_t* module, bufo_t* buf);
+static int __use_precompressed(httpresponse_t* response);
+static int __compress_oneshot(http_module_gzip_t* module, httpresponse_t* response);
+static int __skip(httpresponse_t* response);
+static http_content_encoding_t __negotiate(httprequest_t* request, httpresponse_t* response);
+static const char* __encodings_name(http_content_encoding_t encoding);
+static int __level(httpresponse_t* response, http_content_encoding_t encoding);
+static int __identity(httpresponse_t* response, size_t data_size);
+static int __gzip_enabled(void);
+static int __encoder_start(http_module_gzip_t* module, http_content_encoding_t encoding, int level);
+static void __encoder_set_in(http_module_gzip_t* module, const char* data, size_t length);
+static size_t __encoder_compress(http_module_gzip_t* module, char* out, size_t out_length, int end);
+static size_t __encoder_avail_in(http_module_gzip_t* module);
+static int __encoder_has_error(http_module_gzip_t* module);
+static int __encoder_is_end(http_module_gzip_t* module);
+static int __encoder_want_continue(http_module_gzip_t* module);
+static size_t __encoder_bound(http_module_gzip_t* module, size_t length);
+static void __encoder_free(http_module_gzip_t* module);
+
+/* Порядок - предпочтение при равных q, как у sidecar-файлов (br > zstd > gzip):
+ * brotli и zstd на низких уровнях сжимают лучше gzip при меньших затратах CPU. */
+static const struct {
+    http_content_encoding_t encoding;
+    const char* name;
+    int(*enabled)(void);
+} __encodings[] = {
+    { CE_BR, "br", brotli_encoder_enabled },
+    { CE_ZSTD, "zstd", zstd_encoder_enabled },
+    { CE_GZIP, "gzip", __gzip_enabled }
+};
 
 http_filter_t* http_gzip_filter_create(void) {
     http_filter_t* filter = malloc(sizeof * filter);
@@ -37,6 +72,11 @@ http_module_gzip_t* __create(void) {
     module->base.parent_buf = NULL;
     module->base.free = __free;
     module->base.reset = __reset;
+    module->precompressed = 0;
+    module->encoding = CE_NONE;
+    module->gzip = NULL;
+    brotli_encoder_init(&module->brotli);
+    zstd_encoder_init(&module->zstd);
     module->buf = bufo_create();
 
     if (module->buf == NULL) {
@@ -44,11 +84,6 @@ http_module_gzip_t* __create(void) {
         return NULL;
     }
 
-    if (!gzip_init(&module->gzip)) {
-        __free(module);
-        return NULL;
-    }
-
     return module;
 }
 
@@ -56,7 +91,7 @@ void __free(void* arg) {
     http_module_gzip_t* module = arg;
 
     bufo_free(module->buf);
-    gzip_free(&module->gzip);
+    __encoder_free(module);
     free(module);
 }
 
@@ -66,34 +101,51 @@ void __reset(void* arg) {
     module->base.cont = 0;
     module->base.done = 0;
     module->base.parent_buf = NULL;
+    module->precompressed = 0;
 
     bufo_flush(module->buf);
-    gzip_free(&module->gzip);
+    __encoder_free(module);
 }
 
 int __header(httprequest_t* request, httpresponse_t* response) {
     http_filter_t* cur_filter = response->cur_filter;
     http_module_gzip_t* module = cur_filter->module;
 
+    if (__skip(response))
+        return filter_next_handler_header(request, response);
+
     size_t data_size = response->body.size;
     if (response->file_.fd > -1)
         data_size = response->file_.size;
 
-    if (response->content_encoding == CE_NONE || data_size < 1024)
-        return filter_next_handler_header(request, response);
-
-    if (response->last_modified)
-        return filter_next_handler_header(request, response);
-
     int r = 0;
 
     if (module->base.cont)
         goto cont;
 
-    if (response->get_header(response, "Content-Encoding") == NULL)
-        if (!response->add_header(response, "Content-Encoding", "gzip"))
+    // Ответ зависит от Accept-Encoding независимо от выбранной кодировки;
+    // при выборе сжатой копии файла заголовок уже добавлен
+    if (request != NULL) {
+        const http_header_t* vary = response->get_header(response, "Vary");
+        if (vary == NULL || strstr(vary->value, "Accept-Encoding") == NULL)
+            if (!response->add_headeru(response, "Vary", 4, "Accept-Encoding", 15))
+                return CWF_ERROR;
+    }
+
+    const http_content_encoding_t encoding = __negotiate(request, response);
+    if (encoding == CE_NONE) {
+        if (!__identity(response, data_size))
             return CWF_ERROR;
 
+        goto cont;
+    }
+
+    response->remove_header(response, "Content-Encoding");
+    if (!response->add_header(response, "Content-Encoding", __encodings_name(encoding)))
+        return CWF_ERROR;
+
+    response->content_encoding = encoding;
+
     /* The upstream data filter runs before gzip and already added
      * Content-Length while transfer_encoding was still TE_NONE.
      * Content-Length is forbidden alongside Transfer-Encoding (RFC 7232
@@ -101,12 +153,40 @@ int __header(httprequest_t* request, httpresponse_t* response) {
      * so drop it before switching to chunked. */
     response->remove_header(response, "Content-Length");
 
-    response->transfer_encoding = TE_CHUNKED;
+    if (encoding == CE_GZIP && __use_precompressed(response)) {
+        module->precompressed = 1;
 
-    if (!bufo_alloc(module->buf, BUF_SIZE))
+        /* Сжатая копия известной длины: chunked не нужен. */
+        response->transfer_encoding = TE_NONE;
+        if (!response->add_content_length(response, response->body.size))
+            return CWF_ERROR;
+
+        goto cont;
+    }
+
+    if (!__encoder_start(module, encoding, __level(response, encoding)))
         return CWF_ERROR;
 
-    if (!gzip_deflate_init(&module->gzip))
+    /* Тело целиком в памяти и chunked не задан обработчиком явно:
+     * сжатие за один проход, ответ уходит с Content-Length. */
+    if (response->file_.fd == -1 && response->get_header(response, "Transfer-Encoding") == NULL) {
+        const int oneshot = __compress_oneshot(module, response);
+        if (oneshot < 0)
+            return CWF_ERROR;
+
+        if (oneshot) {
+            module->precompressed = 1;
+            response->transfer_encoding = TE_NONE;
+            if (!response->add_content_length(response, response->body.size))
+                return CWF_ERROR;
+
+            goto cont;
+        }
+    }
+
+    response->transfer_encoding = TE_CHUNKED;
+
+    if (!bufo_alloc(module->buf, BUF_SIZE))
         return CWF_ERROR;
 
     cont:
@@ -126,14 +206,7 @@ int __body(httprequest_t* request, httpresponse_t* response, bufo_t* parent_buf)
     http_module_gzip_t* module = cur_filter->module;
     module->base.parent_buf = parent_buf;
 
-    size_t data_size = response->body.size;
-    if (response->file_.fd > -1)
-        data_size = response->file_.size;
-
-    if (response->content_encoding == CE_NONE || data_size < 1024)
-        return filter_next_handler_body(request, response, parent_buf);
-
-    if (response->last_modified)
+    if (__skip(response) || module->precompressed)
         return filter_next_handler_body(request, response, parent_buf);
 
     int r = 0;
@@ -144,7 +217,7 @@ int __body(httprequest_t* request, httpresponse_t* response, bufo_t* parent_buf)
 
     bufo_reset_pos(buf);
 
-    gzip_set_in(&module->gzip, parent_buf->data + parent_buf->pos, parent_buf->size - parent_buf->pos);
+    __encoder_set_in(module, parent_buf->data + parent_buf->pos, parent_buf->size - parent_buf->pos);
 
     while (1) {
         response->cur_filter = cur_filter;
@@ -161,7 +234,7 @@ int __body(httprequest_t* request, httpresponse_t* response, bufo_t* parent_buf)
         module->base.cont = 0;
 
         if (r == CWF_DATA_AGAIN) {
-            if (gzip_want_continue(&module->gzip) && !gzip_is_end(&module->gzip))
+            if (__encoder_want_continue(module) && !__encoder_is_end(module))
                 continue;
 
             if (parent_buf->pos < parent_buf->size)
@@ -185,13 +258,13 @@ int __process(http_module_gzip_t* module, bufo_t* buf) {
     bufo_reset_pos(buf);
     bufo_reset_size(buf);
 
-    const size_t compress_writed = gzip_deflate(&module->gzip, bufo_data(buf), buf->capacity, parent_buf->is_last);
-    if (gzip_deflate_has_error(&module->gzip)) {
-        log_error("http_gzip_filter: deflate error\n");
+    const size_t compress_writed = __encoder_compress(module, bufo_data(buf), buf->capacity, parent_buf->is_last);
+    if (__encoder_has_error(module)) {
+        log_error("http_gzip_filter: compress error\n");
         return 0;
     }
 
-    const size_t processed = (parent_buf->size - parent_buf->pos) - module->gzip.stream.avail_in;
+    const size_t processed = (parent_buf->size - parent_buf->pos) - __encoder_avail_in(module);
 
     bufo_set_size(buf, compress_writed);
 
@@ -201,10 +274,258 @@ int __process(http_module_gzip_t* module, bufo_t* buf) {
      * stream already reached Z_STREAM_END there is nothing left to flush.
      * Asking for another turn would deflate a finished stream (Z_STREAM_ERROR)
      * and surface a spurious compress error. */
-    if (gzip_want_continue(&module->gzip) && !gzip_is_end(&module->gzip))
+    if (__encoder_want_continue(module) && !__encoder_is_end(module))
         return 1;
 
     module->buf->is_last = parent_buf->is_last;
 
     return 1;
-}
\ No newline at end of file
+}
+
+/*
+ * Ответ из памяти open file cache со сжатой копией: body переключается
+ * на неё, сжатие на каждый запрос не выполняется.
+ */
+int __use_precompressed(httpresponse_t* response) {
+    filecache_content_t* content = response->file_content;
+    if (content == NULL || content->gzip == NULL)
+        return 0;
+
+    response->body.data = content->gzip;
+    response->body.capacity = content->gzip_size;
+    response->body.size = content->gzip_size;
+    response->body.pos = 0;
+
+    return 1;
+}
+
+/*
+ * Сжатие всего тела в буфер размера худшего случая. Возвращает 1, если
+ * тело заменено сжатым, 0 - если тело слишком велико (остаётся поток),
+ * -1 при ошибке сжатия.
+ */
+int __compress_oneshot(http_module_gzip_t* module, httpresponse_t* response) {
+    bufo_t* body = &response->body;
+
+    const size_t bound = __encoder_bound(module, body->size);
+    if (bound == 0 || bound > ONESHOT_MAX_SIZE)
+        return 0;
+
+    char* data = malloc(bound);
+    if (data == NULL)
+        return 0;
+
+    __encoder_set_in(module, body->data, body->size);
+
+    size_t size = 0;
+    while (!__encoder_is_end(module)) {
+        const size_t writed = __encoder_compress(module, data + size, bound - size, 1);
+        if (__encoder_has_error(module) || (writed == 0 && !__encoder_is_end(module))) {
+            log_error("http_gzip_filter: compress error\n");
+            free(data);
+            return -1;
+        }
+
+        size += writed;
+    }
+
+    // Поток больше не нужен: возвращается в пул до отправки ответа
+    __encoder_free(module);
+
+    bufo_attach(body, data, bound);
+    body->size = size;
+
+    return 1;
+}
+
+int __skip(httpresponse_t* response) {
+    if (response->content_encoding == CE_NONE || response->last_modified)
+        return 1;
+
+    size_t data_size = response->body.size;
+    if (response->file_.fd > -1)
+        data_size = response->file_.size;
+
+    return data_size < env()->main.gzip_min_length;
+}
+
+/*
+ * Без запроса (внутренние ответы) сохраняется прежнее поведение - gzip.
+ * Без Accept-Encoding или при q=0 для всех кодировок ответ не сжимается.
+ * При равных q кодировка с готовой сжатой копией в памяти выигрывает:
+ * повторное сжатие горячего файла дороже разницы в степени сжатия.
+ */
+http_content_encoding_t __negotiate(httprequest_t* request, httpresponse_t* response) {
+    if (request == NULL) return CE_GZIP;
+
+    http_header_t* header = request->get_header(request, "Accept-Encoding");
+    if (header == NULL) return CE_NONE;
+
+    const int precompressed_gzip = response->file_content != NULL && response->file_content->gzip != NULL;
+
+    http_content_encoding_t encoding = CE_NONE;
+    int best_weight = 0;
+
+    for (size_t i = 0; i < sizeof(__encodings) / sizeof(__encodings[0]); i++) {
+        if (!__encodings[i].enabled()) continue;
+
+        const int weight = http_accept_encoding_weight(header->value, header->value_length, __encodings[i].name);
+        const int precompressed = precompressed_gzip && __encodings[i].encoding == CE_GZIP;
+        if (weight > best_weight || (precompressed && weight > 0 && weight == best_weight)) {
+            best_weight = weight;
+            encoding = __encodings[i].encoding;
+        }
+    }
+
+    return encoding;
+}
+
+const char* __encodings_name(http_content_encoding_t encoding) {
+    for (size_t i = 0; i < sizeof(__encodings) / sizeof(__encodings[0]); i++)
+        if (__encodings[i].encoding == encoding)
+            return __encodings[i].name;
+
+    return "gzip";
+}
+
+int __level(httpresponse_t* response, http_content_encoding_t encoding) {
+    const env_gzip_str_t* item = NULL;
+    http_header_t* content_type = response->get_header(response, "Content-Type");
+    if (content_type != NULL)
+        for (item = env()->main.gzip; item != NULL; item = item->next)
+            if (cmpstr_lower(item->mimetype, content_type->value))
+                break;
+
+    switch (encoding) {
+    case CE_BR:
+        return item != NULL ? item->brotli_level : ENV_BROTLI_LEVEL_DEFAULT;
+    case CE_ZSTD:
+        return item != NULL ? item->zstd_level : ENV_ZSTD_LEVEL_DEFAULT;
+    default:
+        return item != NULL ? item->gzip_level : ENV_GZIP_LEVEL_DEFAULT;
+    }
+}
+
+/*
+ * Клиент не принимает сжатие: тело уходит как есть. Chunked, включённый
+ * вместе со сжатием, снимается, если обработчик не задал его явно.
+ */
+int __identity(httpresponse_t* response, size_t data_size) {
+    response->content_encoding = CE_NONE;
+    response->remove_header(response, "Content-Encoding");
+
+    if (response->get_header(response, "Transfer-Encoding") != NULL)
+        return 1;
+
+    response->transfer_encoding = TE_NONE;
+
+    if (response->get_header(response, "Content-Length") != NULL)
+        return 1;
+
+    return response->add_content_length(response, data_size);
+}
+
+int __gzip_enabled(void) {
+    return 1;
+}
+
+int __encoder_start(http_module_gzip_t* module, http_content_encoding_t encoding, int level) {
+    module->encoding = encoding;
+
+    switch (encoding) {
+    case CE_BR:
+        return brotli_encoder_start(&module->brotli, level);
+    case CE_ZSTD:
+        return zstd_encoder_start(&module->zstd, level);
+    default:
+        module->gzip = gzip_deflate_acquire(level);
+        return module->gzip != NULL;
+    }
+}
+
+void __encoder_set_in(http_module_gzip_t* module, const char* data, size_t length) {
+    switch (module->encoding) {
+    case CE_BR:
+        brotli_encoder_set_in(&module->brotli, data, length);
+        break;
+    case CE_ZSTD:
+        zstd_encoder_set_in(&module->zstd, data, length);
+        break;
+    default:
+        gzip_set_in(module->gzip, data, length);
+    }
+}
+
+size_t __encoder_compress(http_module_gzip_t* module, char* out, size_t out_length, int end) {
+    switch (module->encoding) {
+    case CE_BR:
+        return brotli_encoder_compress(&module->brotli, out, out_length, end);
+    case CE_ZSTD:
+        return zstd_encoder_compress(&module->zstd, out, out_length, end);
+    default:
+        return gzip_deflate(module->gzip, out, out_length, end);
+    }
+}
+
+size_t __encoder_avail_in(http_module_gzip_t* module) {
+    switch (module->encoding) {
+    case CE_BR:
+        return module->brotli.avail_in;
+    case CE_ZSTD:
+        return module->zstd.avail_in;
+    default:
+        return module->gzip->stream.avail_in;
+    }
+}
+
+int __encoder_has_error(http_module_gzip_t* module) {
+    switch (module->encoding) {
+    case CE_BR:
+        return brotli_encoder_has_error(&module->brotli);
+    case CE_ZSTD:
+        return zstd_encoder_has_error(&module->zstd);
+    default:
+        return gzip_deflate_has_error(module->gzip);
+    }
+}
+
+int __encoder_is_end(http_module_gzip_t* module) {
+    switch (module->encoding) {
+    case CE_BR:
+        return brotli_encoder_is_end(&module->brotli);
+    case CE_ZSTD:
+        return zstd_encoder_is_end(&module->zstd);
+    default:
+        return gzip_is_end(module->gzip);
+    }
+}
+
+int __encoder_want_continue(http_module_gzip_t* module) {
+    switch (module->encoding) {
+    case CE_BR:
+        return brotli_encoder_want_continue(&module->brotli);
+    case CE_ZSTD:
+        return zstd_encoder_want_continue(&module->zstd);
+    default:
+        return gzip_want_continue(module->gzip);
+    }
+}
+
+size_t __encoder_bound(http_module_gzip_t* module, size_t length) {
+    switch (module->encoding) {
+    case CE_BR:
+        return brotli_encoder_bound(length);
+    case CE_ZSTD:
+        return zstd_encoder_bound(length);
+    default:
+        return deflateBound(&module->gzip->stream, length);
+    }
+}
+
+void __encoder_free(http_module_gzip_t* module) {
+    gzip_deflate_release(module->gzip);
+    module->gzip = NULL;
+    brotli_encoder_free(&module->brotli);
+    zstd_encoder_free(&module->zstd);
+    module->encoding = CE_NONE;
+}
@@ -4,11 +4,26 @@
 #include "httprequest.h"
 #include "httpresponse.h"
 #include "gzip.h"
+#include "brotli_encoder.h"
+#include "zstd_encoder.h"
 
+/*
+ * Фильтр сжатия ответа. Кодировка (gzip, br, zstd) выбирается по q-value
+ * из Accept-Encoding среди доступных в сборке; уровень берётся из элемента
+ * main.gzip, совпавшего с Content-Type.
+ *
+ * Ответы меньше main.gzip_min_length не сжимаются. Тело в памяти известной
+ * длины сжимается целиком за один проход и уходит с Content-Length,
+ * потоковое сжатие с chunked остаётся для файлов и явного chunked.
+ */
 typedef struct {
     http_module_t base;
     bufo_t* buf;
-    gzip_t gzip;
+    gzip_t* gzip;                  // Из пула потока, NULL вне сжатия
+    brotli_encoder_t brotli;
+    zstd_encoder_t zstd;
+    http_content_encoding_t encoding;
+    unsigned precompressed:1;      // Тело уже сжато: копия из open file cache или сжатие целиком
 } http_module_gzip_t;
 
 http_filter_t* http_gzip_filter_create(void);
@@ -71,8 +71,18 @@ int http_not_modified_header(httprequest_t* request, httpresponse_t* response) {
     if (module->base.cont)
         goto cont;
 
+    /* Файл из open file cache: валидаторы отформатированы при открытии.
+     * Ответ из памяти (file_content) не имеет fd, но валидаторы те же. */
+    filecache_entry_t* entry = response->file_entry;
+    if (entry != NULL && entry->mtime > 0) {
+        if (entry->last_modified_length > 0)
+            response->add_headern(response, "Last-Modified", 13, entry->last_modified, entry->last_modified_length);
+
+        if (entry->etag_length > 0)
+            response->add_headern(response, "ETag", 4, entry->etag, entry->etag_length);
+    }
     // Add Last-Modified header for files with mtime
-    if (response->file_.fd > -1 && response->file_.mtime > 0) {
+    else if (response->file_.fd > -1 && response->file_.mtime > 0) {
         char last_modified[64];
         if (http_format_date(response->file_.mtime, last_modified, sizeof(last_modified)) > 0) {
             response->add_header(response, "Last-Modified", last_modified);
@@ -4,6 +4,7 @@
 
 #include "http_write_filter.h"
 #include "log.h"
+#include "metrics.h"
 
 #define BUF_SIZE 16384
 
@@ -11,9 +12,14 @@ void http_write_free(void* arg);
 void http_write_reset(void* arg);
 
 ssize_t __write(connection_t* connection, const char* data, size_t size) {
-    return connection->ssl ?
+    const ssize_t writed = connection->ssl ?
         openssl_write(connection->ssl, data, size) :
         send(connection->fd, data, size, MSG_NOSIGNAL);
+
+    if (writed > 0)
+        metrics_record_bytes_out((size_t)writed);
+
+    return writed;
 }
 
 size_t __head_size(httpresponse_t* response) {
@@ -157,6 +163,9 @@ int __wr(httpresponse_t* response, bufo_t* buf) {
         }
 
         bufo_move_front_pos(buf, writed);
+        if (response->bytes_sent == 0)
+            response->first_byte_at = metrics_now_ns();
+        response->bytes_sent += (size_t)writed;
     }
 
     return CWF_OK;
@@ -5,9 +5,12 @@
 #include "httpresponse.h"
 #include "httprequestparser.h"
 #include "log.h"
+#include "memstat.h"
 #include "connection_queue.h"
 #include "openssl.h"
 #include "idn_utils.h"
+#include "probes.h"
+#include "profiler.h"
 
 typedef struct {
     connection_queue_item_data_t base;
@@ -15,6 +18,7 @@ typedef struct {
     httpresponse_t* response;
     connection_t* connection;
     ratelimiter_t* ratelimiter;
+    concurrencylimiter_t* concurrencylimiter;
 } connection_queue_http_data_t;
 
 struct middleware_item;
@@ -26,14 +30,18 @@ typedef void*(*queue_data_create)(connection_t* connection, httprequest_t* reque
 int run_middlewares(struct middleware_item* middleware_item, void* ctx);
 
 static int __tls_read(connection_t* connection);
+static int __tls_read_offload(connection_t* connection);
+static void __queue_handshake_handler(void* arg);
 static int __tls_write(connection_t* connection);
 static int __read(connection_t* connection);
 static int __write(connection_t* connection);
-static int __deferred_handler(connection_t* connection, httprequest_t* request, httpresponse_t* response, queue_handler runner, queue_handler handle, queue_data_create data_create, ratelimiter_t* ratelimiter);
+static int __deferred_handler(connection_t* connection, httprequest_t* request, httpresponse_t* response, queue_handler runner, queue_handler handle, queue_data_create data_create, ratelimiter_t* ratelimiter, route_priority_e priority, concurrencylimiter_t* concurrencylimiter);
+static int __deferred_request_handler(connection_t* connection, httprequest_t* request, httpresponse_t* response, route_t* route, ratelimiter_t* ratelimiter, deferred_handler handler);
 static int __handle(connection_t* connection, httprequest_t* request, deferred_handler handler);
-static int __handler_added_to_queue(httprequest_t* request, httpresponse_t* response);
-static int __get_redirect(connection_t* connection, httprequest_t* request);
-static int __apply_redirect(httprequest_t* request, httpresponse_t* response, deferred_handler handler);
+static int __handle_routing(connection_t* connection, httprequest_t* request, httpresponse_t* response, server_routing_t* routing, deferred_handler handler);
+static int __handler_added_to_queue(httprequest_t* request, httpresponse_t* response, server_routing_t* routing, deferred_handler handler);
+static int __get_redirect(connection_t* connection, httprequest_t* request, server_routing_t* routing);
+static int __apply_redirect(httprequest_t* request, httpresponse_t* response, server_routing_t* routing, deferred_handler handler);
 static void __queue_request_handler(void* arg);
 static void __queue_response_handler(void* arg);
 static void* __queue_data_request_create(connection_t* connection, httprequest_t* request, httpresponse_t* response, ratelimiter_t* ratelimiter);
@@ -48,12 +56,58 @@ static int __post_response_default(connection_t* connection, int status_code);
 static int __post_response(httprequest_t* request, httpresponse_t* response);
 static int __post_deffered_response(httprequest_t* request, httpresponse_t* response);
 static ratelimiter_t* __ratelimiter_find(server_http_t* http_config, route_t* route);
-static int __prepare_static_file_response(connection_server_ctx_t* ctx, httpresponse_t* response, const char* static_file_path);
+static int __prepare_static_file_response(connection_server_ctx_t* ctx, httprequest_t* request, httpresponse_t* response, const char* static_file_path);
+static int __metrics_requested(connection_t* connection, httprequest_t* request);
+static int __metrics_response(httprequest_t* request, httpresponse_t* response, deferred_handler handler);
+static int __profiler_requested(connection_t* connection, httprequest_t* request);
+static void __queue_profiler_handler(void* arg);
+static int __memory_exceeded(void);
 
 int __tls_read(connection_t* connection) {
     return __handshake(connection);
 }
 
+int __tls_read_offload(connection_t* connection) {
+    connection_server_ctx_t* ctx = connection->ctx;
+
+    // рукопожатие уже ожидает обработчика
+    if (!cqueue_empty(ctx->queue))
+        return 1;
+
+    connection_queue_item_t* item = connection_queue_item_create();
+    if (item == NULL) return 0;
+
+    item->run = __queue_handshake_handler;
+    item->connection = connection;
+
+    if (!cqueue_append(ctx->queue, item)) {
+        item->free(item);
+        return 0;
+    }
+
+    if (!connection_queue_append(item)) {
+        cqueue_pop(ctx->queue);
+        item->free(item);
+        return 0;
+    }
+
+    return 1;
+}
+
+void __queue_handshake_handler(void* arg) {
+    connection_queue_item_t* item = arg;
+    connection_t* connection = item->connection;
+
+    if (!__handshake(connection)) {
+        connection_server_ctx_t* ctx = connection->ctx;
+        atomic_store(&ctx->destroyed, 1);
+        connection_after_read(connection);
+        return;
+    }
+
+    connection_resume(connection);
+}
+
 int __tls_write(connection_t* connection) {
     (void)connection;
     log_error("tls write\n");
@@ -64,7 +118,7 @@ int set_tls(connection_t* connection) {
     connection_server_ctx_t* ctx = connection->ctx;
     connection->ssl_ctx = ctx->server->openssl->ctx;
 
-    connection->read = __tls_read;
+    connection->read = ctx->server->openssl->handshake_offload ? __tls_read_offload : __tls_read;
     connection->write = __tls_write;
     return 1;
 }
@@ -163,6 +217,8 @@ int __read(connection_t* connection) {
                     goto read_data;
                 case HTTP1PARSER_HANDLE_AND_CONTINUE:
                 {
+                    parser->request->parsed_at = metrics_now_ns();
+                    CWFR_PROBE(request_parsed, connection->fd, parser->request->method, parser->request->path, parser->request->parsed_at - parser->request->read_at);
                     if (!__handle(connection, parser->request, __post_deffered_response))
                         return 0;
 
@@ -171,6 +227,8 @@ int __read(connection_t* connection) {
                 }
                 case HTTP1PARSER_COMPLETE:
                 {
+                    parser->request->parsed_at = metrics_now_ns();
+                    CWFR_PROBE(request_parsed, connection->fd, parser->request->method, parser->request->path, parser->request->parsed_at - parser->request->read_at);
                     if (!__handle(connection, parser->request, __post_response))
                         return 0;
 
@@ -206,6 +264,14 @@ int __write(connection_t* connection) {
         return 0;
     }
 
+    if (!response->server_timing && ctx->server != NULL && ctx->server->server_timing) {
+        char value[512];
+        if (httpresponse_server_timing(response, ctx->request, metrics_now_ns(), value, sizeof(value)) > 0)
+            response->add_header(response, "Server-Timing", value);
+
+        response->server_timing = 1;
+    }
+
     int r = __run_header_filters(ctx->request, response);
     if (r == CWF_EVENT_AGAIN)
         return 1;
@@ -218,23 +284,61 @@ int __write(connection_t* connection) {
     if (r == CWF_ERROR)
         return 0;
 
+    ctx->metrics.started_at = response->started_at;
+    ctx->metrics.route = response->metrics_route;
+    ctx->metrics.status = response->status_code;
+
+    response->completed_at = metrics_now_ns();
+    CWFR_PROBE(response_complete, connection->fd, response->status_code, response->bytes_sent, response->completed_at - response->started_at);
+    if (response->first_byte_at > response->started_at)
+        metrics_record_first_byte(response->metrics_route, response->first_byte_at - response->started_at);
+
+    if (accesslog_enabled()) {
+        httprequest_t* request = ctx->request;
+        ctx->access.method = request != NULL ? httprequest_method_string(request->method) : NULL;
+        ctx->access.path = request != NULL ? request->path : NULL;
+        ctx->access.path_length = request != NULL ? request->path_length : 0;
+        ctx->access.bytes = response->bytes_sent;
+        ctx->access.parse_ns = request != NULL && request->parsed_at > request->read_at ? request->parsed_at - request->read_at : 0;
+        ctx->access.queue_ns = response->enqueued_at != 0 && response->handler_started_at > response->enqueued_at ? response->handler_started_at - response->enqueued_at : 0;
+        ctx->access.handler_ns = response->handler_finished_at - response->handler_started_at;
+        ctx->access.first_byte_ns = response->first_byte_at > response->started_at ? response->first_byte_at - response->started_at : 0;
+        ctx->access.spans_count = 0;
+        for (unsigned int i = 0; i < response->spans_count && i < ACCESSLOG_SPANS_MAX; i++) {
+            ctx->access.spans[i].name = response->spans[i].name;
+            ctx->access.spans[i].duration_ns = response->spans[i].duration_ns;
+            ctx->access.spans_count++;
+        }
+    }
+
     return connection_after_write(connection);
  }
 
-int __deferred_handler(connection_t* connection, httprequest_t* request, httpresponse_t* response, queue_handler runner, queue_handler handle, queue_data_create data_create, ratelimiter_t* ratelimiter) {
+// Место в concurrencylimiter переходит во владение задания: его освобождает
+// обработчик или освобождение данных задания, в том числе при ошибке здесь
+int __deferred_handler(connection_t* connection, httprequest_t* request, httpresponse_t* response, queue_handler runner, queue_handler handle, queue_data_create data_create, ratelimiter_t* ratelimiter, route_priority_e priority, concurrencylimiter_t* concurrencylimiter) {
     connection_queue_item_t* item = connection_queue_item_create();
-    if (item == NULL) return 0;
+    if (item == NULL) {
+        concurrencylimiter_release(concurrencylimiter, 0);
+        return 0;
+    }
 
+    item->priority = priority;
     item->run = runner;
     item->handle = handle;
     item->connection = connection;
     item->data = data_create(connection, request, response, ratelimiter);
+    response->enqueued_at = item->enqueued_at;
+    CWFR_PROBE(handler_enqueue, connection->fd, priority);
 
     if (item->data == NULL) {
+        concurrencylimiter_release(concurrencylimiter, 0);
         item->free(item);
         return 0;
     }
 
+    ((connection_queue_http_data_t*)item->data)->concurrencylimiter = concurrencylimiter;
+
     connection_server_ctx_t* ctx = connection->ctx;
     const int queue_empty = cqueue_empty(ctx->queue);
 
@@ -258,11 +362,54 @@ int __deferred_handler(connection_t* connection, httprequest_t* request, httpres
     return 1;
 }
 
+// Запрос сверх лимита маршрута не ставится в переполненную очередь:
+// 503 отдаёт сам воркер, как при сбросе нагрузки по памяти.
+// -1 - ответ отправить не удалось
+int __deferred_request_handler(connection_t* connection, httprequest_t* request, httpresponse_t* response, route_t* route, ratelimiter_t* ratelimiter, deferred_handler handler) {
+    response->metrics_route = route->metrics_id;
+
+    const route_priority_e priority = route->priority[request->method];
+    concurrencylimiter_t* concurrencylimiter = route->concurrencylimiter[request->method];
+
+    if (!concurrencylimiter_acquire(concurrencylimiter)) {
+        httpresponse_default(response, 503);
+        response->add_header(response, "Retry-After", "1");
+        return handler(request, response) ? 1 : -1;
+    }
+
+    return __deferred_handler(connection, request, response, __queue_request_handler, route->handler[request->method], __queue_data_request_create, ratelimiter, priority, concurrencylimiter);
+}
+
 int __handle(connection_t* connection, httprequest_t* request, deferred_handler handler) {
     httpresponse_t* response = httpresponse_create(connection);
     if (response == NULL) return 0;
 
-    switch (__apply_redirect(request, response, handler)) {
+    // Задание в очереди держит снимок своей меткой, эта защищает только поиск маршрута
+    connection_server_ctx_t* ctx = connection->ctx;
+    const unsigned long token = server_routing_enter();
+    const int result = __handle_routing(connection, request, response, server_routing(ctx->server), handler);
+    server_routing_exit(token);
+
+    return result;
+}
+
+int __handle_routing(connection_t* connection, httprequest_t* request, httpresponse_t* response, server_routing_t* routing, deferred_handler handler) {
+    if (__metrics_requested(connection, request))
+        return __metrics_response(request, response, handler);
+
+    // замер длится секунды: он занимает поток-обработчик, а не воркер
+    if (__profiler_requested(connection, request))
+        return __deferred_handler(connection, request, response, __queue_profiler_handler, NULL, __queue_data_response_create, NULL, ROUTE_PRIORITY_LOW, NULL);
+
+    // Мягкий лимит памяти: запрос не доходит до обработчика и не растит его память.
+    // Метрики и профилировщик выше остаются доступными
+    if (__memory_exceeded()) {
+        httpresponse_default(response, 503);
+        response->add_header(response, "Retry-After", "1");
+        return handler(request, response);
+    }
+
+    switch (__apply_redirect(request, response, routing, handler)) {
     case -1:
         return 0;
     case 1:
@@ -272,47 +419,154 @@ int __handle(connection_t* connection, httprequest_t* request, deferred_handler
         break;
     }
 
-    if (__handler_added_to_queue(request, response))
+    switch (__handler_added_to_queue(request, response, routing, handler)) {
+    case -1:
+        return 0;
+    case 1:
         return 1;
+    case 0:
+    default:
+        break;
+    }
 
     connection_server_ctx_t* ctx = connection->ctx;
-    char file_full_path[PATH_MAX];
-    const file_status_e file_status = http_get_file_full_path(ctx->server, file_full_path, PATH_MAX, request->path, request->path_length);
+    filecache_entry_t* entry = http_get_file_entry(ctx->server, request->path, request->path_length);
+    const filecache_status_e file_status = entry != NULL ? entry->status : FILECACHE_NOTFOUND;
 
-    if (file_status == FILE_OK) {
-        if (!ratelimiter_allow(ctx->server->http.ratelimiter, connection->remote_ip, 1)) {
+    if (file_status == FILECACHE_OK) {
+        if (!ratelimiter_allow(routing->http.ratelimiter, connection->remote_ip, 1)) {
+            filecache_release(entry);
             httpresponse_default(response, 429);
             response->add_header(response, "Retry-After", "1");
         }
         else
-            http_response_file(response, file_full_path);
+            http_response_file_entry_negotiate(response, entry, request->get_header(request, "Accept-Encoding"));
+    }
+    else {
+        filecache_release(entry);
+
+        if (file_status == FILECACHE_FORBIDDEN)
+            httpresponse_default(response, 403);
+        else
+            httpresponse_default(response, 404);
+    }
+
+    return handler(request, response);
+}
+
+int __metrics_requested(connection_t* connection, httprequest_t* request) {
+    connection_server_ctx_t* ctx = connection->ctx;
+    const server_t* server = ctx->server;
+
+    if (server->metrics_path == NULL) return 0;
+    if (request->method != ROUTE_GET && request->method != ROUTE_HEAD) return 0;
+    if (request->path_length != server->metrics_path_length) return 0;
+
+    return memcmp(request->path, server->metrics_path, request->path_length) == 0;
+}
+
+// Выдача метрик собирается прямо в потоке воркера: она не должна зависеть
+// от загруженности очереди обработчиков, которую и показывает
+int __metrics_response(httprequest_t* request, httpresponse_t* response, deferred_handler handler) {
+    str_t out;
+    str_init(&out, 16384);
+
+    if (metrics_render(&out)) {
+        response->add_header(response, "Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+        response->send_datan(response, str_get(&out), str_size(&out));
     }
-    else if (file_status == FILE_FORBIDDEN)
-        httpresponse_default(response, 403);
     else
-        httpresponse_default(response, 404);
+        httpresponse_default(response, 500);
+
+    str_clear(&out);
 
     return handler(request, response);
 }
 
-int __handler_added_to_queue(httprequest_t* request, httpresponse_t* response) {
+int __profiler_requested(connection_t* connection, httprequest_t* request) {
+    connection_server_ctx_t* ctx = connection->ctx;
+    const server_t* server = ctx->server;
+
+    if (server->profiler_path == NULL) return 0;
+    if (request->method != ROUTE_GET) return 0;
+    if (request->path_length != server->profiler_path_length) return 0;
+
+    return memcmp(request->path, server->profiler_path, request->path_length) == 0;
+}
+
+// ?seconds=N&hz=M, ответ - folded stacks всех потоков процесса
+void __queue_profiler_handler(void* arg) {
+    connection_queue_item_t* item = arg;
+    if (item == NULL || item->data == NULL || item->connection == NULL) {
+        log_error("__queue_profiler_handler: item, item->data or item->connection is NULL\n");
+        return;
+    }
+
+    connection_queue_http_data_t* data = (connection_queue_http_data_t*)item->data;
+    connection_server_ctx_t* conn_ctx = item->connection->ctx;
+    httprequest_t* request = data->request;
+    httpresponse_t* response = data->response;
+
+    conn_ctx->request = request;
+    conn_ctx->response = response;
+
+    int ok = 0;
+    unsigned int seconds = query_param_uint(request->query_, "seconds", &ok);
+    if (!ok || seconds == 0) seconds = PROFILER_SECONDS_DEFAULT;
+    if (seconds > PROFILER_SECONDS_MAX) seconds = PROFILER_SECONDS_MAX;
+
+    unsigned int frequency = query_param_uint(request->query_, "hz", &ok);
+    if (!ok || frequency == 0) frequency = PROFILER_FREQUENCY_DEFAULT;
+
+    str_t out;
+    str_init(&out, 65536);
+
+    profiler_stats_t stats;
+    switch (profiler_run(seconds * 1000, frequency, &out, &stats)) {
+    case PROFILER_OK:
+    {
+        char value[32];
+        response->add_header(response, "Content-Type", "text/plain; charset=utf-8");
+        snprintf(value, sizeof(value), "%zu", stats.samples);
+        response->add_header(response, "X-Profile-Samples", value);
+        snprintf(value, sizeof(value), "%zu", stats.dropped);
+        response->add_header(response, "X-Profile-Dropped", value);
+        response->send_datan(response, str_get(&out), str_size(&out));
+        break;
+    }
+    case PROFILER_BUSY:
+        httpresponse_default(response, 409);
+        break;
+    default:
+        httpresponse_default(response, 500);
+        break;
+    }
+
+    str_clear(&out);
+
+    connection_after_read(item->connection);
+}
+
+int __handler_added_to_queue(httprequest_t* request, httpresponse_t* response, server_routing_t* routing, deferred_handler handler) {
     connection_t* connection = request->connection;
     connection_server_ctx_t* ctx = connection->ctx;
 
-    for (route_t* route = ctx->server->http.route; route; route = route->next) {
-        ratelimiter_t* ratelimiter = __ratelimiter_find(&ctx->server->http, route);
+    for (route_t* route = routing->http.route; route; route = route->next) {
+        ratelimiter_t* ratelimiter = __ratelimiter_find(&routing->http, route);
 
         if (route->is_primitive && route_compare_primitive(route, request->path, request->path_length)) {
             if (route->static_file[request->method] != NULL) {
-                if (!__prepare_static_file_response(ctx, response, route->static_file[request->method]))
+                if (!__prepare_static_file_response(ctx, request, response, route->static_file[request->method]))
                     return 0;
 
-                return __deferred_handler(connection, request, response, __queue_response_handler, NULL, __queue_data_response_create, ratelimiter);
+                response->metrics_route = route->metrics_id;
+
+                return __deferred_handler(connection, request, response, __queue_response_handler, NULL, __queue_data_response_create, ratelimiter, route->priority[request->method], NULL);
             }
 
             if (route->handler[request->method] == NULL) continue;
 
-            return __deferred_handler(connection, request, response, __queue_request_handler, route->handler[request->method], __queue_data_request_create, ratelimiter);
+            return __deferred_request_handler(connection, request, response, route, ratelimiter, handler);
         }
 
         int vector_size = route->params_count > 0 ? route->params_count * 6 : 20 * 6;
@@ -335,37 +589,41 @@ int __handler_added_to_queue(httprequest_t* request, httpresponse_t* response) {
             }
 
             if (route->static_file[request->method] != NULL) {
-                if (!__prepare_static_file_response(ctx, response, route->static_file[request->method]))
+                if (!__prepare_static_file_response(ctx, request, response, route->static_file[request->method]))
                     return 0;
 
-                return __deferred_handler(connection, request, response, __queue_response_handler, NULL, __queue_data_response_create, ratelimiter);
+                response->metrics_route = route->metrics_id;
+
+                return __deferred_handler(connection, request, response, __queue_response_handler, NULL, __queue_data_response_create, ratelimiter, route->priority[request->method], NULL);
             }
 
             if (route->handler[request->method] == NULL) continue;
 
-            return __deferred_handler(connection, request, response,  __queue_request_handler, route->handler[request->method], __queue_data_request_create, ratelimiter);
+            return __deferred_request_handler(connection, request, response, route, ratelimiter, handler);
         }
         else if (matches_count == 1) {
             if (route->static_file[request->method] != NULL) {
-                if (!__prepare_static_file_response(ctx, response, route->static_file[request->method]))
+                if (!__prepare_static_file_response(ctx, request, response, route->static_file[request->method]))
                     return 0;
 
-                return __deferred_handler(connection, request, response, __queue_response_handler, NULL, __queue_data_response_create, ratelimiter);
+                response->metrics_route = route->metrics_id;
+
+                return __deferred_handler(connection, request, response, __queue_response_handler, NULL, __queue_data_response_create, ratelimiter, route->priority[request->method], NULL);
             }
 
             if (route->handler[request->method] == NULL) continue;
 
-            return __deferred_handler(connection, request, response,  __queue_request_handler, route->handler[request->method], __queue_data_request_create, ratelimiter);
+            return __deferred_request_handler(connection, request, response, route, ratelimiter, handler);
         }
     }
 
     return 0;
 }
 
-int __apply_redirect(httprequest_t* request, httpresponse_t* response, deferred_handler handler) {
+int __apply_redirect(httprequest_t* request, httpresponse_t* response, server_routing_t* routing, deferred_handler handler) {
     connection_t* connection = request->connection;
     
-    switch (__get_redirect(connection, request)) {
+    switch (__get_redirect(connection, request, routing)) {
     case REDIRECT_OUT_OF_MEMORY:
     {
         httpresponse_default(response, 500);
@@ -394,12 +652,11 @@ int __apply_redirect(httprequest_t* request, httpresponse_t* response, deferred_
     return 0;
 }
 
-int __get_redirect(connection_t* connection, httprequest_t* request) {
+int __get_redirect(connection_t* connection, httprequest_t* request, server_routing_t* routing) {
     int loop_cycle = 1;
     int find_new_location = 0;
 
-    connection_server_ctx_t* ctx = connection->ctx;
-    redirect_t* redirect = ctx->server->http.redirect;
+    redirect_t* redirect = routing->http.redirect;
 
     while (redirect) {
         if (loop_cycle >= 10) return REDIRECT_LOOP_CYCLE;
@@ -445,7 +702,7 @@ int __get_redirect(connection_t* connection, httprequest_t* request) {
             return REDIRECT_BAD_REQUEST;
         }
 
-        redirect = ctx->server->http.redirect;
+        redirect = routing->http.redirect;
 
         loop_cycle++;
     }
@@ -462,6 +719,7 @@ void* __queue_data_request_create(connection_t* connection, httprequest_t* reque
     data->connection = connection;
     data->response = response;
     data->ratelimiter = ratelimiter;
+    data->concurrencylimiter = NULL;
 
     return data;
 }
@@ -475,6 +733,7 @@ void* __queue_data_response_create(connection_t* connection, httprequest_t* requ
     data->connection = connection;
     data->response = response;
     data->ratelimiter = ratelimiter;
+    data->concurrencylimiter = NULL;
 
     return data;
 }
@@ -484,6 +743,9 @@ void __queue_data_request_free(void* arg) {
 
     connection_queue_http_data_t* data = arg;
 
+    // задание не дошло до обработчика
+    concurrencylimiter_release(data->concurrencylimiter, 0);
+
     free(data);
 }
 
@@ -522,6 +784,26 @@ void __queue_request_handler(void* arg) {
     conn_ctx->request = data->request;
     conn_ctx->response = data->response;
 
+    const unsigned int metrics_route = data->response != NULL ? data->response->metrics_route : METRICS_ROUTE_NONE;
+    const uint64_t queue_wait = connection_queue_item_wait(item);
+    metrics_record_queue_wait(metrics_route, queue_wait);
+    CWFR_PROBE(handler_dequeue, item->connection->fd, queue_wait);
+
+    // ответ уже никому не нужен: клиент ждал дольше бюджета очереди
+    const uint64_t wait_budget = (uint64_t)env()->main.queue_wait_budget * 1000000ULL;
+    if (wait_budget > 0 && queue_wait > wait_budget) {
+        concurrencylimiter_release_overload(data->concurrencylimiter);
+        data->concurrencylimiter = NULL;
+
+        httpresponse_t* response = conn_ctx->response;
+        if (response != NULL) {
+            httpresponse_default(response, 503);
+            response->add_header(response, "Retry-After", "1");
+        }
+        connection_after_read(item->connection);
+        return;
+    }
+
     if (!ratelimiter_allow(data->ratelimiter, item->connection->remote_ip, 1)) {
         httpresponse_t* response = conn_ctx->response;
         if (response != NULL) {
@@ -535,11 +817,27 @@ void __queue_request_handler(void* arg) {
     httpctx_t ctx;
     httpctx_init(&ctx, conn_ctx->request, conn_ctx->response);
 
-    if (run_middlewares(conn_ctx->server->http.middleware, &ctx))
+    httpresponse_t* response = conn_ctx->response;
+    const uint64_t handler_started_at = metrics_now_ns();
+    CWFR_PROBE(handler_start, item->connection->fd, ctx.request != NULL ? ctx.request->path : NULL);
+
+    // снимок защищён меткой задания (connection_queue_item_create)
+    if (run_middlewares(server_routing(conn_ctx->server)->http.middleware, &ctx))
         item->handle(&ctx);
 
+    const uint64_t handler_finished_at = metrics_now_ns();
+    metrics_record_handler(metrics_route, handler_finished_at - handler_started_at);
+    CWFR_PROBE(handler_end, item->connection->fd, handler_finished_at - handler_started_at);
+    if (response != NULL) {
+        response->handler_started_at = handler_started_at;
+        response->handler_finished_at = handler_finished_at;
+    }
+
     httpctx_clear(&ctx);
 
+    concurrencylimiter_release(data->concurrencylimiter, connection_queue_item_wait(item));
+    data->concurrencylimiter = NULL;
+
     connection_after_read(item->connection);
 }
 
@@ -659,7 +957,11 @@ int __run_body_filters(httprequest_t* request, httpresponse_t* response) {
 }
 
 int __handshake(connection_t* connection) {
+    connection_server_ctx_t* ctx = connection->ctx;
+
     if (connection->ssl == NULL) {
+        ctx->handshake_started_at = metrics_now_ns();
+
         connection->ssl = SSL_new(connection->ssl_ctx);
         if (connection->ssl == NULL) {
             log_error(TLS_ERROR_ALLOC_SSL);
@@ -679,6 +981,11 @@ int __handshake(connection_t* connection) {
 
     const int result = SSL_do_handshake(connection->ssl);
     if (result == 1) {
+        const uint64_t handshake_ns = metrics_now_ns() - ctx->handshake_started_at;
+        openssl_handshake_done(connection->ssl);
+        metrics_record_handshake(handshake_ns);
+        CWFR_PROBE(tls_handshake, connection->fd, SSL_session_reused(connection->ssl), handshake_ns);
+
         if (!set_http(connection))
             return 0;
 
@@ -809,7 +1116,7 @@ int __post_response(httprequest_t* request, httpresponse_t* response) {
         return connection_after_read(connection);
     }
 
-    return __deferred_handler(connection, request, response, __queue_response_handler, NULL, __queue_data_response_create, NULL);
+    return __deferred_handler(connection, request, response, __queue_response_handler, NULL, __queue_data_response_create, NULL, ROUTE_PRIORITY_NORMAL, NULL);
 }
 
 int __post_deffered_response(httprequest_t* request, httpresponse_t* response) {
@@ -824,7 +1131,7 @@ int __post_deffered_response(httprequest_t* request, httpresponse_t* response) {
         return 0;
     }
 
-    return __deferred_handler(connection, request, response, __queue_response_handler, NULL, __queue_data_response_create, NULL);
+    return __deferred_handler(connection, request, response, __queue_response_handler, NULL, __queue_data_response_create, NULL, ROUTE_PRIORITY_NORMAL, NULL);
 }
 
 ratelimiter_t* __ratelimiter_find(server_http_t* http_config, route_t* route) {
@@ -833,7 +1140,7 @@ ratelimiter_t* __ratelimiter_find(server_http_t* http_config, route_t* route) {
     return http_config->ratelimiter;
 }
 
-int __prepare_static_file_response(connection_server_ctx_t* ctx, httpresponse_t* response, const char* static_file_path) {
+int __prepare_static_file_response(connection_server_ctx_t* ctx, httprequest_t* request, httpresponse_t* response, const char* static_file_path) {
     char file_full_path[PATH_MAX];
     size_t pos = 0;
     size_t static_file_len = strlen(static_file_path);
@@ -855,7 +1162,7 @@ int __prepare_static_file_response(connection_server_ctx_t* ctx, httpresponse_t*
 
     file_full_path[pos] = '\0';
 
-    http_response_file(response, file_full_path);
+    http_response_file_negotiate(response, file_full_path, request->get_header(request, "Accept-Encoding"));
 
     return 1;
 }
@@ -865,3 +1172,14 @@ void http_server_init_sni_callbacks(server_t* servers) {
         if (server->openssl != NULL)
             openssl_set_sni_callback(server->openssl, __sni_callback);
 }
+
+// Подсистемы, которые растит обработчик запроса: тела, буферы, json, результаты БД
+int __memory_exceeded(void) {
+    static const memstat_subsystem_e subsystems[] = { MEMSTAT_BODIES, MEMSTAT_BUFFERS, MEMSTAT_JSON, MEMSTAT_DBRESULT };
+
+    for (size_t i = 0; i < sizeof(subsystems) / sizeof(subsystems[0]); i++)
+        if (memstat_should_shed(subsystems[i]))
+            return 1;
+
+    return 0;
+}
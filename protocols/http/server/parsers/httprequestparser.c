@@ -14,6 +14,7 @@
 #include "httpcommon.h"
 #include "httprequestparser.h"
 #include "helpers.h"
+#include "memstat.h"
 #include "queryparser.h"
 #include "idn_utils.h"
 #include "connection_s.h"
@@ -50,6 +51,7 @@ httprequestparser_t* httpparser_create(connection_t* connection) {
     if (parser == NULL) return NULL;
 
     httpparser_init(parser, connection);
+    memstat_add(MEMSTAT_CONNECTIONS, sizeof * parser);
 
     return parser;
 }
@@ -75,6 +77,7 @@ void httpparser_init(httprequestparser_t* parser, connection_t* connection) {
 }
 
 void httpparser_free(void* parser) {
+    memstat_sub(MEMSTAT_CONNECTIONS, sizeof(httprequestparser_t));
     __clear(parser);
     free(parser);
 }
@@ -85,8 +88,7 @@ void httpparser_reset(httprequestparser_t* parser) {
 }
 
 void __clear_buf(httprequestparser_t* parser) {
-    if (parser->buf.dynamic_buffer) free(parser->buf.dynamic_buffer);
-    parser->buf.dynamic_buffer = NULL;
+    bufferdata_clear(&parser->buf);
 }
 
 int __clear_and_return(httprequestparser_t* parser, int error) {
@@ -133,6 +135,8 @@ int httpparser_run(httprequestparser_t* parser) {
                 if (parser->request == NULL)
                     return __clear_and_return(parser, HTTP1PARSER_OUT_OF_MEMORY);
 
+                parser->request->read_at = metrics_now_ns();
+
                 const size_t remaining = parser->bytes_readed - parser->pos;
                 const size_t log_size = remaining < 500 ? remaining : 500;
                 log_debug("HTTP Request head (%zu bytes): %.*s", log_size, (int)log_size, &parser->buffer[parser->pos]);
@@ -45,8 +45,7 @@ void smtpresponseparser_reset(smtpresponseparser_t* parser) {
 }
 
 void __smtpresponseparser_flush(smtpresponseparser_t* parser) {
-    if (parser->buf.dynamic_buffer) free(parser->buf.dynamic_buffer);
-    parser->buf.dynamic_buffer = NULL;
+    bufferdata_clear(&parser->buf);
 }
 
 int smtpresponseparser_run(smtpresponseparser_t* parser) {
@@ -4,6 +4,7 @@
 #include "appconfig.h"
 #include "websocketsparser.h"
 #include "connection_s.h"
+#include "memstat.h"
 
 int websocketsparser_parse_first_byte(websocketsparser_t*);
 int websocketsparser_parse_second_byte(websocketsparser_t*);
@@ -47,6 +48,7 @@ websocketsparser_t* websocketsparser_create(connection_t* connection, websockets
     parser->connection = connection;
     parser->protocol_create = protocol_create;
     parser->buffer = connection->buffer;
+    memstat_add(MEMSTAT_CONNECTIONS, sizeof * parser);
 
     return parser;
 }
@@ -77,6 +79,7 @@ void websocketsparser_free(void* arg) {
     __clear(parser);
     ws_deflate_free(&parser->ws_deflate);
     bufo_clear(&parser->compressed_buf);
+    memstat_sub(MEMSTAT_CONNECTIONS, sizeof * parser);
     free(parser);
 }
 
@@ -103,8 +106,7 @@ void __clear(websocketsparser_t* parser) {
 }
 
 void websocketsparser_flush(websocketsparser_t* parser) {
-    if (parser->buf.dynamic_buffer) free(parser->buf.dynamic_buffer);
-    parser->buf.dynamic_buffer = NULL;
+    bufferdata_clear(&parser->buf);
 
     parser->stage = WSPARSER_STAGE_FIRST_BYTE;
     parser->bytes_readed = 0;
@@ -247,7 +247,8 @@ void websockets_queue_request_handler(void* arg) {
     wsctx_t ctx;
     wsctx_init(&ctx, data->request, conn_ctx->response);
 
-    if (run_middlewares(conn_ctx->server->websockets.middleware, &ctx))
+    // снимок защищён меткой задания (connection_queue_item_create)
+    if (run_middlewares(server_routing(conn_ctx->server)->websockets.middleware, &ctx))
         item->handle(&ctx);
 
     wsctx_clear(&ctx);
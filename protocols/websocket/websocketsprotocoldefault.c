@@ -35,9 +35,14 @@ websockets_protocol_t* websockets_protocol_default_create(void) {
 int websocketsrequest_get_default(connection_t* connection, websocketsrequest_t* request) {
     connection_server_ctx_t* ctx = connection->ctx;
 
-    ratelimiter_t* ratelimiter = ctx->server->websockets.ratelimiter;
+    const unsigned long token = server_routing_enter();
+    server_routing_t* routing = server_routing(ctx->server);
 
-    return websockets_deferred_handler(connection, request, websockets_queue_request_handler, ctx->server->websockets.default_handler, websockets_queue_data_request_create, ratelimiter);
+    const int result = websockets_deferred_handler(connection, request, websockets_queue_request_handler, routing->websockets.default_handler, websockets_queue_data_request_create, routing->websockets.ratelimiter);
+
+    server_routing_exit(token);
+
+    return result;
 }
 
 void websockets_protocol_default_reset(void* protocol) {
@@ -27,6 +27,7 @@ int websocketsparser_append_uri(websockets_protocol_resource_t*, const char*, si
 int websocketsparser_set_path(websockets_protocol_resource_t*, const char*, size_t);
 int websocketsparser_set_query(websockets_protocol_resource_t*, const char*, size_t, size_t);
 static ratelimiter_t* __ratelimiter_find(server_websockets_t* websockets_config, route_t* route);
+static int __get_resource(connection_t* connection, websocketsrequest_t* request, server_routing_t* routing);
 
 websockets_protocol_t* websockets_protocol_resource_create(void) {
     websockets_protocol_resource_t* protocol = malloc(sizeof * protocol);
@@ -86,8 +87,18 @@ int websocketsrequest_get_resource(connection_t* connection, websocketsrequest_t
 
     connection_server_ctx_t* ctx = connection->ctx;
 
-    for (route_t* route = ctx->server->websockets.route; route; route = route->next) {
-        ratelimiter_t* ratelimiter = __ratelimiter_find(&ctx->server->websockets, route);
+    const unsigned long token = server_routing_enter();
+    const int result = __get_resource(connection, request, server_routing(ctx->server));
+    server_routing_exit(token);
+
+    return result;
+}
+
+int __get_resource(connection_t* connection, websocketsrequest_t* request, server_routing_t* routing) {
+    websockets_protocol_resource_t* protocol = (websockets_protocol_resource_t*)request->protocol;
+
+    for (route_t* route = routing->websockets.route; route; route = route->next) {
+        ratelimiter_t* ratelimiter = __ratelimiter_find(&routing->websockets, route);
 
         if (route->is_primitive && route_compare_primitive(route, protocol->path, protocol->path_length)) {
             if (route->handler[protocol->method] == NULL) continue;
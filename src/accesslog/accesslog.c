@@ -0,0 +1,449 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/stat.h>
+
+#include "log.h"
+#include "threadring.h"
+#include "accesslog.h"
+
+// Буфер строк одного потока, степень двойки
+#define ACCESSLOG_RING_SIZE 262144
+// Путь и имена отрезков длиннее обрезаются, чтобы строка всегда помещалась в ACCESSLOG_LINE_SIZE
+#define ACCESSLOG_PATH_MAX 1024
+#define ACCESSLOG_SPAN_NAME_MAX 31
+#define ACCESSLOG_LINE_SIZE (ACCESSLOG_PATH_MAX * 6 + ACCESSLOG_SPANS_MAX * (ACCESSLOG_SPAN_NAME_MAX * 6 + 32) + 384)
+#define ACCESSLOG_BATCH_SIZE 262144
+
+/*
+ * Кольцо байтов одного потока, head и tail считают байты.
+ * Строки лежат целиком, перевод строки - граница записи.
+ */
+typedef struct accesslog_ring {
+    threadring_t base;
+    char data[ACCESSLOG_RING_SIZE];
+} accesslog_ring_t;
+
+typedef struct accesslog_file {
+    int fd;
+    size_t size;
+    time_t opened_at;
+} accesslog_file_t;
+
+static void* __writer(void* arg);
+static size_t __drain(accesslog_file_t* file, char* batch);
+static void __flush(accesslog_file_t* file, char* batch, size_t size);
+static int __file_open(accesslog_file_t* file);
+static void __file_rotate(accesslog_file_t* file);
+static void __file_close(accesslog_file_t* file);
+static char* __append_uint(char* out, unsigned long long value);
+static char* __append_str(char* out, const char* value, size_t length);
+static char* __append_escaped(char* out, const char* value, size_t length);
+
+static threadrings_t __rings = THREADRINGS_INITIALIZER;
+static _Thread_local threadring_t* __ring = NULL;
+
+static atomic_bool __running = 0;
+static atomic_bool __stop = 0;
+static atomic_bool __reopen = 0;
+static atomic_ullong __dropped = 0;
+static pthread_t __writer_thread;
+// Запуск, остановка и настройки файла
+static pthread_mutex_t __mutex = PTHREAD_MUTEX_INITIALIZER;
+static char* __path = NULL;
+static size_t __rotate_size = 0;
+static unsigned int __rotate_interval = 0;
+
+int accesslog_start(const char* file, size_t rotate_size, unsigned int rotate_interval) {
+    if (file == NULL) {
+        accesslog_stop();
+        return 1;
+    }
+
+    int result = 0;
+
+    pthread_mutex_lock(&__mutex);
+
+    char* path = strdup(file);
+    if (path == NULL) goto failed;
+
+    free(__path);
+    __path = path;
+    __rotate_size = rotate_size;
+    __rotate_interval = rotate_interval;
+
+    // Новые настройки применит уже работающий фоновый поток
+    if (atomic_load(&__running)) {
+        accesslog_reopen();
+        result = 1;
+        goto failed;
+    }
+
+    // Ошибка в пути видна сразу, файл затем открывает фоновый поток
+    const int fd = open(__path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        log_error("accesslog: can't open %s: %s\n", __path, strerror(errno));
+        goto failed;
+    }
+    close(fd);
+
+    if (!threadrings_open(&__rings)) goto failed;
+
+    atomic_store(&__stop, 0);
+    atomic_store(&__reopen, 1);
+
+    if (pthread_create(&__writer_thread, NULL, __writer, NULL) != 0) {
+        threadrings_close(&__rings);
+        goto failed;
+    }
+
+    pthread_setname_np(__writer_thread, "Server access");
+
+    atomic_store(&__running, 1);
+
+    result = 1;
+
+    failed:
+
+    pthread_mutex_unlock(&__mutex);
+
+    return result;
+}
+
+void accesslog_stop(void) {
+    pthread_mutex_lock(&__mutex);
+
+    if (!atomic_load(&__running)) {
+        pthread_mutex_unlock(&__mutex);
+        return;
+    }
+
+    atomic_store(&__running, 0);
+    atomic_store(&__stop, 1);
+    threadrings_wakeup(&__rings);
+
+    const pthread_t thread = __writer_thread;
+
+    // Фоновый поток берёт мьютекс при открытии и ротации файла
+    pthread_mutex_unlock(&__mutex);
+
+    pthread_join(thread, NULL);
+
+    pthread_mutex_lock(&__mutex);
+    threadrings_close(&__rings);
+    pthread_mutex_unlock(&__mutex);
+}
+
+int accesslog_enabled(void) {
+    return atomic_load_explicit(&__running, memory_order_relaxed);
+}
+
+void accesslog_write(const accesslog_record_t* record) {
+    if (!accesslog_enabled()) return;
+
+    accesslog_ring_t* ring = (accesslog_ring_t*)(__ring != NULL ? __ring : threadrings_attach(&__rings, &__ring, sizeof(accesslog_ring_t)));
+    if (ring == NULL) return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    char line[ACCESSLOG_LINE_SIZE];
+    char* pos = line;
+
+    char ip[INET_ADDRSTRLEN] = {0};
+    struct in_addr addr = { .s_addr = record->remote_ip };
+    inet_ntop(AF_INET, &addr, ip, sizeof(ip));
+
+    const char* method = record->method != NULL ? record->method : "-";
+    const size_t path_length = record->path_length < ACCESSLOG_PATH_MAX ? record->path_length : ACCESSLOG_PATH_MAX;
+
+    pos = __append_str(pos, "{\"time_ms\":", 11);
+    pos = __append_uint(pos, (unsigned long long)now.tv_sec * 1000 + now.tv_nsec / 1000000);
+    pos = __append_str(pos, ",\"ip\":\"", 7);
+    pos = __append_str(pos, ip, strlen(ip));
+    pos = __append_str(pos, "\",\"method\":\"", 12);
+    pos = __append_str(pos, method, strlen(method));
+    pos = __append_str(pos, "\",\"path\":\"", 10);
+    pos = __append_escaped(pos, record->path != NULL ? record->path : "", record->path != NULL ? path_length : 0);
+    pos = __append_str(pos, "\",\"status\":", 11);
+    pos = __append_uint(pos, record->status > 0 ? (unsigned long long)record->status : 0);
+    pos = __append_str(pos, ",\"bytes\":", 9);
+    pos = __append_uint(pos, record->bytes);
+    pos = __append_str(pos, ",\"duration_us\":", 15);
+    pos = __append_uint(pos, record->duration_ns / 1000);
+    pos = __append_str(pos, ",\"parse_us\":", 12);
+    pos = __append_uint(pos, record->parse_ns / 1000);
+    pos = __append_str(pos, ",\"queue_us\":", 12);
+    pos = __append_uint(pos, record->queue_ns / 1000);
+    pos = __append_str(pos, ",\"handler_us\":", 14);
+    pos = __append_uint(pos, record->handler_ns / 1000);
+    pos = __append_str(pos, ",\"first_byte_us\":", 17);
+    pos = __append_uint(pos, record->first_byte_ns / 1000);
+
+    if (record->spans_count > 0) {
+        pos = __append_str(pos, ",\"spans\":{", 10);
+        for (unsigned int i = 0; i < record->spans_count && i < ACCESSLOG_SPANS_MAX; i++) {
+            const char* name = record->spans[i].name != NULL ? record->spans[i].name : "";
+            const size_t name_length = strnlen(name, ACCESSLOG_SPAN_NAME_MAX);
+
+            pos = __append_str(pos, i > 0 ? ",\"" : "\"", i > 0 ? 2 : 1);
+            pos = __append_escaped(pos, name, name_length);
+            pos = __append_str(pos, "\":", 2);
+            pos = __append_uint(pos, record->spans[i].duration_ns / 1000);
+        }
+        pos = __append_str(pos, "}", 1);
+    }
+
+    pos = __append_str(pos, "}\n", 2);
+
+    const size_t size = (size_t)(pos - line);
+
+    const unsigned long head = atomic_load_explicit(&ring->base.head, memory_order_relaxed);
+    const unsigned long tail = atomic_load_explicit(&ring->base.tail, memory_order_acquire);
+    const size_t used = head - tail;
+    if (ACCESSLOG_RING_SIZE - used < size) {
+        atomic_fetch_add_explicit(&ring->base.dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    const size_t offset = head & (ACCESSLOG_RING_SIZE - 1);
+    const size_t first = ACCESSLOG_RING_SIZE - offset < size ? ACCESSLOG_RING_SIZE - offset : size;
+    memcpy(ring->data + offset, line, first);
+    memcpy(ring->data, line + first, size - first);
+
+    atomic_store_explicit(&ring->base.head, head + size, memory_order_release);
+
+    // Раньше таймера фоновый поток будится, только когда буфер заполнен наполовину
+    if (used + size < ACCESSLOG_RING_SIZE / 2) return;
+
+    threadrings_notify(&__rings);
+}
+
+void accesslog_reopen(void) {
+    atomic_store(&__reopen, 1);
+    threadrings_wakeup(&__rings);
+}
+
+unsigned long long accesslog_dropped(void) {
+    return atomic_load(&__dropped);
+}
+
+void* __writer(void* arg) {
+    (void)arg;
+
+    threadrings_writer_sigmask();
+
+    char* batch = malloc(ACCESSLOG_BATCH_SIZE);
+    if (batch == NULL) {
+        log_error("accesslog: alloc memory for batch failed\n");
+        return NULL;
+    }
+
+    accesslog_file_t file = { .fd = -1, .size = 0, .opened_at = 0 };
+
+    while (1) {
+        if (atomic_exchange(&__reopen, 0))
+            __file_open(&file);
+
+        const int stop = atomic_load(&__stop);
+
+        __drain(&file, batch);
+        threadrings_collect(&__rings);
+
+        if (stop) break;
+
+        __file_rotate(&file);
+
+        // Строки копятся до таймера: запись пачками важнее задержки
+        threadrings_sleep(&__rings, ACCESSLOG_FLUSH_INTERVAL_MS, 0);
+    }
+
+    __file_close(&file);
+    free(batch);
+
+    return NULL;
+}
+
+size_t __drain(accesslog_file_t* file, char* batch) {
+    size_t batch_size = 0;
+    size_t total = 0;
+    unsigned long long dropped = 0;
+
+    for (threadring_t* base = atomic_load(&__rings.rings); base != NULL; base = base->next) {
+        const accesslog_ring_t* ring = (const accesslog_ring_t*)base;
+        unsigned long tail = atomic_load_explicit(&base->tail, memory_order_relaxed);
+        const unsigned long head = atomic_load_explicit(&base->head, memory_order_acquire);
+
+        while (tail != head) {
+            const size_t offset = tail & (ACCESSLOG_RING_SIZE - 1);
+            size_t size = head - tail;
+            if (size > ACCESSLOG_RING_SIZE - offset)
+                size = ACCESSLOG_RING_SIZE - offset;
+            if (size > ACCESSLOG_BATCH_SIZE - batch_size)
+                size = ACCESSLOG_BATCH_SIZE - batch_size;
+
+            memcpy(batch + batch_size, ring->data + offset, size);
+            batch_size += size;
+            tail += size;
+            total += size;
+
+            if (batch_size == ACCESSLOG_BATCH_SIZE) {
+                __flush(file, batch, batch_size);
+                batch_size = 0;
+            }
+        }
+
+        atomic_store_explicit(&base->tail, tail, memory_order_release);
+
+        dropped += threadring_dropped(base);
+    }
+
+    if (batch_size > 0)
+        __flush(file, batch, batch_size);
+
+    if (dropped > 0) {
+        atomic_fetch_add(&__dropped, dropped);
+        log_warning("accesslog: %llu records dropped, buffer is full\n", dropped);
+    }
+
+    return total;
+}
+
+void __flush(accesslog_file_t* file, char* batch, size_t size) {
+    if (file->fd == -1) return;
+
+    while (size > 0) {
+        const ssize_t writed = write(file->fd, batch, size);
+        if (writed < 0) {
+            if (errno == EINTR) continue;
+
+            log_error("accesslog: write error: %s\n", strerror(errno));
+            return;
+        }
+
+        batch += writed;
+        size -= (size_t)writed;
+        file->size += (size_t)writed;
+    }
+}
+
+int __file_open(accesslog_file_t* file) {
+    pthread_mutex_lock(&__mutex);
+    const int fd = __path != NULL ? open(__path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644) : -1;
+    if (fd == -1 && __path != NULL)
+        log_error("accesslog: can't open %s: %s\n", __path, strerror(errno));
+    pthread_mutex_unlock(&__mutex);
+
+    // Пока новый файл не открыт, строки пишутся в старый
+    if (fd == -1) return 0;
+
+    __file_close(file);
+
+    struct stat st;
+    file->fd = fd;
+    file->size = fstat(fd, &st) == 0 ? (size_t)st.st_size : 0;
+    file->opened_at = time(NULL);
+
+    return 1;
+}
+
+void __file_rotate(accesslog_file_t* file) {
+    if (file->fd == -1 || file->size == 0) return;
+
+    pthread_mutex_lock(&__mutex);
+
+    const time_t now = time(NULL);
+    const int by_size = __rotate_size > 0 && file->size >= __rotate_size;
+    const int by_time = __rotate_interval > 0 && now - file->opened_at >= (time_t)__rotate_interval;
+    if ((!by_size && !by_time) || __path == NULL) {
+        pthread_mutex_unlock(&__mutex);
+        return;
+    }
+
+    struct tm tm;
+    localtime_r(&now, &tm);
+
+    char suffix[32];
+    strftime(suffix, sizeof(suffix), "%Y%m%d-%H%M%S", &tm);
+
+    // За одну секунду файл может ротироваться несколько раз
+    char rotated[PATH_MAX];
+    struct stat st;
+    snprintf(rotated, sizeof(rotated), "%s.%s", __path, suffix);
+    for (int i = 1; stat(rotated, &st) == 0 && i < 1000; i++)
+        snprintf(rotated, sizeof(rotated), "%s.%s-%d", __path, suffix, i);
+
+    const int renamed = rename(__path, rotated) == 0;
+    if (!renamed)
+        log_error("accesslog: can't rotate %s: %s\n", __path, strerror(errno));
+
+    pthread_mutex_unlock(&__mutex);
+
+    if (renamed)
+        __file_open(file);
+    else
+        file->opened_at = now;
+}
+
+void __file_close(accesslog_file_t* file) {
+    if (file->fd != -1)
+        close(file->fd);
+
+    file->fd = -1;
+    file->size = 0;
+}
+
+char* __append_uint(char* out, unsigned long long value) {
+    char digits[20];
+    int count = 0;
+
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+
+    while (count > 0)
+        *out++ = digits[--count];
+
+    return out;
+}
+
+char* __append_str(char* out, const char* value, size_t length) {
+    memcpy(out, value, length);
+
+    return out + length;
+}
+
+char* __append_escaped(char* out, const char* value, size_t length) {
+    static const char hex[] = "0123456789abcdef";
+
+    for (size_t i = 0; i < length; i++) {
+        const unsigned char c = (unsigned char)value[i];
+
+        if (c == '"' || c == '\\') {
+            *out++ = '\\';
+            *out++ = c;
+        }
+        else if (c < 0x20 || c == 0x7f) {
+            *out++ = '\\';
+            *out++ = 'u';
+            *out++ = '0';
+            *out++ = '0';
+            *out++ = hex[c >> 4];
+            *out++ = hex[c & 0xf];
+        }
+        else
+            *out++ = c;
+    }
+
+    return out;
+}
@@ -0,0 +1,74 @@
+#ifndef __ACCESSLOG__
+#define __ACCESSLOG__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+/**
+ * Журнал доступа в формате JSON lines: одна строка на завершённый ответ.
+ *
+ * Поток форматирует строку в собственный кольцевой буфер без блокировок
+ * и системных вызовов. Фоновый поток раз в ACCESSLOG_FLUSH_INTERVAL_MS
+ * (или раньше, когда буфер заполнен наполовину) забирает строки всех
+ * потоков и дописывает их в файл. Если буфер заполнен, строка
+ * отбрасывается и учитывается в accesslog_dropped.
+ *
+ * Файл ротируется по размеру и/или по времени: текущий переименовывается
+ * в <file>.<ГГГГММДД-ЧЧММСС>, запись продолжается в новый. По SIGHUP файл
+ * переоткрывается, если его переместила внешняя ротация.
+ */
+
+#define ACCESSLOG_FLUSH_INTERVAL_MS 100
+#define ACCESSLOG_SPANS_MAX 8
+
+typedef struct accesslog_span {
+    const char* name;
+    uint64_t duration_ns;
+} accesslog_span_t;
+
+typedef struct accesslog_record {
+    const char* method;
+    const char* path;
+    size_t path_length;
+    in_addr_t remote_ip;
+    int status;
+    size_t bytes;                  // Отправлено байт вместе с заголовками
+    uint64_t duration_ns;          // От начала обработки до отправки ответа
+    uint64_t parse_ns;             // Разбор запроса
+    uint64_t queue_ns;             // Ожидание в очереди обработчиков
+    uint64_t handler_ns;           // Код приложения, 0 - ответ без обработчика
+    uint64_t first_byte_ns;        // От начала обработки до первого байта ответа
+    unsigned int spans_count;
+    accesslog_span_t spans[ACCESSLOG_SPANS_MAX]; // Отрезки обработчика (запрос к БД, шаблон)
+} accesslog_record_t;
+
+/**
+ * Запуск записи в file. Повторный вызов меняет файл и параметры ротации,
+ * file == NULL останавливает запись.
+ * @param rotate_size - размер файла для ротации, байт; 0 - без ротации по размеру
+ * @param rotate_interval - интервал ротации, секунд; 0 - без ротации по времени
+ * @return 1 при успехе, 0 если файл не открыть или поток не запустить
+ */
+int accesslog_start(const char* file, size_t rotate_size, unsigned int rotate_interval);
+
+/**
+ * Остановка: накопленные строки дописываются, файл закрывается
+ */
+void accesslog_stop(void);
+
+int accesslog_enabled(void);
+
+void accesslog_write(const accesslog_record_t* record);
+
+/**
+ * Переоткрыть файл. Безопасна в обработчике сигнала
+ */
+void accesslog_reopen(void);
+
+/**
+ * Число строк, отброшенных из-за заполненных буферов
+ */
+unsigned long long accesslog_dropped(void);
+
+#endif
@@ -6,6 +6,8 @@
 #include <stdint.h>
 
 #include "log.h"
+#include "memstat.h"
+#include "probes.h"
 #include "broadcast.h"
 #include "websocketsresponse.h"
 
@@ -106,6 +108,7 @@ broadcast_payload_t* __broadcast_payload_create(const char* payload, size_t size
 
     atomic_store(&shared_payload->ref_count, 1);
     shared_payload->size = size;
+    memstat_add(MEMSTAT_BROADCAST, sizeof * shared_payload + size);
 
     if (size > 0)
         memcpy(shared_payload->data, payload, size);
@@ -122,8 +125,10 @@ broadcast_payload_t* __broadcast_payload_acquire(broadcast_payload_t* payload) {
 void __broadcast_payload_release(broadcast_payload_t* payload) {
     if (payload == NULL) return;
 
-    if (atomic_fetch_sub(&payload->ref_count, 1) == 1)
+    if (atomic_fetch_sub(&payload->ref_count, 1) == 1) {
+        memstat_sub(MEMSTAT_BROADCAST, sizeof * payload + payload->size);
         free(payload);
+    }
 }
 
 broadcast_list_t* __broadcast_create_list(const char* broadcast_name) {
@@ -140,6 +145,7 @@ broadcast_list_t* __broadcast_create_list(const char* broadcast_name) {
     if (!list->name) goto failed;
     strcpy(list->name, broadcast_name);
 
+    memstat_add(MEMSTAT_BROADCAST, sizeof * list + strlen(broadcast_name) + 1);
     result = list;
 
     failed:
@@ -153,8 +159,10 @@ broadcast_list_t* __broadcast_create_list(const char* broadcast_name) {
 void __broadcast_free_list(broadcast_list_t* list) {
     if (!list) return;
 
-    if (list->name)
+    if (list->name) {
+        memstat_sub(MEMSTAT_BROADCAST, sizeof * list + strlen(list->name) + 1);
         free(list->name);
+    }
 
     free(list);
 }
@@ -168,6 +176,8 @@ broadcast_item_t* __broadcast_create_item(connection_t* connection, void* id, vo
     item->response_handler = response_handler;
     item->id = id;
 
+    memstat_add(MEMSTAT_BROADCAST, sizeof * item);
+
     return item;
 }
 
@@ -179,6 +189,7 @@ void __broadcast_free_item(broadcast_item_t* item) {
             item->id->free(item->id);
     }
 
+    memstat_sub(MEMSTAT_BROADCAST, sizeof * item);
     free(item);
 }
 
@@ -261,6 +272,10 @@ void __broadcast_queue_add(connection_t* connection, broadcast_payload_t* payloa
     if (atomic_load(&ctx->destroyed))
         return;
 
+    // Мягкий лимит памяти: сообщение отбрасывается, отказ виден в счётчике memstat
+    if (memstat_should_shed(MEMSTAT_BROADCAST))
+        return;
+
     connection_queue_item_t* item = connection_queue_item_create();
     if (item == NULL) return;
 
@@ -403,6 +418,9 @@ connection_queue_broadcast_data_t* __broadcast_queue_data_create(broadcast_paylo
     data->payload = __broadcast_payload_acquire(payload);
     data->handler = handle;
 
+    // Вместе с данными учитывается и элемент очереди, который ими владеет
+    memstat_add(MEMSTAT_BROADCAST, sizeof * data + sizeof(connection_queue_item_t));
+
     return data;
 }
 
@@ -413,6 +431,7 @@ void __broadcast_queue_data_free(void* arg) {
 
     __broadcast_payload_release(data->payload);
 
+    memstat_sub(MEMSTAT_BROADCAST, sizeof * data + sizeof(connection_queue_item_t));
     free(data);
 }
 
@@ -601,6 +620,8 @@ void broadcast_send(const char* broadcast_name, connection_t* connection, const
 
     if (list == NULL) goto done;
 
+    CWFR_PROBE(broadcast_send, broadcast_name, size);
+
     broadcast_payload_t* shared_payload = __broadcast_payload_create(payload, size);
     if (shared_payload == NULL) {
         __broadcast_unlock_list(list);
@@ -54,6 +54,9 @@ appconfig_t* appconfig_create(const char* path) {
 
     atomic_store(&config->shutdown, 0);
     atomic_store(&config->threads_count, 0);
+    atomic_store(&config->handler_pool.threads, 0);
+    atomic_store(&config->handler_pool.idle, 0);
+    atomic_store(&config->handler_pool.last_grow, 0);
     __appconfig_env_init(&config->env);
     config->mimetype = NULL;
     config->databases = NULL;
@@ -64,6 +67,7 @@ appconfig_t* appconfig_create(const char* path) {
     config->taskmanager = NULL;
     config->translations = NULL;
     config->sessionconfigs = NULL;
+    config->ratelimits = NULL;
     config->path = strdup(path);
     if (config->path == NULL) {
         printf("Error: Memory allocation failed for config path\n");
@@ -116,6 +120,11 @@ void appconfig_clear(appconfig_t* config) {
         config->sessionconfigs = NULL;
     }
 
+    if (config->ratelimits != NULL) {
+        map_free(config->ratelimits);
+        config->ratelimits = NULL;
+    }
+
     routeloader_free(config->taskmanager_loader);
     config->taskmanager_loader = NULL;
 
@@ -158,11 +167,26 @@ void __appconfig_env_init(env_t* env) {
     env->main.reload = APPCONFIG_RELOAD_SOFT;
     env->main.client_max_body_size = 0;
     env->main.gzip = NULL;
+    env->main.gzip_min_length = ENV_GZIP_MIN_LENGTH_DEFAULT;
     env->main.threads = 0;
+    env->main.threads_max = 0;
+    env->main.threads_queue_depth = ENV_THREADS_QUEUE_DEPTH_DEFAULT;
+    env->main.threads_queue_wait = ENV_THREADS_QUEUE_WAIT_DEFAULT;
+    env->main.threads_idle_timeout = ENV_THREADS_IDLE_TIMEOUT_DEFAULT;
+    for (int i = 0; i < ROUTE_PRIORITY_COUNT; i++)
+        env->main.priority_weights[i] = 0;
+    env->main.queue_wait_budget = 0;
+    env->main.handoff_socket = NULL;
     env->main.workers = 0;
     env->main.tmp = NULL;
     env->main.log.enabled = false;
     env->main.log.level = 0;
+    env->main.log.file = NULL;
+    env->main.access_log.file = NULL;
+    env->main.access_log.rotate_size = 0;
+    env->main.access_log.rotate_interval = 0;
+    for (int i = 0; i <= MEMSTAT_TOTAL; i++)
+        env->main.memory_limits[i] = 0;
     env->mail.dkim_private = NULL;
     env->mail.dkim_selector = NULL;
     env->mail.host = NULL;
@@ -174,6 +198,7 @@ void __appconfig_env_free(env_t* env) {
 
     env->main.client_max_body_size = 0;
     env->main.threads = 0;
+    env->main.threads_max = 0;
     env->main.workers = 0;
 
     if (env->main.gzip != NULL) {
@@ -186,9 +211,29 @@ void __appconfig_env_free(env_t* env) {
         env->main.tmp = NULL;
     }
 
+    if (env->main.handoff_socket != NULL) {
+        free(env->main.handoff_socket);
+        env->main.handoff_socket = NULL;
+    }
+
     env->main.log.enabled = false;
     env->main.log.level = 0;
 
+    if (env->main.log.file != NULL) {
+        free(env->main.log.file);
+        env->main.log.file = NULL;
+    }
+
+    if (env->main.access_log.file != NULL) {
+        free(env->main.access_log.file);
+        env->main.access_log.file = NULL;
+    }
+    env->main.access_log.rotate_size = 0;
+    env->main.access_log.rotate_interval = 0;
+
+    for (int i = 0; i <= MEMSTAT_TOTAL; i++)
+        env->main.memory_limits[i] = 0;
+
     if (env->mail.dkim_private != NULL) {
         free(env->mail.dkim_private);
         env->mail.dkim_private = NULL;
@@ -6,6 +6,7 @@
 #include "array.h"
 #include "map.h"
 #include "json.h"
+#include "memstat.h"
 #include "server.h"
 #include "storage.h"
 #include "database.h"
@@ -16,8 +17,25 @@
 
 typedef struct taskmanager taskmanager_t;
 
+// Уровни сжатия по умолчанию для строковых элементов main.gzip
+#define ENV_GZIP_LEVEL_DEFAULT 1
+#define ENV_BROTLI_LEVEL_DEFAULT 4
+#define ENV_ZSTD_LEVEL_DEFAULT 3
+
+// Ответы меньше этого размера не сжимаются
+#define ENV_GZIP_MIN_LENGTH_DEFAULT 1024
+
+// Эластичный пул обработчиков: рост при очереди глубже threads_queue_depth
+// или старше threads_queue_wait мс, сжатие после threads_idle_timeout с простоя
+#define ENV_THREADS_QUEUE_DEPTH_DEFAULT 64
+#define ENV_THREADS_QUEUE_WAIT_DEFAULT 50
+#define ENV_THREADS_IDLE_TIMEOUT_DEFAULT 60
+
 typedef struct env_gzip_str {
     char* mimetype;
+    int gzip_level;                // 1..9
+    int brotli_level;              // 0..11
+    int zstd_level;                // 1..19
     struct env_gzip_str* next;
 } env_gzip_str_t;
 
@@ -29,18 +47,35 @@ typedef enum {
 typedef struct env_log {
     bool enabled;
     int level;
+    char* file; // NULL - syslog
 } env_log_t;
 
+typedef struct env_access_log {
+    char* file;                    // NULL - журнал доступа выключен
+    size_t rotate_size;            // Байт, 0 - без ротации по размеру
+    unsigned int rotate_interval;  // Секунд, 0 - без ротации по времени
+} env_access_log_t;
+
 typedef struct i18n i18n_t;
 
 typedef struct env_main {
     appconfig_reload_state_e reload;
     unsigned int workers;
     unsigned int threads;
+    unsigned int threads_max;
+    unsigned int threads_queue_depth;
+    unsigned int threads_queue_wait;
+    unsigned int threads_idle_timeout;
+    unsigned int priority_weights[ROUTE_PRIORITY_COUNT];
+    unsigned int queue_wait_budget;
+    char* handoff_socket;
     unsigned int client_max_body_size;
     char* tmp;
     env_gzip_str_t* gzip;
+    unsigned int gzip_min_length;
     env_log_t log;
+    env_access_log_t access_log;
+    size_t memory_limits[MEMSTAT_COUNT + 1]; // Байт по подсистемам memstat, последний - общий; 0 - без лимита
 } env_main_t;
 
 typedef struct env_mail {
@@ -55,11 +90,19 @@ typedef struct {
     json_doc_t* custom_store;
 } env_t;
 
+typedef struct handler_pool {
+    atomic_int threads;            // Запущенные потоки-обработчики
+    atomic_int idle;               // Из них ожидающие задания
+    atomic_ullong last_grow;       // Время последнего роста, нс
+} handler_pool_t;
+
 typedef struct appconfig {
     atomic_bool shutdown;
     atomic_int threads_count;
+    handler_pool_t handler_pool;
     env_t env;
     map_t* sessionconfigs;
+    map_t* ratelimits;    // map: name -> ratelimit_t*
     char* path;
     mimetype_t* mimetype;
     array_t* databases;
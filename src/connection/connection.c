@@ -2,6 +2,7 @@
 
 #include "connection.h"
 #include "openssl.h"
+#include "metrics.h"
 
 void connection_reset(connection_t* connection) {
     if (connection == NULL) return;
@@ -28,13 +29,23 @@ void connection_free(connection_t* connection) {
 }
 
 ssize_t connection_data_read(connection_t* connection) {
-    return connection->ssl ?
+    const ssize_t readed = connection->ssl ?
         openssl_read(connection->ssl, connection->buffer, connection->buffer_size) :
         recv(connection->fd, connection->buffer, connection->buffer_size, 0);
+
+    if (readed > 0)
+        metrics_record_bytes_in((size_t)readed);
+
+    return readed;
 }
 
 ssize_t connection_data_write(connection_t* connection, const char* data, size_t size) {
-    return connection->ssl ?
+    const ssize_t writed = connection->ssl ?
         openssl_write(connection->ssl, data, size) :
         send(connection->fd, data, size, MSG_NOSIGNAL);
+
+    if (writed > 0)
+        metrics_record_bytes_out((size_t)writed);
+
+    return writed;
 }
@@ -2,48 +2,139 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <time.h>
 
 #include "log.h"
 #include "connection_queue.h"
 #include "cqueue.h"
-
-static cqueue_t* queue = NULL;
+#include "metrics.h"
+
+/*
+ * Общая очередь разбита на классы приоритета маршрутов. Классы обслуживаются
+ * по deficit round robin: заходя в класс, диспетчер начисляет ему квант,
+ * равный весу, и выдаёт из него по соединению, пока квант не исчерпан.
+ * Стоимость одного задания - единица, поэтому при нагрузке во всех классах
+ * доли выдачи пропорциональны весам, а пустой класс теряет остаток кванта.
+ * Внутри класса соединения идут по кругу: соединение снимается ради одного
+ * задания и возвращается в хвост, если у него остались задания.
+ */
+typedef struct {
+    cqueue_t* classes[ROUTE_PRIORITY_COUNT];
+    int weight[ROUTE_PRIORITY_COUNT];
+    int deficit[ROUTE_PRIORITY_COUNT];
+    int current;
+    pthread_mutex_t mutex;
+} connection_queue_t;
+
+static connection_queue_t queue = {
+    .classes = { NULL },
+    .weight = { CONNECTION_QUEUE_WEIGHT_HIGH, CONNECTION_QUEUE_WEIGHT_NORMAL, CONNECTION_QUEUE_WEIGHT_LOW },
+    .deficit = { 0 },
+    .current = 0,
+    .mutex = PTHREAD_MUTEX_INITIALIZER
+};
 
 static pthread_cond_t connection_queue_cond = PTHREAD_COND_INITIALIZER;
 static pthread_mutex_t connection_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static void(*_Atomic __append_cb)(void) = NULL;
 
 void __connection_queue_append(connection_queue_item_t*);
-int __connection_queue_empty(cqueue_t*);
+int __connection_queue_empty(void);
 connection_t* __connection_queue_pop();
 void __connection_queue_item_free(connection_queue_item_t*);
-int __connection_queue_append_item(cqueue_t* queue, void* data);
+int __connection_queue_append_item(connection_t* connection, int priority);
+int __connection_queue_priority(connection_t* connection);
+int __connection_queue_next_class(void);
+uint64_t __connection_queue_time_ns(void);
+void __connection_queue_notify(void);
 
 
 void __connection_queue_append(connection_queue_item_t* qitem) {
     connection_s_inc(qitem->connection);
 
-    if (!__connection_queue_append_item(queue, qitem->connection))
+    if (!__connection_queue_append_item(qitem->connection, qitem->priority))
         connection_s_dec(qitem->connection);
 }
 
 
-int __connection_queue_append_item(cqueue_t* queue, void* data) {
-    cqueue_lock(queue);
-    const int r = cqueue_append(queue, data);
-    cqueue_unlock(queue);
+int __connection_queue_append_item(connection_t* connection, int priority) {
+    if (priority < 0 || priority >= ROUTE_PRIORITY_COUNT)
+        priority = ROUTE_PRIORITY_NORMAL;
+
+    const uint64_t now = __connection_queue_time_ns();
+
+    pthread_mutex_lock(&queue.mutex);
+    ((connection_server_ctx_t*)connection->ctx)->queued_at = now;
+    const int r = cqueue_append(queue.classes[priority], connection);
+    pthread_mutex_unlock(&queue.mutex);
 
     return r;
 }
 
+// Класс соединения определяется следующим заданием в его очереди;
+// рассылки и пустая очередь идут с обычным приоритетом
+int __connection_queue_priority(connection_t* connection) {
+    connection_server_ctx_t* ctx = connection->ctx;
+    int priority = ROUTE_PRIORITY_NORMAL;
+
+    cqueue_lock(ctx->queue);
+    cqueue_item_t* item = cqueue_first(ctx->queue);
+    if (item != NULL)
+        priority = ((connection_queue_item_t*)item->data)->priority;
+    cqueue_unlock(ctx->queue);
+
+    return priority;
+}
+
+// Вызывается под queue.mutex, возвращает -1 для пустой очереди
+int __connection_queue_next_class(void) {
+    for (int i = 0; i < ROUTE_PRIORITY_COUNT * 2; i++) {
+        const int current = queue.current;
+
+        if (cqueue_empty(queue.classes[current])) {
+            queue.deficit[current] = 0;
+            queue.current = (current + 1) % ROUTE_PRIORITY_COUNT;
+            continue;
+        }
+
+        if (queue.deficit[current] == 0)
+            queue.deficit[current] = queue.weight[current];
+
+        queue.deficit[current]--;
+        if (queue.deficit[current] == 0)
+            queue.current = (current + 1) % ROUTE_PRIORITY_COUNT;
+
+        return current;
+    }
+
+    return -1;
+}
+
 connection_t* __connection_queue_pop() {
-    cqueue_lock(queue);
-    connection_t* connection = cqueue_pop(queue);
-    cqueue_unlock(queue);
+    connection_t* connection = NULL;
+
+    int depth = 0;
+    uint64_t queued_at = 0;
+
+    pthread_mutex_lock(&queue.mutex);
+    const int class = __connection_queue_next_class();
+    if (class >= 0) {
+        for (int i = 0; i < ROUTE_PRIORITY_COUNT; i++)
+            depth += cqueue_size(queue.classes[i]);
+
+        connection = cqueue_pop(queue.classes[class]);
+        if (connection != NULL)
+            queued_at = ((connection_server_ctx_t*)connection->ctx)->queued_at;
+    }
+    pthread_mutex_unlock(&queue.mutex);
 
     // queue is empty
     if (connection == NULL)
         return NULL;
 
+    const uint64_t now = __connection_queue_time_ns();
+    metrics_record_queue_pop(depth, now > queued_at ? now - queued_at : 0);
+
     connection_s_lock(connection);
 
     connection_server_ctx_t* ctx = connection->ctx;
@@ -58,50 +149,95 @@ connection_t* __connection_queue_pop() {
     return connection;
 }
 
-int __connection_queue_empty(cqueue_t* queue) {
-    if (queue == NULL) return 1;
+int __connection_queue_empty(void) {
+    if (queue.classes[0] == NULL) return 1;
 
-    cqueue_lock(queue);
-    const int empty = cqueue_empty(queue);
-    cqueue_unlock(queue);
+    int empty = 1;
+
+    pthread_mutex_lock(&queue.mutex);
+    for (int i = 0; i < ROUTE_PRIORITY_COUNT && empty; i++)
+        empty = cqueue_empty(queue.classes[i]);
+    pthread_mutex_unlock(&queue.mutex);
 
     return empty;
 }
 
+uint64_t __connection_queue_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void __connection_queue_notify(void) {
+    void(*cb)(void) = atomic_load(&__append_cb);
+    if (cb != NULL)
+        cb();
+}
+
 void __connection_queue_item_free(connection_queue_item_t* item) {
     if (item == NULL) return;
 
     if (item->data != NULL)
         item->data->free(item->data);
 
+    server_routing_release(item->routing_token);
+
     free(item);
 }
 
 int connection_queue_init() {
-    if (queue != NULL) return 1;
+    if (queue.classes[0] != NULL) return 1;
 
-    queue = cqueue_create();
-    if (queue == NULL) return 0;
+    cqueue_t* classes[ROUTE_PRIORITY_COUNT];
+    for (int i = 0; i < ROUTE_PRIORITY_COUNT; i++) {
+        classes[i] = cqueue_create();
+        if (classes[i] == NULL) {
+            for (int j = 0; j < i; j++)
+                cqueue_free(classes[j]);
+
+            return 0;
+        }
+    }
+
+    // classes[0] публикуется последним: по нему проверяется инициализация
+    for (int i = ROUTE_PRIORITY_COUNT - 1; i >= 0; i--)
+        queue.classes[i] = classes[i];
 
     return 1;
 }
 
+void connection_queue_set_weights(const unsigned int* weights) {
+    pthread_mutex_lock(&queue.mutex);
+    for (int i = 0; i < ROUTE_PRIORITY_COUNT; i++) {
+        queue.weight[i] = weights[i] > 0 ? (int)weights[i] : 1;
+        queue.deficit[i] = 0;
+    }
+    queue.current = 0;
+    pthread_mutex_unlock(&queue.mutex);
+}
+
 void connection_queue_guard_append_item(connection_queue_item_t* item) {
     pthread_mutex_lock(&connection_queue_mutex);
     __connection_queue_append(item);
     pthread_cond_signal(&connection_queue_cond);
     pthread_mutex_unlock(&connection_queue_mutex);
+
+    __connection_queue_notify();
 }
 
 void connection_queue_guard_append(connection_t* connection) {
     pthread_mutex_lock(&connection_queue_mutex);
 
+    const int priority = __connection_queue_priority(connection);
+
     connection_s_inc(connection);
-    if (!__connection_queue_append_item(queue, connection))
+    if (!__connection_queue_append_item(connection, priority))
         connection_s_dec(connection);
 
     pthread_cond_signal(&connection_queue_cond);
     pthread_mutex_unlock(&connection_queue_mutex);
+
+    __connection_queue_notify();
 }
 
 connection_t* connection_queue_guard_pop() {
@@ -116,7 +252,7 @@ connection_t* connection_queue_guard_pop() {
     // проверка вне мьютекса позволяла пропустить сигнал, отправленный между
     // проверкой и ожиданием, и задержать обработку на величину таймаута
     pthread_mutex_lock(&connection_queue_mutex);
-    if (__connection_queue_empty(queue))
+    if (__connection_queue_empty())
         pthread_cond_timedwait(&connection_queue_cond, &connection_queue_mutex, &timeToWait);
     pthread_mutex_unlock(&connection_queue_mutex);
 
@@ -138,6 +274,56 @@ connection_queue_item_t* connection_queue_item_create() {
     item->handle = NULL;
     item->connection = NULL;
     item->data = NULL;
+    item->priority = ROUTE_PRIORITY_NORMAL;
+    item->enqueued_at = __connection_queue_time_ns();
+    item->routing_token = server_routing_hold();
 
     return item;
 }
+
+uint64_t connection_queue_item_wait(connection_queue_item_t* item) {
+    const uint64_t now = __connection_queue_time_ns();
+
+    return now > item->enqueued_at ? now - item->enqueued_at : 0;
+}
+
+int connection_queue_depth(void) {
+    if (queue.classes[0] == NULL) return 0;
+
+    int depth = 0;
+
+    pthread_mutex_lock(&queue.mutex);
+    for (int i = 0; i < ROUTE_PRIORITY_COUNT; i++)
+        depth += cqueue_size(queue.classes[i]);
+    pthread_mutex_unlock(&queue.mutex);
+
+    return depth;
+}
+
+uint64_t connection_queue_wait(void) {
+    if (queue.classes[0] == NULL) return 0;
+
+    uint64_t queued_at = 0;
+
+    pthread_mutex_lock(&queue.mutex);
+    for (int i = 0; i < ROUTE_PRIORITY_COUNT; i++) {
+        cqueue_item_t* item = cqueue_first(queue.classes[i]);
+        if (item == NULL) continue;
+
+        connection_t* connection = item->data;
+        const uint64_t class_queued_at = ((connection_server_ctx_t*)connection->ctx)->queued_at;
+        if (queued_at == 0 || class_queued_at < queued_at)
+            queued_at = class_queued_at;
+    }
+    pthread_mutex_unlock(&queue.mutex);
+
+    if (queued_at == 0) return 0;
+
+    const uint64_t now = __connection_queue_time_ns();
+
+    return now > queued_at ? now - queued_at : 0;
+}
+
+void connection_queue_set_append_cb(void(*cb)(void)) {
+    atomic_store(&__append_cb, cb);
+}
@@ -3,11 +3,28 @@
 
 #include "connection_s.h"
 
+// Веса классов приоритета по умолчанию (доля выдачи при нагрузке во всех классах)
+#define CONNECTION_QUEUE_WEIGHT_HIGH 8
+#define CONNECTION_QUEUE_WEIGHT_NORMAL 4
+#define CONNECTION_QUEUE_WEIGHT_LOW 1
+
 int connection_queue_init();
 void connection_queue_guard_append_item(connection_queue_item_t*);
 void connection_queue_guard_append(connection_t*);
 connection_t* connection_queue_guard_pop();
 void connection_queue_broadcast();
 connection_queue_item_t* connection_queue_item_create();
+void connection_queue_set_weights(const unsigned int* weights);
+// Время с создания задания, нс
+uint64_t connection_queue_item_wait(connection_queue_item_t* item);
+
+/**
+ * Глубина общей очереди и возраст её старейшего элемента в наносекундах
+ * (0 для пустой очереди). Колбэк вызывается после каждой постановки в очередь
+ * вне мьютекса очереди; пул обработчиков решает по нему, нужен ли новый поток.
+ */
+int connection_queue_depth(void);
+uint64_t connection_queue_wait(void);
+void connection_queue_set_append_cb(void(*cb)(void));
 
 #endif
@@ -1,11 +1,15 @@
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
 
 #include "log.h"
 #include "openssl.h"
 #include "connection_s.h"
 #include "connection_queue.h"
+#include "memstat.h"
+#include "metrics.h"
 #include "multiplexing.h"
+#include "probes.h"
 
 void broadcast_clear(connection_t*);
 void httpparser_free(void*);
@@ -24,6 +28,10 @@ connection_t* connection_s_create(int fd, in_addr_t ip, unsigned short int port,
     if (connfd == -1)
         return NULL;
 
+    // Мягкий лимит памяти: соединение принимается и сразу закрывается,
+    // иначе оно ждало бы в очереди accept до освобождения памяти
+    if (memstat_should_shed(MEMSTAT_CONNECTIONS)) goto failed;
+
     // int size = 16384;
     // if (setsockopt(connfd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) == -1) goto failed;
 
@@ -50,6 +58,7 @@ connection_t* connection_s_create(int fd, in_addr_t ip, unsigned short int port,
     if (connection == NULL) goto failed;
 
     connection->close = connection_close;
+    CWFR_PROBE(conn_accept, connfd, remote_ip, remote_port);
 
     result = connection;
 
@@ -87,6 +96,8 @@ connection_t* connection_s_alloc(listener_t* listener, int fd, in_addr_t ip, uns
     connection->read = NULL;
     connection->write = NULL;
 
+    memstat_add(MEMSTAT_CONNECTIONS, sizeof(connection_t) + sizeof(connection_server_ctx_t));
+
     return connection;
 }
 
@@ -159,6 +170,20 @@ connection_dec_result_e connection_s_dec(connection_t* connection) {
 int connection_after_write(connection_t* connection) {
     connection_server_ctx_t* ctx = connection->ctx;
 
+    if (ctx->metrics.started_at != 0) {
+        const uint64_t now = metrics_now_ns();
+        const uint64_t latency = now > ctx->metrics.started_at ? now - ctx->metrics.started_at : 0;
+        metrics_record_request(ctx->metrics.route, ctx->metrics.status, latency);
+        ctx->metrics.started_at = 0;
+
+        if (accesslog_enabled()) {
+            ctx->access.remote_ip = connection->remote_ip;
+            ctx->access.status = ctx->metrics.status;
+            ctx->access.duration_ns = latency;
+            accesslog_write(&ctx->access);
+        }
+    }
+
     if (connection->keepalive == 0) {
         atomic_store(&ctx->destroyed, 1);
         return ctx->listener->api->control_mod(connection, MPXOUT | MPXIN | MPXHUP);
@@ -176,6 +201,14 @@ int connection_after_write(connection_t* connection) {
         ctx->switch_to_protocol.data_free = NULL;
     }
 
+    return connection_resume(connection);
+}
+
+// Возвращает соединение воркеру после работы в потоке-обработчике:
+// ставит в очередь снова, если есть ожидающие задания, иначе ждёт чтения
+int connection_resume(connection_t* connection) {
+    connection_server_ctx_t* ctx = connection->ctx;
+
     cqueue_lock(ctx->broadcast_queue);
     const int broadcast_empty = cqueue_empty(ctx->broadcast_queue);
     cqueue_unlock(ctx->broadcast_queue);
@@ -254,6 +287,8 @@ int connection_close(connection_t* connection) {
         SSL_clear(connection->ssl);
     }
 
+    CWFR_PROBE(conn_close, connection->fd);
+
     shutdown(connection->fd, SHUT_RDWR);
     close(connection->fd);
 
@@ -287,6 +322,12 @@ connection_server_ctx_t* __ctx_create(listener_t* listener) {
     ctx->switch_to_protocol.fn = NULL;
     ctx->switch_to_protocol.data = NULL;
     ctx->switch_to_protocol.data_free = NULL;
+    ctx->queued_at = 0;
+    ctx->handshake_started_at = 0;
+    ctx->metrics.started_at = 0;
+    ctx->metrics.route = METRICS_ROUTE_NONE;
+    ctx->metrics.status = 0;
+    memset(&ctx->access, 0, sizeof(ctx->access));
 
     if (listener != NULL) {
         cqueue_item_t* item = cqueue_first(&listener->servers);
@@ -350,5 +391,8 @@ void __ctx_free(void* arg) {
         ctx->response = NULL;
     }
 
+    // Вместе с контекстом освобождается и соединение (connection_free)
+    memstat_sub(MEMSTAT_CONNECTIONS, sizeof(connection_t) + sizeof(connection_server_ctx_t));
+
     free(ctx);
 }
\ No newline at end of file
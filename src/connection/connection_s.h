@@ -2,6 +2,7 @@
 #define __CONNECTION_S__
 
 #include <stdatomic.h>
+#include <stdint.h>
 
 #include "connection.h"
 #include "multiplexingserver.h"
@@ -9,6 +10,7 @@
 #include "request.h"
 #include "response.h"
 #include "cqueue.h"
+#include "accesslog.h"
 
 struct mpxapi;
 
@@ -47,6 +49,19 @@ typedef struct {
 
     switch_to_protocol_t switch_to_protocol;
 
+    uint64_t queued_at;            // Постановка в общую очередь, нс
+    uint64_t handshake_started_at; // Начало TLS-рукопожатия, нс
+
+    // Ответ, который сейчас отправляется; учитывается в connection_after_write
+    struct {
+        uint64_t started_at;       // нс, 0 - не учитывать
+        unsigned int route;
+        int status;
+    } metrics;
+
+    // Строка журнала доступа того же ответа; заполняется, только если журнал включён
+    accesslog_record_t access;
+
     atomic_int ref_count;
     atomic_int broadcast_ref_count;
     atomic_bool destroyed;
@@ -64,6 +79,9 @@ typedef struct connection_queue_item {
     void(*handle)(void*);
     connection_t* connection;
     connection_queue_item_data_t* data;
+    int priority;                  // Класс в общей очереди, route_priority_e
+    uint64_t enqueued_at;          // Создание задания, нс (CLOCK_MONOTONIC)
+    unsigned long routing_token;   // Удерживает снимок маршрутизации до освобождения
 } connection_queue_item_t;
 
 connection_t* connection_s_create(int fd, in_addr_t ip, unsigned short int port, connection_server_ctx_t* ctx, char* buffer, size_t buffer_size);
@@ -77,6 +95,7 @@ void connection_s_inc(connection_t*);
 connection_dec_result_e connection_s_dec(connection_t*);
 
 int connection_after_write(connection_t*);
+int connection_resume(connection_t*);
 int connection_queue_append(connection_queue_item_t*);
 int connection_queue_append_broadcast(connection_t*);
 int connection_after_read(connection_t*);
@@ -0,0 +1,552 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <linux/limits.h>
+
+#include "helpers.h"
+#include "gzip.h"
+#include "filecache.h"
+
+#define FILECACHE_OPEN_FLAGS (O_RDONLY | O_NONBLOCK | O_CLOEXEC)
+#define FILECACHE_EVICT_BATCH 64
+#define FILECACHE_EXPIRED_SCAN_NS 1000000000ULL
+#define FILECACHE_CONTENT_USES 2
+
+static uint64_t __filecache_time_ns(void);
+static filecache_entry_t* __filecache_entry_create(const char* path, const char* index, mimetype_t* mimetype, uint64_t valid_until_ns);
+static int __filecache_entry_resolve(filecache_entry_t* entry, const char* index, struct stat* stat_obj);
+static int __filecache_entry_set_index_path(filecache_entry_t* entry, const char* index);
+static void __filecache_entry_set_meta(filecache_entry_t* entry, int fd, const struct stat* stat_obj, mimetype_t* mimetype);
+static void __filecache_entry_free(filecache_entry_t* entry);
+static void __filecache_value_free(void* arg);
+static void __filecache_evict_expired(filecache_t* cache, uint64_t now);
+static void __filecache_remove(filecache_t* cache, filecache_entry_t* entry);
+static void __filecache_table_unlink(filecache_t* cache, filecache_entry_t* entry);
+static void __filecache_table_push(filecache_t* cache, filecache_entry_t* entry);
+static void __filecache_lru_unlink(filecache_t* cache, filecache_entry_t* entry);
+static void __filecache_lru_push(filecache_t* cache, filecache_entry_t* entry);
+static void __filecache_content_detach(filecache_t* cache, filecache_entry_t* entry);
+static void __filecache_content_reserve(filecache_t* cache, size_t memory);
+static void __filecache_content_inherit(filecache_t* cache, filecache_entry_t* entry, filecache_entry_t* current);
+static filecache_content_t* __filecache_content_load(filecache_entry_t* entry, int compress);
+static int __filecache_content_compress(filecache_content_t* content);
+
+filecache_t* filecache_create(filecache_config_t* config) {
+    if (config == NULL) return NULL;
+
+    filecache_t* cache = malloc(sizeof * cache);
+    if (cache == NULL) return NULL;
+
+    cache->config = *config;
+    cache->lru_head = NULL;
+    cache->lru_tail = NULL;
+    cache->table_head = NULL;
+    cache->table_tail = NULL;
+    cache->expired_scan_ns = 0;
+    cache->content_total = 0;
+    cache->entries = hashmap_create_ex(hashmap_hash_string, hashmap_equals_string,
+                                       16, 0.75f, NULL, NULL, NULL, __filecache_value_free);
+    if (cache->entries == NULL) {
+        free(cache);
+        return NULL;
+    }
+
+    pthread_mutex_init(&cache->mutex, NULL);
+
+    return cache;
+}
+
+void filecache_free(filecache_t* cache) {
+    if (cache == NULL) return;
+
+    hashmap_foreach(cache->entries, it) {
+        filecache_entry_t* entry = hashmap_iterator_value(it);
+        __filecache_content_detach(cache, entry);
+        entry->in_table = 0;
+    }
+
+    hashmap_free(cache->entries);
+    pthread_mutex_destroy(&cache->mutex);
+    free(cache);
+}
+
+filecache_entry_t* filecache_get(filecache_t* cache, const char* path, const char* index, mimetype_t* mimetype) {
+    if (path == NULL) return NULL;
+
+    if (cache == NULL)
+        return __filecache_entry_create(path, index, mimetype, 0);
+
+    const uint64_t now = __filecache_time_ns();
+
+    pthread_mutex_lock(&cache->mutex);
+    filecache_entry_t* entry = hashmap_find(cache->entries, path);
+    if (entry != NULL && entry->valid_until_ns > now) {
+        __filecache_table_unlink(cache, entry);
+        __filecache_table_push(cache, entry);
+        atomic_fetch_add(&entry->ref_count, 1);
+        pthread_mutex_unlock(&cache->mutex);
+        return entry;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+
+    /* open/fstat выполняются без блокировки: медленный диск
+     * не должен останавливать попадания в кэш других потоков. */
+    entry = __filecache_entry_create(path, index, mimetype, now + (uint64_t)cache->config.valid_s * 1000000000ULL);
+    if (entry == NULL) return NULL;
+
+    pthread_mutex_lock(&cache->mutex);
+
+    filecache_entry_t* current = hashmap_find(cache->entries, path);
+    if (current != NULL && current->valid_until_ns > now) {
+        // Другой поток успел обновить запись, пока файл открывался
+        atomic_fetch_add(&current->ref_count, 1);
+        pthread_mutex_unlock(&cache->mutex);
+        filecache_release(entry);
+        return current;
+    }
+
+    if (current != NULL) {
+        __filecache_content_inherit(cache, entry, current);
+        __filecache_remove(cache, current);
+    }
+    else if (hashmap_size(cache->entries) >= cache->config.max_entries) {
+        // Обход всей таблицы не повторяется на каждом промахе
+        if (now >= cache->expired_scan_ns) {
+            cache->expired_scan_ns = now + FILECACHE_EXPIRED_SCAN_NS;
+            __filecache_evict_expired(cache, now);
+        }
+
+        // Таблица заполнена живыми записями: место уступает давно не запрошенная
+        while (hashmap_size(cache->entries) >= cache->config.max_entries && cache->table_tail != NULL)
+            __filecache_remove(cache, cache->table_tail);
+    }
+
+    /* Если запись не удалось сохранить, она отдаётся без сохранения
+     * и закроется вместе с ответом. */
+    if (hashmap_size(cache->entries) < cache->config.max_entries) {
+        atomic_fetch_add(&entry->ref_count, 1);
+        if (hashmap_insert(cache->entries, entry->key, entry) == 1) {
+            entry->in_table = 1;
+            __filecache_table_push(cache, entry);
+        }
+        else
+            atomic_fetch_sub(&entry->ref_count, 1);
+    }
+
+    // Унаследованное содержимое остаётся только у записи из таблицы
+    if (!entry->in_table)
+        __filecache_content_detach(cache, entry);
+
+    pthread_mutex_unlock(&cache->mutex);
+
+    return entry;
+}
+
+void filecache_release(filecache_entry_t* entry) {
+    if (entry == NULL) return;
+
+    if (atomic_fetch_sub(&entry->ref_count, 1) == 1)
+        __filecache_entry_free(entry);
+}
+
+filecache_content_t* filecache_content_get(filecache_t* cache, filecache_entry_t* entry, int compress) {
+    if (cache == NULL || entry == NULL) return NULL;
+    if (entry->status != FILECACHE_OK || entry->fd == -1) return NULL;
+    if (entry->size == 0 || entry->size > cache->config.content_max_size) return NULL;
+    if (entry->size > cache->config.content_memory) return NULL;
+
+    pthread_mutex_lock(&cache->mutex);
+
+    filecache_content_t* content = entry->content;
+    if (content != NULL) {
+        __filecache_lru_unlink(cache, entry);
+        __filecache_lru_push(cache, entry);
+        atomic_fetch_add(&content->ref_count, 1);
+        pthread_mutex_unlock(&cache->mutex);
+        return content;
+    }
+
+    /* Однократно запрошенные файлы не занимают память:
+     * содержимое читается начиная со второго обращения. */
+    if (!entry->in_table || entry->content_loading || ++entry->uses < FILECACHE_CONTENT_USES) {
+        pthread_mutex_unlock(&cache->mutex);
+        return NULL;
+    }
+
+    entry->content_loading = 1;
+    pthread_mutex_unlock(&cache->mutex);
+
+    content = __filecache_content_load(entry, compress);
+
+    pthread_mutex_lock(&cache->mutex);
+    entry->content_loading = 0;
+
+    if (content == NULL || !entry->in_table || content->memory > cache->config.content_memory) {
+        pthread_mutex_unlock(&cache->mutex);
+        filecache_content_release(content);
+        return NULL;
+    }
+
+    __filecache_content_reserve(cache, content->memory);
+
+    entry->content = content;
+    cache->content_total += content->memory;
+    __filecache_lru_push(cache, entry);
+    atomic_fetch_add(&content->ref_count, 1);
+
+    pthread_mutex_unlock(&cache->mutex);
+
+    return content;
+}
+
+void filecache_content_release(filecache_content_t* content) {
+    if (content == NULL) return;
+
+    if (atomic_fetch_sub(&content->ref_count, 1) == 1) {
+        free(content->gzip);
+        free(content);
+    }
+}
+
+uint64_t __filecache_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+filecache_entry_t* __filecache_entry_create(const char* path, const char* index, mimetype_t* mimetype, uint64_t valid_until_ns) {
+    filecache_entry_t* entry = malloc(sizeof * entry);
+    if (entry == NULL) return NULL;
+
+    atomic_init(&entry->ref_count, 1);
+    entry->status = FILECACHE_NOTFOUND;
+    entry->fd = -1;
+    entry->size = 0;
+    entry->mtime = 0;
+    entry->valid_until_ns = valid_until_ns;
+    entry->path = NULL;
+    entry->mimetype = NULL;
+    entry->mimetype_length = 0;
+    entry->last_modified_length = 0;
+    entry->etag_length = 0;
+    entry->last_modified[0] = 0;
+    entry->etag[0] = 0;
+    entry->content = NULL;
+    entry->lru_prev = NULL;
+    entry->lru_next = NULL;
+    entry->table_prev = NULL;
+    entry->table_next = NULL;
+    entry->uses = 0;
+    entry->in_table = 0;
+    entry->content_loading = 0;
+    entry->key = strdup(path);
+    if (entry->key == NULL) {
+        free(entry);
+        return NULL;
+    }
+
+    struct stat stat_obj;
+    const int fd = __filecache_entry_resolve(entry, index, &stat_obj);
+    if (fd == -1) return entry;
+
+    __filecache_entry_set_meta(entry, fd, &stat_obj, mimetype);
+
+    return entry;
+}
+
+/*
+ * Открывает файл по entry->key. Директория резолвится в index через openat
+ * относительно уже открытого дескриптора директории: это заменяет пару
+ * stat + open и не требует повторного разбора пути.
+ * Возвращает fd обычного файла (stat_obj заполнен) или -1
+ * (entry->status содержит причину).
+ */
+int __filecache_entry_resolve(filecache_entry_t* entry, const char* index, struct stat* stat_obj) {
+    /* O_NONBLOCK: open() на FIFO в корне сайта не должен блокировать воркер. */
+    int fd = open(entry->key, FILECACHE_OPEN_FLAGS);
+    if (fd == -1) return -1;
+
+    if (fstat(fd, stat_obj) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    if (S_ISREG(stat_obj->st_mode)) {
+        entry->path = entry->key;
+        return fd;
+    }
+
+    if (!S_ISDIR(stat_obj->st_mode)) {
+        close(fd);
+        return -1;
+    }
+
+    entry->status = FILECACHE_FORBIDDEN;
+
+    if (index == NULL) {
+        close(fd);
+        return -1;
+    }
+
+    const int dirfd = fd;
+    fd = openat(dirfd, index, FILECACHE_OPEN_FLAGS);
+    close(dirfd);
+    if (fd == -1) return -1;
+
+    if (fstat(fd, stat_obj) == -1 || !S_ISREG(stat_obj->st_mode)) {
+        close(fd);
+        return -1;
+    }
+
+    if (!__filecache_entry_set_index_path(entry, index)) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int __filecache_entry_set_index_path(filecache_entry_t* entry, const char* index) {
+    const size_t key_length = strlen(entry->key);
+    const size_t index_length = strlen(index);
+    const int need_slash = key_length == 0 || entry->key[key_length - 1] != '/';
+    const size_t length = key_length + need_slash + index_length;
+
+    if (length >= PATH_MAX) return 0;
+
+    entry->path = malloc(length + 1);
+    if (entry->path == NULL) return 0;
+
+    memcpy(entry->path, entry->key, key_length);
+    if (need_slash)
+        entry->path[key_length] = '/';
+    memcpy(entry->path + key_length + need_slash, index, index_length);
+    entry->path[length] = 0;
+
+    return 1;
+}
+
+void __filecache_entry_set_meta(filecache_entry_t* entry, int fd, const struct stat* stat_obj, mimetype_t* mimetype) {
+    entry->status = FILECACHE_OK;
+    entry->fd = fd;
+    entry->size = stat_obj->st_size;
+    entry->mtime = stat_obj->st_mtime;
+
+    const char* type = mimetype_find_type(mimetype, file_extension(entry->path));
+    if (type != NULL) {
+        entry->mimetype = strdup(type);
+        if (entry->mimetype != NULL)
+            entry->mimetype_length = strlen(entry->mimetype);
+    }
+
+    if (entry->mtime > 0) {
+        entry->last_modified_length = http_format_date(entry->mtime, entry->last_modified, sizeof(entry->last_modified));
+
+        // Слабый ETag: mtime имеет секундную гранулярность
+        const int n = snprintf(entry->etag, sizeof(entry->etag), "W/\"%lx-%lx\"",
+                               (unsigned long)entry->mtime, (unsigned long)entry->size);
+        if (n > 0 && (size_t)n < sizeof(entry->etag))
+            entry->etag_length = n;
+    }
+}
+
+void __filecache_entry_free(filecache_entry_t* entry) {
+    filecache_content_release(entry->content);
+
+    if (entry->fd > -1)
+        close(entry->fd);
+
+    if (entry->path != NULL && entry->path != entry->key)
+        free(entry->path);
+
+    free(entry->mimetype);
+    free(entry->key);
+    free(entry);
+}
+
+void __filecache_value_free(void* arg) {
+    filecache_release(arg);
+}
+
+void __filecache_evict_expired(filecache_t* cache, uint64_t now) {
+    filecache_entry_t* entries[FILECACHE_EVICT_BATCH];
+    size_t count = 0;
+
+    do {
+        count = 0;
+        hashmap_foreach(cache->entries, it) {
+            filecache_entry_t* entry = hashmap_iterator_value(it);
+            if (entry->valid_until_ns > now) continue;
+
+            entries[count++] = entry;
+            if (count == FILECACHE_EVICT_BATCH) break;
+        }
+
+        for (size_t i = 0; i < count; i++)
+            __filecache_remove(cache, entries[i]);
+    } while (count == FILECACHE_EVICT_BATCH);
+}
+
+void __filecache_remove(filecache_t* cache, filecache_entry_t* entry) {
+    __filecache_content_detach(cache, entry);
+    __filecache_table_unlink(cache, entry);
+    entry->in_table = 0;
+    hashmap_erase(cache->entries, entry->key);
+}
+
+void __filecache_table_unlink(filecache_t* cache, filecache_entry_t* entry) {
+    if (entry->table_prev != NULL)
+        entry->table_prev->table_next = entry->table_next;
+    else
+        cache->table_head = entry->table_next;
+
+    if (entry->table_next != NULL)
+        entry->table_next->table_prev = entry->table_prev;
+    else
+        cache->table_tail = entry->table_prev;
+
+    entry->table_prev = NULL;
+    entry->table_next = NULL;
+}
+
+void __filecache_table_push(filecache_t* cache, filecache_entry_t* entry) {
+    entry->table_prev = NULL;
+    entry->table_next = cache->table_head;
+
+    if (cache->table_head != NULL)
+        cache->table_head->table_prev = entry;
+    else
+        cache->table_tail = entry;
+
+    cache->table_head = entry;
+}
+
+void __filecache_lru_unlink(filecache_t* cache, filecache_entry_t* entry) {
+    if (entry->lru_prev != NULL)
+        entry->lru_prev->lru_next = entry->lru_next;
+    else
+        cache->lru_head = entry->lru_next;
+
+    if (entry->lru_next != NULL)
+        entry->lru_next->lru_prev = entry->lru_prev;
+    else
+        cache->lru_tail = entry->lru_prev;
+
+    entry->lru_prev = NULL;
+    entry->lru_next = NULL;
+}
+
+void __filecache_lru_push(filecache_t* cache, filecache_entry_t* entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = cache->lru_head;
+
+    if (cache->lru_head != NULL)
+        cache->lru_head->lru_prev = entry;
+    else
+        cache->lru_tail = entry;
+
+    cache->lru_head = entry;
+}
+
+void __filecache_content_detach(filecache_t* cache, filecache_entry_t* entry) {
+    filecache_content_t* content = entry->content;
+    if (content == NULL) return;
+
+    __filecache_lru_unlink(cache, entry);
+    cache->content_total -= content->memory;
+    entry->content = NULL;
+
+    // Ответы, которые отдают содержимое, держат собственные ссылки
+    filecache_content_release(content);
+}
+
+void __filecache_content_reserve(filecache_t* cache, size_t memory) {
+    while (cache->lru_tail != NULL && cache->content_total + memory > cache->config.content_memory)
+        __filecache_content_detach(cache, cache->lru_tail);
+}
+
+/*
+ * Перепроверенная запись забирает содержимое устаревшей, если файл
+ * не изменился. Иначе содержимое освобождается вместе со старой записью.
+ */
+void __filecache_content_inherit(filecache_t* cache, filecache_entry_t* entry, filecache_entry_t* current) {
+    if (entry->status != FILECACHE_OK || current->status != FILECACHE_OK) return;
+    if (entry->mtime != current->mtime || entry->size != current->size) return;
+    if (strcmp(entry->path, current->path) != 0) return;
+
+    entry->uses = current->uses;
+
+    filecache_content_t* content = current->content;
+    if (content == NULL) return;
+
+    __filecache_lru_unlink(cache, current);
+    current->content = NULL;
+
+    entry->content = content;
+    __filecache_lru_push(cache, entry);
+}
+
+filecache_content_t* __filecache_content_load(filecache_entry_t* entry, int compress) {
+    filecache_content_t* content = malloc(sizeof * content + entry->size);
+    if (content == NULL) return NULL;
+
+    atomic_init(&content->ref_count, 1);
+    content->size = entry->size;
+    content->memory = entry->size;
+    content->gzip = NULL;
+    content->gzip_size = 0;
+
+    size_t offset = 0;
+    while (offset < content->size) {
+        const ssize_t readed = pread(entry->fd, content->data + offset, content->size - offset, offset);
+        if (readed <= 0) {
+            // Файл укоротили после fstat: содержимое не соответствует записи
+            filecache_content_release(content);
+            return NULL;
+        }
+
+        offset += readed;
+    }
+
+    if (compress && __filecache_content_compress(content))
+        content->memory += content->gzip_size;
+
+    return content;
+}
+
+/*
+ * Сжатие выполняется один раз на всё время жизни содержимого,
+ * поэтому используется максимальный уровень.
+ */
+int __filecache_content_compress(filecache_content_t* content) {
+    gzip_t gzip;
+    gzip_init(&gzip);
+    if (!gzip_deflate_init_level(&gzip, Z_BEST_COMPRESSION))
+        return 0;
+
+    const size_t bound = deflateBound(&gzip.stream, content->size);
+    char* out = malloc(bound);
+    if (out == NULL) {
+        gzip_free(&gzip);
+        return 0;
+    }
+
+    gzip_set_in(&gzip, content->data, content->size);
+    const size_t size = gzip_deflate(&gzip, out, bound, 1);
+    const int done = gzip_is_end(&gzip);
+    gzip_free(&gzip);
+
+    if (!done || size >= content->size) {
+        free(out);
+        return 0;
+    }
+
+    content->gzip = out;
+    content->gzip_size = size;
+
+    return 1;
+}
@@ -0,0 +1,136 @@
+#ifndef __FILECACHE__
+#define __FILECACHE__
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "hashmap.h"
+#include "mimetype.h"
+
+/**
+ * Open file cache - кэш открытых дескрипторов и метаданных статических файлов.
+ *
+ * Для каждого полного пути запроса (root + path) хранится результат
+ * резолва (включая подстановку index для директорий), открытый fd,
+ * размер, mtime, mimetype и заранее отформатированные Last-Modified/ETag.
+ * Отрицательные результаты (нет файла, директория без index) тоже кэшируются.
+ *
+ * Записи разделяются между потоками и считают ссылки: ответ держит ссылку
+ * на запись всё время отправки, поэтому вытеснение записи из таблицы
+ * (по TTL или при переполнении) не закрывает fd под читающим ответом.
+ * Заполненная таблица освобождает место под новую запись, вытесняя давно
+ * не запрошенную (LRU); поиск устаревших записей обходит таблицу не чаще
+ * раза в секунду.
+ *
+ * Горячие небольшие файлы дополнительно держатся в памяти целиком
+ * (filecache_content_t) вместе с заранее сжатой gzip-копией. Содержимое
+ * загружается при повторном обращении к записи, общий объём ограничен
+ * content_memory и вытесняется по LRU. Смена mtime или размера файла,
+ * обнаруженная при перепроверке записи, сбрасывает содержимое.
+ */
+
+typedef enum {
+    FILECACHE_OK = 0,
+    FILECACHE_FORBIDDEN,
+    FILECACHE_NOTFOUND
+} filecache_status_e;
+
+typedef struct filecache_config {
+    uint32_t max_entries;          // Максимальное количество записей в таблице
+    uint32_t valid_s;              // Время жизни записи в секундах
+    size_t content_max_size;       // Максимальный размер файла для кэша содержимого
+    size_t content_memory;         // Общий лимит памяти под содержимое (0 - выключен)
+} filecache_config_t;
+
+typedef struct filecache_content {
+    atomic_int ref_count;
+    size_t size;
+    size_t memory;                 // Учитываемый объём: size + gzip_size
+    char* gzip;                    // NULL, если сжатие не нужно или не выгодно
+    size_t gzip_size;
+    char data[];
+} filecache_content_t;
+
+typedef struct filecache_entry {
+    atomic_int ref_count;
+    filecache_status_e status;
+    int fd;                        // -1 для отрицательных записей
+    size_t size;
+    time_t mtime;
+    uint64_t valid_until_ns;
+    char* key;                     // Полный путь запроса
+    char* path;                    // Итоговый путь к файлу (с учётом index)
+    char* mimetype;                // NULL, если расширение неизвестно
+    size_t mimetype_length;
+    size_t last_modified_length;
+    size_t etag_length;
+    char last_modified[32];
+    char etag[48];
+
+    // Поля ниже защищены мьютексом кэша
+    filecache_content_t* content;
+    struct filecache_entry* lru_prev;
+    struct filecache_entry* lru_next;
+    struct filecache_entry* table_prev;
+    struct filecache_entry* table_next;
+    uint32_t uses;
+    unsigned in_table:1;
+    unsigned content_loading:1;
+} filecache_entry_t;
+
+typedef struct filecache {
+    filecache_config_t config;
+    pthread_mutex_t mutex;
+    hashmap_t* entries;            // key -> filecache_entry_t*
+    filecache_entry_t* lru_head;   // Записи с содержимым, от недавних к давним
+    filecache_entry_t* lru_tail;
+    filecache_entry_t* table_head; // Записи таблицы, от недавних к давним
+    filecache_entry_t* table_tail;
+    uint64_t expired_scan_ns;      // Раньше этого времени устаревшие записи не ищутся
+    size_t content_total;
+} filecache_t;
+
+/**
+ * Создание кэша. Возвращает NULL при ошибке выделения памяти.
+ */
+filecache_t* filecache_create(filecache_config_t* config);
+
+/**
+ * Освобождение кэша. Записи, на которые ещё ссылаются ответы,
+ * живут до последнего filecache_release.
+ */
+void filecache_free(filecache_t* cache);
+
+/**
+ * Получить запись для полного пути.
+ * @param cache - кэш (может быть NULL: запись строится без сохранения)
+ * @param path - полный путь, нуль-терминированная строка
+ * @param index - имя index-файла для директорий (NULL - директории запрещены)
+ * @param mimetype - таблица mimetype для определения Content-Type
+ * @return запись с захваченной ссылкой или NULL при ошибке выделения памяти
+ */
+filecache_entry_t* filecache_get(filecache_t* cache, const char* path, const char* index, mimetype_t* mimetype);
+
+/**
+ * Отпустить ссылку на запись. Последний владелец закрывает fd.
+ */
+void filecache_release(filecache_entry_t* entry);
+
+/**
+ * Получить содержимое файла из памяти.
+ * Содержимое читается при втором обращении к записи, которая хранится
+ * в таблице; до этого и для файлов больше content_max_size возвращается NULL,
+ * и ответ отдаётся через fd.
+ * @param compress - подготовить gzip-копию (mimetype входит в список сжатия)
+ * @return содержимое с захваченной ссылкой или NULL
+ */
+filecache_content_t* filecache_content_get(filecache_t* cache, filecache_entry_t* entry, int compress);
+
+/**
+ * Отпустить ссылку на содержимое.
+ */
+void filecache_content_release(filecache_content_t* content);
+
+#endif
@@ -0,0 +1,578 @@
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "log.h"
+#include "memstat.h"
+#include "metrics.h"
+#include "threadshard.h"
+
+#define METRICS_COLLECTORS_MAX 16
+
+typedef struct metrics_route_stats {
+    metrics_histogram_t latency[METRICS_STATUS_CLASSES];
+    metrics_histogram_t queue_wait;
+    metrics_histogram_t handler;
+    metrics_histogram_t first_byte;
+} metrics_route_stats_t;
+
+/*
+ * Набор гистограмм одного потока. Пишет только поток-владелец, поэтому
+ * достаточно relaxed-операций; читатель при выдаче видит значения
+ * с небольшим запаздыванием. Набор завершившегося потока не удаляется,
+ * а переходит к следующему новому потоку, чтобы счётчики не убывали.
+ */
+typedef struct metrics_shard {
+    threadshard_t base;
+    metrics_loop_stats_t loop;
+    _Atomic(metrics_route_stats_t*) routes[METRICS_ROUTES_MAX];
+} metrics_shard_t;
+
+typedef struct metrics_family {
+    const char* name;
+    const char* help;
+} metrics_family_t;
+
+static threadshards_t __shards = THREADSHARDS_INITIALIZER;
+static _Thread_local threadshard_t* __shard = NULL;
+
+static pthread_mutex_t __routes_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char* __route_names[METRICS_ROUTES_MAX] = {0};
+static atomic_uint __routes_count = 1;
+
+static pthread_mutex_t __collectors_mutex = PTHREAD_MUTEX_INITIALIZER;
+static void(*__collectors[METRICS_COLLECTORS_MAX])(str_t*) = {0};
+static int __collectors_count = 0;
+
+static const char* __status_classes[METRICS_STATUS_CLASSES] = { "1xx", "2xx", "3xx", "4xx", "5xx" };
+
+static metrics_shard_t* __shard_get(void);
+static metrics_route_stats_t* __route_stats(unsigned int route);
+static void __record(metrics_histogram_t* histogram, uint64_t value_us);
+static void __add(atomic_ullong* counter, unsigned long long value);
+static int __render_histogram(str_t* out, const char* name, const char* labels, metrics_histogram_t* histogram, double divider, uint64_t exclusive);
+static int __render_loop(str_t* out);
+static int __render_memory(str_t* out);
+static int __render_memory_family(str_t* out, const char* name, const char* type, const char* help, const unsigned long long* values);
+static const char* __route_name(unsigned int route);
+static int __render_route_labels(str_t* labels, unsigned int route, const char* status);
+static int __merge_route(metrics_route_stats_t* dst, unsigned int route);
+static int __render_latency(str_t* out, unsigned int routes_count);
+static int __render_route_histograms(str_t* out, unsigned int routes_count, const metrics_family_t* family, size_t offset);
+
+unsigned int metrics_route_register(const char* name) {
+    if (name == NULL) return METRICS_ROUTE_NONE;
+
+    unsigned int route = METRICS_ROUTE_NONE;
+
+    pthread_mutex_lock(&__routes_mutex);
+
+    const unsigned int count = atomic_load(&__routes_count);
+    for (unsigned int i = 1; i < count; i++) {
+        if (strcmp(__route_names[i], name) == 0) {
+            route = i;
+            goto unlock;
+        }
+    }
+
+    if (count >= METRICS_ROUTES_MAX) {
+        log_error("metrics_route_register: routes limit %d reached, \"%s\" is counted as unmatched\n", METRICS_ROUTES_MAX, name);
+        goto unlock;
+    }
+
+    char* copy = malloc(strlen(name) + 1);
+    if (copy == NULL) goto unlock;
+
+    strcpy(copy, name);
+    __route_names[count] = copy;
+    route = count;
+
+    // имя записано до публикации номера
+    atomic_store_explicit(&__routes_count, count + 1, memory_order_release);
+
+    unlock:
+
+    pthread_mutex_unlock(&__routes_mutex);
+
+    return route;
+}
+
+void metrics_record_request(unsigned int route, int status_code, uint64_t latency_ns) {
+    metrics_route_stats_t* stats = __route_stats(route);
+    if (stats == NULL) return;
+
+    int status_class = status_code / 100 - 1;
+    if (status_class < 0 || status_class >= METRICS_STATUS_CLASSES)
+        status_class = METRICS_STATUS_CLASSES - 1;
+
+    __record(&stats->latency[status_class], latency_ns / 1000);
+}
+
+void metrics_record_queue_wait(unsigned int route, uint64_t wait_ns) {
+    metrics_route_stats_t* stats = __route_stats(route);
+    if (stats == NULL) return;
+
+    __record(&stats->queue_wait, wait_ns / 1000);
+}
+
+void metrics_record_handler(unsigned int route, uint64_t duration_ns) {
+    metrics_route_stats_t* stats = __route_stats(route);
+    if (stats == NULL) return;
+
+    __record(&stats->handler, duration_ns / 1000);
+}
+
+void metrics_record_first_byte(unsigned int route, uint64_t duration_ns) {
+    metrics_route_stats_t* stats = __route_stats(route);
+    if (stats == NULL) return;
+
+    __record(&stats->first_byte, duration_ns / 1000);
+}
+
+void metrics_record_wakeup(int events, uint64_t callbacks_ns) {
+    metrics_shard_t* shard = __shard_get();
+    if (shard == NULL) return;
+
+    __record(&shard->loop.events, (uint64_t)events);
+    __record(&shard->loop.callbacks, callbacks_ns / 1000);
+}
+
+void metrics_record_queue_pop(int depth, uint64_t wait_ns) {
+    metrics_shard_t* shard = __shard_get();
+    if (shard == NULL) return;
+
+    __record(&shard->loop.queue_depth, (uint64_t)depth);
+    __record(&shard->loop.queue_wait, wait_ns / 1000);
+}
+
+void metrics_record_handshake(uint64_t duration_ns) {
+    metrics_shard_t* shard = __shard_get();
+    if (shard == NULL) return;
+
+    __record(&shard->loop.handshake, duration_ns / 1000);
+}
+
+void metrics_record_bytes_in(size_t size) {
+    metrics_shard_t* shard = __shard_get();
+    if (shard == NULL) return;
+
+    __add(&shard->loop.bytes_in, size);
+}
+
+void metrics_record_bytes_out(size_t size) {
+    metrics_shard_t* shard = __shard_get();
+    if (shard == NULL) return;
+
+    __add(&shard->loop.bytes_out, size);
+}
+
+void metrics_loop_stats(metrics_loop_stats_t* stats) {
+    if (stats == NULL) return;
+
+    memset(stats, 0, sizeof * stats);
+
+    for (threadshard_t* base = atomic_load(&__shards.shards); base != NULL; base = base->next) {
+        metrics_shard_t* shard = (metrics_shard_t*)base;
+        metrics_histogram_merge(&stats->events, &shard->loop.events);
+        metrics_histogram_merge(&stats->callbacks, &shard->loop.callbacks);
+        metrics_histogram_merge(&stats->queue_depth, &shard->loop.queue_depth);
+        metrics_histogram_merge(&stats->queue_wait, &shard->loop.queue_wait);
+        metrics_histogram_merge(&stats->handshake, &shard->loop.handshake);
+        atomic_fetch_add_explicit(&stats->bytes_in, atomic_load_explicit(&shard->loop.bytes_in, memory_order_relaxed), memory_order_relaxed);
+        atomic_fetch_add_explicit(&stats->bytes_out, atomic_load_explicit(&shard->loop.bytes_out, memory_order_relaxed), memory_order_relaxed);
+    }
+}
+
+void metrics_histogram_record(metrics_histogram_t* histogram, uint64_t value_us) {
+    atomic_fetch_add(&histogram->buckets[metrics_histogram_bucket(value_us)], 1);
+    atomic_fetch_add(&histogram->sum, value_us);
+    atomic_fetch_add(&histogram->count, 1);
+}
+
+void metrics_histogram_merge(metrics_histogram_t* dst, metrics_histogram_t* src) {
+    for (int i = 0; i < METRICS_BUCKETS; i++) {
+        const unsigned long long value = atomic_load_explicit(&src->buckets[i], memory_order_relaxed);
+        if (value > 0)
+            atomic_fetch_add_explicit(&dst->buckets[i], value, memory_order_relaxed);
+    }
+
+    atomic_fetch_add_explicit(&dst->sum, atomic_load_explicit(&src->sum, memory_order_relaxed), memory_order_relaxed);
+    atomic_fetch_add_explicit(&dst->count, atomic_load_explicit(&src->count, memory_order_relaxed), memory_order_relaxed);
+}
+
+void metrics_histogram_reset(metrics_histogram_t* histogram) {
+    for (int i = 0; i < METRICS_BUCKETS; i++)
+        atomic_init(&histogram->buckets[i], 0);
+
+    atomic_init(&histogram->sum, 0);
+    atomic_init(&histogram->count, 0);
+}
+
+int metrics_histogram_bucket(uint64_t value_us) {
+    if (value_us < METRICS_SUB_BUCKETS) return (int)value_us;
+
+    // старший бит задаёт степень двойки, два следующих - корзину внутри неё
+    const int exponent = 63 - __builtin_clzll(value_us);
+    const int sub = (int)((value_us >> (exponent - 2)) & (METRICS_SUB_BUCKETS - 1));
+    const int bucket = METRICS_SUB_BUCKETS + (exponent - 2) * METRICS_SUB_BUCKETS + sub;
+
+    return bucket < METRICS_BUCKETS ? bucket : METRICS_BUCKETS - 1;
+}
+
+uint64_t metrics_histogram_bucket_bound(int bucket) {
+    if (bucket < METRICS_SUB_BUCKETS) return (uint64_t)bucket + 1;
+
+    const int exponent = (bucket - METRICS_SUB_BUCKETS) / METRICS_SUB_BUCKETS + 2;
+    const int sub = (bucket - METRICS_SUB_BUCKETS) % METRICS_SUB_BUCKETS;
+
+    return (uint64_t)(METRICS_SUB_BUCKETS + sub + 1) << (exponent - 2);
+}
+
+int metrics_register_collector(void(*collector)(str_t* out)) {
+    if (collector == NULL) return 0;
+
+    int result = 0;
+
+    pthread_mutex_lock(&__collectors_mutex);
+
+    for (int i = 0; i < __collectors_count; i++) {
+        if (__collectors[i] == collector) {
+            result = 1;
+            goto unlock;
+        }
+    }
+
+    if (__collectors_count >= METRICS_COLLECTORS_MAX) {
+        log_error("metrics_register_collector: collectors limit %d reached\n", METRICS_COLLECTORS_MAX);
+        goto unlock;
+    }
+
+    __collectors[__collectors_count++] = collector;
+    result = 1;
+
+    unlock:
+
+    pthread_mutex_unlock(&__collectors_mutex);
+
+    return result;
+}
+
+int metrics_render(str_t* out) {
+    if (out == NULL) return 0;
+
+    const unsigned int routes_count = atomic_load_explicit(&__routes_count, memory_order_acquire);
+
+    static const metrics_family_t queue_wait = {
+        "cwfr_http_queue_wait_seconds",
+        "Time a request waited in the handler queue"
+    };
+    static const metrics_family_t handler = {
+        "cwfr_http_handler_duration_seconds",
+        "Time spent in the route handler"
+    };
+    static const metrics_family_t first_byte = {
+        "cwfr_http_first_byte_seconds",
+        "Time from a parsed request to the first byte of its response"
+    };
+
+    if (!__render_latency(out, routes_count)) return 0;
+    if (!__render_route_histograms(out, routes_count, &queue_wait, offsetof(metrics_route_stats_t, queue_wait))) return 0;
+    if (!__render_route_histograms(out, routes_count, &handler, offsetof(metrics_route_stats_t, handler))) return 0;
+    if (!__render_route_histograms(out, routes_count, &first_byte, offsetof(metrics_route_stats_t, first_byte))) return 0;
+    if (!__render_loop(out)) return 0;
+    if (!__render_memory(out)) return 0;
+
+    pthread_mutex_lock(&__collectors_mutex);
+    for (int i = 0; i < __collectors_count; i++)
+        __collectors[i](out);
+    pthread_mutex_unlock(&__collectors_mutex);
+
+    return 1;
+}
+
+int metrics_render_header(str_t* out, const char* name, const char* type, const char* help) {
+    return str_appendf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+int metrics_render_counter(str_t* out, const char* name, const char* help, unsigned long long value) {
+    if (!metrics_render_header(out, name, "counter", help)) return 0;
+
+    return str_appendf(out, "%s %llu\n", name, value);
+}
+
+int metrics_render_gauge(str_t* out, const char* name, const char* help, double value) {
+    if (!metrics_render_header(out, name, "gauge", help)) return 0;
+
+    return str_appendf(out, "%s %.17g\n", name, value);
+}
+
+int metrics_render_histogram(str_t* out, const char* name, const char* labels, metrics_histogram_t* histogram) {
+    return __render_histogram(out, name, labels, histogram, 1000000.0, 0);
+}
+
+int metrics_render_histogram_values(str_t* out, const char* name, const char* labels, metrics_histogram_t* histogram) {
+    // у целых величин граница корзины b исключена, поэтому le = b - 1
+    return __render_histogram(out, name, labels, histogram, 1.0, 1);
+}
+
+int metrics_render_label_value(str_t* out, const char* value) {
+    if (!str_appendc(out, '"')) return 0;
+
+    for (const char* c = value; *c != 0; c++) {
+        int result = 1;
+        switch (*c) {
+        case '\\': result = str_append(out, "\\\\", 2); break;
+        case '"': result = str_append(out, "\\\"", 2); break;
+        case '\n': result = str_append(out, "\\n", 2); break;
+        default: result = str_appendc(out, *c);
+        }
+
+        if (!result) return 0;
+    }
+
+    return str_appendc(out, '"');
+}
+
+uint64_t metrics_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+metrics_shard_t* __shard_get(void) {
+    if (__shard != NULL) return (metrics_shard_t*)__shard;
+
+    return (metrics_shard_t*)threadshards_attach(&__shards, &__shard, sizeof(metrics_shard_t));
+}
+
+metrics_route_stats_t* __route_stats(unsigned int route) {
+    if (route >= METRICS_ROUTES_MAX) route = METRICS_ROUTE_NONE;
+
+    metrics_shard_t* shard = __shard_get();
+    if (shard == NULL) return NULL;
+
+    metrics_route_stats_t* stats = atomic_load_explicit(&shard->routes[route], memory_order_acquire);
+    if (stats != NULL) return stats;
+
+    // место под маршрут выделяется один раз при первом запросе в потоке
+    stats = calloc(1, sizeof * stats);
+    if (stats == NULL) return NULL;
+
+    atomic_store_explicit(&shard->routes[route], stats, memory_order_release);
+
+    return stats;
+}
+
+void __record(metrics_histogram_t* histogram, uint64_t value_us) {
+    // у гистограммы один писатель, поэтому чтение и запись без read-modify-write
+    atomic_ullong* bucket = &histogram->buckets[metrics_histogram_bucket(value_us)];
+    atomic_store_explicit(bucket, atomic_load_explicit(bucket, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_store_explicit(&histogram->sum, atomic_load_explicit(&histogram->sum, memory_order_relaxed) + value_us, memory_order_relaxed);
+    atomic_store_explicit(&histogram->count, atomic_load_explicit(&histogram->count, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+void __add(atomic_ullong* counter, unsigned long long value) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+int __render_memory(str_t* out) {
+    memstat_stats_t stats;
+    memstat_snapshot(&stats);
+
+    unsigned long long bytes[MEMSTAT_COUNT];
+    unsigned long long limits[MEMSTAT_COUNT];
+    for (int i = 0; i < MEMSTAT_COUNT; i++) {
+        bytes[i] = stats.bytes[i];
+        limits[i] = stats.limits[i];
+    }
+
+    if (!__render_memory_family(out, "cwfr_memory_bytes", "gauge", "Bytes held by a subsystem", bytes)) return 0;
+    if (!__render_memory_family(out, "cwfr_memory_limit_bytes", "gauge", "Soft memory limit of a subsystem, 0 - no limit", limits)) return 0;
+    if (!__render_memory_family(out, "cwfr_memory_shed_total", "counter", "Objects refused because a memory limit was exceeded", stats.shed)) return 0;
+    if (!metrics_render_gauge(out, "cwfr_memory_total_bytes", "Bytes held by all accounted subsystems", (double)stats.total)) return 0;
+    if (!metrics_render_gauge(out, "cwfr_memory_total_limit_bytes", "Soft limit of all accounted subsystems, 0 - no limit", (double)stats.total_limit)) return 0;
+
+    return metrics_render_gauge(out, "process_resident_memory_bytes", "Resident memory size in bytes", (double)stats.rss);
+}
+
+int __render_memory_family(str_t* out, const char* name, const char* type, const char* help, const unsigned long long* values) {
+    if (!metrics_render_header(out, name, type, help)) return 0;
+
+    for (int i = 0; i < MEMSTAT_COUNT; i++)
+        if (!str_appendf(out, "%s{subsystem=\"%s\"} %llu\n", name, memstat_name(i), values[i])) return 0;
+
+    return 1;
+}
+
+const char* __route_name(unsigned int route) {
+    if (route == METRICS_ROUTE_NONE) return "unmatched";
+
+    return __route_names[route];
+}
+
+int __render_route_labels(str_t* labels, unsigned int route, const char* status) {
+    str_reset(labels);
+
+    if (!str_append(labels, "route=", 6)) return 0;
+    if (!metrics_render_label_value(labels, __route_name(route))) return 0;
+
+    if (status != NULL)
+        return str_appendf(labels, ",status=\"%s\"", status);
+
+    return 1;
+}
+
+int __merge_route(metrics_route_stats_t* dst, unsigned int route) {
+    memset(dst, 0, sizeof * dst);
+
+    int found = 0;
+    for (threadshard_t* base = atomic_load(&__shards.shards); base != NULL; base = base->next) {
+        metrics_shard_t* shard = (metrics_shard_t*)base;
+        metrics_route_stats_t* stats = atomic_load_explicit(&shard->routes[route], memory_order_acquire);
+        if (stats == NULL) continue;
+
+        for (int i = 0; i < METRICS_STATUS_CLASSES; i++)
+            metrics_histogram_merge(&dst->latency[i], &stats->latency[i]);
+
+        metrics_histogram_merge(&dst->queue_wait, &stats->queue_wait);
+        metrics_histogram_merge(&dst->handler, &stats->handler);
+        metrics_histogram_merge(&dst->first_byte, &stats->first_byte);
+        found = 1;
+    }
+
+    return found;
+}
+
+int __render_latency(str_t* out, unsigned int routes_count) {
+    const char* name = "cwfr_http_request_duration_seconds";
+    if (!metrics_render_header(out, name, "histogram", "Time from request start to response completion")) return 0;
+
+    metrics_route_stats_t* merged = malloc(sizeof * merged);
+    if (merged == NULL) return 0;
+
+    str_t labels;
+    str_init(&labels, 64);
+
+    int result = 0;
+    for (unsigned int route = 0; route < routes_count; route++) {
+        if (!__merge_route(merged, route)) continue;
+
+        for (int i = 0; i < METRICS_STATUS_CLASSES; i++) {
+            if (atomic_load_explicit(&merged->latency[i].count, memory_order_relaxed) == 0) continue;
+
+            if (!__render_route_labels(&labels, route, __status_classes[i])) goto failed;
+            if (!metrics_render_histogram(out, name, str_get(&labels), &merged->latency[i])) goto failed;
+        }
+    }
+
+    result = 1;
+
+    failed:
+
+    str_clear(&labels);
+    free(merged);
+
+    return result;
+}
+
+int __render_route_histograms(str_t* out, unsigned int routes_count, const metrics_family_t* family, size_t offset) {
+    if (!metrics_render_header(out, family->name, "histogram", family->help)) return 0;
+
+    metrics_route_stats_t* merged = malloc(sizeof * merged);
+    if (merged == NULL) return 0;
+
+    str_t labels;
+    str_init(&labels, 64);
+
+    int result = 0;
+    for (unsigned int route = 0; route < routes_count; route++) {
+        if (!__merge_route(merged, route)) continue;
+
+        metrics_histogram_t* histogram = (metrics_histogram_t*)((char*)merged + offset);
+        if (atomic_load_explicit(&histogram->count, memory_order_relaxed) == 0) continue;
+
+        if (!__render_route_labels(&labels, route, NULL)) goto failed;
+        if (!metrics_render_histogram(out, family->name, str_get(&labels), histogram)) goto failed;
+    }
+
+    result = 1;
+
+    failed:
+
+    str_clear(&labels);
+    free(merged);
+
+    return result;
+}
+
+int __render_histogram(str_t* out, const char* name, const char* labels, metrics_histogram_t* histogram, double divider, uint64_t exclusive) {
+    const char* separator = labels != NULL && labels[0] != 0 ? "," : "";
+    if (labels == NULL) labels = "";
+
+    // наружу отдаются только границы на степенях двойки: корзин меньше,
+    // а внутренние границы совпадают с ними на каждой четвёртой корзине
+    unsigned long long cumulative = 0;
+    for (int i = 0; i < METRICS_BUCKETS; i++) {
+        cumulative += atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+
+        const uint64_t bound = metrics_histogram_bucket_bound(i);
+        if ((bound & (bound - 1)) != 0) continue;
+
+        if (!str_appendf(out, "%s_bucket{%s%sle=\"%g\"} %llu\n", name, labels, separator, (double)(bound - exclusive) / divider, cumulative))
+            return 0;
+    }
+
+    const unsigned long long count = atomic_load_explicit(&histogram->count, memory_order_relaxed);
+    const unsigned long long sum = atomic_load_explicit(&histogram->sum, memory_order_relaxed);
+
+    // запись не атомарна целиком: +Inf не может быть меньше последней корзины
+    if (count > cumulative) cumulative = count;
+
+    if (!str_appendf(out, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, separator, cumulative)) return 0;
+
+    if (labels[0] != 0) {
+        if (!str_appendf(out, "%s_sum{%s} %.6f\n", name, labels, (double)sum / divider)) return 0;
+        return str_appendf(out, "%s_count{%s} %llu\n", name, labels, cumulative);
+    }
+
+    if (!str_appendf(out, "%s_sum %.6f\n", name, (double)sum / divider)) return 0;
+    return str_appendf(out, "%s_count %llu\n", name, cumulative);
+}
+
+int __render_loop(str_t* out) {
+    metrics_loop_stats_t* stats = malloc(sizeof * stats);
+    if (stats == NULL) return 0;
+
+    metrics_loop_stats(stats);
+
+    int result = 0;
+
+    if (!metrics_render_header(out, "cwfr_loop_wakeup_events", "histogram", "Events returned by one epoll_wait wakeup")) goto failed;
+    if (!metrics_render_histogram_values(out, "cwfr_loop_wakeup_events", NULL, &stats->events)) goto failed;
+
+    if (!metrics_render_header(out, "cwfr_loop_wakeup_callbacks_seconds", "histogram", "Time in read and write callbacks per wakeup")) goto failed;
+    if (!metrics_render_histogram(out, "cwfr_loop_wakeup_callbacks_seconds", NULL, &stats->callbacks)) goto failed;
+
+    if (!metrics_render_header(out, "cwfr_handler_queue_depth_observed", "histogram", "Handler queue length seen when a connection is taken")) goto failed;
+    if (!metrics_render_histogram_values(out, "cwfr_handler_queue_depth_observed", NULL, &stats->queue_depth)) goto failed;
+
+    if (!metrics_render_header(out, "cwfr_handler_queue_wait_seconds", "histogram", "Time a connection waited in the handler queue")) goto failed;
+    if (!metrics_render_histogram(out, "cwfr_handler_queue_wait_seconds", NULL, &stats->queue_wait)) goto failed;
+
+    if (!metrics_render_header(out, "cwfr_tls_handshake_duration_seconds", "histogram", "Server TLS handshake duration")) goto failed;
+    if (!metrics_render_histogram(out, "cwfr_tls_handshake_duration_seconds", NULL, &stats->handshake)) goto failed;
+
+    if (!metrics_render_counter(out, "cwfr_net_received_bytes_total", "Bytes read from connections", atomic_load(&stats->bytes_in))) goto failed;
+    if (!metrics_render_counter(out, "cwfr_net_sent_bytes_total", "Bytes written to connections", atomic_load(&stats->bytes_out))) goto failed;
+
+    result = 1;
+
+    failed:
+
+    free(stats);
+
+    return result;
+}
@@ -0,0 +1,120 @@
+#ifndef __METRICS__
+#define __METRICS__
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "str.h"
+
+/**
+ * Метрики запросов: гистограммы задержек и счётчики по маршрутам и
+ * классам статусов ответа.
+ *
+ * Каждый поток пишет в собственный набор гистограмм, поэтому запись не
+ * ждёт ни блокировок, ни других потоков. При выдаче наборы всех потоков
+ * складываются. Гистограммы логарифмически-линейные (как HDR): четыре
+ * корзины на каждую степень двойки микросекунд.
+ */
+
+// Корзины 0..3 мкс линейные, далее по 4 на степень двойки до 2^30 мкс
+#define METRICS_SUB_BUCKETS 4
+#define METRICS_BUCKETS (METRICS_SUB_BUCKETS + 28 * METRICS_SUB_BUCKETS)
+#define METRICS_ROUTES_MAX 256
+// Маршрут 0 - запросы без обработчика (статика, перенаправления, ошибки)
+#define METRICS_ROUTE_NONE 0
+// Классы статусов 1xx..5xx
+#define METRICS_STATUS_CLASSES 5
+
+typedef struct metrics_histogram {
+    atomic_ullong count;
+    atomic_ullong sum;             // мкс, у гистограмм величин - штуки
+    atomic_ullong buckets[METRICS_BUCKETS];
+} metrics_histogram_t;
+
+/**
+ * Работа цикла событий и общей очереди обработчиков. Разделяет задержку
+ * на ожидание воркера, ожидание в очереди и код приложения
+ */
+typedef struct metrics_loop_stats {
+    metrics_histogram_t events;    // События за одно пробуждение epoll_wait, штуки
+    metrics_histogram_t callbacks; // Время в обработчиках чтения и записи за пробуждение, мкс
+    metrics_histogram_t queue_depth; // Длина очереди при выдаче соединения, штуки
+    metrics_histogram_t queue_wait;  // Ожидание соединения в очереди, мкс
+    metrics_histogram_t handshake;   // TLS-рукопожатие от первого чтения до завершения, мкс
+    atomic_ullong bytes_in;
+    atomic_ullong bytes_out;
+} metrics_loop_stats_t;
+
+/**
+ * Регистрация маршрута по имени; повторная регистрация возвращает тот же
+ * номер, поэтому метрики переживают перезагрузку маршрутов.
+ * @return номер маршрута или METRICS_ROUTE_NONE, если мест нет
+ */
+unsigned int metrics_route_register(const char* name);
+
+/**
+ * Запись в гистограммы текущего потока
+ */
+void metrics_record_request(unsigned int route, int status_code, uint64_t latency_ns);
+void metrics_record_queue_wait(unsigned int route, uint64_t wait_ns);
+void metrics_record_handler(unsigned int route, uint64_t duration_ns);
+void metrics_record_first_byte(unsigned int route, uint64_t duration_ns);
+
+void metrics_record_wakeup(int events, uint64_t callbacks_ns);
+void metrics_record_queue_pop(int depth, uint64_t wait_ns);
+void metrics_record_handshake(uint64_t duration_ns);
+void metrics_record_bytes_in(size_t size);
+void metrics_record_bytes_out(size_t size);
+
+/**
+ * Сумма по всем потокам
+ */
+void metrics_loop_stats(metrics_loop_stats_t* stats);
+
+void metrics_histogram_record(metrics_histogram_t* histogram, uint64_t value_us);
+void metrics_histogram_merge(metrics_histogram_t* dst, metrics_histogram_t* src);
+void metrics_histogram_reset(metrics_histogram_t* histogram);
+int metrics_histogram_bucket(uint64_t value_us);
+// Верхняя граница корзины (не включая), мкс
+uint64_t metrics_histogram_bucket_bound(int bucket);
+
+/**
+ * Источник дополнительных метрик (пул потоков, TLS и т.п.): дописывает
+ * свои строки в формате Prometheus. Повторная регистрация игнорируется
+ */
+int metrics_register_collector(void(*collector)(str_t* out));
+
+/**
+ * Все метрики в текстовом формате Prometheus
+ */
+int metrics_render(str_t* out);
+
+/**
+ * Строки # HELP и # TYPE семейства метрик
+ */
+int metrics_render_header(str_t* out, const char* name, const char* type, const char* help);
+
+// Семейство из одного значения без меток вместе с заголовком
+int metrics_render_counter(str_t* out, const char* name, const char* help, unsigned long long value);
+int metrics_render_gauge(str_t* out, const char* name, const char* help, double value);
+
+/**
+ * Ряд гистограммы в секундах (корзины на степенях двойки микросекунд,
+ * _sum и _count); labels - готовые метки без фигурных скобок или NULL
+ */
+int metrics_render_histogram(str_t* out, const char* name, const char* labels, metrics_histogram_t* histogram);
+
+/**
+ * Ряд гистограммы величин без единиц (количество событий, длина очереди)
+ */
+int metrics_render_histogram_values(str_t* out, const char* name, const char* labels, metrics_histogram_t* histogram);
+
+/**
+ * Значение метки в кавычках с экранированием \, " и перевода строки
+ */
+int metrics_render_label_value(str_t* out, const char* value);
+
+uint64_t metrics_now_ns(void);
+
+#endif
@@ -0,0 +1,250 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "log.h"
+#include "appconfig.h"
+#include "moduleloader.h"
+#include "sockethandoff.h"
+#include "signal/signal.h"
+#include "handoff.h"
+
+// Сколько ждать, пока воркеры заберут полученные сокеты
+#define HANDOFF_CLAIM_TIMEOUT_MS 5000
+// Сколько старый процесс ждёт завершения текущих запросов
+#define HANDOFF_DRAIN_TIMEOUT_MS 30000
+#define HANDOFF_POLL_INTERVAL_MS 10
+
+static atomic_bool __received = 0;
+static atomic_bool __completed = 0;
+static int __channel = -1;
+
+static int __handoff_address(const char* path, struct sockaddr_un* addr);
+static void* __handoff_serve(void* arg);
+static int __handoff_serve_socket(const char* path);
+static int __handoff_peer_trusted(int channel);
+static int __handoff_transfer(int channel);
+static void __handoff_drain(void);
+static void __handoff_sleep_ms(int ms);
+
+void handoff_receive(const char* path) {
+    if (path == NULL) return;
+    if (atomic_exchange(&__received, 1)) return;
+
+    struct sockaddr_un addr;
+    if (!__handoff_address(path, &addr)) return;
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        log_error("handoff_receive: can't create socket\n");
+        return;
+    }
+
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        // Никто не слушает - обычный холодный старт
+        if (errno != ENOENT && errno != ECONNREFUSED)
+            log_error("handoff_receive: can't connect to %s\n", path);
+
+        close(fd);
+        return;
+    }
+
+    const int count = socket_handoff_receive(fd);
+    if (count < 0) {
+        socket_handoff_close_unclaimed();
+        close(fd);
+        return;
+    }
+
+    log_info("handoff_receive: received %d listening sockets\n", count);
+
+    __channel = fd;
+}
+
+int handoff_complete(const char* path) {
+    if (path == NULL) return 1;
+    if (atomic_exchange(&__completed, 1)) return 1;
+
+    if (__channel != -1) {
+        for (int waited = 0; waited < HANDOFF_CLAIM_TIMEOUT_MS && socket_handoff_unclaimed() > 0; waited += HANDOFF_POLL_INTERVAL_MS)
+            __handoff_sleep_ms(HANDOFF_POLL_INTERVAL_MS);
+
+        const int unclaimed = socket_handoff_unclaimed();
+        if (unclaimed > 0)
+            log_info("handoff_complete: %d sockets are not claimed, closing (workers count changed?)\n", unclaimed);
+
+        socket_handoff_close_unclaimed();
+
+        if (!socket_handoff_ack(__channel))
+            log_error("handoff_complete: can't notify previous process\n");
+
+        close(__channel);
+        __channel = -1;
+    }
+
+    const int fd = __handoff_serve_socket(path);
+    if (fd == -1) return 0;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, __handoff_serve, (void*)(intptr_t)fd) != 0) {
+        log_error("handoff_complete: unable to create thread\n");
+        close(fd);
+        return 0;
+    }
+
+    pthread_detach(thread);
+    pthread_setname_np(thread, "Server handoff");
+
+    return 1;
+}
+
+int __handoff_address(const char* path, struct sockaddr_un* addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        log_error("handoff: socket path is too long\n");
+        return 0;
+    }
+
+    strcpy(addr->sun_path, path);
+
+    return 1;
+}
+
+int __handoff_serve_socket(const char* path) {
+    struct sockaddr_un addr;
+    if (!__handoff_address(path, &addr)) return -1;
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        log_error("handoff_complete: can't create socket\n");
+        return -1;
+    }
+
+    // Путь остался от старого процесса: он уже передал сокеты и больше его не слушает
+    unlink(path);
+
+    // Права выставляются до listen: подключиться до этого нельзя
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1
+        || chmod(path, S_IRUSR | S_IWUSR) == -1
+        || listen(fd, 1) == -1) {
+        log_error("handoff_complete: can't listen %s\n", path);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// Сокеты отдаются только процессу того же пользователя
+int __handoff_peer_trusted(int channel) {
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(channel, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1) {
+        log_error("__handoff_serve: can't get peer credentials\n");
+        return 0;
+    }
+
+    if (cred.uid != geteuid()) {
+        log_error("__handoff_serve: rejected peer pid %d uid %u\n", (int)cred.pid, (unsigned int)cred.uid);
+        return 0;
+    }
+
+    return 1;
+}
+
+void* __handoff_serve(void* arg) {
+    signal_block_reload();
+
+    const int fd = (int)(intptr_t)arg;
+
+    while (1) {
+        const int channel = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+        if (channel == -1) {
+            if (errno == EINTR) continue;
+
+            log_error("__handoff_serve: accept failed\n");
+            close(fd);
+            pthread_exit(NULL);
+        }
+
+        if (!__handoff_peer_trusted(channel)) {
+            close(channel);
+            continue;
+        }
+
+        const int transferred = __handoff_transfer(channel);
+        close(channel);
+
+        if (transferred) break;
+    }
+
+    close(fd);
+
+    __handoff_drain();
+
+    pthread_exit(NULL);
+}
+
+int __handoff_transfer(int channel) {
+    // Закрытие канала без подтверждения - новый процесс не поднялся, работаем дальше
+    const int count = socket_handoff_send(channel);
+    if (count < 0) {
+        log_error("__handoff_serve: new process failed, keep serving\n");
+        return 0;
+    }
+
+    log_info("__handoff_serve: sent %d listening sockets to new process\n", count);
+
+    return 1;
+}
+
+/*
+ * Штатная мягкая остановка: воркеры снимают слушающие сокеты с мультиплексора
+ * и дорабатывают открытые соединения. Сами сокеты разделяются с новым
+ * процессом, поэтому закрываются без shutdown (см. socket_handoff_sent).
+ */
+void __handoff_drain(void) {
+    while (module_loader_signal_locked())
+        __handoff_sleep_ms(HANDOFF_POLL_INTERVAL_MS);
+
+    // Перезагрузка конфигурации во время остановки пересоздала бы потоки
+    module_loader_signal_lock();
+
+    appconfig_t* config = appconfig();
+    if (config != NULL) {
+        appconfg_threads_increment(config);
+        atomic_store(&config->shutdown, 1);
+        module_loader_wakeup_all_threads();
+
+        for (int waited = 0; waited < HANDOFF_DRAIN_TIMEOUT_MS && atomic_load(&config->threads_count) > 1; waited += HANDOFF_POLL_INTERVAL_MS)
+            __handoff_sleep_ms(HANDOFF_POLL_INTERVAL_MS);
+
+        // Счётчик не уменьшаем: конфигурация освободилась бы, пока процесс ещё жив
+        if (atomic_load(&config->threads_count) > 1)
+            log_error("__handoff_drain: drain timeout, terminating\n");
+    }
+
+    log_info("__handoff_drain: handed off to new process\n");
+
+    kill(getpid(), SIGTERM);
+}
+
+void __handoff_sleep_ms(int ms) {
+    struct timespec delay = {
+        .tv_sec = ms / 1000,
+        .tv_nsec = (long)(ms % 1000) * 1000000
+    };
+    nanosleep(&delay, NULL);
+}
@@ -0,0 +1,31 @@
+#ifndef __HANDOFF__
+#define __HANDOFF__
+
+/**
+ * Обновление бинарника без простоя.
+ *
+ * Новый процесс при старте подключается к unix-сокету main.handoff_socket
+ * и получает слушающие сокеты работающего процесса. Воркеры забирают их
+ * вместо создания новых, так что очереди принятых ядром соединений
+ * переходят к новому процессу целиком. После полной инициализации новый
+ * процесс подтверждает готовность, и только тогда старый перестаёт
+ * принимать соединения, дожидается завершения текущих запросов и выходит.
+ * Если новый процесс упал до подтверждения, старый продолжает работу.
+ *
+ * Передача выполняется один раз за время жизни процесса: перезагрузка
+ * конфигурации по SIGUSR1 её не затрагивает.
+ */
+
+/**
+ * Получение сокетов от работающего процесса. Без пути или без работающего
+ * процесса ничего не делает - сокеты будут созданы заново
+ */
+void handoff_receive(const char* path);
+
+/**
+ * Вызывается после запуска потоков: закрывает невостребованные сокеты,
+ * подтверждает готовность старому процессу и начинает ждать следующего
+ */
+int handoff_complete(const char* path);
+
+#endif
@@ -6,6 +6,7 @@
 #include <pthread.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <sys/un.h>
 #include <syslog.h>
 
 #include "log.h"
@@ -22,6 +23,7 @@
 #include "openssl.h"
 #include "mimetype.h"
 #include "session.h"
+#include "ratelimit.h"
 #include "storagefs.h"
 #include "storages3.h"
 #include "viewstore.h"
@@ -33,6 +35,8 @@
 #include "httpserverhandlers.h"
 #include "taskmanager.h"
 #include "i18n.h"
+#include "handoff.h"
+#include "accesslog.h"
 #ifdef MySQL_FOUND
     #include "mysql.h"
 #endif
@@ -72,6 +76,8 @@ static void __free_gzip_list(env_gzip_str_t* item) {
 }
 
 static int __module_loader_init_modules(appconfig_t* config, json_doc_t* document);
+static env_gzip_str_t* __module_loader_gzip_item_load(const json_token_t* token_item);
+static int __module_loader_gzip_level_load(const json_token_t* token_item, const char* key, int min, int max, int* level);
 static int __module_loader_taskmanager_load(appconfig_t* config, taskmanager_t* manager, const json_token_t* token_taskmanager);
 static int __module_loader_servers_load(appconfig_t* config, const json_token_t* servers);
 static domain_t* __module_loader_domains_load(const json_token_t* token_array);
@@ -80,10 +86,40 @@ static int __module_loader_storages_load(appconfig_t* config, const json_token_t
 static int __module_loader_mimetype_load(appconfig_t* config, const json_token_t* mimetypes);
 static int __module_loader_viewstore_load(appconfig_t* config);
 static int __module_loader_sessionconfig_load(appconfig_t* config, const json_token_t* sessionconfig);
+static int __module_loader_keyed_ratelimits_load(appconfig_t* config, const json_token_t* token_object);
+static ratelimit_t* __module_loader_keyed_ratelimit_load(appconfig_t* config, const char* name, const json_token_t* token_object);
+static int __module_loader_redis_host_exists(appconfig_t* config, const char* host_id);
 static int __module_loader_taskmanager_init(appconfig_t* config, json_token_t* task_manager);
 static int __module_loader_translations_load(appconfig_t* config, json_token_t* translations);
 
-static int __module_loader_http_routes_load(routeloader_lib_t** first_lib, const json_token_t* token_object, route_t** route, map_t* ratelimiter_config);
+static // host_id в виде "redis" или "redis.<id хоста>", как в dbquery
+int __module_loader_redis_host_exists(appconfig_t* config, const char* host_id) {
+    const char* dot = strchr(host_id, '.');
+    const size_t driver_size = dot != NULL ? (size_t)(dot - host_id) : strlen(host_id);
+    if (driver_size != 5 || strncmp(host_id, "redis", driver_size) != 0) return 0;
+
+    const char* host = dot != NULL && dot[1] != 0 ? dot + 1 : NULL;
+
+    for (size_t i = 0; i < array_size(config->databases); i++) {
+        db_t* db = array_get(config->databases, i);
+        if (strcmp(db->id, "redis") != 0) continue;
+
+        if (host == NULL)
+            return array_size(db->hosts) > 0;
+
+        for (size_t j = 0; j < array_size(db->hosts); j++) {
+            dbhost_t* dbhost = array_get(db->hosts, j);
+            if (dbhost != NULL && strcmp(dbhost->id, host) == 0)
+                return 1;
+        }
+
+        return 0;
+    }
+
+    return 0;
+}
+
+int __module_loader_http_routes_load(routeloader_lib_t** first_lib, const json_token_t* token_object, route_t** route, map_t* ratelimiter_config);
 static int __module_loader_set_http_route(routeloader_lib_t** first_lib, routeloader_lib_t** last_lib, route_t* route, const json_token_t* token_object, map_t* ratelimiter_config);
 static int __module_loader_http_redirects_load(const json_token_t* token_object, redirect_t** redirect);
 static int __module_loader_middlewares_load(const json_token_t* token_object, middleware_item_t** middleware_item);
@@ -98,9 +134,14 @@ static const char* __module_loader_storage_field(const char* storage_name, const
 static int __module_loader_thread_taskmanager_load(appconfig_t* config);
 static int __module_loader_thread_workers_load(appconfig_t* config);
 static int __module_loader_thread_handlers_load(appconfig_t* config);
+static int __module_loader_threads_option_load(const json_token_t* token_main, const char* key, unsigned int* value);
+static int __module_loader_priority_weights_load(const json_token_t* token_weights, unsigned int* weights);
 static void __module_loader_on_shutdown_cb(void);
+static int __module_loader_servers_match(server_t* server, server_t* staged);
+static void __module_loader_routeloader_free(void* lib);
 static map_t* __module_loader_ratelimits_configs_load(const json_token_t* token_object);
 static ratelimiter_config_t* __module_loader_ratelimits_config_load(const json_token_t* token_object);
+static filecache_t* __module_loader_filecache_load(const json_token_t* token_object);
 static int __module_loader_http_ratelimit_load(const json_token_t* token_string, ratelimiter_t** ratelimiter, map_t* ratelimits_config);
 static int __module_loader_websockets_ratelimit_load(const json_token_t* token_string, ratelimiter_t** ratelimiter, map_t* ratelimits_config);
 
@@ -199,6 +240,21 @@ int __module_loader_init_modules(appconfig_t* config, json_doc_t* document) {
     if (!module_loader_config_load(config, document))
         goto failed;
 
+    // Фоновый поток журнала запускается после daemon(), иначе он не переживёт fork
+    if (!log_async_start(config->env.main.log.file))
+        log_error("__module_loader_init_modules: log_async_start error\n");
+
+    const env_access_log_t* access_log = &config->env.main.access_log;
+    if (!accesslog_start(access_log->file, access_log->rotate_size, access_log->rotate_interval))
+        log_error("__module_loader_init_modules: accesslog_start error\n");
+
+    memstat_reset_limits();
+    for (int i = 0; i <= MEMSTAT_TOTAL; i++)
+        memstat_set_limit(i, config->env.main.memory_limits[i]);
+
+    // Сокеты старого процесса должны быть в запасе до запуска воркеров
+    handoff_receive(config->env.main.handoff_socket);
+
     if (config->server_chain && config->server_chain->server)
         http_server_init_sni_callbacks(config->server_chain->server);
 
@@ -208,6 +264,8 @@ int __module_loader_init_modules(appconfig_t* config, json_doc_t* document) {
         goto failed;
     if (!__module_loader_thread_handlers_load(config))
         goto failed;
+    if (!handoff_complete(config->env.main.handoff_socket))
+        goto failed;
 
     result = 1;
 
@@ -292,6 +350,61 @@ int module_loader_config_load(appconfig_t* config, json_doc_t* document) {
     }
     env->main.threads = threads_count;
 
+    // Необязательные границы эластичного пула: без threads_max пул фиксирован
+    env->main.threads_max = threads_count;
+    const json_token_t* token_threads_max = json_object_get(token_main, "threads_max");
+    if (token_threads_max != NULL) {
+        ok = 0;
+        const int threads_max = json_int(token_threads_max, &ok);
+        if (!json_is_number(token_threads_max) || !ok || threads_max < threads_count) {
+            __module_loader_config_error("module_loader_config_load: threads_max must be int >= threads\n");
+            return 0;
+        }
+        env->main.threads_max = threads_max;
+    }
+
+    if (!__module_loader_threads_option_load(token_main, "threads_queue_depth", &env->main.threads_queue_depth))
+        return 0;
+    if (!__module_loader_threads_option_load(token_main, "threads_queue_wait", &env->main.threads_queue_wait))
+        return 0;
+    if (!__module_loader_threads_option_load(token_main, "threads_idle_timeout", &env->main.threads_idle_timeout))
+        return 0;
+
+    if (!__module_loader_priority_weights_load(json_object_get(token_main, "priority_weights"), env->main.priority_weights))
+        return 0;
+
+    // Бюджет ожидания запроса в очереди обработчиков, мс (0 - без ограничения)
+    const json_token_t* token_queue_wait_budget = json_object_get(token_main, "queue_wait_budget");
+    if (token_queue_wait_budget != NULL) {
+        ok = 0;
+        const int queue_wait_budget = json_int(token_queue_wait_budget, &ok);
+        if (!json_is_number(token_queue_wait_budget) || !ok || queue_wait_budget < 0) {
+            __module_loader_config_error("module_loader_config_load: queue_wait_budget must be int >= 0\n");
+            return 0;
+        }
+        env->main.queue_wait_budget = queue_wait_budget;
+    }
+
+    // Путь unix-сокета для передачи слушающих сокетов новому процессу при обновлении
+    const json_token_t* token_handoff_socket = json_object_get(token_main, "handoff_socket");
+    if (token_handoff_socket != NULL) {
+        if (!json_is_string(token_handoff_socket) || json_string_size(token_handoff_socket) == 0) {
+            __module_loader_config_error("module_loader_config_load: handoff_socket must be not empty string\n");
+            return 0;
+        }
+        if (json_string_size(token_handoff_socket) >= sizeof(((struct sockaddr_un*)0)->sun_path)) {
+            __module_loader_config_error("module_loader_config_load: handoff_socket path is too long\n");
+            return 0;
+        }
+
+        env->main.handoff_socket = malloc(sizeof(char) * (json_string_size(token_handoff_socket) + 1));
+        if (env->main.handoff_socket == NULL) {
+            __module_loader_config_error("module_loader_config_load: alloc memory for handoff_socket failed\n");
+            return 0;
+        }
+        strcpy(env->main.handoff_socket, json_string(token_handoff_socket));
+    }
+
 
     const json_token_t* token_client_max_body_size = json_object_get(token_main, "client_max_body_size");
     if (token_client_max_body_size == NULL) {
@@ -350,37 +463,12 @@ int module_loader_config_load(appconfig_t* config, json_doc_t* document) {
         return 0;
     }
     for (; !json_end_it(&it); it = json_next_it(&it)) {
-        const json_token_t* token_mimetype = json_it_value(&it);
-        if (!json_is_string(token_mimetype)) {
-            __module_loader_config_error("module_loader_config_load: gzip must be array of strings\n");
-            __free_gzip_list(env->main.gzip);
-            env->main.gzip = NULL;
-            return 0;
-        }
-        if (json_string_size(token_mimetype) == 0) {
-            __module_loader_config_error("module_loader_config_load: gzip item must be not empty\n");
-            __free_gzip_list(env->main.gzip);
-            env->main.gzip = NULL;
-            return 0;
-        }
-
-        env_gzip_str_t* str = malloc(sizeof * str);
+        env_gzip_str_t* str = __module_loader_gzip_item_load(json_it_value(&it));
         if (str == NULL) {
-            log_error("module_loader_config_load: memory alloc error for gzip item\n");
-            __free_gzip_list(env->main.gzip);
-            env->main.gzip = NULL;
-            return 0;
-        }
-        str->next = NULL;
-        str->mimetype = malloc(sizeof(char) * (json_string_size(token_mimetype) + 1));
-        if (str->mimetype == NULL) {
-            log_error("module_loader_config_load: memory alloc error for gzip item value\n");
-            free(str);
             __free_gzip_list(env->main.gzip);
             env->main.gzip = NULL;
             return 0;
         }
-        strcpy(str->mimetype, json_string(token_mimetype));
 
         if (env->main.gzip == NULL)
             env->main.gzip = str;
@@ -391,6 +479,18 @@ int module_loader_config_load(appconfig_t* config, json_doc_t* document) {
         last_gzip_item = str;
     }
 
+    env->main.gzip_min_length = ENV_GZIP_MIN_LENGTH_DEFAULT;
+    const json_token_t* token_gzip_min_length = json_object_get(token_main, "gzip_min_length");
+    if (token_gzip_min_length != NULL) {
+        ok = 0;
+        const int gzip_min_length = json_int(token_gzip_min_length, &ok);
+        if (!json_is_number(token_gzip_min_length) || !ok || gzip_min_length < 0) {
+            __module_loader_config_error("module_loader_config_load: gzip_min_length must be int >= 0\n");
+            goto failed;
+        }
+        env->main.gzip_min_length = gzip_min_length;
+    }
+
 
     const json_token_t* token_log = json_object_get(token_main, "log");
     if (token_log == NULL) {
@@ -452,6 +552,93 @@ int module_loader_config_load(appconfig_t* config, json_doc_t* document) {
         goto failed;
     }
 
+    const json_token_t* token_log_file = json_object_get(token_log, "file");
+    if (token_log_file != NULL) {
+        if (!json_is_string(token_log_file) || json_string_size(token_log_file) == 0) {
+            __module_loader_config_error("module_loader_config_load: log.file must be not empty string\n");
+            goto failed;
+        }
+
+        env->main.log.file = malloc(sizeof(char) * (json_string_size(token_log_file) + 1));
+        if (env->main.log.file == NULL) {
+            __module_loader_config_error("module_loader_config_load: alloc memory for log.file failed\n");
+            goto failed;
+        }
+        strcpy(env->main.log.file, json_string(token_log_file));
+    }
+
+
+    const json_token_t* token_access_log = json_object_get(token_main, "access_log");
+    if (token_access_log != NULL) {
+        if (!json_is_object(token_access_log)) {
+            __module_loader_config_error("module_loader_config_load: access_log must be object\n");
+            goto failed;
+        }
+
+        const json_token_t* token_access_log_file = json_object_get(token_access_log, "file");
+        if (token_access_log_file == NULL || !json_is_string(token_access_log_file) || json_string_size(token_access_log_file) == 0) {
+            __module_loader_config_error("module_loader_config_load: access_log.file must be not empty string\n");
+            goto failed;
+        }
+
+        env->main.access_log.file = malloc(sizeof(char) * (json_string_size(token_access_log_file) + 1));
+        if (env->main.access_log.file == NULL) {
+            __module_loader_config_error("module_loader_config_load: alloc memory for access_log.file failed\n");
+            goto failed;
+        }
+        strcpy(env->main.access_log.file, json_string(token_access_log_file));
+
+        const json_token_t* token_rotate_size = json_object_get(token_access_log, "rotate_size");
+        if (token_rotate_size != NULL) {
+            ok = 0;
+            const long long rotate_size = json_llong(token_rotate_size, &ok);
+            if (!json_is_number(token_rotate_size) || !ok || rotate_size < 0) {
+                __module_loader_config_error("module_loader_config_load: access_log.rotate_size must be int >= 0\n");
+                goto failed;
+            }
+            env->main.access_log.rotate_size = (size_t)rotate_size;
+        }
+
+        const json_token_t* token_rotate_interval = json_object_get(token_access_log, "rotate_interval");
+        if (token_rotate_interval != NULL) {
+            ok = 0;
+            const int rotate_interval = json_int(token_rotate_interval, &ok);
+            if (!json_is_number(token_rotate_interval) || !ok || rotate_interval < 0) {
+                __module_loader_config_error("module_loader_config_load: access_log.rotate_interval must be int >= 0\n");
+                goto failed;
+            }
+            env->main.access_log.rotate_interval = (unsigned int)rotate_interval;
+        }
+    }
+
+
+    const json_token_t* token_memory_limits = json_object_get(token_main, "memory_limits");
+    if (token_memory_limits != NULL) {
+        if (!json_is_object(token_memory_limits)) {
+            __module_loader_config_error("module_loader_config_load: memory_limits must be object\n");
+            goto failed;
+        }
+
+        for (json_it_t it = json_init_it(token_memory_limits); !json_end_it(&it); it = json_next_it(&it)) {
+            const char* key = json_it_key(&it);
+            const json_token_t* value = json_it_value(&it);
+
+            const int subsystem = memstat_find(key);
+            if (subsystem == -1) {
+                __module_loader_config_error("module_loader_config_load: memory_limits.%s unknown subsystem\n", key);
+                goto failed;
+            }
+
+            ok = 0;
+            const long long limit = json_llong(value, &ok);
+            if (!json_is_number(value) || !ok || limit < 0) {
+                __module_loader_config_error("module_loader_config_load: memory_limits.%s must be int >= 0\n", key);
+                goto failed;
+            }
+            env->main.memory_limits[subsystem] = (size_t)limit;
+        }
+    }
+
 
     const json_token_t* token_env = json_object_get(token_main, "env");
     if (token_env != NULL) {
@@ -501,6 +688,8 @@ int module_loader_config_load(appconfig_t* config, json_doc_t* document) {
         goto failed;
     if (!__module_loader_sessionconfig_load(config, json_object_get(root, "sessions")))
         goto failed;
+    if (!__module_loader_keyed_ratelimits_load(config, json_object_get(root, "ratelimits")))
+        goto failed;
     if (!__module_loader_taskmanager_init(config, json_object_get(root, "task_manager")))
         goto failed;
     if (!__module_loader_translations_load(config, json_object_get(root, "translations")))
@@ -666,6 +855,9 @@ int __module_loader_servers_load(appconfig_t* config, const json_token_t* token_
 
         last_server = server;
 
+        // Снимок ещё не опубликован: читателей нет, заполняем напрямую
+        server_routing_t* routing = server_routing(server);
+
         server->broadcast = broadcast_init();
         if (server->broadcast == NULL) {
             log_error("__module_loader_servers_load: can't create broadcast\n");
@@ -769,6 +961,74 @@ int __module_loader_servers_load(appconfig_t* config, const json_token_t* token_
             }
         }
 
+        const json_token_t* token_metrics = json_object_get(token_server, "metrics");
+        if (token_metrics != NULL) {
+            if (!json_is_string(token_metrics) || json_string(token_metrics)[0] != '/') {
+                __module_loader_config_error("__module_loader_servers_load: metrics must be path string\n");
+                goto failed;
+            }
+
+            const size_t value_length = json_string_size(token_metrics);
+
+            server->metrics_path = malloc(value_length + 1);
+            if (server->metrics_path == NULL) {
+                log_error("__module_loader_servers_load: can't alloc memory for metrics path\n");
+                goto failed;
+            }
+
+            strcpy(server->metrics_path, json_string(token_metrics));
+            server->metrics_path_length = value_length;
+        }
+
+        const json_token_t* token_profiler = json_object_get(token_server, "profiler");
+        if (token_profiler != NULL) {
+            if (!json_is_string(token_profiler) || json_string(token_profiler)[0] != '/') {
+                __module_loader_config_error("__module_loader_servers_load: profiler must be path string\n");
+                goto failed;
+            }
+
+            const size_t value_length = json_string_size(token_profiler);
+
+            server->profiler_path = malloc(value_length + 1);
+            if (server->profiler_path == NULL) {
+                log_error("__module_loader_servers_load: can't alloc memory for profiler path\n");
+                goto failed;
+            }
+
+            strcpy(server->profiler_path, json_string(token_profiler));
+            server->profiler_path_length = value_length;
+        }
+
+        const json_token_t* token_server_timing = json_object_get(token_server, "server_timing");
+        if (token_server_timing != NULL) {
+            if (!json_is_bool(token_server_timing)) {
+                __module_loader_config_error("__module_loader_servers_load: server_timing must be boolean\n");
+                goto failed;
+            }
+
+            server->server_timing = json_bool(token_server_timing);
+        }
+
+        // Поиск копий стоит до трёх open() на запрос, если open_file_cache не запоминает промахи
+        const json_token_t* token_precompressed = json_object_get(token_server, "precompressed");
+        if (token_precompressed != NULL) {
+            if (!json_is_bool(token_precompressed)) {
+                __module_loader_config_error("__module_loader_servers_load: precompressed must be boolean\n");
+                goto failed;
+            }
+
+            server->precompressed = json_bool(token_precompressed);
+        }
+
+        const json_token_t* token_open_file_cache = json_object_get(token_server, "open_file_cache");
+        if (token_open_file_cache != NULL) {
+            server->filecache = __module_loader_filecache_load(token_open_file_cache);
+            if (server->filecache == NULL) {
+                log_error("__module_loader_servers_load: can't load open_file_cache\n");
+                goto failed;
+            }
+        }
+
         const json_token_t* token_ratelimits = json_object_get(token_server, "ratelimits");
         if (token_ratelimits != NULL) {
             finded_fields[RATELIMITS] = 1;
@@ -794,19 +1054,19 @@ int __module_loader_servers_load(appconfig_t* config, const json_token_t* token_
                 goto failed;
             }
 
-            if (!__module_loader_http_ratelimit_load(json_object_get(token_http, "ratelimit"), &server->http.ratelimiter, server->ratelimits_config)) {
+            if (!__module_loader_http_ratelimit_load(json_object_get(token_http, "ratelimit"), &routing->http.ratelimiter, server->ratelimits_config)) {
                 log_error("__module_loader_servers_load: can't load routes\n");
                 goto failed;
             }
-            if (!__module_loader_http_routes_load(&first_lib, json_object_get(token_http, "routes"), &server->http.route, server->ratelimits_config)) {
+            if (!__module_loader_http_routes_load(&first_lib, json_object_get(token_http, "routes"), &routing->http.route, server->ratelimits_config)) {
                 log_error("__module_loader_servers_load: can't load routes\n");
                 goto failed;
             }
-            if (!__module_loader_http_redirects_load(json_object_get(token_http, "redirects"), &server->http.redirect)) {
+            if (!__module_loader_http_redirects_load(json_object_get(token_http, "redirects"), &routing->http.redirect)) {
                 log_error("__module_loader_servers_load: can't load redirects\n");
                 goto failed;
             }
-            if (!__module_loader_middlewares_load(json_object_get(token_http, "middlewares"), &server->http.middleware)) {
+            if (!__module_loader_middlewares_load(json_object_get(token_http, "middlewares"), &routing->http.middleware)) {
                 log_error("__module_loader_servers_load: can't load middlewares\n");
                 goto failed;
             }
@@ -821,19 +1081,19 @@ int __module_loader_servers_load(appconfig_t* config, const json_token_t* token_
                 goto failed;
             }
 
-            if (!__module_loader_websockets_default_load(&server->websockets.default_handler, &first_lib, json_object_get(token_websockets, "default"), server->ratelimits_config)) {
+            if (!__module_loader_websockets_default_load(&routing->websockets.default_handler, &first_lib, json_object_get(token_websockets, "default"), server->ratelimits_config)) {
                 log_error("__module_loader_servers_load: can't load default handler\n");
                 goto failed;
             }
-            if (!__module_loader_websockets_ratelimit_load(json_object_get(token_websockets, "ratelimit"), &server->websockets.ratelimiter, server->ratelimits_config)) {
+            if (!__module_loader_websockets_ratelimit_load(json_object_get(token_websockets, "ratelimit"), &routing->websockets.ratelimiter, server->ratelimits_config)) {
                 log_error("__module_loader_servers_load: can't load routes\n");
                 goto failed;
             }
-            if (!__module_loader_websockets_routes_load(&first_lib, json_object_get(token_websockets, "routes"), &server->websockets.route, server->ratelimits_config)) {
+            if (!__module_loader_websockets_routes_load(&first_lib, json_object_get(token_websockets, "routes"), &routing->websockets.route, server->ratelimits_config)) {
                 log_error("__module_loader_servers_load: can't load routes\n");
                 goto failed;
             }
-            if (!__module_loader_middlewares_load(json_object_get(token_websockets, "middlewares"), &server->websockets.middleware)) {
+            if (!__module_loader_middlewares_load(json_object_get(token_websockets, "middlewares"), &routing->websockets.middleware)) {
                 log_error("__module_loader_servers_load: can't load middlewares\n");
                 goto failed;
             }
@@ -871,7 +1131,7 @@ int __module_loader_servers_load(appconfig_t* config, const json_token_t* token_
         }
 
         if (finded_fields[WEBSOCKETS] == 0)
-            server->websockets.default_handler = (void(*)(void*))websockets_default_handler;
+            routing->websockets.default_handler = (void(*)(void*))websockets_default_handler;
 
         if (!__module_loader_check_unique_domainport(first_server)) {
             __module_loader_config_error("__module_loader_servers_load: domains with ports must be unique\n");
@@ -1296,6 +1556,151 @@ int __module_loader_sessionconfig_load(appconfig_t* config, const json_token_t*
     return 0;
 }
 
+/*
+ * Лимиты по произвольному ключу (API-ключ, пользователь), доступные
+ * middleware через ratelimit_allow(name, key):
+ * "ratelimits": {"api": {"driver": "redis", "host_id": "redis.main",
+ *                "burst": 100, "rate": 10, "lease": 10, "idle_timeout": 60}}
+ * driver "memory" держит лимит в процессе, "redis" - общий для всех узлов.
+ */
+int __module_loader_keyed_ratelimits_load(appconfig_t* config, const json_token_t* token_object) {
+    if (token_object == NULL) return 1;
+    if (!json_is_object(token_object)) {
+        __module_loader_config_error("__module_loader_keyed_ratelimits_load: ratelimits must be object\n");
+        return 0;
+    }
+
+    config->ratelimits = map_create_ex(map_compare_string, map_copy_string, free, NULL, (map_free_fn)ratelimit_free);
+    if (config->ratelimits == NULL) {
+        log_error("__module_loader_keyed_ratelimits_load: can't create ratelimits map\n");
+        return 0;
+    }
+
+    for (json_it_t it = json_init_it(token_object); !json_end_it(&it); json_next_it(&it)) {
+        const char* name = json_it_key(&it);
+
+        ratelimit_t* limiter = __module_loader_keyed_ratelimit_load(config, name, json_it_value(&it));
+        if (limiter == NULL)
+            goto failed;
+
+        if (map_insert(config->ratelimits, name, limiter) == -1) {
+            log_error("__module_loader_keyed_ratelimits_load: can't insert ratelimits.%s\n", name);
+            ratelimit_free(limiter);
+            goto failed;
+        }
+    }
+
+    return 1;
+
+    failed:
+
+    map_free(config->ratelimits);
+    config->ratelimits = NULL;
+
+    return 0;
+}
+
+ratelimit_t* __module_loader_keyed_ratelimit_load(appconfig_t* appconfig, const char* name, const json_token_t* token_object) {
+    if (!json_is_object(token_object)) {
+        __module_loader_config_error("__module_loader_keyed_ratelimit_load: ratelimits.%s must be object\n", name);
+        return NULL;
+    }
+
+    ratelimitconfig_t config = {
+        .burst = 0,
+        .rate = 0,
+        .lease = 10,
+        .idle_timeout_s = 60,
+        .host_id = ""
+    };
+
+    int ok = 0;
+    const int burst = json_int(json_object_get(token_object, "burst"), &ok);
+    if (!ok || burst < 1) {
+        __module_loader_config_error("__module_loader_keyed_ratelimit_load: ratelimits.%s.burst must be integer >= 1\n", name);
+        return NULL;
+    }
+    config.burst = burst;
+
+    const int rate = json_int(json_object_get(token_object, "rate"), &ok);
+    if (!ok || rate < 1) {
+        __module_loader_config_error("__module_loader_keyed_ratelimit_load: ratelimits.%s.rate must be integer >= 1\n", name);
+        return NULL;
+    }
+    config.rate = rate;
+
+    const json_token_t* token_lease = json_object_get(token_object, "lease");
+    if (token_lease != NULL) {
+        const int lease = json_int(token_lease, &ok);
+        if (!ok || lease < 1) {
+            __module_loader_config_error("__module_loader_keyed_ratelimit_load: ratelimits.%s.lease must be integer >= 1\n", name);
+            return NULL;
+        }
+        config.lease = lease;
+    }
+
+    // Аренда больше bucket'а никогда не выдаётся целиком
+    if (config.lease > config.burst)
+        config.lease = config.burst;
+
+    const json_token_t* token_idle_timeout = json_object_get(token_object, "idle_timeout");
+    if (token_idle_timeout != NULL) {
+        const int idle_timeout = json_int(token_idle_timeout, &ok);
+        if (!ok || idle_timeout < 1) {
+            __module_loader_config_error("__module_loader_keyed_ratelimit_load: ratelimits.%s.idle_timeout must be integer >= 1\n", name);
+            return NULL;
+        }
+        config.idle_timeout_s = idle_timeout;
+    }
+
+    const json_token_t* token_driver = json_object_get(token_object, "driver");
+    const char* driver = "memory";
+    if (token_driver != NULL) {
+        if (!json_is_string(token_driver)) {
+            __module_loader_config_error("__module_loader_keyed_ratelimit_load: ratelimits.%s.driver must be string\n", name);
+            return NULL;
+        }
+        driver = json_string(token_driver);
+    }
+
+    ratelimitstore_t* store = NULL;
+
+    if (strcmp(driver, "redis") == 0) {
+        const json_token_t* token_host_id = json_object_get(token_object, "host_id");
+        if (!json_is_string(token_host_id) || json_string_size(token_host_id) == 0) {
+            __module_loader_config_error("__module_loader_keyed_ratelimit_load: ratelimits.%s.host_id must be not empty string\n", name);
+            return NULL;
+        }
+        if (json_string_size(token_host_id) >= sizeof(config.host_id)) {
+            __module_loader_config_error("__module_loader_keyed_ratelimit_load: ratelimits.%s.host_id is too long\n", name);
+            return NULL;
+        }
+        strcpy(config.host_id, json_string(token_host_id));
+
+        // С опечаткой в host_id каждая аренда бы не удавалась и лимит не действовал
+        if (!__module_loader_redis_host_exists(appconfig, config.host_id)) {
+            __module_loader_config_error("__module_loader_keyed_ratelimit_load: ratelimits.%s.host_id %s is not a redis database from databases\n", name, config.host_id);
+            return NULL;
+        }
+
+        store = ratelimitredis_init();
+        if (store == NULL) {
+            log_error("__module_loader_keyed_ratelimit_load: can't create redis store for %s\n", name);
+            return NULL;
+        }
+    }
+    else if (strcmp(driver, "memory") != 0) {
+        __module_loader_config_error("__module_loader_keyed_ratelimit_load: unknown driver %s in ratelimits.%s\n", driver, name);
+        return NULL;
+    }
+
+    ratelimit_t* limiter = ratelimit_create(name, &config, store);
+    if (limiter == NULL)
+        log_error("__module_loader_keyed_ratelimit_load: can't create ratelimit %s\n", name);
+
+    return limiter;
+}
+
 int __module_loader_http_routes_load(routeloader_lib_t** first_lib, const json_token_t* token_object, route_t** route, map_t* ratelimiter_config) {
     int result = 0;
     route_t* first_route = NULL;
@@ -1385,6 +1790,28 @@ int __module_loader_set_http_route(routeloader_lib_t** first_lib, routeloader_li
             return 0;
         }
 
+        const json_token_t* token_priority = json_object_get(token_item, "priority");
+        if (token_priority != NULL) {
+            if (!json_is_string(token_priority) || !route_set_priority(route, method, json_string(token_priority))) {
+                __module_loader_config_error("__module_loader_set_http_route: http.route item.value.priority must be high, normal or low\n");
+                return 0;
+            }
+        }
+
+        const json_token_t* token_max_in_flight = json_object_get(token_item, "max_in_flight");
+        if (token_max_in_flight != NULL) {
+            int ok = 0;
+            const int max_in_flight = json_int(token_max_in_flight, &ok);
+            if (!json_is_number(token_max_in_flight) || !ok || max_in_flight < 1) {
+                __module_loader_config_error("__module_loader_set_http_route: http.route item.value.max_in_flight must be int >= 1\n");
+                return 0;
+            }
+            if (!route_set_max_in_flight(route, method, max_in_flight)) {
+                log_error("__module_loader_set_http_route: failed to set max_in_flight\n");
+                return 0;
+            }
+        }
+
         const json_token_t* token_ratelimit = json_object_get(token_item, "ratelimit");
         ratelimiter_t* ratelimiter = NULL;
         if (token_ratelimit != NULL) {
@@ -1851,6 +2278,91 @@ void module_loader_create_config_and_init(void) {
     module_loader_init(newconfig);
 }
 
+/*
+ * Горячая замена маршрутизации: конфигурация разбирается целиком, но
+ * из неё берутся только снимки маршрутизации серверов и библиотеки
+ * обработчиков. Потоки и соединения продолжают работать, запросы,
+ * начатые на старом снимке, завершаются на нём.
+ */
+int module_loader_routes_reload(void) {
+    appconfig_t* config = appconfig();
+    if (config == NULL || config->server_chain == NULL) {
+        log_error("module_loader_routes_reload: config is not loaded\n");
+        return 0;
+    }
+
+    int result = 0;
+    json_doc_t* document = NULL;
+    appconfig_t* staged = NULL;
+
+    if (!module_loader_load_json_config(appconfig_path(), &document))
+        goto failed;
+
+    staged = appconfig_create(appconfig_path());
+    if (staged == NULL) {
+        log_error("module_loader_routes_reload: can't create config\n");
+        goto failed;
+    }
+
+    if (!module_loader_config_load(staged, document))
+        goto failed;
+
+    server_chain_t* chain = config->server_chain;
+    if (!__module_loader_servers_match(chain->server, staged->server_chain->server)) {
+        log_error("module_loader_routes_reload: servers changed, full reload required (SIGUSR1)\n");
+        goto failed;
+    }
+
+    pthread_mutex_lock(&chain->mutex);
+
+    server_t* staged_server = staged->server_chain->server;
+    for (server_t* server = chain->server; server != NULL; server = server->next) {
+        server_routing_publish(server, atomic_exchange(&staged_server->routing, NULL));
+        staged_server = staged_server->next;
+    }
+
+    // Обработчики старых снимков находятся в старых библиотеках
+    server_routing_retire(chain->routeloader, __module_loader_routeloader_free);
+    chain->routeloader = staged->server_chain->routeloader;
+    staged->server_chain->routeloader = NULL;
+
+    pthread_mutex_unlock(&chain->mutex);
+
+    log_info("module_loader_routes_reload: routes reloaded\n");
+
+    result = 1;
+
+    failed:
+
+    appconfig_free(staged);
+    json_free(document);
+
+    return result;
+}
+
+// Снимок переносится в сервер с тем же адресом и доменами, остальное требует полной перезагрузки
+int __module_loader_servers_match(server_t* server, server_t* staged) {
+    for (; server != NULL && staged != NULL; server = server->next, staged = staged->next) {
+        if (server->ip != staged->ip || server->port != staged->port)
+            return 0;
+
+        domain_t* domain = server->domain;
+        domain_t* staged_domain = staged->domain;
+        for (; domain != NULL && staged_domain != NULL; domain = domain->next, staged_domain = staged_domain->next)
+            if (strcmp(domain->template, staged_domain->template) != 0)
+                return 0;
+
+        if (domain != NULL || staged_domain != NULL)
+            return 0;
+    }
+
+    return server == NULL && staged == NULL;
+}
+
+void __module_loader_routeloader_free(void* lib) {
+    routeloader_free(lib);
+}
+
 void __module_loader_on_shutdown_cb(void) {
     atomic_store(&appconfig()->shutdown, 1);
     module_loader_wakeup_all_threads();
@@ -1946,6 +2458,133 @@ ratelimiter_config_t* __module_loader_ratelimits_config_load(const json_token_t*
     return config;
 }
 
+filecache_t* __module_loader_filecache_load(const json_token_t* token_object) {
+    if (!json_is_object(token_object)) {
+        __module_loader_config_error("__module_loader_filecache_load: open_file_cache must be object\n");
+        return NULL;
+    }
+
+    filecache_config_t config = {
+        .max_entries = 1024,
+        .valid_s = 30,
+        .content_max_size = 1024 * 1024,
+        .content_memory = 64 * 1024 * 1024
+    };
+
+    int ok = 0;
+    const json_token_t* token_max = json_object_get(token_object, "max");
+    if (token_max != NULL) {
+        const int max = json_int(token_max, &ok);
+        if (!ok || max < 1) {
+            __module_loader_config_error("__module_loader_filecache_load: open_file_cache.max must be integer >= 1\n");
+            return NULL;
+        }
+        config.max_entries = max;
+    }
+
+    const json_token_t* token_valid = json_object_get(token_object, "valid");
+    if (token_valid != NULL) {
+        const int valid = json_int(token_valid, &ok);
+        if (!ok || valid < 1) {
+            __module_loader_config_error("__module_loader_filecache_load: open_file_cache.valid must be integer >= 1\n");
+            return NULL;
+        }
+        config.valid_s = valid;
+    }
+
+    const json_token_t* token_content_max_size = json_object_get(token_object, "content_max_size");
+    if (token_content_max_size != NULL) {
+        const int content_max_size = json_int(token_content_max_size, &ok);
+        if (!ok || content_max_size < 1) {
+            __module_loader_config_error("__module_loader_filecache_load: open_file_cache.content_max_size must be integer >= 1\n");
+            return NULL;
+        }
+        config.content_max_size = content_max_size;
+    }
+
+    // 0 выключает хранение содержимого файлов в памяти
+    const json_token_t* token_content_memory = json_object_get(token_object, "content_memory");
+    if (token_content_memory != NULL) {
+        const int content_memory = json_int(token_content_memory, &ok);
+        if (!ok || content_memory < 0) {
+            __module_loader_config_error("__module_loader_filecache_load: open_file_cache.content_memory must be integer >= 0\n");
+            return NULL;
+        }
+        config.content_memory = content_memory;
+    }
+
+    filecache_t* cache = filecache_create(&config);
+    if (cache == NULL)
+        log_error("__module_loader_filecache_load: can't create open file cache\n");
+
+    return cache;
+}
+
+/*
+ * Элемент main.gzip: строка mimetype или объект
+ * {"mimetype": "text/css", "gzip": 6, "br": 5, "zstd": 3}
+ * с уровнями сжатия для каждой кодировки.
+ */
+env_gzip_str_t* __module_loader_gzip_item_load(const json_token_t* token_item) {
+    const json_token_t* token_mimetype = token_item;
+    if (json_is_object(token_item))
+        token_mimetype = json_object_get(token_item, "mimetype");
+
+    if (token_mimetype == NULL || !json_is_string(token_mimetype)) {
+        __module_loader_config_error("module_loader_config_load: gzip item must be string or object with mimetype\n");
+        return NULL;
+    }
+    if (json_string_size(token_mimetype) == 0) {
+        __module_loader_config_error("module_loader_config_load: gzip item must be not empty\n");
+        return NULL;
+    }
+
+    env_gzip_str_t* str = malloc(sizeof * str);
+    if (str == NULL) {
+        log_error("module_loader_config_load: memory alloc error for gzip item\n");
+        return NULL;
+    }
+    str->next = NULL;
+    str->gzip_level = ENV_GZIP_LEVEL_DEFAULT;
+    str->brotli_level = ENV_BROTLI_LEVEL_DEFAULT;
+    str->zstd_level = ENV_ZSTD_LEVEL_DEFAULT;
+    str->mimetype = malloc(sizeof(char) * (json_string_size(token_mimetype) + 1));
+    if (str->mimetype == NULL) {
+        log_error("module_loader_config_load: memory alloc error for gzip item value\n");
+        free(str);
+        return NULL;
+    }
+    strcpy(str->mimetype, json_string(token_mimetype));
+
+    if (json_is_object(token_item)) {
+        if (!__module_loader_gzip_level_load(token_item, "gzip", 1, 9, &str->gzip_level) ||
+            !__module_loader_gzip_level_load(token_item, "br", 0, 11, &str->brotli_level) ||
+            !__module_loader_gzip_level_load(token_item, "zstd", 1, 19, &str->zstd_level)) {
+            free(str->mimetype);
+            free(str);
+            return NULL;
+        }
+    }
+
+    return str;
+}
+
+int __module_loader_gzip_level_load(const json_token_t* token_item, const char* key, int min, int max, int* level) {
+    const json_token_t* token_level = json_object_get(token_item, key);
+    if (token_level == NULL) return 1;
+
+    int ok = 0;
+    const int value = json_int(token_level, &ok);
+    if (!ok || value < min || value > max) {
+        __module_loader_config_error("module_loader_config_load: gzip item %s level must be integer %d..%d\n", key, min, max);
+        return 0;
+    }
+
+    *level = value;
+
+    return 1;
+}
+
 int __module_loader_http_ratelimit_load(const json_token_t* token_string, ratelimiter_t** ratelimiter, map_t* ratelimits_config) {
     *ratelimiter = NULL;
 
@@ -2236,6 +2875,42 @@ openssl_t* __module_loader_tls_load(const json_token_t* token_object) {
 
             strcpy(openssl->ciphers, json_string(token_value));
         }
+        else if (strcmp(key, "session_tickets") == 0) {
+            if (!json_is_bool(token_value)) {
+                __module_loader_config_error("__module_loader_tls_load: field session_tickets must be bool type\n");
+                goto failed;
+            }
+
+            openssl->session_tickets = json_bool(token_value);
+        }
+        else if (strcmp(key, "session_cache") == 0) {
+            int ok = 0;
+            const int session_cache = json_int(token_value, &ok);
+            if (!json_is_number(token_value) || !ok || session_cache < 0) {
+                __module_loader_config_error("__module_loader_tls_load: field session_cache must be int >= 0\n");
+                goto failed;
+            }
+
+            openssl->session_cache = session_cache;
+        }
+        else if (strcmp(key, "session_timeout") == 0) {
+            int ok = 0;
+            const int session_timeout = json_int(token_value, &ok);
+            if (!json_is_number(token_value) || !ok || session_timeout < 1) {
+                __module_loader_config_error("__module_loader_tls_load: field session_timeout must be int >= 1\n");
+                goto failed;
+            }
+
+            openssl->session_timeout = session_timeout;
+        }
+        else if (strcmp(key, "handshake_offload") == 0) {
+            if (!json_is_bool(token_value)) {
+                __module_loader_config_error("__module_loader_tls_load: field handshake_offload must be bool type\n");
+                goto failed;
+            }
+
+            openssl->handshake_offload = json_bool(token_value);
+        }
     }
 
     for (int i = 0; i < FIELDS_COUNT; i++) {
@@ -2296,6 +2971,54 @@ int __module_loader_thread_workers_load(appconfig_t* config) {
     return thread_worker_run(config, count);
 }
 
+int __module_loader_threads_option_load(const json_token_t* token_main, const char* key, unsigned int* value) {
+    const json_token_t* token = json_object_get(token_main, key);
+    if (token == NULL)
+        return 1;
+
+    int ok = 0;
+    const int number = json_int(token, &ok);
+    if (!json_is_number(token) || !ok || number < 1) {
+        __module_loader_config_error("module_loader_config_load: %s must be int >= 1\n", key);
+        return 0;
+    }
+
+    *value = number;
+
+    return 1;
+}
+
+int __module_loader_priority_weights_load(const json_token_t* token_weights, unsigned int* weights) {
+    weights[ROUTE_PRIORITY_HIGH] = CONNECTION_QUEUE_WEIGHT_HIGH;
+    weights[ROUTE_PRIORITY_NORMAL] = CONNECTION_QUEUE_WEIGHT_NORMAL;
+    weights[ROUTE_PRIORITY_LOW] = CONNECTION_QUEUE_WEIGHT_LOW;
+
+    if (token_weights == NULL)
+        return 1;
+
+    if (!json_is_object(token_weights)) {
+        __module_loader_config_error("module_loader_config_load: priority_weights must be object\n");
+        return 0;
+    }
+
+    const char* names[ROUTE_PRIORITY_COUNT] = { "high", "normal", "low" };
+    for (int i = 0; i < ROUTE_PRIORITY_COUNT; i++) {
+        const json_token_t* token = json_object_get(token_weights, names[i]);
+        if (token == NULL) continue;
+
+        int ok = 0;
+        const int weight = json_int(token, &ok);
+        if (!json_is_number(token) || !ok || weight < 1) {
+            __module_loader_config_error("module_loader_config_load: priority_weights.%s must be int >= 1\n", names[i]);
+            return 0;
+        }
+
+        weights[i] = weight;
+    }
+
+    return 1;
+}
+
 int __module_loader_thread_handlers_load(appconfig_t* config) {
     const int count = config->env.main.threads;
     if (count <= 0) {
@@ -2303,14 +3026,19 @@ int __module_loader_thread_handlers_load(appconfig_t* config) {
         return 0;
     }
 
+    connection_queue_set_weights(config->env.main.priority_weights);
+
     return thread_handler_run(config, count);
 }
 
 int __module_loader_taskmanager_init(appconfig_t* config, json_token_t* token_taskmanager) {
-    if (token_taskmanager == NULL)
+    // Ротация ключей TLS-билетов требует планировщика и без task_manager
+    const int ticket_keys_interval = openssl_ticket_keys_interval();
+
+    if (token_taskmanager == NULL && ticket_keys_interval == 0)
         return 1;
 
-    if (!json_is_array(token_taskmanager)) {
+    if (token_taskmanager != NULL && !json_is_array(token_taskmanager)) {
         __module_loader_config_error("__module_loader_taskmanager_init: task_manager must be array\n");
         return 0;
     }
@@ -2323,6 +3051,15 @@ int __module_loader_taskmanager_init(appconfig_t* config, json_token_t* token_ta
 
     config->taskmanager = manager;
 
+    if (ticket_keys_interval > 0)
+        if (!taskmanager_schedule(manager, "openssl_ticket_keys_rotate", ticket_keys_interval, openssl_ticket_keys_rotate_task)) {
+            log_error("__module_loader_taskmanager_init: failed to schedule ticket keys rotation\n");
+            return 0;
+        }
+
+    if (token_taskmanager == NULL)
+        return 1;
+
     if (!__module_loader_taskmanager_load(config, manager, token_taskmanager)) {
         log_error("__module_loader_taskmanager_init: failed to load scheduled tasks\n");
         return 0;
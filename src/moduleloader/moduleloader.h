@@ -9,6 +9,7 @@ int module_loader_init(appconfig_t* config);
 int module_loader_config_load(appconfig_t* config, json_doc_t* document);
 int module_loader_config_correct(const char* path);
 void module_loader_create_config_and_init(void);
+int module_loader_routes_reload(void);
 void module_loader_wakeup_all_threads(void);
 void module_loader_signal_lock(void);
 void module_loader_signal_unlock(void);
@@ -1,12 +1,83 @@
+#include <pthread.h>
+
+#include "metrics.h"
 #include "multiplexing.h"
 #include "multiplexingepoll.h"
 
+// Циклы событий для метрик: по одному на воркер
+#define MPX_REGISTRY_MAX 256
+
+static pthread_mutex_t __registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static mpxapi_t* __registry[MPX_REGISTRY_MAX] = {0};
+
+static void __mpx_register(mpxapi_t* api);
+static void __mpx_unregister(mpxapi_t* api);
+static void __mpx_metrics(str_t* out);
+
 mpxapi_t* mpx_create() {
-    return mpx_epoll_init();
+    mpxapi_t* api = mpx_epoll_init();
+    if (api == NULL) return NULL;
+
+    __mpx_register(api);
+
+    return api;
 }
 
 void mpx_free(mpxapi_t* api) {
     if (api == NULL) return;
 
+    __mpx_unregister(api);
+
     api->free(api);
 }
+
+int mpx_connection_counts(int* counts, int size) {
+    int count = 0;
+
+    pthread_mutex_lock(&__registry_mutex);
+    for (int i = 0; i < MPX_REGISTRY_MAX && count < size; i++) {
+        if (__registry[i] == NULL) continue;
+
+        counts[count++] = atomic_load(&__registry[i]->connection_count);
+    }
+    pthread_mutex_unlock(&__registry_mutex);
+
+    return count;
+}
+
+void __mpx_register(mpxapi_t* api) {
+    metrics_register_collector(__mpx_metrics);
+
+    pthread_mutex_lock(&__registry_mutex);
+    for (int i = 0; i < MPX_REGISTRY_MAX; i++) {
+        if (__registry[i] != NULL) continue;
+
+        __registry[i] = api;
+        break;
+    }
+    pthread_mutex_unlock(&__registry_mutex);
+}
+
+void __mpx_unregister(mpxapi_t* api) {
+    pthread_mutex_lock(&__registry_mutex);
+    for (int i = 0; i < MPX_REGISTRY_MAX; i++) {
+        if (__registry[i] != api) continue;
+
+        __registry[i] = NULL;
+        break;
+    }
+    pthread_mutex_unlock(&__registry_mutex);
+}
+
+// Номер цикла - его место в реестре, поэтому ряды не множатся при перезагрузке
+void __mpx_metrics(str_t* out) {
+    metrics_render_header(out, "cwfr_loop_connections", "gauge", "Connections registered in an event loop");
+
+    pthread_mutex_lock(&__registry_mutex);
+    for (int i = 0; i < MPX_REGISTRY_MAX; i++) {
+        if (__registry[i] == NULL) continue;
+
+        str_appendf(out, "cwfr_loop_connections{loop=\"%d\"} %d\n", i, atomic_load(&__registry[i]->connection_count));
+    }
+    pthread_mutex_unlock(&__registry_mutex);
+}
@@ -29,4 +29,10 @@ typedef struct mpxapi {
 mpxapi_t* mpx_create();
 void mpx_free(mpxapi_t*);
 
+/**
+ * Число соединений каждого работающего цикла событий
+ * @return количество циклов, записанных в counts
+ */
+int mpx_connection_counts(int* counts, int size);
+
 #endif
\ No newline at end of file
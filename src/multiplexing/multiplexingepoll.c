@@ -4,6 +4,7 @@
 
 #include "log.h"
 #include "connection_s.h"
+#include "metrics.h"
 #include "multiplexingepoll.h"
 
 #define EPOLL_MAX_EVENTS 16
@@ -113,6 +114,9 @@ void __mpx_epoll_process_events(appconfig_t* appconfig, void* arg) {
         return;
     }
 
+    const int events_count = n;
+    const uint64_t started_at = events_count > 0 ? metrics_now_ns() : 0;
+
     while (--n >= 0) {
         epoll_event_t* ev = &events[n];
         connection_t* connection = ev->data.ptr;
@@ -135,6 +139,9 @@ void __mpx_epoll_process_events(appconfig_t* appconfig, void* arg) {
 
         connection->close(connection);
     }
+
+    if (events_count > 0)
+        metrics_record_wakeup(events_count, metrics_now_ns() - started_at);
 }
 
 int __mpx_epoll_control(connection_t* connection, int action, uint32_t flags) {
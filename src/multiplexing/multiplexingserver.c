@@ -1,5 +1,6 @@
 #include "log.h"
 #include "socket.h"
+#include "sockethandoff.h"
 #include "broadcast.h"
 #include "multiplexing.h"
 #include "multiplexingserver.h"
@@ -56,7 +57,7 @@ int mpxserver_run(appconfig_t* appconfig) {
     if (buffer != NULL)
         free(buffer);
 
-    api->free(api);
+    mpx_free(api);
 
     return result;
 }
@@ -76,7 +77,9 @@ int __listener_connection_close(connection_t* connection) {
     if (!ctx->listener->api->control_del(connection))
         log_error("Connection not removed from api\n");
 
-    shutdown(connection->fd, SHUT_RDWR);
+    // Переданный новому процессу сокет продолжает у него работать
+    if (!socket_handoff_sent())
+        shutdown(connection->fd, SHUT_RDWR);
     close(connection->fd);
 
     atomic_store(&ctx->destroyed, 1);
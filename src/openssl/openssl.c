@@ -1,9 +1,21 @@
 #include <stdlib.h>
 #include <stddef.h>
+#include <stdatomic.h>
+#include <string.h>
 #include <errno.h>
 #include <limits.h>
+#include <pthread.h>
+#include <openssl/rand.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#else
+#include <openssl/hmac.h>
+#endif
 
 #include "log.h"
+#include "metrics.h"
 #include "openssl.h"
 
 #define OPENSSL_ERROR_CHAIN_FILE "Openssl error: can't load chain file\n"
@@ -12,8 +24,41 @@
 #define OPENSSL_ERROR_CIPHER_LIST "Openssl error: cipher list is invalid\n"
 #define OPENSSL_ERROR_MIN_PROTO "Openssl error: can't set minimum protocol version\n"
 #define OPENSSL_ERROR_CONFIG "Openssl error: fullchain, private or ciphers not set\n"
+#define OPENSSL_ERROR_TICKET_KEYS "Openssl error: can't generate session ticket keys\n"
+#define OPENSSL_ERROR_SESSION "Openssl error: can't configure session resumption\n"
+
+#define OPENSSL_TICKET_KEY_NAME_SIZE 16
+#define OPENSSL_TICKET_KEY_SIZE 32
+
+typedef struct openssl_ticket_key {
+    unsigned char name[OPENSSL_TICKET_KEY_NAME_SIZE];
+    unsigned char aes[OPENSSL_TICKET_KEY_SIZE];
+    unsigned char hmac[OPENSSL_TICKET_KEY_SIZE];
+} openssl_ticket_key_t;
+
+// [0] - текущий ключ шифрования, [1] - предыдущий, только для расшифровки
+static struct {
+    pthread_rwlock_t lock;
+    openssl_ticket_key_t keys[2];
+    int count;
+} __ticket_keys = { .lock = PTHREAD_RWLOCK_INITIALIZER, .count = 0 };
+
+static atomic_int __ticket_keys_interval = 0;
+static atomic_ullong __handshakes = 0;
+static atomic_ullong __resumed = 0;
 
 static int openssl_context_init(openssl_t*);
+static int __openssl_session_init(openssl_t* openssl);
+static int __openssl_session_id_context(SSL_CTX* ctx);
+static void __openssl_metrics(str_t* out);
+static int __openssl_ticket_keys_init(void);
+static int __openssl_ticket_key_generate(openssl_ticket_key_t* key);
+static int __openssl_ticket_key_find(const unsigned char* name, openssl_ticket_key_t* key, int* current);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+static int __openssl_ticket_key_cb(SSL* ssl, unsigned char* key_name, unsigned char* iv, EVP_CIPHER_CTX* cipher_ctx, EVP_MAC_CTX* mac_ctx, int enc);
+#else
+static int __openssl_ticket_key_cb(SSL* ssl, unsigned char* key_name, unsigned char* iv, EVP_CIPHER_CTX* cipher_ctx, HMAC_CTX* mac_ctx, int enc);
+#endif
 
 /* No manual library init: TLS_server_method() already requires
  * OpenSSL >= 1.1.0, which self-initializes thread-safely on first use. */
@@ -22,6 +67,8 @@ int openssl_init(openssl_t* openssl) {
 
     if (openssl_context_init(openssl) == -1) return 0;
 
+    metrics_register_collector(__openssl_metrics);
+
     return 1;
 }
 
@@ -69,6 +116,11 @@ static int openssl_context_init(openssl_t* openssl) {
         goto failed;
     }
 
+    if (!__openssl_session_init(openssl)) {
+        log_error(OPENSSL_ERROR_SESSION);
+        goto failed;
+    }
+
     result = 0;
 
     failed:
@@ -89,6 +141,10 @@ openssl_t* openssl_create(void) {
     openssl->private = NULL;
     openssl->ciphers = NULL;
     openssl->ctx = NULL;
+    openssl->session_tickets = 1;
+    openssl->session_cache = 0;
+    openssl->session_timeout = OPENSSL_SESSION_TIMEOUT_DEFAULT;
+    openssl->handshake_offload = 0;
 
     return openssl;
 }
@@ -140,3 +196,229 @@ int openssl_write(SSL* ssl, const void* buffer, size_t num) {
 
     return result;
 }
+
+int openssl_ticket_keys_rotate(void) {
+    openssl_ticket_key_t key;
+    if (!__openssl_ticket_key_generate(&key)) {
+        log_error(OPENSSL_ERROR_TICKET_KEYS);
+        return 0;
+    }
+
+    pthread_rwlock_wrlock(&__ticket_keys.lock);
+    if (__ticket_keys.count > 0) {
+        __ticket_keys.keys[1] = __ticket_keys.keys[0];
+        __ticket_keys.count = 2;
+    }
+    else
+        __ticket_keys.count = 1;
+
+    __ticket_keys.keys[0] = key;
+    pthread_rwlock_unlock(&__ticket_keys.lock);
+
+    OPENSSL_cleanse(&key, sizeof(key));
+
+    return 1;
+}
+
+void openssl_ticket_keys_rotate_task(void* data) {
+    (void)data;
+
+    if (openssl_ticket_keys_rotate())
+        log_info("openssl: session ticket key rotated\n");
+}
+
+int openssl_ticket_keys_interval(void) {
+    return atomic_load(&__ticket_keys_interval);
+}
+
+void openssl_handshake_done(SSL* ssl) {
+    if (ssl == NULL) return;
+
+    atomic_fetch_add(&__handshakes, 1);
+
+    if (SSL_session_reused(ssl))
+        atomic_fetch_add(&__resumed, 1);
+}
+
+void openssl_session_stats(openssl_session_stats_t* stats) {
+    if (stats == NULL) return;
+
+    stats->handshakes = atomic_load(&__handshakes);
+    stats->resumed = atomic_load(&__resumed);
+}
+
+int __openssl_session_init(openssl_t* openssl) {
+    SSL_CTX* ctx = openssl->ctx;
+
+    if (!__openssl_session_id_context(ctx))
+        return 0;
+
+    SSL_CTX_set_timeout(ctx, openssl->session_timeout);
+
+    if (openssl->session_cache > 0) {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_cache_size(ctx, openssl->session_cache);
+    }
+    else
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+
+    if (!openssl->session_tickets) {
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+        return 1;
+    }
+
+    if (!__openssl_ticket_keys_init())
+        return 0;
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    if (!SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, __openssl_ticket_key_cb))
+        return 0;
+#else
+    if (!SSL_CTX_set_tlsext_ticket_key_cb(ctx, __openssl_ticket_key_cb))
+        return 0;
+#endif
+
+    int interval = atomic_load(&__ticket_keys_interval);
+    while (openssl->session_timeout > interval)
+        if (atomic_compare_exchange_weak(&__ticket_keys_interval, &interval, (int)openssl->session_timeout))
+            break;
+
+    return 1;
+}
+
+/*
+ * Контекст сессий - SHA-256 сертификата сервера. Ключи билетов общие для
+ * процесса, поэтому сессия, выданная одним сервером, не должна продолжаться
+ * на сервере с другим сертификатом: OpenSSL сверяет контекст при возобновлении.
+ * Серверы с одним сертификатом, между которыми переключает SNI, делят сессии.
+ */
+int __openssl_session_id_context(SSL_CTX* ctx) {
+    X509* cert = SSL_CTX_get0_certificate(ctx);
+    if (cert == NULL) return 0;
+
+    unsigned char* der = NULL;
+    const int der_size = i2d_X509(cert, &der);
+    if (der_size <= 0) return 0;
+
+    unsigned char sid_ctx[EVP_MAX_MD_SIZE];
+    unsigned int sid_ctx_size = 0;
+    const int digested = EVP_Digest(der, (size_t)der_size, sid_ctx, &sid_ctx_size, EVP_sha256(), NULL);
+    OPENSSL_free(der);
+
+    if (digested != 1) return 0;
+    if (sid_ctx_size > SSL_MAX_SID_CTX_LENGTH)
+        sid_ctx_size = SSL_MAX_SID_CTX_LENGTH;
+
+    return SSL_CTX_set_session_id_context(ctx, sid_ctx, sid_ctx_size);
+}
+
+int __openssl_ticket_keys_init(void) {
+    pthread_rwlock_rdlock(&__ticket_keys.lock);
+    const int count = __ticket_keys.count;
+    pthread_rwlock_unlock(&__ticket_keys.lock);
+
+    // Ключи переживают перезагрузку конфигурации: выданные билеты остаются валидными
+    if (count > 0) return 1;
+
+    return openssl_ticket_keys_rotate();
+}
+
+int __openssl_ticket_key_generate(openssl_ticket_key_t* key) {
+    return RAND_bytes(key->name, sizeof(key->name)) == 1
+        && RAND_priv_bytes(key->aes, sizeof(key->aes)) == 1
+        && RAND_priv_bytes(key->hmac, sizeof(key->hmac)) == 1;
+}
+
+int __openssl_ticket_key_find(const unsigned char* name, openssl_ticket_key_t* key, int* current) {
+    int found = 0;
+
+    pthread_rwlock_rdlock(&__ticket_keys.lock);
+    for (int i = 0; i < __ticket_keys.count; i++) {
+        if (memcmp(__ticket_keys.keys[i].name, name, OPENSSL_TICKET_KEY_NAME_SIZE) != 0)
+            continue;
+
+        *key = __ticket_keys.keys[i];
+        *current = i == 0;
+        found = 1;
+        break;
+    }
+    pthread_rwlock_unlock(&__ticket_keys.lock);
+
+    return found;
+}
+
+/*
+ * enc = 1: шифрование билета текущим ключом.
+ * enc = 0: поиск ключа по имени; 0 - ключ неизвестен (полное рукопожатие),
+ * 2 - билет принят, но выпущен предыдущим ключом и будет заменён.
+ */
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+int __openssl_ticket_key_cb(SSL* ssl, unsigned char* key_name, unsigned char* iv, EVP_CIPHER_CTX* cipher_ctx, EVP_MAC_CTX* mac_ctx, int enc) {
+#else
+int __openssl_ticket_key_cb(SSL* ssl, unsigned char* key_name, unsigned char* iv, EVP_CIPHER_CTX* cipher_ctx, HMAC_CTX* mac_ctx, int enc) {
+#endif
+    (void)ssl;
+
+    openssl_ticket_key_t key;
+    int result = 1;
+
+    if (enc) {
+        pthread_rwlock_rdlock(&__ticket_keys.lock);
+        const int count = __ticket_keys.count;
+        if (count > 0)
+            key = __ticket_keys.keys[0];
+        pthread_rwlock_unlock(&__ticket_keys.lock);
+
+        if (count == 0) return -1;
+
+        if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1)
+            goto failed;
+
+        memcpy(key_name, key.name, OPENSSL_TICKET_KEY_NAME_SIZE);
+
+        if (EVP_EncryptInit_ex(cipher_ctx, EVP_aes_256_cbc(), NULL, key.aes, iv) != 1)
+            goto failed;
+    }
+    else {
+        int current = 0;
+        if (!__openssl_ticket_key_find(key_name, &key, &current))
+            return 0;
+
+        if (EVP_DecryptInit_ex(cipher_ctx, EVP_aes_256_cbc(), NULL, key.aes, iv) != 1)
+            goto failed;
+
+        result = current ? 1 : 2;
+    }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.hmac, sizeof(key.hmac)),
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, "SHA256", 0),
+        OSSL_PARAM_construct_end()
+    };
+
+    if (EVP_MAC_CTX_set_params(mac_ctx, params) != 1)
+        goto failed;
+#else
+    if (HMAC_Init_ex(mac_ctx, key.hmac, sizeof(key.hmac), EVP_sha256(), NULL) != 1)
+        goto failed;
+#endif
+
+    OPENSSL_cleanse(&key, sizeof(key));
+
+    return result;
+
+    failed:
+
+    OPENSSL_cleanse(&key, sizeof(key));
+
+    return -1;
+}
+
+void __openssl_metrics(str_t* out) {
+    openssl_session_stats_t stats;
+    openssl_session_stats(&stats);
+
+    metrics_render_counter(out, "cwfr_tls_handshakes_total", "Completed server TLS handshakes", stats.handshakes);
+    metrics_render_counter(out, "cwfr_tls_handshakes_resumed_total", "Server TLS handshakes that resumed a session", stats.resumed);
+}
@@ -7,18 +7,67 @@
 #define TLS_ERROR_ALLOC_SSL "Tls error: can't allocate a new ssl object\n"
 #define TLS_ERROR_SET_SSL_FD "Tls error: can't attach fd to ssl\n"
 
+#define OPENSSL_SESSION_TIMEOUT_DEFAULT 3600
+
+/**
+ * Возобновление TLS-сессий.
+ *
+ * Stateless tickets (TLS 1.2 и 1.3) шифруются ключами, общими для всех
+ * контекстов и потоков процесса. Ключ ротируется задачей taskmanager
+ * с интервалом, равным наибольшему session_timeout; предыдущий ключ
+ * остаётся для расшифровки, поэтому билет живёт не меньше своего таймаута,
+ * а предъявленный со старым ключом билет перевыпускается.
+ *
+ * Серверный кэш сессий необязателен и ограничен session_cache записями
+ * (0 - выключен, возобновление только по билетам).
+ *
+ * При handshake_offload рукопожатие (SNI-колбэк и операция с приватным
+ * ключом) выполняется в пуле потоков-обработчиков, а не в цикле событий
+ * воркера, чтобы всплеск новых соединений не задерживал уже установленные.
+ */
 typedef struct openssl {
     char* fullchain;
     char* private;
     char* ciphers;
     SSL_CTX* ctx;
+    int session_tickets;           // 1 - выдавать stateless tickets
+    long session_cache;            // Размер кэша сессий, 0 - выключен
+    long session_timeout;          // Время жизни сессии в секундах
+    int handshake_offload;         // 1 - рукопожатие в потоках-обработчиках
 } openssl_t;
 
+typedef struct openssl_session_stats {
+    unsigned long long handshakes; // Завершённые серверные рукопожатия
+    unsigned long long resumed;    // Из них возобновлённые
+} openssl_session_stats_t;
+
 int openssl_init(openssl_t* openssl);
 openssl_t* openssl_create(void);
 void openssl_free(openssl_t* openssl);
 void openssl_set_sni_callback(openssl_t* openssl, int (*callback)(SSL*, int*, void*));
 int openssl_read(SSL*, void*, size_t);
+
+/**
+ * Новый ключ билетов; текущий становится предыдущим.
+ */
+int openssl_ticket_keys_rotate(void);
+
+/**
+ * Задача taskmanager для ротации ключей, data не используется.
+ */
+void openssl_ticket_keys_rotate_task(void* data);
+
+/**
+ * Интервал ротации в секундах: наибольший session_timeout среди
+ * инициализированных контекстов с билетами, 0 - билеты не используются.
+ */
+int openssl_ticket_keys_interval(void);
+
+/**
+ * Учёт завершённого серверного рукопожатия.
+ */
+void openssl_handshake_done(SSL* ssl);
+void openssl_session_stats(openssl_session_stats_t* stats);
 int openssl_write(SSL*, const void*, size_t);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,397 @@
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <ucontext.h>
+#include <sys/prctl.h>
+#include <sys/time.h>
+
+#include "log.h"
+#include "profiler.h"
+
+#define PROFILER_THREAD_NAME_SIZE 16
+// Наибольший размер кадра: дальше указатель кадра считается испорченным
+#define PROFILER_FRAME_MAX (256 * 1024)
+
+// Кадр при указателях кадров (x86-64, AArch64): сохранённый указатель
+// кадра вызывающего и адрес возврата в него
+typedef struct profiler_frame {
+    const struct profiler_frame* next;
+    void* ret;
+} profiler_frame_t;
+
+typedef struct profiler_sample {
+    atomic_int ready;
+    int depth;
+    char thread[PROFILER_THREAD_NAME_SIZE];
+    void* frames[PROFILER_DEPTH];  // От листа к корню
+} profiler_sample_t;
+
+typedef struct profiler_symbol {
+    uintptr_t address;
+    size_t offset;                 // Начало имени в общем буфере
+} profiler_symbol_t;
+
+static atomic_bool __running = 0;
+static atomic_bool __installed = 0;
+static atomic_int __active = 0;
+static atomic_int __in_handler = 0;
+static atomic_size_t __next = 0;
+static profiler_sample_t* __samples = NULL;
+static size_t __capacity = 0;
+// Границы стека потока из profiler_thread_init, 0 - неизвестны. Модель
+// initial-exec: обработчик сигнала читает их без __tls_get_addr
+static _Thread_local uintptr_t __stack_low __attribute__((tls_model("initial-exec"))) = 0;
+static _Thread_local uintptr_t __stack_high __attribute__((tls_model("initial-exec"))) = 0;
+
+static int __profiler_install(void);
+static void __profiler_signal(int sig, siginfo_t* info, void* context);
+static int __profiler_unwind(const void* context, void** frames, int max);
+static void __profiler_sleep(unsigned int duration_ms);
+static size_t __profiler_render(size_t count, str_t* out);
+static int __profiler_sample_cmp(const void* a, const void* b);
+static int __profiler_address_cmp(const void* a, const void* b);
+static uintptr_t __profiler_frame_address(const profiler_sample_t* sample, int frame);
+static void __profiler_symbol_name(uintptr_t address, str_t* names);
+
+profiler_result_e profiler_run(unsigned int duration_ms, unsigned int frequency, str_t* out, profiler_stats_t* stats) {
+    if (out == NULL || duration_ms == 0 || frequency == 0)
+        return PROFILER_ERROR;
+
+    if (duration_ms > PROFILER_SECONDS_MAX * 1000)
+        duration_ms = PROFILER_SECONDS_MAX * 1000;
+    if (frequency > PROFILER_FREQUENCY_MAX)
+        frequency = PROFILER_FREQUENCY_MAX;
+
+    _Bool expected = 0;
+    if (!atomic_compare_exchange_strong(&__running, &expected, 1))
+        return PROFILER_BUSY;
+
+    profiler_result_e result = PROFILER_ERROR;
+
+
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t capacity = (size_t)frequency * (duration_ms / 1000 + 1) * (size_t)(cpus > 0 ? cpus : 1);
+    if (capacity > PROFILER_SAMPLES_MAX)
+        capacity = PROFILER_SAMPLES_MAX;
+
+    __samples = calloc(capacity, sizeof(profiler_sample_t));
+    if (__samples == NULL) goto failed;
+
+    __capacity = capacity;
+
+    if (!__profiler_install()) goto failed;
+
+    atomic_store(&__next, 0);
+    atomic_store(&__active, 1);
+
+    const long interval_us = 1000000L / frequency;
+    struct itimerval timer = {
+        .it_interval = { .tv_sec = interval_us / 1000000L, .tv_usec = interval_us % 1000000L },
+        .it_value = { .tv_sec = interval_us / 1000000L, .tv_usec = interval_us % 1000000L }
+    };
+    if (setitimer(ITIMER_PROF, &timer, NULL) == -1) {
+        log_error("profiler: setitimer failed (errno %d)\n", errno);
+        atomic_store(&__active, 0);
+        goto failed;
+    }
+
+    __profiler_sleep(duration_ms);
+
+    const struct itimerval stop = {0};
+    setitimer(ITIMER_PROF, &stop, NULL);
+
+    // Обработчики, уже начавшие запись, дописывают выборку
+    atomic_store(&__active, 0);
+    while (atomic_load(&__in_handler) > 0)
+        sched_yield();
+
+    const size_t taken = atomic_load(&__next);
+    const size_t count = taken < __capacity ? taken : __capacity;
+    const size_t stacks = __profiler_render(count, out);
+    if (stacks == (size_t)-1) goto failed;
+
+    if (stats != NULL) {
+        stats->samples = count;
+        stats->dropped = taken - count;
+        stats->stacks = stacks;
+    }
+
+    result = PROFILER_OK;
+
+    failed:
+
+    free(__samples);
+    __samples = NULL;
+    __capacity = 0;
+    atomic_store(&__running, 0);
+
+    return result;
+}
+
+int profiler_running(void) {
+    return atomic_load(&__running);
+}
+
+void profiler_thread_init(void) {
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr) != 0) return;
+
+    void* stack = NULL;
+    size_t size = 0;
+    if (pthread_attr_getstack(&attr, &stack, &size) == 0 && stack != NULL && size > 0) {
+        __stack_low = (uintptr_t)stack;
+        __stack_high = (uintptr_t)stack + size;
+    }
+
+    pthread_attr_destroy(&attr);
+}
+
+/*
+ * Обработчик остаётся установленным и после замера: сигнал, сгенерированный
+ * до остановки таймера, но ещё не доставленный, с действием по умолчанию
+ * завершил бы процесс.
+ */
+int __profiler_install(void) {
+    if (atomic_load(&__installed))
+        return 1;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = __profiler_signal;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+
+    if (sigaction(SIGPROF, &action, NULL) == -1) {
+        log_error("profiler: sigaction failed (errno %d)\n", errno);
+        return 0;
+    }
+
+    atomic_store(&__installed, 1);
+
+    return 1;
+}
+
+void __profiler_signal(int sig, siginfo_t* info, void* context) {
+    (void)sig;
+    (void)info;
+
+    const int saved_errno = errno;
+
+    atomic_fetch_add(&__in_handler, 1);
+
+    if (atomic_load(&__active)) {
+        const size_t index = atomic_fetch_add(&__next, 1);
+        if (index < __capacity) {
+            profiler_sample_t* sample = &__samples[index];
+
+            sample->depth = __profiler_unwind(context, sample->frames, PROFILER_DEPTH);
+
+            prctl(PR_GET_NAME, sample->thread, 0, 0, 0);
+            atomic_store(&sample->ready, 1);
+        }
+    }
+
+    atomic_fetch_sub(&__in_handler, 1);
+
+    errno = saved_errno;
+}
+
+/*
+ * Раскрутка по цепочке указателей кадров от прерванной инструкции. Только
+ * чтение памяти стека, поэтому безопасна в обработчике сигнала. Каждый
+ * кадр проверяется: выровнен, лежит выше предыдущего не дальше
+ * PROFILER_FRAME_MAX и внутри стека потока. Без указателей кадров в
+ * регистре может оказаться любое значение, поэтому читается только стек
+ * самого потока; у потока без profiler_thread_init берётся один лист.
+ * @return число кадров, от листа к корню
+ */
+int __profiler_unwind(const void* context, void** frames, int max) {
+    const ucontext_t* ucontext = context;
+    uintptr_t pc = 0;
+    uintptr_t fp = 0;
+
+#if defined(__x86_64__)
+    pc = (uintptr_t)ucontext->uc_mcontext.gregs[REG_RIP];
+    fp = (uintptr_t)ucontext->uc_mcontext.gregs[REG_RBP];
+#elif defined(__aarch64__)
+    pc = (uintptr_t)ucontext->uc_mcontext.pc;
+    fp = (uintptr_t)ucontext->uc_mcontext.regs[29];
+#else
+    // Соглашение о кадрах неизвестно: выборка без стека
+    (void)ucontext;
+#endif
+
+    if (pc == 0 || max <= 0) return 0;
+
+    int depth = 0;
+    frames[depth++] = (void*)pc;
+
+    const uintptr_t low = __stack_low;
+    const uintptr_t high = __stack_high;
+    if (high == 0) return depth;
+
+    while (depth < max) {
+        if (fp < low || fp > high - sizeof(profiler_frame_t) || fp % sizeof(void*) != 0) break;
+
+        const profiler_frame_t* frame = (const profiler_frame_t*)fp;
+        if (frame->ret == NULL) break;
+
+        frames[depth++] = frame->ret;
+
+        const uintptr_t next = (uintptr_t)frame->next;
+        if (next <= fp || next - fp > PROFILER_FRAME_MAX) break;
+
+        fp = next;
+    }
+
+    return depth;
+}
+
+void __profiler_sleep(unsigned int duration_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += duration_ms / 1000;
+    deadline.tv_nsec += (long)(duration_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    // SIGPROF прерывает и этот поток
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR);
+}
+
+/*
+ * Одинаковые стеки соседствуют после сортировки, каждый адрес разрешается
+ * в имя один раз.
+ * @return число различных стеков или (size_t)-1 при нехватке памяти
+ */
+size_t __profiler_render(size_t count, str_t* out) {
+    size_t stacks = (size_t)-1;
+    profiler_sample_t** samples = NULL;
+    profiler_symbol_t* symbols = NULL;
+    str_t names;
+    str_init(&names, 16384);
+
+    samples = malloc((count > 0 ? count : 1) * sizeof(profiler_sample_t*));
+    if (samples == NULL) goto failed;
+
+    size_t ready = 0;
+    size_t frames = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!atomic_load(&__samples[i].ready) || __samples[i].depth <= 0) continue;
+
+        samples[ready++] = &__samples[i];
+        frames += (size_t)__samples[i].depth;
+    }
+
+    qsort(samples, ready, sizeof(profiler_sample_t*), __profiler_sample_cmp);
+
+    symbols = malloc((frames > 0 ? frames : 1) * sizeof(profiler_symbol_t));
+    if (symbols == NULL) goto failed;
+
+    size_t symbols_count = 0;
+    for (size_t i = 0; i < ready; i++)
+        for (int j = 0; j < samples[i]->depth; j++)
+            symbols[symbols_count++].address = __profiler_frame_address(samples[i], j);
+
+    qsort(symbols, symbols_count, sizeof(profiler_symbol_t), __profiler_address_cmp);
+
+    size_t unique = 0;
+    for (size_t i = 0; i < symbols_count; i++) {
+        if (unique > 0 && symbols[unique - 1].address == symbols[i].address) continue;
+
+        symbols[unique].address = symbols[i].address;
+        symbols[unique].offset = str_size(&names);
+        __profiler_symbol_name(symbols[unique].address, &names);
+        str_appendc(&names, 0);
+        unique++;
+    }
+
+    stacks = 0;
+    for (size_t i = 0; i < ready; ) {
+        size_t same = i + 1;
+        while (same < ready && __profiler_sample_cmp(&samples[i], &samples[same]) == 0)
+            same++;
+
+        const profiler_sample_t* sample = samples[i];
+        str_append(out, sample->thread[0] != 0 ? sample->thread : "unknown", sample->thread[0] != 0 ? strnlen(sample->thread, PROFILER_THREAD_NAME_SIZE) : 7);
+
+        for (int j = sample->depth - 1; j >= 0; j--) {
+            const profiler_symbol_t key = { .address = __profiler_frame_address(sample, j), .offset = 0 };
+            const profiler_symbol_t* symbol = bsearch(&key, symbols, unique, sizeof(profiler_symbol_t), __profiler_address_cmp);
+
+            str_appendc(out, ';');
+            if (symbol != NULL)
+                str_appendf(out, "%s", str_get(&names) + symbol->offset);
+        }
+
+        str_appendf(out, " %zu\n", same - i);
+
+        stacks++;
+        i = same;
+    }
+
+    failed:
+
+    free(samples);
+    free(symbols);
+    str_clear(&names);
+
+    return stacks;
+}
+
+int __profiler_sample_cmp(const void* a, const void* b) {
+    const profiler_sample_t* first = *(profiler_sample_t* const*)a;
+    const profiler_sample_t* second = *(profiler_sample_t* const*)b;
+
+    const int names = strncmp(first->thread, second->thread, PROFILER_THREAD_NAME_SIZE);
+    if (names != 0) return names;
+
+    if (first->depth != second->depth)
+        return first->depth < second->depth ? -1 : 1;
+
+    return memcmp(first->frames, second->frames, (size_t)first->depth * sizeof(void*));
+}
+
+int __profiler_address_cmp(const void* a, const void* b) {
+    const uintptr_t first = ((const profiler_symbol_t*)a)->address;
+    const uintptr_t second = ((const profiler_symbol_t*)b)->address;
+
+    return first < second ? -1 : first > second;
+}
+
+// Для вызывающих кадров сохранён адрес возврата: он может указывать уже на
+// следующую функцию, поэтому берётся адрес внутри инструкции вызова
+uintptr_t __profiler_frame_address(const profiler_sample_t* sample, int frame) {
+    const uintptr_t address = (uintptr_t)sample->frames[frame];
+
+    return frame > 0 && address > 0 ? address - 1 : address;
+}
+
+void __profiler_symbol_name(uintptr_t address, str_t* names) {
+    Dl_info info;
+    if (dladdr((void*)address, &info) == 0) {
+        str_appendf(names, "0x%lx", (unsigned long)address);
+        return;
+    }
+
+    if (info.dli_sname != NULL) {
+        str_append(names, info.dli_sname, strlen(info.dli_sname));
+        return;
+    }
+
+    const char* module = info.dli_fname != NULL ? strrchr(info.dli_fname, '/') : NULL;
+    module = module != NULL ? module + 1 : (info.dli_fname != NULL ? info.dli_fname : "?");
+
+    str_appendf(names, "%s+0x%lx", module, (unsigned long)(address - (uintptr_t)info.dli_fbase));
+}
@@ -0,0 +1,63 @@
+#ifndef __PROFILER__
+#define __PROFILER__
+
+#include <stddef.h>
+
+#include "str.h"
+
+/**
+ * Выборочный профилировщик процессорного времени всех потоков процесса.
+ *
+ * На время замера взводится ITIMER_PROF: ядро отправляет SIGPROF потоку,
+ * потратившему очередной квант процессора. Обработчик сигнала снимает стек
+ * по цепочке указателей кадров (backtrace небезопасен в обработчике) и
+ * кладёт его в заранее выделенный буфер без блокировок. Полные стеки
+ * требуют сборки с -fno-omit-frame-pointer, иначе стек обрывается на
+ * первой функции без указателя кадра. Раскручиваются стеки только потоков,
+ * вызвавших profiler_thread_init. По окончании одинаковые
+ * стеки складываются и выдаются в формате folded stacks для flamegraph.pl
+ * и speedscope: "имя потока;корень;...;лист количество".
+ *
+ * Имена берутся через dladdr, поэтому видны только экспортируемые символы
+ * (сборка с -rdynamic). Для статических функций выдаётся модуль+смещение,
+ * его разрешает addr2line. Потоки, блокирующие сигналы (запись журналов),
+ * в выборку не попадают.
+ */
+
+#define PROFILER_SECONDS_DEFAULT 10
+#define PROFILER_SECONDS_MAX 60
+#define PROFILER_FREQUENCY_DEFAULT 99
+#define PROFILER_FREQUENCY_MAX 1000
+#define PROFILER_DEPTH 64
+#define PROFILER_SAMPLES_MAX 16384
+
+typedef enum {
+    PROFILER_OK = 0,
+    PROFILER_BUSY,                 // Замер уже идёт
+    PROFILER_ERROR
+} profiler_result_e;
+
+typedef struct profiler_stats {
+    size_t samples;                // Снято стеков
+    size_t dropped;                // Не поместилось в буфер
+    size_t stacks;                 // Различных стеков в выдаче
+} profiler_stats_t;
+
+/**
+ * Замер в течение duration_ms с частотой frequency выборок на секунду
+ * процессорного времени. Блокирует вызывающий поток на всё время замера.
+ * @param out - строки folded stacks, дописываются в конец
+ * @param stats - может быть NULL
+ */
+profiler_result_e profiler_run(unsigned int duration_ms, unsigned int frequency, str_t* out, profiler_stats_t* stats);
+
+int profiler_running(void);
+
+/**
+ * Запоминает границы стека вызывающего потока. Вызывается в начале потока:
+ * стек раскручивается только в потоках, вызвавших её, у остальных в выборку
+ * попадает лишь выполнявшаяся функция
+ */
+void profiler_thread_init(void);
+
+#endif
@@ -0,0 +1,131 @@
+#include <stdlib.h>
+
+#include "concurrencylimiter.h"
+#include "ratelimiter.h"
+
+// Задержка выше baseline * CONCURRENCYLIMITER_TOLERANCE считается перегрузкой
+#define CONCURRENCYLIMITER_TOLERANCE 2
+// Вес нового замера в скользящем среднем: 1 / 2^CONCURRENCYLIMITER_EWMA_SHIFT
+#define CONCURRENCYLIMITER_EWMA_SHIFT 5
+
+static void __concurrencylimiter_increase(concurrencylimiter_t* limiter);
+static void __concurrencylimiter_decrease(concurrencylimiter_t* limiter, uint64_t now_ns);
+static uint64_t __concurrencylimiter_baseline_update(concurrencylimiter_t* limiter, uint64_t latency_ns);
+
+concurrencylimiter_t* concurrencylimiter_create(uint32_t max) {
+    if (max == 0) return NULL;
+
+    concurrencylimiter_t* limiter = malloc(sizeof * limiter);
+    if (limiter == NULL) return NULL;
+
+    limiter->max = max;
+    atomic_init(&limiter->limit, max);
+    atomic_init(&limiter->inflight, 0);
+    atomic_init(&limiter->successes, 0);
+    atomic_init(&limiter->baseline_ns, 0);
+    atomic_init(&limiter->last_decrease_ns, 0);
+    atomic_init(&limiter->rejected, 0);
+
+    return limiter;
+}
+
+void concurrencylimiter_free(concurrencylimiter_t* limiter) {
+    free(limiter);
+}
+
+int concurrencylimiter_acquire(concurrencylimiter_t* limiter) {
+    if (limiter == NULL) return 1;
+
+    uint_fast32_t inflight = atomic_load(&limiter->inflight);
+    do {
+        if (inflight >= atomic_load(&limiter->limit)) {
+            atomic_fetch_add(&limiter->rejected, 1);
+            return 0;
+        }
+    } while (!atomic_compare_exchange_weak(&limiter->inflight, &inflight, inflight + 1));
+
+    return 1;
+}
+
+void concurrencylimiter_release(concurrencylimiter_t* limiter, uint64_t latency_ns) {
+    if (limiter == NULL) return;
+
+    atomic_fetch_sub(&limiter->inflight, 1);
+
+    if (latency_ns == 0) return;
+
+    const uint64_t baseline = __concurrencylimiter_baseline_update(limiter, latency_ns);
+    if (latency_ns > baseline * CONCURRENCYLIMITER_TOLERANCE) {
+        __concurrencylimiter_decrease(limiter, ratelimiter_get_time_ns());
+        return;
+    }
+
+    __concurrencylimiter_increase(limiter);
+}
+
+void concurrencylimiter_release_overload(concurrencylimiter_t* limiter) {
+    if (limiter == NULL) return;
+
+    atomic_fetch_sub(&limiter->inflight, 1);
+    __concurrencylimiter_decrease(limiter, ratelimiter_get_time_ns());
+}
+
+uint32_t concurrencylimiter_limit(concurrencylimiter_t* limiter) {
+    if (limiter == NULL) return 0;
+
+    return atomic_load(&limiter->limit);
+}
+
+void __concurrencylimiter_increase(concurrencylimiter_t* limiter) {
+    const uint_fast32_t limit = atomic_load(&limiter->limit);
+    if (atomic_fetch_add(&limiter->successes, 1) + 1 < limit)
+        return;
+
+    atomic_store(&limiter->successes, 0);
+
+    uint_fast32_t expected = limit;
+    if (limit < limiter->max)
+        atomic_compare_exchange_strong(&limiter->limit, &expected, limit + 1);
+}
+
+void __concurrencylimiter_decrease(concurrencylimiter_t* limiter, uint64_t now_ns) {
+    // Без замеров нет ни интервала между снижениями, ни уверенности в перегрузке:
+    // иначе серия ранних тайм-аутов очереди обваливает лимит до единицы
+    const uint64_t baseline = atomic_load(&limiter->baseline_ns);
+    if (baseline == 0)
+        return;
+
+    uint_fast64_t last = atomic_load(&limiter->last_decrease_ns);
+    if (last != 0 && now_ns - last < baseline)
+        return;
+    if (!atomic_compare_exchange_strong(&limiter->last_decrease_ns, &last, now_ns))
+        return;
+
+    atomic_store(&limiter->successes, 0);
+
+    uint_fast32_t limit = atomic_load(&limiter->limit);
+    uint_fast32_t decreased;
+    do {
+        decreased = limit - limit / 10;
+        if (decreased == limit && limit > 1)
+            decreased = limit - 1;
+        if (decreased < 1)
+            decreased = 1;
+    } while (!atomic_compare_exchange_weak(&limiter->limit, &limit, decreased));
+}
+
+uint64_t __concurrencylimiter_baseline_update(concurrencylimiter_t* limiter, uint64_t latency_ns) {
+    uint_fast64_t baseline = atomic_load(&limiter->baseline_ns);
+    uint_fast64_t updated;
+    do {
+        if (baseline == 0)
+            updated = latency_ns;
+        else if (latency_ns > baseline)
+            updated = baseline + ((latency_ns - baseline) >> CONCURRENCYLIMITER_EWMA_SHIFT);
+        else
+            updated = baseline - ((baseline - latency_ns) >> CONCURRENCYLIMITER_EWMA_SHIFT);
+    } while (!atomic_compare_exchange_weak(&limiter->baseline_ns, &baseline, updated));
+
+    // сравнение идёт с базой до замера, иначе выброс сам поднимает порог
+    return baseline == 0 ? latency_ns : baseline;
+}
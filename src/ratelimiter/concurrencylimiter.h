@@ -0,0 +1,55 @@
+#ifndef __CONCURRENCYLIMITER__
+#define __CONCURRENCYLIMITER__
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+/**
+ * Concurrency Limiter - адаптивное ограничение числа запросов маршрута,
+ * находящихся в обработке (от постановки в очередь до завершения).
+ *
+ * Лимит меняется по AIMD: после limit успешных завершений подряд он растёт
+ * на единицу (не выше max), а при перегрузке уменьшается на 10% (не ниже 1).
+ * Перегрузкой считается задержка выше удвоенной базовой (скользящее среднее
+ * задержек) либо отказ по бюджету ожидания в очереди. Уменьшение происходит
+ * не чаще раза за базовую задержку, чтобы одна волна медленных ответов
+ * не обрушила лимит.
+ */
+
+typedef struct concurrencylimiter {
+    uint32_t max;                          // Верхняя граница лимита из конфигурации
+    atomic_uint_fast32_t limit;            // Текущий лимит
+    atomic_uint_fast32_t inflight;         // Запросы в обработке
+    atomic_uint_fast32_t successes;        // Успешные завершения с последнего роста
+    atomic_uint_fast64_t baseline_ns;      // Скользящее среднее задержки
+    atomic_uint_fast64_t last_decrease_ns; // Время последнего уменьшения
+    atomic_uint_fast64_t rejected;         // Отказы из-за лимита
+} concurrencylimiter_t;
+
+/**
+ * Создание ограничителя с начальным и максимальным лимитом max
+ */
+concurrencylimiter_t* concurrencylimiter_create(uint32_t max);
+
+void concurrencylimiter_free(concurrencylimiter_t* limiter);
+
+/**
+ * Занимает место под запрос
+ * @return 1 - запрос допущен, 0 - лимит исчерпан. NULL допускает всё
+ */
+int concurrencylimiter_acquire(concurrencylimiter_t* limiter);
+
+/**
+ * Освобождает место с замером задержки запроса (0 - без замера,
+ * например, если запрос не был выполнен)
+ */
+void concurrencylimiter_release(concurrencylimiter_t* limiter, uint64_t latency_ns);
+
+/**
+ * Освобождает место с сигналом перегрузки
+ */
+void concurrencylimiter_release_overload(concurrencylimiter_t* limiter);
+
+uint32_t concurrencylimiter_limit(concurrencylimiter_t* limiter);
+
+#endif
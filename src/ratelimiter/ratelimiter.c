@@ -7,218 +7,221 @@
 #include "log.h"
 
 // =============================================================================
-// Spinlock helpers
+// Time functions
 // =============================================================================
 
-static inline void spinlock_lock(atomic_flag* lock) {
-    while (atomic_flag_test_and_set_explicit(lock, memory_order_acquire)) {
-        // Spin with pause hint for better performance
-        #if defined(__x86_64__) || defined(__i386__)
-        __asm__ __volatile__("pause");
-        #endif
-    }
-}
-
-static inline void spinlock_unlock(atomic_flag* lock) {
-    atomic_flag_clear_explicit(lock, memory_order_release);
+uint64_t ratelimiter_get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
 }
 
 // =============================================================================
-// Seqlock implementation
+// Hash table helpers
 // =============================================================================
 
-static inline void seqlock_init(ratelimiter_seqlock_t* sl) {
-    atomic_init(&sl->seq, 0);
-    atomic_flag_clear(&sl->write_lock);
+// Финализатор murmur3: соседние адреса одной подсети расходятся по частям
+static inline uint32_t hash_ip(in_addr_t ip) {
+    uint32_t h = (uint32_t)ip;
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    h ^= h >> 16;
+    return h;
 }
 
-// Начать чтение - возвращает sequence number
-static inline uint64_t seqlock_read_begin(ratelimiter_seqlock_t* sl) {
-    uint64_t seq;
-    do {
-        seq = atomic_load_explicit(&sl->seq, memory_order_acquire);
-    } while (seq & 1);  // Ждём пока seq чётный (нет записи)
-    return seq;
+// Младшие биты хеша выбирают часть, остальные - слот в ней
+static inline ratelimiter_shard_t* shard_of(ratelimiter_t* limiter, uint32_t hash) {
+    return &limiter->shards[hash & (RATELIMITER_SHARDS - 1)];
 }
 
-// Проверить валидность чтения - true если данные консистентны
-static inline int seqlock_read_retry(ratelimiter_seqlock_t* sl, uint64_t start_seq) {
-    atomic_thread_fence(memory_order_acquire);
-    return atomic_load_explicit(&sl->seq, memory_order_relaxed) != start_seq;
+static inline uint32_t slot_of(uint32_t hash, uint32_t capacity) {
+    return (hash / RATELIMITER_SHARDS) & (capacity - 1);
 }
 
-// Захватить write lock
-static inline void seqlock_write_lock(ratelimiter_seqlock_t* sl) {
-    spinlock_lock(&sl->write_lock);
-    atomic_fetch_add_explicit(&sl->seq, 1, memory_order_release);  // seq становится нечётным
+static inline int slot_used(const ratelimiter_bucket_t* bucket) {
+    return bucket->last_access_ns != 0;
 }
 
-// Освободить write lock
-static inline void seqlock_write_unlock(ratelimiter_seqlock_t* sl) {
-    atomic_fetch_add_explicit(&sl->seq, 1, memory_order_release);  // seq становится чётным
-    spinlock_unlock(&sl->write_lock);
+// now, снятое до обращения к бакету в другом потоке, может быть меньше его времени
+static inline int bucket_expired(ratelimiter_t* limiter, const ratelimiter_bucket_t* bucket, uint64_t now) {
+    return now > bucket->last_access_ns && now - bucket->last_access_ns > limiter->cleanup_interval_ns;
 }
 
-// =============================================================================
-// Time functions
-// =============================================================================
+static ratelimiter_bucket_t* slots_create(uint32_t capacity) {
+    const size_t size = (size_t)capacity * sizeof(ratelimiter_bucket_t);
 
-uint64_t ratelimiter_get_time_ns(void) {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
-}
+    ratelimiter_bucket_t* slots = aligned_alloc(64, size);
+    if (slots == NULL) return NULL;
 
-// =============================================================================
-// Map helpers
-// =============================================================================
+    memset(slots, 0, size);
 
-static int compare_ip(const void* a, const void* b) {
-    in_addr_t ip_a = (in_addr_t)(uintptr_t)a;
-    in_addr_t ip_b = (in_addr_t)(uintptr_t)b;
-    if (ip_a < ip_b) return -1;
-    if (ip_a > ip_b) return 1;
-    return 0;
+    return slots;
 }
 
-static void bucket_free_fn(void* data) {
-    free(data);
-}
+// Перестраивает часть под новую ёмкость; 0 - без таблицы
+static int shard_resize(ratelimiter_shard_t* shard, uint32_t capacity) {
+    ratelimiter_bucket_t* slots = NULL;
 
-// =============================================================================
-// Bucket operations
-// =============================================================================
+    if (capacity > 0) {
+        slots = slots_create(capacity);
+        if (slots == NULL) return 0;
 
-static ratelimiter_bucket_t* bucket_create(in_addr_t ip, uint32_t initial_tokens) {
-    ratelimiter_bucket_t* bucket = malloc(sizeof(ratelimiter_bucket_t));
-    if (!bucket) return NULL;
+        for (uint32_t i = 0; i < shard->capacity; i++) {
+            const ratelimiter_bucket_t* bucket = &shard->slots[i];
+            if (!slot_used(bucket)) continue;
 
-    bucket->ip = ip;
-    atomic_init(&bucket->tokens, initial_tokens);
-    atomic_init(&bucket->last_refill_ns, ratelimiter_get_time_ns());
-    atomic_init(&bucket->last_access_ns, ratelimiter_get_time_ns());
-    atomic_flag_clear(&bucket->locked);
+            uint32_t index = slot_of(hash_ip(bucket->ip), capacity);
+            while (slot_used(&slots[index]))
+                index = (index + 1) & (capacity - 1);
 
-    return bucket;
+            slots[index] = *bucket;
+        }
+    }
+
+    free(shard->slots);
+    shard->slots = slots;
+    shard->capacity = capacity;
+    shard->cleanup_cursor = 0;
+
+    return 1;
 }
 
-static void bucket_refill(ratelimiter_bucket_t* bucket, ratelimiter_config_t* config) {
-    uint64_t now = ratelimiter_get_time_ns();
-    uint64_t last_refill = atomic_load(&bucket->last_refill_ns);
-    uint64_t elapsed_ns = now - last_refill;
+static ratelimiter_bucket_t* shard_find(ratelimiter_shard_t* shard, in_addr_t ip, uint32_t hash) {
+    if (shard->capacity == 0) return NULL;
 
-    uint64_t tokens_to_add = (elapsed_ns * config->refill_rate) / 1000000000ULL;
+    const uint32_t mask = shard->capacity - 1;
 
-    if (tokens_to_add > 0) {
-        uint32_t current_tokens = atomic_load(&bucket->tokens);
-        uint32_t new_tokens = current_tokens + (uint32_t)tokens_to_add;
+    for (uint32_t index = slot_of(hash, shard->capacity); slot_used(&shard->slots[index]); index = (index + 1) & mask)
+        if (shard->slots[index].ip == ip)
+            return &shard->slots[index];
 
-        if (new_tokens > config->max_tokens) {
-            new_tokens = config->max_tokens;
-        }
+    return NULL;
+}
 
-        atomic_store(&bucket->tokens, new_tokens);
-        atomic_store(&bucket->last_refill_ns, now);
+/*
+ * Удаление со сдвигом назад: следующие записи цепочки подтягиваются
+ * в освободившийся слот, надгробия не нужны и поиск не удлиняется.
+ */
+static void shard_remove(ratelimiter_shard_t* shard, uint32_t index) {
+    const uint32_t mask = shard->capacity - 1;
+    uint32_t hole = index;
+
+    for (uint32_t next = (hole + 1) & mask; slot_used(&shard->slots[next]); next = (next + 1) & mask) {
+        const uint32_t home = slot_of(hash_ip(shard->slots[next].ip), shard->capacity);
+
+        // Запись можно перенести, если её исходный слот не лежит между дырой и ею
+        const int movable = hole <= next
+            ? (home <= hole || home > next)
+            : (home <= hole && home > next);
+
+        if (movable) {
+            shard->slots[hole] = shard->slots[next];
+            hole = next;
+        }
     }
+
+    memset(&shard->slots[hole], 0, sizeof(ratelimiter_bucket_t));
+    shard->count--;
 }
 
-// =============================================================================
-// Lock-free find with seqlock
-// =============================================================================
+// Удаляет все устаревшие записи части: перед ростом, который и так обходит её целиком
+static void shard_sweep(ratelimiter_t* limiter, ratelimiter_shard_t* shard, uint64_t now) {
+    uint32_t index = 0;
+    while (index < shard->capacity) {
+        if (slot_used(&shard->slots[index]) && bucket_expired(limiter, &shard->slots[index], now))
+            shard_remove(shard, index); // на место удалённой могла встать другая запись
+        else
+            index++;
+    }
+}
 
-static ratelimiter_bucket_t* find_bucket_lockfree(ratelimiter_t* limiter, in_addr_t ip) {
-    ratelimiter_bucket_t* bucket;
-    uint64_t seq;
+// Наименьшая ёмкость с заполнением не больше половины
+static uint32_t shard_fit_capacity(uint32_t count) {
+    if (count == 0) return 0;
 
-    do {
-        seq = seqlock_read_begin(&limiter->seqlock);
-        bucket = map_find(limiter->buckets, (void*)(uintptr_t)ip);
-    } while (seqlock_read_retry(&limiter->seqlock, seq));
+    uint32_t capacity = RATELIMITER_SHARD_CAPACITY_MIN;
+    while (capacity < count * 2)
+        capacity *= 2;
 
-    return bucket;
+    return capacity;
 }
 
-// Найти или создать bucket для IP
-static ratelimiter_bucket_t* find_or_create_bucket(ratelimiter_t* limiter, in_addr_t ip) {
-    // Сначала пробуем найти lock-free
-    ratelimiter_bucket_t* bucket = find_bucket_lockfree(limiter, ip);
-    if (bucket) {
-        return bucket;
-    }
+/*
+ * Проверяет несколько слотов от курсора. После полного прохода часть,
+ * опустевшая после наплыва адресов, ужимается и отдаёт память.
+ */
+static void shard_cleanup_step(ratelimiter_t* limiter, ratelimiter_shard_t* shard, uint64_t now) {
+    for (int step = 0; step < RATELIMITER_CLEANUP_STEP && shard->capacity > 0; step++) {
+        const uint32_t index = shard->cleanup_cursor;
+
+        if (slot_used(&shard->slots[index]) && bucket_expired(limiter, &shard->slots[index], now)) {
+            shard_remove(shard, index);
+            continue;
+        }
 
-    // Не найден - нужен write lock для создания
-    seqlock_write_lock(&limiter->seqlock);
+        shard->cleanup_cursor = (index + 1) & (shard->capacity - 1);
+        if (shard->cleanup_cursor != 0) continue;
 
-    // Повторная проверка (другой поток мог создать)
-    bucket = map_find(limiter->buckets, (void*)(uintptr_t)ip);
-    if (bucket) {
-        seqlock_write_unlock(&limiter->seqlock);
-        return bucket;
+        const uint32_t capacity = shard_fit_capacity(shard->count);
+        if (capacity < shard->capacity / 4 || capacity == 0)
+            shard_resize(shard, capacity);
     }
+}
 
-    // Создание нового bucket
-    bucket = bucket_create(ip, limiter->config.max_tokens);
-    if (bucket) {
-        map_insert(limiter->buckets, (void*)(uintptr_t)ip, bucket);
+static ratelimiter_bucket_t* shard_insert(ratelimiter_t* limiter, ratelimiter_shard_t* shard, in_addr_t ip, uint32_t hash, uint64_t now) {
+    // Заполнение не выше 3/4, иначе цепочки пробирования растут
+    if ((uint64_t)(shard->count + 1) * 4 > (uint64_t)shard->capacity * 3) {
+        if (shard->capacity > 0)
+            shard_sweep(limiter, shard, now);
+
+        // Рост, если обход не опустил заполнение до половины: иначе при живых
+        // записях чуть ниже 3/4 полный обход повторялся бы через несколько вставок
+        if ((uint64_t)(shard->count + 1) * 2 > (uint64_t)shard->capacity) {
+            const uint32_t capacity = shard->capacity == 0 ? RATELIMITER_SHARD_CAPACITY_MIN : shard->capacity * 2;
+            if (capacity <= shard->capacity || !shard_resize(shard, capacity))
+                return NULL;
+        }
     }
 
-    seqlock_write_unlock(&limiter->seqlock);
+    const uint32_t mask = shard->capacity - 1;
+    uint32_t index = slot_of(hash, shard->capacity);
+    while (slot_used(&shard->slots[index]))
+        index = (index + 1) & mask;
+
+    ratelimiter_bucket_t* bucket = &shard->slots[index];
+    bucket->ip = ip;
+    bucket->tokens = limiter->config.max_tokens;
+    bucket->last_refill_ns = now;
+    bucket->last_access_ns = now;
+    shard->count++;
 
     return bucket;
 }
 
 // =============================================================================
-// Cleanup
+// Bucket operations
 // =============================================================================
 
-static void cleanup_old_buckets(ratelimiter_t* limiter) {
-    uint64_t now = ratelimiter_get_time_ns();
-    uint64_t last_cleanup = atomic_load(&limiter->last_cleanup_ns);
+static void bucket_refill(ratelimiter_bucket_t* bucket, ratelimiter_config_t* config, uint64_t now) {
+    if (now <= bucket->last_refill_ns) return;
 
-    uint64_t cleanup_interval_ns = (uint64_t)limiter->config.cleanup_interval_s * 1000000000ULL;
-    if (now - last_cleanup < cleanup_interval_ns) {
-        return;
-    }
+    uint64_t elapsed_ns = now - bucket->last_refill_ns;
 
-    // Атомарно обновляем время последней очистки
-    if (!atomic_compare_exchange_strong(&limiter->last_cleanup_ns, &last_cleanup, now)) {
-        return;
-    }
+    uint64_t tokens_to_add = (elapsed_ns / 1000000000ULL) * config->refill_rate
+        + ((elapsed_ns % 1000000000ULL) * config->refill_rate) / 1000000000ULL;
 
-    // Берём write lock для cleanup
-    seqlock_write_lock(&limiter->seqlock);
+    if (tokens_to_add > 0) {
+        uint64_t new_tokens = (uint64_t)bucket->tokens + tokens_to_add;
 
-    // Подсчитываем количество для удаления
-    size_t to_delete_count = 0;
-    for (map_iterator_t it = map_begin(limiter->buckets); map_iterator_valid(it); it = map_next(it)) {
-        ratelimiter_bucket_t* bucket = map_iterator_value(it);
-        uint64_t last_access = atomic_load(&bucket->last_access_ns);
-        if (now - last_access > cleanup_interval_ns) {
-            to_delete_count++;
+        if (new_tokens > config->max_tokens) {
+            new_tokens = config->max_tokens;
         }
-    }
 
-    if (to_delete_count > 0) {
-        in_addr_t* ips_to_delete = malloc(to_delete_count * sizeof(in_addr_t));
-        if (ips_to_delete) {
-            size_t idx = 0;
-            for (map_iterator_t it = map_begin(limiter->buckets); map_iterator_valid(it); it = map_next(it)) {
-                ratelimiter_bucket_t* bucket = map_iterator_value(it);
-                uint64_t last_access = atomic_load(&bucket->last_access_ns);
-                if (now - last_access > cleanup_interval_ns) {
-                    ips_to_delete[idx++] = bucket->ip;
-                }
-            }
-
-            for (size_t i = 0; i < to_delete_count; i++) {
-                map_erase(limiter->buckets, (void*)(uintptr_t)ips_to_delete[i]);
-            }
-
-            free(ips_to_delete);
-        }
+        bucket->tokens = (uint32_t)new_tokens;
+        bucket->last_refill_ns = now;
     }
-
-    seqlock_write_unlock(&limiter->seqlock);
 }
 
 // =============================================================================
@@ -228,19 +231,21 @@ static void cleanup_old_buckets(ratelimiter_t* limiter) {
 ratelimiter_t* ratelimiter_init(ratelimiter_config_t* config) {
     if (!config) return NULL;
 
-    ratelimiter_t* limiter = malloc(sizeof(ratelimiter_t));
+    ratelimiter_t* limiter = aligned_alloc(64, sizeof(ratelimiter_t));
     if (!limiter) return NULL;
 
     limiter->config = *config;
+    limiter->cleanup_interval_ns = (uint64_t)config->cleanup_interval_s * 1000000000ULL;
 
-    limiter->buckets = map_create_ex(compare_ip, NULL, NULL, NULL, bucket_free_fn);
-    if (!limiter->buckets) {
-        free(limiter);
-        return NULL;
-    }
+    for (int i = 0; i < RATELIMITER_SHARDS; i++) {
+        ratelimiter_shard_t* shard = &limiter->shards[i];
 
-    seqlock_init(&limiter->seqlock);
-    atomic_init(&limiter->last_cleanup_ns, ratelimiter_get_time_ns());
+        atomic_flag_clear(&shard->locked);
+        shard->slots = NULL;
+        shard->capacity = 0;
+        shard->count = 0;
+        shard->cleanup_cursor = 0;
+    }
 
     return limiter;
 }
@@ -248,38 +253,65 @@ ratelimiter_t* ratelimiter_init(ratelimiter_config_t* config) {
 void ratelimiter_free(ratelimiter_t* limiter) {
     if (!limiter) return;
 
-    map_free(limiter->buckets);
+    for (int i = 0; i < RATELIMITER_SHARDS; i++)
+        free(limiter->shards[i].slots);
+
     free(limiter);
 }
 
 int ratelimiter_allow(ratelimiter_t* limiter, in_addr_t ip, uint32_t tokens_required) {
     if (!limiter) return 1;
 
-    cleanup_old_buckets(limiter);
-    
     if (limiter->config.refill_rate == 0)
         return 1;
 
-    ratelimiter_bucket_t* bucket = find_or_create_bucket(limiter, ip);
+    const uint32_t hash = hash_ip(ip);
+    ratelimiter_shard_t* shard = shard_of(limiter, hash);
+
+    spinlock_lock(&shard->locked);
+
+    // Время снимается под блокировкой: бакеты части обновляются по порядку
+    const uint64_t now = ratelimiter_get_time_ns();
+
+    ratelimiter_bucket_t* bucket = shard_find(shard, ip, hash);
+    if (!bucket)
+        bucket = shard_insert(limiter, shard, ip, hash, now);
+
     if (!bucket) {
+        spinlock_unlock(&shard->locked);
         log_error("Failed to create rate limiter bucket");
         return 1;
     }
 
-    spinlock_lock(&bucket->locked);
+    bucket_refill(bucket, &limiter->config, now);
+    bucket->last_access_ns = now;
 
-    bucket_refill(bucket, &limiter->config);
-    atomic_store(&bucket->last_access_ns, ratelimiter_get_time_ns());
-
-    uint32_t current_tokens = atomic_load(&bucket->tokens);
     int allowed = 0;
 
-    if (current_tokens >= tokens_required) {
-        atomic_store(&bucket->tokens, current_tokens - tokens_required);
+    if (bucket->tokens >= tokens_required) {
+        bucket->tokens -= tokens_required;
         allowed = 1;
     }
 
-    spinlock_unlock(&bucket->locked);
+    // Удаление сдвигает записи, поэтому bucket дальше не используется
+    shard_cleanup_step(limiter, shard, now);
+
+    spinlock_unlock(&shard->locked);
 
     return allowed;
 }
+
+size_t ratelimiter_size(ratelimiter_t* limiter) {
+    if (!limiter) return 0;
+
+    size_t size = 0;
+    for (int i = 0; i < RATELIMITER_SHARDS; i++) {
+        ratelimiter_shard_t* shard = &limiter->shards[i];
+
+        spinlock_lock(&shard->locked);
+        size += shard->count;
+        spinlock_unlock(&shard->locked);
+    }
+
+    return size;
+}
@@ -6,13 +6,34 @@
 #include <time.h>
 #include <netinet/in.h>
 
-#include "map.h"
-
 /**
  * Rate Limiter - реализация Token Bucket алгоритма
- * Lock-free реализация с использованием seqlock для map_t (Red-Black Tree)
+ *
+ * Bucket'ы лежат в хеш-таблице с открытой адресацией (линейное пробирование),
+ * разбитой на RATELIMITER_SHARDS независимых частей со своим spinlock.
+ * Новый IP блокирует только свою часть, рост таблицы перестраивает только её.
+ * Устаревшие записи удаляются понемногу при каждом обращении к части,
+ * без обхода всей таблицы.
  */
 
+#define RATELIMITER_SHARDS 64                 // Степень двойки
+#define RATELIMITER_SHARD_CAPACITY_MIN 64     // Слотов в части при первой вставке
+#define RATELIMITER_CLEANUP_STEP 4            // Слотов, проверяемых за одно обращение
+
+// Spinlock частей таблицы, общий с ключевым ограничителем framework/ratelimit
+static inline void spinlock_lock(atomic_flag* lock) {
+    while (atomic_flag_test_and_set_explicit(lock, memory_order_acquire)) {
+        // Spin with pause hint for better performance
+        #if defined(__x86_64__) || defined(__i386__)
+        __asm__ __volatile__("pause");
+        #endif
+    }
+}
+
+static inline void spinlock_unlock(atomic_flag* lock) {
+    atomic_flag_clear_explicit(lock, memory_order_release);
+}
+
 // Конфигурация rate limiter
 typedef struct ratelimiter_config {
     uint32_t max_tokens;           // Максимальное количество токенов (burst)
@@ -21,26 +42,27 @@ typedef struct ratelimiter_config {
     uint32_t cleanup_interval_s;   // Интервал очистки старых записей (в секундах)
 } ratelimiter_config_t;
 
-// Bucket для одного IP адреса
+// Bucket для одного IP адреса. Меняется только под локом своей части;
+// выравнивание не даёт bucket'у занять две кэш-линии
 typedef struct ratelimiter_bucket {
-    in_addr_t ip;                          // IP адрес клиента
-    atomic_uint_fast32_t tokens;           // Текущее количество токенов
-    atomic_uint_fast64_t last_refill_ns;   // Время последнего пополнения (наносекунды)
-    atomic_uint_fast64_t last_access_ns;   // Время последнего доступа
-    atomic_flag locked;                    // Spinlock для bucket
-} ratelimiter_bucket_t;
+    uint64_t last_access_ns;       // Время последнего доступа, 0 - слот свободен
+    uint64_t last_refill_ns;       // Время последнего пополнения (наносекунды)
+    uint32_t tokens;               // Текущее количество токенов
+    in_addr_t ip;                  // IP адрес клиента
+} __attribute__((aligned(32))) ratelimiter_bucket_t;
 
-// Seqlock для lock-free чтения map
-typedef struct ratelimiter_seqlock {
-    atomic_uint_fast64_t seq;              // Sequence counter (чётный = стабильно)
-    atomic_flag write_lock;                // Spinlock для писателей
-} ratelimiter_seqlock_t;
+typedef struct ratelimiter_shard {
+    atomic_flag locked;
+    ratelimiter_bucket_t* slots;
+    uint32_t capacity;             // Степень двойки, 0 - таблица ещё не создана
+    uint32_t count;
+    uint32_t cleanup_cursor;       // Следующий слот для проверки на устаревание
+} __attribute__((aligned(64))) ratelimiter_shard_t;
 
 typedef struct ratelimiter {
     ratelimiter_config_t config;
-    map_t* buckets;                        // map_t: in_addr_t -> ratelimiter_bucket_t*
-    ratelimiter_seqlock_t seqlock;         // Seqlock для lock-free доступа
-    atomic_uint_fast64_t last_cleanup_ns;
+    uint64_t cleanup_interval_ns;
+    ratelimiter_shard_t shards[RATELIMITER_SHARDS];
 } ratelimiter_t;
 
 /**
@@ -62,6 +84,11 @@ void ratelimiter_free(ratelimiter_t* limiter);
  */
 int ratelimiter_allow(ratelimiter_t* limiter, in_addr_t ip, uint32_t tokens_required);
 
+/**
+ * Количество хранимых bucket'ов (для статистики и тестов)
+ */
+size_t ratelimiter_size(ratelimiter_t* limiter);
+
 /**
  * Получить текущее время в наносекундах (монотонное время)
  */
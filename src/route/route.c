@@ -1,6 +1,7 @@
 #include <string.h>
 
 #include "log.h"
+#include "metrics.h"
 #include "route.h"
 
 #define ROUTE_EMPTY_PATH "Route error: Empty path\n"
@@ -63,6 +64,7 @@ route_t* route_create(const char* dirty_location) {
     route->path = parser.path;
     route->path_length = strlen(parser.path);
     route->param = parser.first_param;
+    route->metrics_id = metrics_route_register(dirty_location);
     parser.path = NULL;
     parser.first_param = NULL;
 
@@ -108,6 +110,11 @@ route_t* route_init_route() {
     route->static_file[ROUTE_PATCH] = NULL;
     route->static_file[ROUTE_HEAD] = NULL;
 
+    for (int i = 0; i < 7; i++) {
+        route->priority[i] = ROUTE_PRIORITY_NORMAL;
+        route->concurrencylimiter[i] = NULL;
+    }
+
     route->location_erroffset = 0;
     route->location = NULL;
     route->is_primitive = 0;
@@ -115,6 +122,7 @@ route_t* route_init_route() {
     route->param = NULL;
     route->next = NULL;
     route->ratelimiter = NULL;
+    route->metrics_id = METRICS_ROUTE_NONE;
 
     return route;
 }
@@ -449,6 +457,38 @@ int route_set_http_static(route_t* route, const char* method, const char* static
     return 1;
 }
 
+int route_set_priority(route_t* route, const char* method, const char* priority) {
+    const int m = route_method_index(method);
+    if (m == ROUTE_NONE) return 0;
+
+    if (strcmp(priority, "high") == 0)
+        route->priority[m] = ROUTE_PRIORITY_HIGH;
+    else if (strcmp(priority, "normal") == 0)
+        route->priority[m] = ROUTE_PRIORITY_NORMAL;
+    else if (strcmp(priority, "low") == 0)
+        route->priority[m] = ROUTE_PRIORITY_LOW;
+    else
+        return 0;
+
+    return 1;
+}
+
+int route_set_max_in_flight(route_t* route, const char* method, unsigned int max) {
+    const int m = route_method_index(method);
+    if (m == ROUTE_NONE) return 0;
+
+    concurrencylimiter_t* limiter = concurrencylimiter_create(max);
+    if (limiter == NULL) {
+        log_error(ROUTE_OUT_OF_MEMORY);
+        return 0;
+    }
+
+    concurrencylimiter_free(route->concurrencylimiter[m]);
+    route->concurrencylimiter[m] = limiter;
+
+    return 1;
+}
+
 int route_set_websockets_handler(route_t* route, const char* method, void(*function)(void*), ratelimiter_t* ratelimiter) {
     const int m = route_ws_method_index(method);
     if (m == ROUTE_NONE) {
@@ -487,6 +527,8 @@ void routes_free(route_t* route) {
         for (int i = 0; i < 7; i++) {
             if (route->static_file[i] != NULL)
                 free(route->static_file[i]);
+
+            concurrencylimiter_free(route->concurrencylimiter[i]);
         }
 
         free(route->path);
@@ -6,6 +6,7 @@
 #include "request.h"
 #include "response.h"
 #include "ratelimiter.h"
+#include "concurrencylimiter.h"
 
 typedef enum route_methods {
     ROUTE_NONE = -1,
@@ -18,6 +19,14 @@ typedef enum route_methods {
     ROUTE_HEAD
 } route_methods_e;
 
+// Классы приоритета обработчиков в общей очереди
+typedef enum route_priority {
+    ROUTE_PRIORITY_HIGH = 0,
+    ROUTE_PRIORITY_NORMAL,
+    ROUTE_PRIORITY_LOW,
+    ROUTE_PRIORITY_COUNT
+} route_priority_e;
+
 typedef struct route_param {
     unsigned short int start;
     unsigned short int end;
@@ -38,13 +47,18 @@ typedef struct route {
     struct route* next;
     void(*handler[7])(void*);
     char* static_file[7];
+    route_priority_e priority[7];
+    concurrencylimiter_t* concurrencylimiter[7];
     ratelimiter_t* ratelimiter;
+    unsigned int metrics_id;
 } route_t;
 
 route_t* route_create(const char*);
 int route_set_http_handler(route_t*, const char*, void(*)(void*), ratelimiter_t* ratelimiter);
 int route_set_http_static(route_t*, const char* method, const char* static_file, ratelimiter_t* ratelimiter);
 int route_set_websockets_handler(route_t*, const char*, void(*)(void*), ratelimiter_t* ratelimiter);
+int route_set_priority(route_t*, const char* method, const char* priority);
+int route_set_max_in_flight(route_t*, const char* method, unsigned int max);
 void routes_free(route_t* route);
 int route_compare_primitive(route_t*, const char*, size_t);
 
@@ -4,11 +4,16 @@
 #include <pthread.h>
 
 #include "log.h"
+#include "epoch.h"
 #include "server.h"
 
 void broadcast_free(struct broadcast* broadcast);
 void middlewares_free(struct middleware_item* middleware_item);
 
+static epoch_t __routing_epoch = EPOCH_INITIALIZER;
+static _Thread_local int __routing_depth = 0;
+static _Thread_local unsigned long __routing_token = 0;
+
 server_t* server_create() {
     server_t* server = malloc(sizeof * server);
     if (server == NULL) return NULL;
@@ -19,20 +24,25 @@ server_t* server_create() {
     
     server->ip = 0;
     server->root = NULL;
+    server->metrics_path = NULL;
+    server->metrics_path_length = 0;
+    server->profiler_path = NULL;
+    server->profiler_path_length = 0;
+    server->server_timing = 0;
+    server->precompressed = 0;
     server->index = NULL;
-    server->http.route = NULL;
-    server->http.redirect = NULL;
-    server->http.middleware = NULL;
-    server->http.ratelimiter = NULL;
-    server->websockets.default_handler = NULL;
-    server->websockets.route = NULL;
-    server->websockets.middleware = NULL;
-    server->websockets.ratelimiter = NULL;
+    atomic_init(&server->routing, server_routing_create());
     server->openssl = NULL;
     server->broadcast = NULL;
     server->ratelimits_config = NULL;
+    server->filecache = NULL;
     server->next = NULL;
 
+    if (atomic_load(&server->routing) == NULL) {
+        free(server);
+        return NULL;
+    }
+
     return server;
 }
 
@@ -50,30 +60,19 @@ void servers_free(server_t* server) {
 
         if (server->root) free(server->root);
         server->root = NULL;
-        
-        if (server->index) server_index_destroy(server->index);
-        server->index = NULL;
-
-        if (server->http.redirect) redirect_free(server->http.redirect);
-        server->http.redirect = NULL;
-
-        if (server->http.middleware) middlewares_free(server->http.middleware);
-        server->http.middleware = NULL;
-
-        if (server->http.route) routes_free(server->http.route);
-        server->http.route = NULL;
 
-        if (server->http.ratelimiter) ratelimiter_free(server->http.ratelimiter);
-        server->http.ratelimiter = NULL;
+        if (server->metrics_path) free(server->metrics_path);
+        server->metrics_path = NULL;
+        server->metrics_path_length = 0;
 
-        if (server->websockets.route) routes_free(server->websockets.route);
-        server->websockets.route = NULL;
+        if (server->profiler_path) free(server->profiler_path);
+        server->profiler_path = NULL;
+        server->profiler_path_length = 0;
 
-        if (server->websockets.middleware) middlewares_free(server->websockets.middleware);
-        server->websockets.middleware = NULL;
+        if (server->index) server_index_destroy(server->index);
+        server->index = NULL;
 
-        if (server->websockets.ratelimiter) ratelimiter_free(server->websockets.ratelimiter);
-        server->websockets.ratelimiter = NULL;
+        server_routing_free(atomic_exchange(&server->routing, NULL));
 
         if (server->openssl) openssl_free(server->openssl);
         server->openssl = NULL;
@@ -84,6 +83,9 @@ void servers_free(server_t* server) {
         if (server->ratelimits_config) map_free(server->ratelimits_config);
         server->ratelimits_config = NULL;
 
+        if (server->filecache) filecache_free(server->filecache);
+        server->filecache = NULL;
+
         server->next = NULL;
 
         free(server);
@@ -157,3 +159,71 @@ void server_chain_destroy(server_chain_t* server_chain) {
 
     free(server_chain);
 }
+
+server_routing_t* server_routing_create(void) {
+    server_routing_t* routing = malloc(sizeof * routing);
+    if (routing == NULL) return NULL;
+
+    routing->http.route = NULL;
+    routing->http.redirect = NULL;
+    routing->http.middleware = NULL;
+    routing->http.ratelimiter = NULL;
+    routing->websockets.default_handler = NULL;
+    routing->websockets.route = NULL;
+    routing->websockets.middleware = NULL;
+    routing->websockets.ratelimiter = NULL;
+
+    return routing;
+}
+
+void server_routing_free(void* arg) {
+    server_routing_t* routing = arg;
+    if (routing == NULL) return;
+
+    if (routing->http.redirect) redirect_free(routing->http.redirect);
+    if (routing->http.middleware) middlewares_free(routing->http.middleware);
+    if (routing->http.route) routes_free(routing->http.route);
+    if (routing->http.ratelimiter) ratelimiter_free(routing->http.ratelimiter);
+    if (routing->websockets.route) routes_free(routing->websockets.route);
+    if (routing->websockets.middleware) middlewares_free(routing->websockets.middleware);
+    if (routing->websockets.ratelimiter) ratelimiter_free(routing->websockets.ratelimiter);
+
+    free(routing);
+}
+
+unsigned long server_routing_enter(void) {
+    const unsigned long token = server_routing_hold();
+    if (__routing_depth++ == 0)
+        __routing_token = token;
+
+    return token;
+}
+
+void server_routing_exit(unsigned long token) {
+    __routing_depth--;
+    server_routing_release(token);
+}
+
+// Вложенная метка берёт эпоху внешней: новая могла бы уже не защищать прочитанное
+unsigned long server_routing_hold(void) {
+    if (__routing_depth > 0)
+        return epoch_hold(&__routing_epoch, __routing_token);
+
+    return epoch_enter(&__routing_epoch);
+}
+
+void server_routing_release(unsigned long token) {
+    epoch_exit(&__routing_epoch, token);
+}
+
+server_routing_t* server_routing(server_t* server) {
+    return atomic_load(&server->routing);
+}
+
+void server_routing_publish(server_t* server, server_routing_t* routing) {
+    server_routing_retire(atomic_exchange(&server->routing, routing), server_routing_free);
+}
+
+void server_routing_retire(void* ptr, void(*free_cb)(void*)) {
+    epoch_retire(&__routing_epoch, ptr, free_cb);
+}
@@ -11,6 +11,7 @@
 #include "domain.h"
 #include "openssl.h"
 #include "ratelimiter.h"
+#include "filecache.h"
 
 struct middleware_item;
 
@@ -33,20 +34,37 @@ typedef struct server_websockets {
     struct middleware_item* middleware;
 } server_websockets_t;
 
+/**
+ * Маршрутизация сервера: маршруты, перенаправления, middleware и ограничители.
+ * Снимок неизменяем после публикации. Перезагрузка маршрутов публикует новый
+ * снимок, а старый освобождается, когда закончатся начатые на нём запросы.
+ * Читать снимок можно только между server_routing_enter и server_routing_exit.
+ */
+typedef struct server_routing {
+    server_http_t http;
+    server_websockets_t websockets;
+} server_routing_t;
+
 struct broadcast;
 
 typedef struct server {
     unsigned short int port;
     size_t root_length;
     in_addr_t ip;
-    server_http_t http;
-    server_websockets_t websockets;
+    _Atomic(server_routing_t*) routing;
 
     char* root;
+    char* metrics_path;       // NULL - метрики не отдаются
+    size_t metrics_path_length;
+    char* profiler_path;      // NULL - профилировщик недоступен
+    size_t profiler_path_length;
+    int server_timing;        // Заголовок Server-Timing в ответах
+    int precompressed;        // Отдавать сжатые копии file.br/.zst/.gz
     domain_t* domain;
     index_t* index;
     openssl_t* openssl;
     map_t* ratelimits_config; // ratelimiter_config_t
+    filecache_t* filecache;   // NULL - open file cache выключен
     struct broadcast* broadcast;
     struct server* next;
 } server_t;
@@ -65,4 +83,34 @@ void servers_free(server_t* server);
 server_chain_t* server_chain_create(server_t* server, routeloader_lib_t*);
 void server_chain_destroy(server_chain_t*);
 
+server_routing_t* server_routing_create(void);
+void server_routing_free(void* routing);
+
+/**
+ * Начало и конец чтения снимков маршрутизации в текущем потоке
+ */
+unsigned long server_routing_enter(void);
+void server_routing_exit(unsigned long token);
+
+/**
+ * Метка, которую можно вернуть из другого потока. Внутри server_routing_enter
+ * она защищает всё, что уже прочитано в текущем потоке: задание в очереди
+ * обработчиков держит так найденный маршрут, его ограничители и обработчик
+ */
+unsigned long server_routing_hold(void);
+void server_routing_release(unsigned long token);
+
+server_routing_t* server_routing(server_t* server);
+
+/**
+ * Публикует новый снимок; старый освобождается после выхода его читателей
+ */
+void server_routing_publish(server_t* server, server_routing_t* routing);
+
+/**
+ * Отложенное освобождение данных, на которые ссылаются снятые снимки
+ * (например, библиотек обработчиков)
+ */
+void server_routing_retire(void* ptr, void(*free_cb)(void*));
+
 #endif
@@ -16,6 +16,7 @@
 #include <pthread.h>
 
 #include "log.h"
+#include "accesslog.h"
 #include "moduleloader.h"
 #include "signal.h"
 #include "appconfig.h"
@@ -56,16 +57,20 @@ void print_stack_trace(void) {
 
 void signal_before_undefined_instruction(__attribute__((unused))int s) {
     signal_flush_streams();
+    // Фоновый поток журнала может не успеть записать сообщение
+    log_sync();
     log_error("[signal_before_undefined_instruction] Недопустимая инструкция\n");
 }
 
 void signal_before_float_point(__attribute__((unused))int s) {
     signal_flush_streams();
+    log_sync();
     log_error("[signal_before_float_point] Ошибка с плавающей запятой - переполнение, или деление на ноль\n");
 }
 
 void signal_before_segmentation_fault(__attribute__((unused))int s) {
     signal_flush_streams();
+    log_sync();
     print_stack_trace();
     log_error("[signal_before_segmentation_fault] Ошибка доступа к памяти\n");
     _exit(1);
@@ -79,6 +84,7 @@ void signal_before_terminate(__attribute__((unused))int s) {
 
 void signal_before_abort(__attribute__((unused))int s) {
     signal_flush_streams();
+    log_sync();
     log_error("[signal_before_abort] Аварийное завершение\n");
     exit(1);
 }
@@ -152,21 +158,44 @@ void signal_USR1(__attribute__((unused))int s) {
     }
 }
 
+// Замена маршрутов без перезапуска потоков
+void signal_USR2(__attribute__((unused))int s) {
+    signal_flush_streams();
+    log_error("signal USR2\n");
+
+    if (module_loader_signal_locked()) {
+        log_info("signal_USR2: wait reload\n");
+        return;
+    }
+
+    module_loader_signal_lock();
+    module_loader_routes_reload();
+    module_loader_signal_unlock();
+}
+
+// Внешняя ротация переместила журналы: только флаги и пробуждение фоновых потоков
+void signal_HUP(__attribute__((unused))int s) {
+    log_reopen();
+    accesslog_reopen();
+}
+
 void signal_init(void) {
     signal(SIGPIPE, SIG_IGN);
     signal(SIGILL,  signal_before_undefined_instruction);
     signal(SIGFPE,  signal_before_float_point);
     signal(SIGSEGV, signal_before_segmentation_fault);
-    signal(SIGHUP,  SIG_IGN);
+    signal(SIGHUP,  signal_HUP);
     signal(SIGBUS,  signal_before_segmentation_fault);
     signal(SIGABRT, signal_before_abort);
     signal(SIGUSR1, signal_USR1);
-    signal(SIGUSR2, SIG_IGN);
+    signal(SIGUSR2, signal_USR2);
 }
 
-void signal_block_usr1(void) {
+// Перезагрузка не должна прерывать поток сервера посреди чтения снимков
+void signal_block_reload(void) {
     sigset_t mask;
     sigemptyset(&mask);
     sigaddset(&mask, SIGUSR1);
+    sigaddset(&mask, SIGUSR2);
     pthread_sigmask(SIG_BLOCK, &mask, NULL);
 }
@@ -3,6 +3,6 @@
 
 void signal_init(void);
 void signal_before_terminate(int);
-void signal_block_usr1(void);
+void signal_block_reload(void);
 
 #endif
\ No newline at end of file
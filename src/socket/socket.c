@@ -8,6 +8,7 @@
 
 #include "log.h"
 #include "socket.h"
+#include "sockethandoff.h"
 
 static int __socket_set_options(int socket);
 
@@ -91,6 +92,11 @@ int socket_listen_create(in_addr_t ip, unsigned short int port) {
         return -1;
     }
 
+    // Сокет, полученный от предыдущего процесса, уже привязан и слушает
+    const int inherited = socket_handoff_take(ip, port);
+    if (inherited != -1)
+        return inherited;
+
     const int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
     if (fd == -1) {
         log_error("Socket error: Can't create socket on %s:%d\n", ip_str, port);
@@ -0,0 +1,259 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include "log.h"
+#include "sockethandoff.h"
+
+// Сокетов в одном сообщении; предел ядра SCM_MAX_FD - 253
+#define SOCKET_HANDOFF_BATCH 64
+#define SOCKET_HANDOFF_MAX 1024
+#define SOCKET_HANDOFF_READY 'R'
+
+typedef struct {
+    int fd;
+    in_addr_t ip;
+    unsigned short int port;
+} socket_handoff_item_t;
+
+static socket_handoff_item_t __items[SOCKET_HANDOFF_MAX];
+static int __items_count = 0;
+static pthread_mutex_t __items_mutex = PTHREAD_MUTEX_INITIALIZER;
+static atomic_bool __sent = 0;
+
+static int __socket_handoff_listening_address(int fd, in_addr_t* ip, unsigned short int* port);
+static int __socket_handoff_collect(int* fds, int max);
+static int __socket_handoff_send_batch(int channel, const int* fds, uint32_t count);
+static int __socket_handoff_receive_batch(int channel, int* fds, uint32_t* count);
+
+int socket_handoff_send(int channel) {
+    int fds[SOCKET_HANDOFF_MAX];
+    const int count = __socket_handoff_collect(fds, SOCKET_HANDOFF_MAX);
+    if (count < 0) return -1;
+
+    for (int i = 0; i < count; i += SOCKET_HANDOFF_BATCH) {
+        const int batch = count - i < SOCKET_HANDOFF_BATCH ? count - i : SOCKET_HANDOFF_BATCH;
+        if (!__socket_handoff_send_batch(channel, &fds[i], batch))
+            return -1;
+    }
+
+    // пустое сообщение завершает передачу
+    if (!__socket_handoff_send_batch(channel, NULL, 0))
+        return -1;
+
+    // Пока новый процесс не подтвердил приём, сокеты остаются только нашими:
+    // при его сбое работа продолжается, и закрывать их нужно как обычно
+    char ready = 0;
+    if (recv(channel, &ready, sizeof(ready), 0) != sizeof(ready) || ready != SOCKET_HANDOFF_READY)
+        return -1;
+
+    atomic_store(&__sent, 1);
+
+    return count;
+}
+
+int socket_handoff_ack(int channel) {
+    const char ready = SOCKET_HANDOFF_READY;
+
+    return send(channel, &ready, sizeof(ready), MSG_NOSIGNAL) == sizeof(ready);
+}
+
+int socket_handoff_receive(int channel) {
+    int received = 0;
+
+    while (1) {
+        int fds[SOCKET_HANDOFF_BATCH];
+        uint32_t count = 0;
+        if (!__socket_handoff_receive_batch(channel, fds, &count))
+            return -1;
+
+        if (count == 0)
+            break;
+
+        pthread_mutex_lock(&__items_mutex);
+        for (uint32_t i = 0; i < count; i++) {
+            in_addr_t ip = 0;
+            unsigned short int port = 0;
+            if (__items_count == SOCKET_HANDOFF_MAX || !__socket_handoff_listening_address(fds[i], &ip, &port)) {
+                close(fds[i]);
+                continue;
+            }
+
+            __items[__items_count].fd = fds[i];
+            __items[__items_count].ip = ip;
+            __items[__items_count].port = port;
+            __items_count++;
+            received++;
+        }
+        pthread_mutex_unlock(&__items_mutex);
+    }
+
+    return received;
+}
+
+int socket_handoff_take(in_addr_t ip, unsigned short int port) {
+    int fd = -1;
+
+    pthread_mutex_lock(&__items_mutex);
+    for (int i = 0; i < __items_count; i++) {
+        if (__items[i].ip != ip || __items[i].port != port) continue;
+
+        fd = __items[i].fd;
+        __items[i] = __items[__items_count - 1];
+        __items_count--;
+        break;
+    }
+    pthread_mutex_unlock(&__items_mutex);
+
+    return fd;
+}
+
+int socket_handoff_unclaimed(void) {
+    pthread_mutex_lock(&__items_mutex);
+    const int count = __items_count;
+    pthread_mutex_unlock(&__items_mutex);
+
+    return count;
+}
+
+/*
+ * Невостребованный сокет нельзя держать открытым: ядро продолжит раздавать
+ * ему соединения из группы SO_REUSEPORT, и их никто не примет.
+ */
+void socket_handoff_close_unclaimed(void) {
+    pthread_mutex_lock(&__items_mutex);
+    for (int i = 0; i < __items_count; i++)
+        close(__items[i].fd);
+    __items_count = 0;
+    pthread_mutex_unlock(&__items_mutex);
+}
+
+int socket_handoff_sent(void) {
+    return atomic_load(&__sent);
+}
+
+int __socket_handoff_listening_address(int fd, in_addr_t* ip, unsigned short int* port) {
+    int accepting = 0;
+    socklen_t optlen = sizeof(accepting);
+    if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &accepting, &optlen) == -1 || !accepting)
+        return 0;
+
+    struct sockaddr_in sa;
+    socklen_t len = sizeof(sa);
+    if (getsockname(fd, (struct sockaddr*)&sa, &len) == -1 || sa.sin_family != AF_INET)
+        return 0;
+
+    *ip = sa.sin_addr.s_addr;
+    *port = ntohs(sa.sin_port);
+
+    return 1;
+}
+
+int __socket_handoff_collect(int* fds, int max) {
+    DIR* dir = opendir("/proc/self/fd");
+    if (dir == NULL) {
+        log_error("socket_handoff_send: can't open /proc/self/fd\n");
+        return -1;
+    }
+
+    const int dir_fd = dirfd(dir);
+    int count = 0;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL && count < max) {
+        if (entry->d_name[0] == '.') continue;
+
+        const int fd = atoi(entry->d_name);
+        if (fd <= 2 || fd == dir_fd) continue;
+
+        struct stat sb;
+        if (fstat(fd, &sb) != 0 || !S_ISSOCK(sb.st_mode)) continue;
+
+        in_addr_t ip = 0;
+        unsigned short int port = 0;
+        if (!__socket_handoff_listening_address(fd, &ip, &port)) continue;
+
+        fds[count++] = fd;
+    }
+
+    closedir(dir);
+
+    return count;
+}
+
+int __socket_handoff_send_batch(int channel, const int* fds, uint32_t count) {
+    char control[CMSG_SPACE(sizeof(int) * SOCKET_HANDOFF_BATCH)];
+    memset(control, 0, sizeof(control));
+
+    struct iovec iov = {
+        .iov_base = &count,
+        .iov_len = sizeof(count)
+    };
+
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    if (count > 0) {
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * count);
+    }
+
+    if (sendmsg(channel, &msg, MSG_NOSIGNAL) != (ssize_t)sizeof(count)) {
+        log_error("socket_handoff_send: sendmsg failed\n");
+        return 0;
+    }
+
+    return 1;
+}
+
+int __socket_handoff_receive_batch(int channel, int* fds, uint32_t* count) {
+    char control[CMSG_SPACE(sizeof(int) * SOCKET_HANDOFF_BATCH)];
+
+    struct iovec iov = {
+        .iov_base = count,
+        .iov_len = sizeof(*count)
+    };
+
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    if (recvmsg(channel, &msg, MSG_CMSG_CLOEXEC) != (ssize_t)sizeof(*count)) {
+        log_error("socket_handoff_receive: recvmsg failed\n");
+        return 0;
+    }
+
+    uint32_t received = 0;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+
+        received = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * received);
+    }
+
+    if (received != *count || (msg.msg_flags & MSG_CTRUNC)) {
+        for (uint32_t i = 0; i < received; i++)
+            close(fds[i]);
+
+        log_error("socket_handoff_receive: descriptors lost in transfer\n");
+        return 0;
+    }
+
+    return 1;
+}
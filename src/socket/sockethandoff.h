@@ -0,0 +1,49 @@
+#ifndef __SOCKETHANDOFF__
+#define __SOCKETHANDOFF__
+
+#include <arpa/inet.h>
+
+/**
+ * Передача слушающих сокетов между процессами через SCM_RIGHTS.
+ *
+ * Старый процесс отправляет все свои слушающие inet-сокеты, новый складывает
+ * их в запас, и socket_listen_create забирает оттуда сокет с тем же адресом
+ * вместо создания нового. Очередь принятых ядром соединений при этом
+ * не теряется: сокет остаётся тем же, меняется только владелец.
+ */
+
+/**
+ * Отправляет все слушающие inet-сокеты процесса в канал и ждёт
+ * подтверждения socket_handoff_ack от принимающей стороны
+ * @return количество отправленных сокетов или -1, в том числе без подтверждения
+ */
+int socket_handoff_send(int channel);
+
+/**
+ * Подтверждает, что принятые сокеты разобраны и процесс готов работать
+ * @return 1 или 0 при ошибке записи в канал
+ */
+int socket_handoff_ack(int channel);
+
+/**
+ * Принимает сокеты из канала в запас
+ * @return количество принятых сокетов или -1
+ */
+int socket_handoff_receive(int channel);
+
+/**
+ * Забирает из запаса сокет, слушающий ip:port
+ * @return дескриптор или -1, если подходящего нет
+ */
+int socket_handoff_take(in_addr_t ip, unsigned short int port);
+
+int socket_handoff_unclaimed(void);
+void socket_handoff_close_unclaimed(void);
+
+/**
+ * 1 - сокеты процесса отправлены и разделяются с другим процессом:
+ * закрывать их можно только close, shutdown остановил бы и новый процесс
+ */
+int socket_handoff_sent(void);
+
+#endif
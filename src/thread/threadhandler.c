@@ -2,27 +2,59 @@
 #include <stddef.h>
 #include <pthread.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include "log.h"
 #include "json.h"
+#include "gzip.h"
 #include "signal/signal.h"
 #include "threadhandler.h"
 #include "connection_queue.h"
+#include "metrics.h"
+#include "profiler.h"
+
+// Не чаще одного нового потока за интервал, чтобы всплеск не поднял пул до максимума
+#define THREAD_HANDLER_GROW_INTERVAL_NS 10000000ULL
+
+static atomic_ullong __grown = 0;
+static atomic_ullong __shrunk = 0;
+static atomic_ullong __grow_failed = 0;
+
+static int __thread_handler_spawn(appconfig_t* appconfig);
+static int __thread_handler_need_grow(appconfig_t* appconfig);
+static int __thread_handler_shrink(appconfig_t* appconfig);
+static uint64_t __thread_handler_time_ns(void);
+static void __thread_handler_append_cb(void);
+static void __thread_handler_metrics(str_t* out);
 
 void* thread_handler(void* arg) {
-    signal_block_usr1();
+    signal_block_reload();
+    profiler_thread_init();
 
     appconfig_t* appconfig = arg;
-    appconfg_threads_increment(appconfig);
+    handler_pool_t* pool = &appconfig->handler_pool;
+    const uint64_t idle_timeout = (uint64_t)appconfig->env.main.threads_idle_timeout * 1000000000ULL;
+    uint64_t idle_since = __thread_handler_time_ns();
 
     while (1) {
         if (atomic_load(&appconfig->shutdown))
             break;
 
+        atomic_fetch_add(&pool->idle, 1);
         // connection already locked
         connection_t* connection = connection_queue_guard_pop();
-        if (connection == NULL)
+        atomic_fetch_sub(&pool->idle, 1);
+
+        if (connection == NULL) {
+            if (__thread_handler_time_ns() - idle_since >= idle_timeout && __thread_handler_shrink(appconfig))
+                break;
+
             continue;
+        }
+
+        // очередь не успевает разбираться: поток уходит в работу, новый подхватит очередь
+        if (__thread_handler_need_grow(appconfig))
+            __thread_handler_spawn(appconfig);
 
         connection_server_ctx_t* ctx = connection->ctx;
 
@@ -46,29 +78,156 @@ void* thread_handler(void* arg) {
 
         if (connection_s_dec(connection) == CONNECTION_DEC_RESULT_DECREMENT)
             connection_s_unlock(connection);
+
+        idle_since = __thread_handler_time_ns();
     }
 
-    appconfg_threads_decrement(appconfig);
     json_manager_free();
+    gzip_pool_free();
+    appconfg_threads_decrement(appconfig);
 
     pthread_exit(NULL);
 }
 
 int thread_handler_run(appconfig_t* appconfig, int thread_count) {
+    atomic_store(&appconfig->handler_pool.idle, 0);
+    atomic_store(&appconfig->handler_pool.threads, thread_count);
+
     for (int i = 0; i < thread_count; i++) {
-        pthread_t thread;
-        if (pthread_create(&thread, NULL, thread_handler, appconfig) != 0) {
+        if (!__thread_handler_spawn(appconfig)) {
             log_error("thread_handler_run: unable to create thread handler\n");
             return 0;
         }
-
-        pthread_detach(thread);
-        pthread_setname_np(thread, "Server handler");
     }
 
+    connection_queue_set_append_cb(__thread_handler_append_cb);
+    metrics_register_collector(__thread_handler_metrics);
+
     return 1;
 }
 
 void thread_handlers_wakeup() {
     connection_queue_broadcast();
 }
+
+void thread_handler_stats(thread_handler_stats_t* stats) {
+    if (stats == NULL) return;
+
+    appconfig_t* config = appconfig();
+
+    stats->threads = config != NULL ? atomic_load(&config->handler_pool.threads) : 0;
+    stats->idle = config != NULL ? atomic_load(&config->handler_pool.idle) : 0;
+    stats->threads_min = config != NULL ? (int)config->env.main.threads : 0;
+    stats->threads_max = config != NULL ? (int)config->env.main.threads_max : 0;
+    stats->queue_depth = connection_queue_depth();
+    stats->queue_wait = connection_queue_wait();
+    stats->grown = atomic_load(&__grown);
+    stats->shrunk = atomic_load(&__shrunk);
+    stats->grow_failed = atomic_load(&__grow_failed);
+}
+
+/*
+ * Счётчик threads_count конфигурации увеличивается до создания потока:
+ * иначе конфигурация могла бы освободиться, пока поток ещё не стартовал.
+ */
+int __thread_handler_spawn(appconfig_t* appconfig) {
+    appconfg_threads_increment(appconfig);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, thread_handler, appconfig) != 0) {
+        atomic_fetch_sub(&appconfig->handler_pool.threads, 1);
+        atomic_fetch_add(&__grow_failed, 1);
+        appconfg_threads_decrement(appconfig);
+        return 0;
+    }
+
+    pthread_detach(thread);
+    pthread_setname_np(thread, "Server handler");
+
+    return 1;
+}
+
+/*
+ * Рост разрешён, когда свободных потоков нет, а очередь глубже порога
+ * или её старейший элемент ждёт дольше порога. При успехе место в пуле
+ * уже занято, вызывающий обязан создать поток.
+ */
+int __thread_handler_need_grow(appconfig_t* appconfig) {
+    handler_pool_t* pool = &appconfig->handler_pool;
+    const env_main_t* env_main = &appconfig->env.main;
+
+    if (atomic_load(&appconfig->shutdown))
+        return 0;
+    if (atomic_load(&pool->idle) > 0)
+        return 0;
+    if (atomic_load(&pool->threads) >= (int)env_main->threads_max)
+        return 0;
+
+    if (connection_queue_depth() < (int)env_main->threads_queue_depth &&
+        connection_queue_wait() < (uint64_t)env_main->threads_queue_wait * 1000000ULL)
+        return 0;
+
+    const uint64_t now = __thread_handler_time_ns();
+    unsigned long long last_grow = atomic_load(&pool->last_grow);
+    if (now - last_grow < THREAD_HANDLER_GROW_INTERVAL_NS)
+        return 0;
+    if (!atomic_compare_exchange_strong(&pool->last_grow, &last_grow, now))
+        return 0;
+
+    int threads = atomic_load(&pool->threads);
+    while (threads < (int)env_main->threads_max) {
+        if (atomic_compare_exchange_weak(&pool->threads, &threads, threads + 1)) {
+            atomic_fetch_add(&__grown, 1);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int __thread_handler_shrink(appconfig_t* appconfig) {
+    handler_pool_t* pool = &appconfig->handler_pool;
+    const int threads_min = appconfig->env.main.threads;
+
+    int threads = atomic_load(&pool->threads);
+    while (threads > threads_min) {
+        if (atomic_compare_exchange_weak(&pool->threads, &threads, threads - 1)) {
+            atomic_fetch_add(&__shrunk, 1);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+uint64_t __thread_handler_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Вызывается воркером после постановки в очередь: если все обработчики
+ * заняты (например, ждут базу данных), снять с очереди некому и решение
+ * о росте принимает воркер.
+ */
+void __thread_handler_append_cb(void) {
+    appconfig_t* config = appconfig();
+    if (config == NULL) return;
+
+    if (__thread_handler_need_grow(config))
+        __thread_handler_spawn(config);
+}
+
+void __thread_handler_metrics(str_t* out) {
+    thread_handler_stats_t stats;
+    thread_handler_stats(&stats);
+
+    metrics_render_gauge(out, "cwfr_handler_threads", "Running handler threads", stats.threads);
+    metrics_render_gauge(out, "cwfr_handler_threads_idle", "Handler threads waiting for a job", stats.idle);
+    metrics_render_gauge(out, "cwfr_handler_queue_depth", "Connections in the shared handler queue", stats.queue_depth);
+    metrics_render_gauge(out, "cwfr_handler_queue_oldest_wait_seconds", "Wait of the oldest queued connection", (double)stats.queue_wait / 1e9);
+    metrics_render_counter(out, "cwfr_handler_threads_grown_total", "Handler threads added by the pool", stats.grown);
+    metrics_render_counter(out, "cwfr_handler_threads_shrunk_total", "Handler threads stopped after idling", stats.shrunk);
+    metrics_render_counter(out, "cwfr_handler_threads_grow_failed_total", "Failed handler thread starts", stats.grow_failed);
+}
@@ -1,10 +1,25 @@
 #ifndef __THREADHANDLER__
 #define __THREADHANDLER__
 
+#include <stdint.h>
+
 #include "appconfig.h"
 
+typedef struct thread_handler_stats {
+    int threads;                   // Запущенные потоки
+    int idle;                      // Из них ожидающие задания
+    int threads_min;
+    int threads_max;
+    int queue_depth;               // Соединения в общей очереди
+    uint64_t queue_wait;           // Ожидание старейшего из них, нс
+    unsigned long long grown;      // Потоки, добавленные пулом
+    unsigned long long shrunk;     // Потоки, завершённые после простоя
+    unsigned long long grow_failed;
+} thread_handler_stats_t;
+
 void* thread_handler(void* arg);
 int thread_handler_run(appconfig_t* appconfig, int thread_count);
 void thread_handlers_wakeup();
+void thread_handler_stats(thread_handler_stats_t* stats);
 
 #endif
@@ -5,14 +5,17 @@
 
 #include "log.h"
 #include "json.h"
+#include "gzip.h"
 #include "signal/signal.h"
 #include "multiplexingserver.h"
+#include "profiler.h"
 #include "threadworker.h"
 
 static void(*__thread_worker_threads_shutdown)(void) = NULL;
 
 void* thread_worker(void* arg) {
-    signal_block_usr1();
+    signal_block_reload();
+    profiler_thread_init();
 
     appconfig_t* appconfig = arg;
 
@@ -23,6 +26,7 @@ void* thread_worker(void* arg) {
 
     appconfg_threads_decrement(appconfig);
     json_manager_free();
+    gzip_pool_free();
 
     pthread_exit(NULL);
 }
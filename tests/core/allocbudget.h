@@ -0,0 +1,92 @@
+#ifndef TEST_ALLOCBUDGET_H
+#define TEST_ALLOCBUDGET_H
+
+#include "framework.h"
+#include "alloccount.h"
+
+/* Allocation budgets for hot paths.
+ *
+ * An operation is a function that runs one request (one message, one
+ * render...) from start to finish and releases everything it allocated:
+ *
+ *     static int op_render(void* arg) {
+ *         char* page = render(arg, "storage", "/page.html");
+ *         free(page);
+ *         return page != NULL;
+ *     }
+ *
+ *     TEST_ASSERT_ALLOC_BUDGET(op_render, document, 4, 8192, "view render");
+ *
+ * The operation runs ALLOC_BUDGET_WARMUP times unmeasured (lazy caches,
+ * first connection) and then ALLOC_BUDGET_ROUNDS times under the counter.
+ * The assertion fails when the average number of allocations or requested
+ * bytes per run exceeds the budget, or when the measured runs did not free
+ * as many blocks as they allocated. Without the counter (sanitizer builds)
+ * the assertion is skipped. ALLOC_BUDGET_REPORT=1 in the environment prints
+ * the measured numbers of every budget, passing or not. */
+
+#define ALLOC_BUDGET_WARMUP 2
+#define ALLOC_BUDGET_ROUNDS 16
+
+typedef int(*alloc_budget_fn)(void* arg);
+
+/* Average per run in out; frees and allocs stay totals for the leak check.
+ * Returns 0 if any run of the operation failed. */
+static inline int alloc_budget_measure(alloc_budget_fn fn, void* arg, alloccount_t* out) {
+    for (int i = 0; i < ALLOC_BUDGET_WARMUP; i++)
+        if (!fn(arg)) return 0;
+
+    alloccount_t before, after;
+    alloccount_snapshot(&before);
+
+    for (int i = 0; i < ALLOC_BUDGET_ROUNDS; i++)
+        if (!fn(arg)) return 0;
+
+    alloccount_snapshot(&after);
+    alloccount_diff(&before, &after, out);
+
+    return 1;
+}
+
+#define TEST_ASSERT_ALLOC_BUDGET(fn, arg, max_allocs, max_bytes, message) do { \
+    if (!alloccount_enabled()) break; \
+    alloccount_t __budget; \
+    stats.total++; \
+    if (!alloc_budget_measure((fn), (arg), &__budget)) { \
+        PRINT_TEST_CONTEXT(); \
+        stats.failed++; \
+        printf("  " COLOR_RED "[FAIL]" COLOR_RESET " %s: operation failed (line %d)\n", message, __LINE__); \
+        break; \
+    } \
+    stats.passed++; \
+    const unsigned long long __allocs = (__budget.allocs + ALLOC_BUDGET_ROUNDS - 1) / ALLOC_BUDGET_ROUNDS; \
+    const unsigned long long __bytes = (__budget.bytes + ALLOC_BUDGET_ROUNDS - 1) / ALLOC_BUDGET_ROUNDS; \
+    if (getenv("ALLOC_BUDGET_REPORT") != NULL) \
+        printf("  %s: %llu allocations, %llu bytes per run\n", message, __allocs, __bytes); \
+    stats.total++; \
+    if (__allocs <= (unsigned long long)(max_allocs)) { \
+        stats.passed++; \
+    } else { \
+        PRINT_TEST_CONTEXT(); \
+        stats.failed++; \
+        printf("  " COLOR_RED "[FAIL]" COLOR_RESET " %s: %llu allocations per run, budget %llu (line %d)\n", message, __allocs, (unsigned long long)(max_allocs), __LINE__); \
+    } \
+    stats.total++; \
+    if (__bytes <= (unsigned long long)(max_bytes)) { \
+        stats.passed++; \
+    } else { \
+        PRINT_TEST_CONTEXT(); \
+        stats.failed++; \
+        printf("  " COLOR_RED "[FAIL]" COLOR_RESET " %s: %llu bytes per run, budget %llu (line %d)\n", message, __bytes, (unsigned long long)(max_bytes), __LINE__); \
+    } \
+    stats.total++; \
+    if (__budget.frees == __budget.allocs) { \
+        stats.passed++; \
+    } else { \
+        PRINT_TEST_CONTEXT(); \
+        stats.failed++; \
+        printf("  " COLOR_RED "[FAIL]" COLOR_RESET " %s: %llu allocations, %llu frees over %d runs (line %d)\n", message, __budget.allocs, __budget.frees, ALLOC_BUDGET_ROUNDS, __LINE__); \
+    } \
+} while(0)
+
+#endif /* TEST_ALLOCBUDGET_H */
@@ -0,0 +1,108 @@
+#include "alloccount.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+
+#if defined(__SANITIZE_ADDRESS__)
+#define ALLOCCOUNT_DISABLED 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define ALLOCCOUNT_DISABLED 1
+#endif
+#endif
+
+static atomic_ullong __allocs = 0;
+static atomic_ullong __reallocs = 0;
+static atomic_ullong __frees = 0;
+static atomic_ullong __bytes = 0;
+
+#ifndef ALLOCCOUNT_DISABLED
+
+/* The glibc allocator under its internal names */
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void* ptr);
+
+static inline void __count_alloc(size_t size) {
+    atomic_fetch_add_explicit(&__allocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&__bytes, size, memory_order_relaxed);
+}
+
+void* malloc(size_t size) {
+    __count_alloc(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    __count_alloc(count * size);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    if (ptr == NULL)
+        __count_alloc(size);
+    else {
+        atomic_fetch_add_explicit(&__reallocs, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&__bytes, size, memory_order_relaxed);
+    }
+
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+    if (ptr != NULL)
+        atomic_fetch_add_explicit(&__frees, 1, memory_order_relaxed);
+
+    __libc_free(ptr);
+}
+
+void* memalign(size_t alignment, size_t size) {
+    __count_alloc(size);
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    __count_alloc(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) {
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+
+    __count_alloc(size);
+    void* p = __libc_memalign(alignment, size);
+    if (p == NULL)
+        return ENOMEM;
+
+    *ptr = p;
+    return 0;
+}
+
+int alloccount_enabled(void) {
+    return 1;
+}
+
+#else
+
+int alloccount_enabled(void) {
+    return 0;
+}
+
+#endif
+
+void alloccount_snapshot(alloccount_t* out) {
+    out->allocs = atomic_load_explicit(&__allocs, memory_order_relaxed);
+    out->reallocs = atomic_load_explicit(&__reallocs, memory_order_relaxed);
+    out->frees = atomic_load_explicit(&__frees, memory_order_relaxed);
+    out->bytes = atomic_load_explicit(&__bytes, memory_order_relaxed);
+}
+
+void alloccount_diff(const alloccount_t* before, const alloccount_t* after, alloccount_t* out) {
+    out->allocs = after->allocs - before->allocs;
+    out->reallocs = after->reallocs - before->reallocs;
+    out->frees = after->frees - before->frees;
+    out->bytes = after->bytes - before->bytes;
+}
@@ -0,0 +1,29 @@
+#ifndef TEST_ALLOCCOUNT_H
+#define TEST_ALLOCCOUNT_H
+
+#include <stddef.h>
+
+/* Heap allocation counter for benchmarks and allocation budgets.
+ *
+ * alloccount.c replaces malloc/calloc/realloc/free and friends for the whole
+ * process (glibc supports replacing the allocator this way; the framework .so
+ * and libc itself call the replacement) and forwards to the glibc allocator.
+ * Counters are process-wide; take a snapshot before and after the measured
+ * code and subtract.
+ *
+ * Under AddressSanitizer the sanitizer owns the allocator, so nothing is
+ * replaced and alloccount_enabled() returns 0. */
+
+typedef struct {
+    unsigned long long allocs;  /* malloc, calloc, aligned and realloc(NULL) */
+    unsigned long long reallocs;  /* realloc of a live block */
+    unsigned long long frees;
+    unsigned long long bytes;  /* requested, including realloc growth targets */
+} alloccount_t;
+
+int alloccount_enabled(void);
+void alloccount_snapshot(alloccount_t* out);
+/* after - before */
+void alloccount_diff(const alloccount_t* before, const alloccount_t* after, alloccount_t* out);
+
+#endif
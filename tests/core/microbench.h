@@ -0,0 +1,64 @@
+#ifndef TEST_MICROBENCH_H
+#define TEST_MICROBENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "alloccount.h"
+
+/* Microbenchmarks for hot components measured in isolation.
+ *
+ * A benchmark prepares its corpus, runs the measured operation inside
+ * MICROBENCH_LOOP and releases the corpus:
+ *
+ *     MICROBENCH(bench_base64_encode_4k) {
+ *         char in[4096], out[8192];
+ *         ...
+ *         microbench_set_bytes(bench, sizeof(in));
+ *         MICROBENCH_LOOP(bench) {
+ *             base64_encode(out, in, sizeof(in));
+ *         }
+ *     }
+ *
+ * The loop runs in doubling batches until both the minimum time and the
+ * minimum iteration count are reached. Only the loop is timed; heap
+ * allocations are counted over the loop as well (see alloccount.h). */
+
+typedef struct microbench {
+    const char* name;
+    size_t bytes;  /* input bytes per operation, 0 if not applicable */
+    uint64_t iterations;
+    uint64_t batch_end;
+    uint64_t batch;
+    uint64_t min_time_ns;
+    uint64_t min_iterations;
+    uint64_t started_at;
+    uint64_t elapsed_ns;
+    alloccount_t allocs_before;
+    alloccount_t allocs;
+    const char* error;
+} microbench_t;
+
+typedef void (*microbench_fn)(microbench_t* bench);
+
+void microbench_register(const char* name, microbench_fn fn);
+
+void microbench_set_bytes(microbench_t* bench, size_t bytes);
+/* Marks the benchmark as failed: the corpus was rejected or the result is
+ * wrong. The loop stops on the next check. */
+void microbench_fail(microbench_t* bench, const char* message);
+
+void microbench_start(microbench_t* bench);
+int microbench_running(microbench_t* bench);
+
+#define MICROBENCH(name) \
+    static void name(microbench_t* bench); \
+    static void __attribute__((constructor)) register_##name(void) { \
+        microbench_register(#name, name); \
+    } \
+    static void name(microbench_t* bench)
+
+#define MICROBENCH_LOOP(bench) \
+    for (microbench_start(bench); microbench_running(bench); )
+
+#endif
@@ -0,0 +1,99 @@
+// Keyed rate limiting against a local Redis (framework/ratelimit). Two
+// limiters stand for two nodes leasing from the same Redis bucket: together
+// they must not exceed it. Skipped gracefully when no Redis host is
+// configured/reachable, like the other Redis tests.
+
+#include "testdb.h"
+#include "dbquery.h"
+#include "dbresult.h"
+#include "model.h"
+#include "ratelimit.h"
+#include <string.h>
+
+#define REDIS_DBID "redis.test"
+
+static int __redis_available(void) {
+    dbresult_t* r = dbquery(REDIS_DBID, "PING", NULL);
+    int ok = dbresult_ok(r);
+    dbresult_free(r);
+    return ok;
+}
+
+static void __redis_del(const char* key) {
+    array_t* params = array_create();
+    if (params == NULL) return;
+    mparams_fill_array(params, mparam_text(key, key));
+    dbresult_t* r = dbquery(REDIS_DBID, "DEL :key", params);
+    array_free(params);
+    dbresult_free(r);
+}
+
+static ratelimit_t* __node_create(void) {
+    ratelimitconfig_t config = {
+        .burst = 20,
+        .rate = 1,
+        .lease = 5,
+        .idle_timeout_s = 60,
+    };
+    strcpy(config.host_id, REDIS_DBID);
+
+    return ratelimit_create("dbtest", &config, ratelimitredis_init());
+}
+
+TEST(test_redis_integer_reply) {
+    TEST_SUITE("redis ratelimit");
+    TEST_CASE("integer replies are read as text");
+
+    if (!__redis_available()) return;
+
+    __redis_del("cwfr:test:counter");
+
+    array_t* params = array_create();
+    mparams_fill_array(params, mparam_text(key, "cwfr:test:counter"));
+    dbresult_t* r = dbquery(REDIS_DBID, "INCRBY :key 7", params);
+    array_free(params);
+
+    TEST_ASSERT(dbresult_ok(r), "INCRBY should succeed");
+    const db_table_cell_t* field = dbresult_field(r, NULL);
+    TEST_ASSERT_NOT_NULL(field, "reply has a value");
+    if (field != NULL && field->value != NULL)
+        TEST_ASSERT_STR_EQUAL("7", field->value, "integer rendered in decimal");
+    dbresult_free(r);
+
+    __redis_del("cwfr:test:counter");
+}
+
+TEST(test_redis_ratelimit_nodes) {
+    TEST_SUITE("redis ratelimit");
+    TEST_CASE("two nodes share one bucket through leases");
+
+    if (!__redis_available()) return;
+
+    __redis_del("cwfr:ratelimit:dbtest:api-key-1");
+
+    ratelimit_t* node_a = __node_create();
+    ratelimit_t* node_b = __node_create();
+    TEST_ASSERT_NOT_NULL(node_a, "node a created");
+    TEST_ASSERT_NOT_NULL(node_b, "node b created");
+    if (node_a == NULL || node_b == NULL) {
+        ratelimit_free(node_a);
+        ratelimit_free(node_b);
+        return;
+    }
+
+    int allowed = 0;
+    for (int i = 0; i < 50; i++) {
+        allowed += ratelimit_take(node_a, "api-key-1", 1);
+        allowed += ratelimit_take(node_b, "api-key-1", 1);
+    }
+
+    // At 1 token per second a refill during the run adds at most one more
+    TEST_ASSERT(allowed >= 20 && allowed <= 21, "burst shared by both nodes");
+    TEST_ASSERT_EQUAL(1, ratelimit_take(node_a, "api-key-2", 1), "other key has its own bucket");
+
+    ratelimit_free(node_a);
+    ratelimit_free(node_b);
+
+    __redis_del("cwfr:ratelimit:dbtest:api-key-1");
+    __redis_del("cwfr:ratelimit:dbtest:api-key-2");
+}
@@ -0,0 +1,62 @@
+/*
+ * Microbenchmarks for misc/base64.c.
+ */
+
+#include "microbench.h"
+#include "base64.h"
+
+#include <stdlib.h>
+
+#define BASE64_BENCH_SIZE 4096
+
+MICROBENCH(bench_base64_encode_4k) {
+    char* plain = malloc(BASE64_BENCH_SIZE);
+    char* encoded = malloc(base64_encode_len(BASE64_BENCH_SIZE));
+    if (plain == NULL || encoded == NULL) {
+        microbench_fail(bench, "alloc corpus failed");
+        goto cleanup;
+    }
+
+    for (int i = 0; i < BASE64_BENCH_SIZE; i++)
+        plain[i] = (char)(i * 31);
+
+    microbench_set_bytes(bench, BASE64_BENCH_SIZE);
+
+    MICROBENCH_LOOP(bench) {
+        base64_encode(encoded, plain, BASE64_BENCH_SIZE);
+    }
+
+    cleanup:
+
+    free(encoded);
+    free(plain);
+}
+
+MICROBENCH(bench_base64_decode_4k) {
+    char* plain = malloc(BASE64_BENCH_SIZE);
+    char* encoded = malloc(base64_encode_len(BASE64_BENCH_SIZE));
+    char* decoded = malloc(BASE64_BENCH_SIZE + 4);
+    if (plain == NULL || encoded == NULL || decoded == NULL) {
+        microbench_fail(bench, "alloc corpus failed");
+        goto cleanup;
+    }
+
+    for (int i = 0; i < BASE64_BENCH_SIZE; i++)
+        plain[i] = (char)(i * 31);
+
+    const int encoded_size = base64_encode(encoded, plain, BASE64_BENCH_SIZE);
+    microbench_set_bytes(bench, encoded_size);
+
+    MICROBENCH_LOOP(bench) {
+        if (base64_decode(decoded, encoded) != BASE64_BENCH_SIZE) {
+            microbench_fail(bench, "decoded size mismatch");
+            break;
+        }
+    }
+
+    cleanup:
+
+    free(decoded);
+    free(encoded);
+    free(plain);
+}
@@ -0,0 +1,38 @@
+/*
+ * Microbenchmarks for protocols/http/server/parsers/cookieparser.c.
+ */
+
+#include "microbench.h"
+#include "cookieparser.h"
+#include "httpcommon.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void run_parser(microbench_t* bench, const char* header) {
+    const size_t size = strlen(header);
+    microbench_set_bytes(bench, size);
+
+    MICROBENCH_LOOP(bench) {
+        cookieparser_t parser;
+        cookieparser_init(&parser);
+
+        if (!cookieparser_parse(&parser, header, size)) {
+            microbench_fail(bench, "cookie header rejected");
+            break;
+        }
+
+        http_cookie_free(cookieparser_cookie(&parser));
+    }
+}
+
+MICROBENCH(bench_cookieparser_session) {
+    run_parser(bench, "session=9f2c4e1a7b3d5f60c8e2a4b6d8f0a1c3");
+}
+
+MICROBENCH(bench_cookieparser_browser) {
+    run_parser(bench,
+        "session=9f2c4e1a7b3d5f60c8e2a4b6d8f0a1c3; theme=dark; lang=en; cart=3; "
+        "_ga=GA1.1.1234567890.1700000000; _gid=GA1.1.987654321.1700000000; "
+        "consent=%7B%22analytics%22%3Atrue%2C%22ads%22%3Afalse%7D; last_visit=1700000123");
+}
@@ -0,0 +1,52 @@
+/*
+ * Microbenchmarks for protocols/smtp/dkimcanonparser.c: relaxed body
+ * canonicalization of a plain-text letter with ragged whitespace.
+ */
+
+#include "microbench.h"
+#include "dkimcanonparser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+MICROBENCH(bench_dkimcanonparser_letter_8k) {
+    const size_t capacity = 8192 + 256;
+    char* letter = malloc(capacity);
+    if (letter == NULL) {
+        microbench_fail(bench, "alloc corpus failed");
+        return;
+    }
+
+    size_t size = 0;
+    for (int i = 0; size < 8192; i++)
+        size += snprintf(letter + size, capacity - size,
+            "Line %d of the letter,\t with  some   spaces \r\n%s", i, i % 10 == 9 ? "\r\n" : "");
+
+    microbench_set_bytes(bench, size);
+
+    dkimcanonparser_t* parser = dkimcanonparser_alloc();
+    if (parser == NULL) {
+        microbench_fail(bench, "alloc parser failed");
+        free(letter);
+        return;
+    }
+
+    dkimcanonparser_init(parser);
+
+    MICROBENCH_LOOP(bench) {
+        dkimcanonparser_init(parser);
+        dkimcanonparser_set_buffer(parser, letter, size);
+
+        if (!dkimcanonparser_run(parser)) {
+            microbench_fail(bench, "letter rejected");
+            break;
+        }
+
+        free(dkimcanonparser_get_content(parser));
+        dkimcanonparser_flush(parser);
+    }
+
+    dkimcanonparser_free(parser);
+    free(letter);
+}
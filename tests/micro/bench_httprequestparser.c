@@ -0,0 +1,154 @@
+/*
+ * Microbenchmarks for protocols/http/server/parsers/httprequestparser.c.
+ *
+ * Drives httpparser_run the way the connection read loop does: the whole
+ * request sits in the connection buffer, the parsed request is handed off
+ * and the parser is reset for the next one. The Host header is matched
+ * against a single virtual server, as on a one-site deployment.
+ */
+
+#include "microbench.h"
+#include "httprequestparser.h"
+#include "httpparsercommon.h"
+#include "httprequest.h"
+#include "connection_s.h"
+#include "server.h"
+#include "domain.h"
+
+#include <pcre.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char request_browser[] =
+    "GET /catalog/items?page=2&sort=price&order=asc HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Referer: http://localhost/catalog/items?page=1\r\n"
+    "Cookie: session=9f2c4e1a7b3d5f60c8e2a4b6d8f0a1c3; theme=dark; lang=en; cart=3\r\n"
+    "Connection: keep-alive\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "Sec-Fetch-Dest: document\r\n"
+    "Sec-Fetch-Mode: navigate\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "\r\n";
+
+static const char request_minimal[] =
+    "GET / HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "\r\n";
+
+typedef struct {
+    domain_t domain;
+    server_t server;
+    listener_t listener;
+    cqueue_item_t item;
+    connection_server_ctx_t ctx;
+    connection_t connection;
+    httprequestparser_t* parser;
+    char* buffer;
+} http_harness_t;
+
+static int harness_init(http_harness_t* h, const char* data, size_t size) {
+    memset(h, 0, sizeof(*h));
+
+    const char* error = NULL;
+    int erroffset = 0;
+    h->domain.template = "localhost";
+    h->domain.pcre_template = pcre_compile("^localhost$", PCRE_CASELESS, &error, &erroffset, NULL);
+    if (h->domain.pcre_template == NULL) return 0;
+
+    h->server.ip = 0x0100007F;
+    h->server.port = 8080;
+    h->server.domain = &h->domain;
+
+    h->item.data = &h->server;
+    h->listener.servers.item = &h->item;
+    h->listener.servers.last_item = &h->item;
+    h->listener.servers.size = 1;
+    h->ctx.listener = &h->listener;
+
+    h->buffer = malloc(size);
+    if (h->buffer == NULL) return 0;
+    memcpy(h->buffer, data, size);
+
+    h->connection.buffer = h->buffer;
+    h->connection.buffer_size = size;
+    h->connection.ip = 0x0100007F;
+    h->connection.port = 8080;
+    h->connection.ctx = (connection_ctx_t*)&h->ctx;
+
+    h->parser = httpparser_create(&h->connection);
+
+    return h->parser != NULL;
+}
+
+static void harness_free(http_harness_t* h) {
+    if (h->parser != NULL) httpparser_free(h->parser);
+    if (h->domain.pcre_template != NULL) pcre_free(h->domain.pcre_template);
+    free(h->buffer);
+}
+
+static void run_parser(microbench_t* bench, const char* data, size_t size) {
+    http_harness_t h;
+    if (!harness_init(&h, data, size)) {
+        microbench_fail(bench, "harness init failed");
+        harness_free(&h);
+        return;
+    }
+
+    microbench_set_bytes(bench, size);
+
+    MICROBENCH_LOOP(bench) {
+        httpparser_set_bytes_readed(h.parser, size);
+        if (httpparser_run(h.parser) != HTTP1PARSER_COMPLETE) {
+            microbench_fail(bench, "request rejected");
+            break;
+        }
+
+        /* the connection layer takes the request, the parser starts over */
+        httprequest_free(h.parser->request);
+        h.parser->request = NULL;
+        h.ctx.server = NULL;
+        httpparser_reset(h.parser);
+    }
+
+    harness_free(&h);
+}
+
+MICROBENCH(bench_httpparser_run_minimal) {
+    run_parser(bench, request_minimal, sizeof(request_minimal) - 1);
+}
+
+MICROBENCH(bench_httpparser_run_browser) {
+    run_parser(bench, request_browser, sizeof(request_browser) - 1);
+}
+
+MICROBENCH(bench_httpparser_run_post_json_1k) {
+    static const char head[] =
+        "POST /api/items HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: 1024\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n";
+
+    const size_t head_size = sizeof(head) - 1;
+    const size_t size = head_size + 1024;
+    char* data = malloc(size);
+    if (data == NULL) {
+        microbench_fail(bench, "alloc corpus failed");
+        return;
+    }
+
+    memcpy(data, head, head_size);
+    memcpy(data + head_size, "{\"data\":\"", 9);
+    memset(data + head_size + 9, 'x', 1024 - 11);
+    memcpy(data + size - 2, "\"}", 2);
+
+    run_parser(bench, data, size);
+
+    free(data);
+}
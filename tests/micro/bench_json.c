@@ -0,0 +1,105 @@
+/*
+ * Microbenchmarks for misc/json.c: parsing, serialization and building a
+ * document in code, on an API-like response of 50 records.
+ */
+
+#include "microbench.h"
+#include "json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char* build_corpus(size_t* size) {
+    const size_t capacity = 32768;
+    char* out = malloc(capacity);
+    if (out == NULL) return NULL;
+
+    size_t pos = snprintf(out, capacity, "{\"total\":50,\"page\":1,\"items\":[");
+    for (int i = 0; i < 50; i++) {
+        pos += snprintf(out + pos, capacity - pos,
+            "%s{\"id\":%d,\"name\":\"Item number %d\",\"price\":%d.%02d,\"active\":%s,"
+            "\"tags\":[\"new\",\"sale\"],\"owner\":{\"id\":%d,\"email\":\"user%d@example.com\"},"
+            "\"description\":\"Line one\\nLine two with \\\"quotes\\\" and \\u0444\"}",
+            i > 0 ? "," : "", i, i, i * 13, i % 100, i % 2 ? "true" : "false", i * 7, i);
+    }
+    pos += snprintf(out + pos, capacity - pos, "]}");
+
+    *size = pos;
+    return out;
+}
+
+MICROBENCH(bench_json_parse) {
+    size_t size = 0;
+    char* corpus = build_corpus(&size);
+    if (corpus == NULL) {
+        microbench_fail(bench, "alloc corpus failed");
+        return;
+    }
+
+    microbench_set_bytes(bench, size);
+
+    MICROBENCH_LOOP(bench) {
+        json_doc_t* document = json_parse(corpus);
+        if (document == NULL) {
+            microbench_fail(bench, "corpus rejected");
+            break;
+        }
+
+        json_free(document);
+    }
+
+    free(corpus);
+}
+
+MICROBENCH(bench_json_stringify) {
+    size_t size = 0;
+    char* corpus = build_corpus(&size);
+    json_doc_t* document = corpus != NULL ? json_parse(corpus) : NULL;
+    if (document == NULL) {
+        microbench_fail(bench, "corpus setup failed");
+        free(corpus);
+        return;
+    }
+
+    microbench_set_bytes(bench, size);
+
+    MICROBENCH_LOOP(bench) {
+        /* the document keeps its output buffer between runs, as in send_json */
+        if (json_stringify(document) == NULL) {
+            microbench_fail(bench, "stringify failed");
+            break;
+        }
+    }
+
+    json_free(document);
+    free(corpus);
+}
+
+MICROBENCH(bench_json_build_and_stringify) {
+    MICROBENCH_LOOP(bench) {
+        json_doc_t* document = json_root_create_object();
+        if (document == NULL) {
+            microbench_fail(bench, "create failed");
+            break;
+        }
+
+        json_token_t* root = json_root(document);
+        json_token_t* items = json_create_array();
+        json_object_set(root, "status", json_create_string("ok"));
+        json_object_set(root, "items", items);
+
+        for (int i = 0; i < 10; i++) {
+            json_token_t* item = json_create_object();
+            json_object_set(item, "id", json_create_number(i));
+            json_object_set(item, "name", json_create_string("Item"));
+            json_object_set(item, "active", json_create_bool(i % 2));
+            json_array_append(items, item);
+        }
+
+        if (json_stringify(document) == NULL)
+            microbench_fail(bench, "stringify failed");
+
+        json_free(document);
+    }
+}
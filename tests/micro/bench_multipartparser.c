@@ -0,0 +1,89 @@
+/*
+ * Microbenchmarks for protocols/http/server/parsers/multipartparser.c.
+ *
+ * A form of several text fields and one file part is parsed from memory,
+ * as httprequest does after reading the body chunk from the payload file.
+ */
+
+#define _GNU_SOURCE
+#include "microbench.h"
+#include "multipartparser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define FORM_BOUNDARY "----cwfrFormBoundary7MA4YWxkTrZu0gW"
+
+static size_t build_form(char* out, size_t capacity, size_t file_size) {
+    size_t size = 0;
+
+    for (int i = 0; i < 8; i++) {
+        size += snprintf(out + size, capacity - size,
+            "--" FORM_BOUNDARY "\r\n"
+            "Content-Disposition: form-data; name=\"field%d\"\r\n"
+            "\r\n"
+            "value of the field number %d\r\n",
+            i, i);
+    }
+
+    size += snprintf(out + size, capacity - size,
+        "--" FORM_BOUNDARY "\r\n"
+        "Content-Disposition: form-data; name=\"upload\"; filename=\"report.txt\"\r\n"
+        "Content-Type: text/plain\r\n"
+        "\r\n");
+
+    for (size_t i = 0; i < file_size; i++)
+        out[size++] = (i % 64 == 63) ? '\n' : 'a' + i % 26;
+
+    size += snprintf(out + size, capacity - size, "\r\n--" FORM_BOUNDARY "--\r\n");
+
+    return size;
+}
+
+static void run_parser(microbench_t* bench, size_t file_size) {
+    const size_t capacity = file_size + 4096;
+    char* form = malloc(capacity);
+    int fd = -1;
+
+    if (form == NULL) {
+        microbench_fail(bench, "alloc corpus failed");
+        return;
+    }
+
+    const size_t size = build_form(form, capacity, file_size);
+
+    fd = memfd_create("bench_multipart", 0);
+    if (fd < 0 || write(fd, form, size) != (ssize_t)size) {
+        microbench_fail(bench, "payload file failed");
+        goto cleanup;
+    }
+
+    microbench_set_bytes(bench, size);
+
+    MICROBENCH_LOOP(bench) {
+        multipartparser_t parser;
+        multipartparser_init(&parser, fd, FORM_BOUNDARY);
+
+        const multipart_res_e res = multipartparser_parse(&parser, form, size);
+        if (res != MP_RES_DONE || multipartparser_part(&parser) == NULL)
+            microbench_fail(bench, "form rejected");
+
+        multipartparser_clear(&parser);
+    }
+
+    cleanup:
+
+    if (fd >= 0) close(fd);
+    free(form);
+}
+
+MICROBENCH(bench_multipartparser_fields) {
+    run_parser(bench, 0);
+}
+
+MICROBENCH(bench_multipartparser_file_64k) {
+    run_parser(bench, 65536);
+}
@@ -0,0 +1,36 @@
+/*
+ * Microbenchmarks for misc/queryparser.c.
+ */
+
+#include "microbench.h"
+#include "queryparser.h"
+
+#include <string.h>
+
+static void run_parser(microbench_t* bench, const char* query) {
+    const size_t size = strlen(query);
+    microbench_set_bytes(bench, size);
+
+    MICROBENCH_LOOP(bench) {
+        query_t* first = NULL;
+        query_t* last = NULL;
+
+        if (queryparser_parse(query, size, 0, NULL, NULL, &first, &last) != QUERYPARSER_OK) {
+            microbench_fail(bench, "query rejected");
+            break;
+        }
+
+        queries_free(first);
+    }
+}
+
+MICROBENCH(bench_queryparser_short) {
+    run_parser(bench, "page=2&sort=price&order=asc");
+}
+
+MICROBENCH(bench_queryparser_encoded) {
+    run_parser(bench,
+        "q=%D0%BF%D0%BE%D0%B8%D1%81%D0%BA+%D1%82%D0%BE%D0%B2%D0%B0%D1%80%D0%B0&category=books"
+        "&price_from=100&price_to=5000&tags[]=new&tags[]=sale&tags[]=gift"
+        "&utm_source=newsletter&utm_medium=email&utm_campaign=autumn%202026");
+}
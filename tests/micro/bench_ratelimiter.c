@@ -0,0 +1,50 @@
+/*
+ * Microbenchmarks for src/ratelimiter/ratelimiter.c.
+ *
+ * A returning client hits an existing bucket; a scan from distinct
+ * addresses creates a bucket on every request.
+ */
+
+#include "microbench.h"
+#include "ratelimiter.h"
+
+static ratelimiter_t* create_limiter(void) {
+    ratelimiter_config_t config = {
+        .max_tokens = 1000000,
+        .refill_rate = 1000000,
+        .time_window_ns = 1000000000ULL,
+        .cleanup_interval_s = 60
+    };
+
+    return ratelimiter_init(&config);
+}
+
+MICROBENCH(bench_ratelimiter_same_ip) {
+    ratelimiter_t* limiter = create_limiter();
+    if (limiter == NULL) {
+        microbench_fail(bench, "limiter not created");
+        return;
+    }
+
+    MICROBENCH_LOOP(bench) {
+        ratelimiter_allow(limiter, 0x0100007f, 1);
+    }
+
+    ratelimiter_free(limiter);
+}
+
+MICROBENCH(bench_ratelimiter_distinct_ips) {
+    ratelimiter_t* limiter = create_limiter();
+    if (limiter == NULL) {
+        microbench_fail(bench, "limiter not created");
+        return;
+    }
+
+    in_addr_t ip = 0x0a000000;
+
+    MICROBENCH_LOOP(bench) {
+        ratelimiter_allow(limiter, ip++, 1);
+    }
+
+    ratelimiter_free(limiter);
+}
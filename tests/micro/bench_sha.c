@@ -0,0 +1,48 @@
+/*
+ * Microbenchmarks for misc/sha1.c and misc/sha256.c: a websocket handshake
+ * key and a 4 KiB block.
+ */
+
+#include "microbench.h"
+#include "sha1.h"
+#include "sha256.h"
+
+#include <string.h>
+
+static const char handshake_key[] = "dGhlIHNhbXBsZSBub25jZQ==258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+static unsigned char block[4096];
+
+static void fill_block(void) {
+    for (size_t i = 0; i < sizeof(block); i++)
+        block[i] = (unsigned char)(i * 31);
+}
+
+MICROBENCH(bench_sha1_handshake_key) {
+    unsigned char result[20];
+    microbench_set_bytes(bench, sizeof(handshake_key) - 1);
+
+    MICROBENCH_LOOP(bench) {
+        sha1((const unsigned char*)handshake_key, sizeof(handshake_key) - 1, result);
+    }
+}
+
+MICROBENCH(bench_sha1_4k) {
+    unsigned char result[20];
+    fill_block();
+    microbench_set_bytes(bench, sizeof(block));
+
+    MICROBENCH_LOOP(bench) {
+        sha1(block, sizeof(block), result);
+    }
+}
+
+MICROBENCH(bench_sha256_4k) {
+    unsigned char result[32];
+    fill_block();
+    microbench_set_bytes(bench, sizeof(block));
+
+    MICROBENCH_LOOP(bench) {
+        sha256(block, sizeof(block), result);
+    }
+}
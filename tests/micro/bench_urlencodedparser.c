@@ -0,0 +1,61 @@
+/*
+ * Microbenchmarks for protocols/http/server/parsers/urlencodedparser.c.
+ *
+ * A login-style form and a long form with percent-encoded values are
+ * split from memory; values are read back from the payload file and
+ * decoded, as for a real request body. Fields are released after every
+ * run.
+ */
+
+#define _GNU_SOURCE
+#include "microbench.h"
+#include "urlencodedparser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static void run_parser(microbench_t* bench, const char* body, size_t size) {
+    char* buffer = malloc(size);
+    const int fd = memfd_create("bench_urlencoded", 0);
+
+    if (buffer == NULL || fd < 0 || write(fd, body, size) != (ssize_t)size) {
+        microbench_fail(bench, "corpus setup failed");
+        goto cleanup;
+    }
+
+    memcpy(buffer, body, size);
+    microbench_set_bytes(bench, size);
+
+    MICROBENCH_LOOP(bench) {
+        urlencodedparser_t parser;
+        urlencodedparser_init(&parser, fd, size);
+
+        if (!urlencodedparser_parse(&parser, buffer, size) || urlencodedparser_field(&parser) == NULL)
+            microbench_fail(bench, "form rejected");
+
+        urlencodedparser_clear(&parser);
+    }
+
+    cleanup:
+
+    if (fd >= 0) close(fd);
+    free(buffer);
+}
+
+MICROBENCH(bench_urlencodedparser_login) {
+    static const char body[] = "login=user%40example.com&password=s3cr3t%21pass&remember=1&csrf=4f9a2c7e1b8d";
+    run_parser(bench, body, sizeof(body) - 1);
+}
+
+MICROBENCH(bench_urlencodedparser_64_fields) {
+    char body[8192];
+    size_t size = 0;
+
+    for (int i = 0; i < 64; i++)
+        size += snprintf(body + size, sizeof(body) - size, "%sfield_%d=some+value+%%D0%%B4%%D0%%B0+%d", i > 0 ? "&" : "", i, i);
+
+    run_parser(bench, body, size);
+}
@@ -0,0 +1,151 @@
+/*
+ * Microbenchmarks for framework/view: parsing a template from storage and
+ * rendering a cached template with a loop and conditions over 20 records.
+ */
+
+#include "microbench.h"
+#include "view.h"
+#include "viewparser.h"
+#include "viewstore.h"
+#include "storagefs.h"
+#include "appconfig.h"
+#include "json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/limits.h>
+
+#define VIEW_BENCH_STORAGE "view_bench_storage"
+
+static const char template_page[] =
+    "<!DOCTYPE html>\n"
+    "<html><head><title>{{ title }}</title></head>\n"
+    "<body>\n"
+    "<h1>{{ title }}</h1>\n"
+    "{% if user.admin %}<a href=\"/admin\">Admin</a>{% else %}<span>{{ user.name }}</span>{% endif %}\n"
+    "<table>\n"
+    "{% for item in items %}"
+    "<tr class=\"{% if item.active %}on{% else %}off{% endif %}\">"
+    "<td>{{ index + 1 }}</td><td>{{ item.name }}</td><td>{{ item.price }}</td></tr>\n"
+    "{% endfor %}"
+    "</table>\n"
+    "<footer>{{ footer }}</footer>\n"
+    "</body></html>\n";
+
+typedef struct {
+    char root[PATH_MAX];
+    char path[PATH_MAX + 16];
+    storagefs_t* fs;
+    viewstore_t* store;
+} view_bench_env_t;
+
+static int env_init(view_bench_env_t* env) {
+    memset(env, 0, sizeof(*env));
+
+    snprintf(env->root, sizeof(env->root), "/tmp/cwfr_view_bench_XXXXXX");
+    if (mkdtemp(env->root) == NULL) return 0;
+
+    snprintf(env->path, sizeof(env->path), "%s/page.html", env->root);
+    FILE* file = fopen(env->path, "w");
+    if (file == NULL) return 0;
+
+    const size_t written = fwrite(template_page, 1, sizeof(template_page) - 1, file);
+    fclose(file);
+    if (written != sizeof(template_page) - 1) return 0;
+
+    env->fs = storage_create_fs(VIEW_BENCH_STORAGE, env->root);
+    env->store = viewstore_create();
+    if (env->fs == NULL || env->store == NULL) return 0;
+
+    appconfig()->storages = (storage_t*)env->fs;
+    appconfig()->viewstore = env->store;
+
+    return 1;
+}
+
+static void env_free(view_bench_env_t* env) {
+    appconfig()->storages = NULL;
+    appconfig()->viewstore = NULL;
+
+    if (env->store != NULL) viewstore_destroy(env->store);
+    if (env->fs != NULL) env->fs->base.free(env->fs);
+
+    if (env->path[0] != 0) unlink(env->path);
+    if (env->root[0] != 0) rmdir(env->root);
+}
+
+static json_doc_t* build_document(void) {
+    char text[4096];
+    size_t size = snprintf(text, sizeof(text),
+        "{\"title\":\"Catalog\",\"footer\":\"(c) 2026\",\"user\":{\"name\":\"Alex\",\"admin\":false},\"items\":[");
+
+    for (int i = 0; i < 20; i++)
+        size += snprintf(text + size, sizeof(text) - size,
+            "%s{\"name\":\"Item %d\",\"price\":%d,\"active\":%s}",
+            i > 0 ? "," : "", i, i * 100, i % 3 ? "true" : "false");
+
+    snprintf(text + size, sizeof(text) - size, "]}");
+
+    return json_parse(text);
+}
+
+MICROBENCH(bench_viewparser_run) {
+    view_bench_env_t env;
+    if (!env_init(&env)) {
+        microbench_fail(bench, "environment setup failed");
+        env_free(&env);
+        return;
+    }
+
+    microbench_set_bytes(bench, sizeof(template_page) - 1);
+
+    MICROBENCH_LOOP(bench) {
+        viewparser_t* parser = viewparser_init(VIEW_BENCH_STORAGE, "/page.html");
+        if (parser == NULL || !viewparser_run(parser)) {
+            microbench_fail(bench, "template rejected");
+            if (parser != NULL) viewparser_free(parser);
+            break;
+        }
+
+        viewparser_free(parser);
+    }
+
+    env_free(&env);
+}
+
+MICROBENCH(bench_view_render) {
+    view_bench_env_t env;
+    json_doc_t* document = NULL;
+
+    if (!env_init(&env) || (document = build_document()) == NULL) {
+        microbench_fail(bench, "environment setup failed");
+        goto cleanup;
+    }
+
+    /* the first render parses the template into the store, the rest reuse it */
+    char* warmup = render(document, VIEW_BENCH_STORAGE, "/page.html");
+    if (warmup == NULL) {
+        microbench_fail(bench, "render failed");
+        goto cleanup;
+    }
+
+    microbench_set_bytes(bench, strlen(warmup));
+    free(warmup);
+
+    MICROBENCH_LOOP(bench) {
+        char* result = render(document, VIEW_BENCH_STORAGE, "/page.html");
+        if (result == NULL) {
+            microbench_fail(bench, "render failed");
+            break;
+        }
+
+        free(result);
+    }
+
+    cleanup:
+
+    json_free(document);
+    env_free(&env);
+}
@@ -0,0 +1,102 @@
+/*
+ * Microbenchmarks for protocols/websocket/server/parsers/websocketsparser.c.
+ *
+ * A masked client frame is parsed from the connection buffer, its request
+ * is handed off and the parser is prepared for the next frame, as the
+ * websocket read loop does. Payloads go through the default protocol, which
+ * keeps them in a temporary file.
+ */
+
+#include "microbench.h"
+#include "connection_s.h"
+#include "websocketsparser.h"
+#include "websocketsrequest.h"
+#include "websocketsprotocoldefault.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const unsigned char mask[4] = {0x12, 0x34, 0x56, 0x78};
+
+static size_t build_frame(unsigned char* out, const unsigned char* payload, size_t payload_size) {
+    size_t pos = 0;
+    out[pos++] = 0x81;
+
+    if (payload_size < 126) {
+        out[pos++] = 0x80 | (unsigned char)payload_size;
+    }
+    else {
+        out[pos++] = 0x80 | 126;
+        out[pos++] = (unsigned char)(payload_size >> 8);
+        out[pos++] = (unsigned char)payload_size;
+    }
+
+    memcpy(&out[pos], mask, 4);
+    pos += 4;
+
+    for (size_t i = 0; i < payload_size; i++)
+        out[pos + i] = payload[i] ^ mask[i % 4];
+
+    return pos + payload_size;
+}
+
+static void run_parser(microbench_t* bench, size_t payload_size) {
+    unsigned char* payload = malloc(payload_size);
+    unsigned char* frame = malloc(payload_size + 14);
+    connection_t connection;
+    connection_server_ctx_t ctx;
+    websocketsparser_t* parser = NULL;
+
+    if (payload == NULL || frame == NULL) {
+        microbench_fail(bench, "alloc corpus failed");
+        goto cleanup;
+    }
+
+    for (size_t i = 0; i < payload_size; i++)
+        payload[i] = 'a' + i % 26;
+
+    const size_t frame_size = build_frame(frame, payload, payload_size);
+
+    memset(&connection, 0, sizeof(connection));
+    memset(&ctx, 0, sizeof(ctx));
+    connection.buffer = (char*)frame;
+    connection.buffer_size = frame_size;
+    connection.ctx = &ctx;
+
+    parser = websocketsparser_create(&connection, websockets_protocol_default_create);
+    if (parser == NULL) {
+        microbench_fail(bench, "parser create failed");
+        goto cleanup;
+    }
+
+    microbench_set_bytes(bench, frame_size);
+
+    MICROBENCH_LOOP(bench) {
+        websocketsparser_set_bytes_readed(parser, frame_size);
+        parser->pos_start = 0;
+        parser->pos = 0;
+
+        if (websocketsparser_run(parser) != WSPARSER_COMPLETE) {
+            microbench_fail(bench, "frame rejected");
+            break;
+        }
+
+        websocketsrequest_free(parser->request);
+        parser->request = NULL;
+        websocketsparser_prepare_remains(parser);
+    }
+
+    cleanup:
+
+    if (parser != NULL) websocketsparser_free(parser);
+    free(frame);
+    free(payload);
+}
+
+MICROBENCH(bench_websocketsparser_run_text_32) {
+    run_parser(bench, 32);
+}
+
+MICROBENCH(bench_websocketsparser_run_text_4k) {
+    run_parser(bench, 4096);
+}
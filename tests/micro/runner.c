@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "microbench.h"
+#include "appconfig.h"
+
+/* Microbenchmark runner.
+ *
+ *   microbench [--time ms] [--json] [filter...]
+ *
+ * Runs every registered benchmark whose name contains one of the filters
+ * (all when none given) and prints ns/op, bytes/s and allocations/op as a
+ * table, or one JSON object per line with --json. --time 0 runs each
+ * benchmark once: a quick check that the corpora still parse. Exits non-zero
+ * if a benchmark failed. */
+
+#define MICROBENCH_DEFAULT_TIME_MS 500
+#define MICROBENCH_FIRST_BATCH 16
+
+typedef struct {
+    const char* name;
+    microbench_fn fn;
+} microbench_entry_t;
+
+static microbench_entry_t* registry = NULL;
+static int registry_count = 0;
+static int registry_capacity = 0;
+
+static uint64_t min_time_ns = (uint64_t)MICROBENCH_DEFAULT_TIME_MS * 1000000ULL;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void microbench_register(const char* name, microbench_fn fn) {
+    if (registry_count >= registry_capacity) {
+        const int capacity = registry_capacity == 0 ? 32 : registry_capacity * 2;
+        microbench_entry_t* entries = realloc(registry, capacity * sizeof(microbench_entry_t));
+        if (entries == NULL) {
+            fprintf(stderr, "ERROR: Failed to allocate memory for benchmarks!\n");
+            return;
+        }
+        registry = entries;
+        registry_capacity = capacity;
+    }
+
+    registry[registry_count].name = name;
+    registry[registry_count].fn = fn;
+    registry_count++;
+}
+
+void microbench_set_bytes(microbench_t* bench, size_t bytes) {
+    bench->bytes = bytes;
+}
+
+void microbench_fail(microbench_t* bench, const char* message) {
+    if (bench->error == NULL)
+        bench->error = message;
+}
+
+void microbench_start(microbench_t* bench) {
+    bench->iterations = 0;
+    bench->batch = MICROBENCH_FIRST_BATCH;
+    bench->batch_end = bench->min_iterations < bench->batch ? bench->min_iterations : bench->batch;
+    alloccount_snapshot(&bench->allocs_before);
+    bench->started_at = now_ns();
+}
+
+/* The clock is read once per batch, so a cheap operation is not dominated
+ * by clock_gettime */
+int microbench_running(microbench_t* bench) {
+    if (bench->error == NULL && bench->iterations < bench->batch_end) {
+        bench->iterations++;
+        return 1;
+    }
+
+    const uint64_t elapsed = now_ns() - bench->started_at;
+    if (bench->error != NULL || (elapsed >= bench->min_time_ns && bench->iterations >= bench->min_iterations)) {
+        bench->elapsed_ns = elapsed;
+
+        alloccount_t after;
+        alloccount_snapshot(&after);
+        alloccount_diff(&bench->allocs_before, &after, &bench->allocs);
+
+        return 0;
+    }
+
+    if (bench->batch < (1ULL << 24))
+        bench->batch *= 2;
+
+    bench->batch_end = bench->iterations + bench->batch;
+    bench->iterations++;
+
+    return 1;
+}
+
+static int matches(const char* name, int argc, char* argv[], int first) {
+    if (first >= argc) return 1;
+
+    for (int i = first; i < argc; i++)
+        if (strstr(name, argv[i]) != NULL)
+            return 1;
+
+    return 0;
+}
+
+/* Benchmarks see the environment of a configured server: tmp for request
+ * bodies, body size limit, no logging */
+static appconfig_t* config_create(void) {
+    appconfig_t* config = calloc(1, sizeof(appconfig_t));
+    if (config == NULL) return NULL;
+
+    config->env.main.client_max_body_size = 110485760;
+    config->env.main.tmp = "/tmp";
+    config->env.main.log.enabled = false;
+    config->env.main.workers = 1;
+    config->env.main.threads = 1;
+    config->env.main.gzip_min_length = ENV_GZIP_MIN_LENGTH_DEFAULT;
+
+    appconfig_set(config);
+
+    return config;
+}
+
+int main(int argc, char* argv[]) {
+    int json = 0;
+    int first_filter = 1;
+
+    while (first_filter < argc && strncmp(argv[first_filter], "--", 2) == 0) {
+        if (strcmp(argv[first_filter], "--json") == 0) {
+            json = 1;
+        }
+        else if (strcmp(argv[first_filter], "--time") == 0 && first_filter + 1 < argc) {
+            min_time_ns = strtoull(argv[first_filter + 1], NULL, 10) * 1000000ULL;
+            first_filter++;
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--time ms] [--json] [filter...]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        first_filter++;
+    }
+
+    appconfig_t* config = config_create();
+    if (config == NULL) {
+        fprintf(stderr, "ERROR: Failed to create config!\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!json) {
+        printf("%-40s %12s %12s %14s %12s %12s\n", "benchmark", "iterations", "ns/op", "MB/s", "allocs/op", "bytes/op");
+        if (!alloccount_enabled())
+            printf("(allocation counting is off under sanitizers)\n");
+    }
+
+    int failed = 0;
+    for (int i = 0; i < registry_count; i++) {
+        if (!matches(registry[i].name, argc, argv, first_filter))
+            continue;
+
+        microbench_t bench;
+        memset(&bench, 0, sizeof(bench));
+        bench.name = registry[i].name;
+        bench.min_time_ns = min_time_ns;
+        bench.min_iterations = min_time_ns == 0 ? 1 : 100;
+
+        registry[i].fn(&bench);
+
+        if (bench.error != NULL) {
+            failed++;
+            if (json)
+                printf("{\"name\":\"%s\",\"error\":\"%s\"}\n", bench.name, bench.error);
+            else
+                printf("%-40s FAILED: %s\n", bench.name, bench.error);
+            continue;
+        }
+
+        const double iterations = bench.iterations > 0 ? (double)bench.iterations : 1.0;
+        const double ns_per_op = (double)bench.elapsed_ns / iterations;
+        const double bytes_per_s = bench.elapsed_ns > 0 ? (double)bench.bytes * iterations * 1e9 / (double)bench.elapsed_ns : 0.0;
+        const double allocs_per_op = (double)(bench.allocs.allocs + bench.allocs.reallocs) / iterations;
+        const double alloc_bytes_per_op = (double)bench.allocs.bytes / iterations;
+
+        if (json) {
+            printf("{\"name\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.1f,\"bytes_per_op\":%zu,"
+                   "\"bytes_per_s\":%.0f,\"allocs_per_op\":%.2f,\"alloc_bytes_per_op\":%.0f}\n",
+                bench.name, (unsigned long long)bench.iterations, ns_per_op, bench.bytes,
+                bytes_per_s, allocs_per_op, alloc_bytes_per_op);
+        }
+        else {
+            printf("%-40s %12llu %12.1f %14.1f %12.2f %12.0f\n",
+                bench.name, (unsigned long long)bench.iterations, ns_per_op,
+                bytes_per_s / 1e6, allocs_per_op, alloc_bytes_per_op);
+        }
+        fflush(stdout);
+    }
+
+    appconfig_set(NULL);
+    free(config);
+    free(registry);
+
+    return failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
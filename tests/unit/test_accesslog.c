@@ -0,0 +1,255 @@
+/*
+ * Unit tests for src/accesslog/accesslog.c.
+ *
+ * Every record becomes one JSON line. Lines from different threads reach
+ * the file through per-thread buffers and the background writer; the file
+ * rotates by size and is reopened on request (SIGHUP).
+ */
+
+#include "framework.h"
+#include "accesslog.h"
+#include "json.h"
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define ACCESSLOG_TEST_THREADS 3
+#define ACCESSLOG_TEST_RECORDS 200
+
+typedef struct {
+    char dir[64];
+    char path[128];
+} accesslog_fixture_t;
+
+static void accesslog_fixture_init(accesslog_fixture_t* fixture) {
+    strcpy(fixture->dir, "/tmp/cwfr_accesslog_XXXXXX");
+    if (mkdtemp(fixture->dir) == NULL)
+        fixture->dir[0] = 0;
+
+    snprintf(fixture->path, sizeof(fixture->path), "%s/access.log", fixture->dir);
+}
+
+static void accesslog_fixture_free(accesslog_fixture_t* fixture) {
+    accesslog_stop();
+
+    DIR* dir = opendir(fixture->dir);
+    if (dir != NULL) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] == '.') continue;
+
+            char path[384];
+            snprintf(path, sizeof(path), "%s/%s", fixture->dir, entry->d_name);
+            unlink(path);
+        }
+        closedir(dir);
+    }
+
+    rmdir(fixture->dir);
+}
+
+static char* accesslog_read_file(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) return NULL;
+
+    char* data = calloc(1, 1 << 20);
+    if (data != NULL)
+        fread(data, 1, (1 << 20) - 1, file);
+
+    fclose(file);
+
+    return data;
+}
+
+static int accesslog_count_lines(const char* data) {
+    int lines = 0;
+    for (; data != NULL && *data; data++)
+        if (*data == '\n') lines++;
+
+    return lines;
+}
+
+static void accesslog_record(int status, const char* path) {
+    accesslog_record_t record = {
+        .method = "GET",
+        .path = path,
+        .path_length = strlen(path),
+        .remote_ip = inet_addr("10.1.2.3"),
+        .status = status,
+        .bytes = 512,
+        .duration_ns = 1500000,
+        .parse_ns = 20000,
+        .queue_ns = 300000,
+        .handler_ns = 1000000,
+        .first_byte_ns = 1400000,
+        .spans_count = 2,
+        .spans = { { "db", 600000 }, { "render", 250000 } }
+    };
+
+    accesslog_write(&record);
+}
+
+static void* accesslog_thread(void* arg) {
+    (void)arg;
+
+    for (int i = 0; i < ACCESSLOG_TEST_RECORDS; i++)
+        accesslog_record(200, "/thread");
+
+    return NULL;
+}
+
+TEST(test_accesslog_json_lines) {
+    TEST_CASE("records become JSON lines with every field");
+
+    accesslog_fixture_t fixture;
+    accesslog_fixture_init(&fixture);
+
+    TEST_ASSERT(!accesslog_enabled(), "disabled before start");
+    TEST_ASSERT(accesslog_start(fixture.path, 0, 0), "started");
+    TEST_ASSERT(accesslog_enabled(), "enabled after start");
+
+    accesslog_record(404, "/a \"quoted\"\npath\\");
+    accesslog_stop();
+
+    char* data = accesslog_read_file(fixture.path);
+    TEST_ASSERT_EQUAL(1, accesslog_count_lines(data), "one line");
+
+    json_doc_t* document = data != NULL ? json_parse(data) : NULL;
+    TEST_ASSERT_NOT_NULL(document, "line is valid JSON");
+
+    if (document != NULL) {
+        const json_token_t* root = json_root(document);
+        int ok = 0;
+
+        TEST_ASSERT_STR_EQUAL("10.1.2.3", json_string(json_object_get(root, "ip")), "ip");
+        TEST_ASSERT_STR_EQUAL("GET", json_string(json_object_get(root, "method")), "method");
+        TEST_ASSERT_STR_EQUAL("/a \"quoted\"\npath\\", json_string(json_object_get(root, "path")), "path escaped and restored");
+        TEST_ASSERT_EQUAL(404, json_int(json_object_get(root, "status"), &ok), "status");
+        TEST_ASSERT_EQUAL(512, json_int(json_object_get(root, "bytes"), &ok), "bytes");
+        TEST_ASSERT_EQUAL(1500, json_int(json_object_get(root, "duration_us"), &ok), "duration in microseconds");
+        TEST_ASSERT_EQUAL(1000, json_int(json_object_get(root, "handler_us"), &ok), "handler time in microseconds");
+        TEST_ASSERT_EQUAL(20, json_int(json_object_get(root, "parse_us"), &ok), "parse time");
+        TEST_ASSERT_EQUAL(300, json_int(json_object_get(root, "queue_us"), &ok), "queue wait");
+        TEST_ASSERT_EQUAL(1400, json_int(json_object_get(root, "first_byte_us"), &ok), "time to first byte");
+
+        const json_token_t* spans = json_object_get(root, "spans");
+        TEST_ASSERT(spans != NULL && json_is_object(spans), "spans object");
+        if (spans != NULL) {
+            TEST_ASSERT_EQUAL(600, json_int(json_object_get(spans, "db"), &ok), "db span");
+            TEST_ASSERT_EQUAL(250, json_int(json_object_get(spans, "render"), &ok), "render span");
+        }
+        TEST_ASSERT(json_llong(json_object_get(root, "time_ms"), &ok) > 1600000000000LL, "wall clock time in milliseconds");
+
+        json_free(document);
+    }
+
+    free(data);
+    accesslog_fixture_free(&fixture);
+}
+
+TEST(test_accesslog_threads) {
+    TEST_CASE("records from several threads are all written");
+
+    accesslog_fixture_t fixture;
+    accesslog_fixture_init(&fixture);
+
+    const unsigned long long dropped = accesslog_dropped();
+    TEST_ASSERT(accesslog_start(fixture.path, 0, 0), "started");
+
+    pthread_t threads[ACCESSLOG_TEST_THREADS];
+    for (int i = 0; i < ACCESSLOG_TEST_THREADS; i++)
+        pthread_create(&threads[i], NULL, accesslog_thread, NULL);
+    for (int i = 0; i < ACCESSLOG_TEST_THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    accesslog_stop();
+
+    char* data = accesslog_read_file(fixture.path);
+    TEST_ASSERT_EQUAL(ACCESSLOG_TEST_THREADS * ACCESSLOG_TEST_RECORDS, accesslog_count_lines(data), "one line per record");
+    TEST_ASSERT(accesslog_dropped() == dropped, "nothing dropped");
+
+    /* writing after stop is a no-op */
+    accesslog_record(200, "/late");
+    TEST_ASSERT(!accesslog_enabled(), "disabled after stop");
+
+    free(data);
+    accesslog_fixture_free(&fixture);
+}
+
+TEST(test_accesslog_rotate_by_size) {
+    TEST_CASE("the file is renamed once it reaches rotate_size");
+
+    accesslog_fixture_t fixture;
+    accesslog_fixture_init(&fixture);
+
+    TEST_ASSERT(accesslog_start(fixture.path, 1000, 0), "started");
+
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 10; i++)
+            accesslog_record(200, "/rotate");
+
+        /* let the writer flush and rotate */
+        usleep(ACCESSLOG_FLUSH_INTERVAL_MS * 3 * 1000);
+    }
+
+    accesslog_stop();
+
+    int files = 0;
+    int lines = 0;
+    DIR* dir = opendir(fixture.dir);
+    if (dir != NULL) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] == '.') continue;
+
+            char path[384];
+            snprintf(path, sizeof(path), "%s/%s", fixture.dir, entry->d_name);
+            char* data = accesslog_read_file(path);
+            lines += accesslog_count_lines(data);
+            free(data);
+            files++;
+        }
+        closedir(dir);
+    }
+
+    TEST_ASSERT(files >= 3, "rotated files next to the current one");
+    TEST_ASSERT_EQUAL(30, lines, "no record lost on rotation");
+
+    accesslog_fixture_free(&fixture);
+}
+
+TEST(test_accesslog_reopen) {
+    TEST_CASE("reopen starts a new file after an external rename");
+
+    accesslog_fixture_t fixture;
+    accesslog_fixture_init(&fixture);
+
+    TEST_ASSERT(accesslog_start(fixture.path, 0, 0), "started");
+
+    accesslog_record(200, "/before");
+    usleep(ACCESSLOG_FLUSH_INTERVAL_MS * 3 * 1000);
+
+    char moved[160];
+    snprintf(moved, sizeof(moved), "%s.old", fixture.path);
+    TEST_ASSERT_EQUAL(0, rename(fixture.path, moved), "moved away");
+
+    accesslog_reopen();
+    usleep(ACCESSLOG_FLUSH_INTERVAL_MS * 2 * 1000);
+
+    accesslog_record(200, "/after");
+    accesslog_stop();
+
+    char* old = accesslog_read_file(moved);
+    char* current = accesslog_read_file(fixture.path);
+
+    TEST_ASSERT(old != NULL && strstr(old, "/before") != NULL && strstr(old, "/after") == NULL, "old file keeps earlier records");
+    TEST_ASSERT(current != NULL && strstr(current, "/after") != NULL && strstr(current, "/before") == NULL, "new file gets later records");
+
+    free(old);
+    free(current);
+    accesslog_fixture_free(&fixture);
+}
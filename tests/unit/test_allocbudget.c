@@ -0,0 +1,613 @@
+/*
+ * Allocation budgets for the hot paths of a request.
+ *
+ * Every path runs from input bytes to the bytes of the answer the way the
+ * server runs it, minus the event loop and the handler queue:
+ *
+ *   - GET of a static file: parse, resolve through the open file cache,
+ *     send through the filter chain into a socket;
+ *   - POST of a JSON body: parse, read the payload as JSON, answer with a
+ *     new document through the filter chain;
+ *   - websocket text message: parse a masked frame, read the payload, build
+ *     the echo frame;
+ *   - model_list of 100 rows from an in-memory driver, serialized to JSON;
+ *   - view render of a cached template with a loop over 20 records.
+ *
+ * Budgets are the measured numbers with a little headroom. When a change
+ * lowers the numbers, lower the budget with it; when a feature has to raise
+ * them, raise the budget in the same change so the cost is visible in review.
+ * Nothing is checked in sanitizer builds (see alloccount.h).
+ *
+ * env()/appconfig() are the weak test doubles from test_httprequestparser.c;
+ * the tests install databases, storages and viewstore there and restore
+ * NULL afterwards.
+ */
+
+#define _GNU_SOURCE
+#include "allocbudget.h"
+#include "httprequestparser.h"
+#include "httpparsercommon.h"
+#include "httprequest.h"
+#include "httpresponse.h"
+#include "http_filter.h"
+#include "connection_s.h"
+#include "server.h"
+#include "domain.h"
+#include "filecache.h"
+#include "websocketsparser.h"
+#include "websocketsrequest.h"
+#include "websocketsresponse.h"
+#include "websocketsprotocoldefault.h"
+#include "database.h"
+#include "dbresult.h"
+#include "model.h"
+#include "view.h"
+#include "viewstore.h"
+#include "storagefs.h"
+#include "appconfig.h"
+#include "json.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pcre.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/limits.h>
+
+#pragma GCC diagnostic ignored "-Wformat-truncation"
+
+// ============================================================================
+// HTTP fixture: one virtual server, a parser on a connection whose socket
+// end is read back by the test
+// ============================================================================
+
+typedef struct {
+    char root[PATH_MAX];
+    char file[PATH_MAX + 16];
+    domain_t domain;
+    server_t server;
+    listener_t listener;
+    cqueue_item_t item;
+    connection_server_ctx_t ctx;
+    connection_t connection;
+    httprequestparser_t* parser;
+    const char* request;
+    size_t request_size;
+    int peer;
+    char buffer[4096];
+} http_budget_t;
+
+static int http_budget_init(http_budget_t* h) {
+    memset(h, 0, sizeof(*h));
+    h->connection.fd = -1;
+    h->peer = -1;
+
+    snprintf(h->root, sizeof(h->root), "/tmp/cwfr_allocbudget_XXXXXX");
+    if (mkdtemp(h->root) == NULL) return 0;
+
+    /* 2 KB of text: small enough for the in-memory content of the cache */
+    snprintf(h->file, sizeof(h->file), "%s/app.css", h->root);
+    FILE* file = fopen(h->file, "w");
+    if (file == NULL) return 0;
+    for (int i = 0; i < 64; i++)
+        fprintf(file, ".block-%02d { margin: 0 auto; padding: 1px; }\n", i % 100);
+    fclose(file);
+
+    const char* error = NULL;
+    int erroffset = 0;
+    h->domain.template = "localhost";
+    h->domain.pcre_template = pcre_compile("^localhost$", PCRE_CASELESS, &error, &erroffset, NULL);
+    if (h->domain.pcre_template == NULL) return 0;
+
+    filecache_config_t config = {
+        .max_entries = 64,
+        .valid_s = 60,
+        .content_max_size = 65536,
+        .content_memory = 1048576
+    };
+    h->server.filecache = filecache_create(&config);
+    if (h->server.filecache == NULL) return 0;
+
+    h->server.ip = 0x0100007F;
+    h->server.port = 8080;
+    h->server.domain = &h->domain;
+    h->server.root = h->root;
+    h->server.root_length = strlen(h->root);
+
+    h->item.data = &h->server;
+    h->listener.servers.item = &h->item;
+    h->listener.servers.last_item = &h->item;
+    h->listener.servers.size = 1;
+    h->ctx.listener = &h->listener;
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) return 0;
+    h->connection.fd = sv[0];
+    h->peer = sv[1];
+    if (fcntl(h->peer, F_SETFL, fcntl(h->peer, F_GETFL, 0) | O_NONBLOCK) == -1) return 0;
+
+    h->connection.ip = 0x0100007F;
+    h->connection.port = 8080;
+    h->connection.keepalive = 1;
+    h->connection.buffer = h->buffer;
+    h->connection.buffer_size = sizeof(h->buffer);
+    h->connection.ctx = (connection_ctx_t*)&h->ctx;
+
+    h->parser = httpparser_create(&h->connection);
+
+    return h->parser != NULL;
+}
+
+static void http_budget_free(http_budget_t* h) {
+    if (h->parser != NULL) httpparser_free(h->parser);
+    if (h->server.filecache != NULL) filecache_free(h->server.filecache);
+    if (h->domain.pcre_template != NULL) pcre_free(h->domain.pcre_template);
+    if (h->connection.fd != -1) close(h->connection.fd);
+    if (h->peer != -1) close(h->peer);
+    if (h->file[0] != 0) unlink(h->file);
+    if (h->root[0] != 0) rmdir(h->root);
+}
+
+// Разбор запроса из буфера соединения, как в цикле чтения
+static httprequest_t* http_budget_parse(http_budget_t* h) {
+    /* the parser consumes the connection buffer in place */
+    if (h->request_size > sizeof(h->buffer)) return NULL;
+    memcpy(h->buffer, h->request, h->request_size);
+
+    httpparser_set_bytes_readed(h->parser, h->request_size);
+
+    httprequest_t* request = NULL;
+    if (httpparser_run(h->parser) == HTTP1PARSER_COMPLETE) {
+        request = h->parser->request;
+        h->parser->request = NULL;
+    }
+
+    httpparser_reset(h->parser);
+
+    return request;
+}
+
+// Отправка через цепочку фильтров, как __write в httpserverhandlers.c
+static int http_budget_send(http_budget_t* h, httprequest_t* request, httpresponse_t* response) {
+    response->cur_filter = response->filter;
+    if (response->filter->handler_header(request, response) != CWF_OK)
+        return 0;
+
+    int r;
+    do {
+        response->cur_filter = response->filter;
+        r = response->filter->handler_body(request, response, NULL);
+    } while (r == CWF_DATA_AGAIN);
+
+    if (r != CWF_OK) return 0;
+
+    char answer[8192];
+    size_t size = 0;
+    while (1) {
+        const ssize_t n = recv(h->peer, answer + size, sizeof(answer) - size, 0);
+        if (n > 0 && (size += (size_t)n) < sizeof(answer)) continue;
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) return 0;
+        break;
+    }
+
+    return size > 12 && memcmp(answer, "HTTP/1.1 200", 12) == 0;
+}
+
+static int op_get_static(void* arg) {
+    http_budget_t* h = arg;
+
+    httprequest_t* request = http_budget_parse(h);
+    if (request == NULL) return 0;
+
+    int ok = 0;
+    httpresponse_t* response = httpresponse_create(&h->connection);
+    if (response == NULL) goto done;
+
+    filecache_entry_t* entry = http_get_file_entry(&h->server, request->path, request->path_length);
+    if (entry == NULL || entry->status != FILECACHE_OK) {
+        filecache_release(entry);
+        goto done;
+    }
+
+    http_response_file_entry_negotiate(response, entry, request->get_header(request, "Accept-Encoding"));
+
+    ok = http_budget_send(h, request, response);
+
+    done:
+
+    if (response != NULL) httpresponse_free(response);
+    httprequest_free(request);
+    h->ctx.server = NULL;
+
+    return ok;
+}
+
+static int op_post_json(void* arg) {
+    http_budget_t* h = arg;
+
+    httprequest_t* request = http_budget_parse(h);
+    if (request == NULL) return 0;
+
+    int ok = 0;
+    json_doc_t* payload = NULL;
+    json_doc_t* document = NULL;
+    httpresponse_t* response = httpresponse_create(&h->connection);
+    if (response == NULL) goto done;
+
+    payload = request->get_payload_json(request);
+    document = json_root_create_object();
+    if (payload == NULL || document == NULL) goto done;
+
+    json_token_t* root = json_root(document);
+    json_object_set(root, "status", json_create_string("ok"));
+    json_object_set(root, "size", json_create_number(json_object_size(json_root(payload))));
+
+    response->send_json(response, document);
+
+    ok = http_budget_send(h, request, response);
+
+    done:
+
+    json_free(document);
+    json_free(payload);
+    if (response != NULL) httpresponse_free(response);
+    httprequest_free(request);
+    h->ctx.server = NULL;
+
+    return ok;
+}
+
+TEST(test_allocbudget_get_static) {
+    TEST_SUITE("allocation budgets");
+    TEST_CASE("GET of a cached static file");
+
+    http_budget_t h;
+    TEST_REQUIRE_GOTO(http_budget_init(&h), "fixture setup", cleanup);
+
+    static const char request[] =
+        "GET /app.css HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0\r\n"
+        "Accept: text/css,*/*;q=0.1\r\n"
+        "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+        "Referer: http://localhost/\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n";
+
+    h.request = request;
+    h.request_size = sizeof(request) - 1;
+
+    TEST_ASSERT_ALLOC_BUDGET(op_get_static, &h, 84, 43008, "GET static");
+
+    cleanup:
+
+    http_budget_free(&h);
+}
+
+TEST(test_allocbudget_post_json) {
+    TEST_SUITE("allocation budgets");
+    TEST_CASE("POST of a JSON body answered with JSON");
+
+    http_budget_t h;
+    TEST_REQUIRE_GOTO(http_budget_init(&h), "fixture setup", cleanup);
+
+    static const char request[] =
+        "POST /api/items HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: 93\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n"
+        "{\"name\":\"Item 42\",\"price\":4200,\"active\":true,\"tags\":[\"new\",\"sale\"],\"owner\":{\"id\":7,\"role\":1}}";
+
+    h.request = request;
+    h.request_size = sizeof(request) - 1;
+
+    TEST_ASSERT_ALLOC_BUDGET(op_post_json, &h, 85, 44032, "POST JSON");
+
+    cleanup:
+
+    http_budget_free(&h);
+}
+
+// ============================================================================
+// Websocket text message
+// ============================================================================
+
+typedef struct {
+    connection_t connection;
+    connection_server_ctx_t ctx;
+    websocketsparser_t* parser;
+    unsigned char frame[256];
+    size_t frame_size;
+    char buffer[256];
+} ws_budget_t;
+
+static int op_ws_text(void* arg) {
+    ws_budget_t* w = arg;
+
+    /* the parser unmasks the connection buffer in place */
+    memcpy(w->buffer, w->frame, w->frame_size);
+
+    websocketsparser_set_bytes_readed(w->parser, w->frame_size);
+    w->parser->pos_start = 0;
+    w->parser->pos = 0;
+
+    if (websocketsparser_run(w->parser) != WSPARSER_COMPLETE) return 0;
+
+    websocketsrequest_t* request = w->parser->request;
+    w->parser->request = NULL;
+    websocketsparser_prepare_remains(w->parser);
+
+    websockets_protocol_default_t* protocol = (websockets_protocol_default_t*)request->protocol;
+    char* payload = protocol->get_payload(protocol);
+    websocketsresponse_t* response = websocketsresponse_create(&w->connection);
+
+    const int ok = payload != NULL && response != NULL;
+    if (ok)
+        response->send_text(response, payload);
+
+    if (response != NULL) response->base.free(response);
+    free(payload);
+    websocketsrequest_free(request);
+
+    return ok;
+}
+
+TEST(test_allocbudget_websocket_text) {
+    TEST_SUITE("allocation budgets");
+    TEST_CASE("websocket text message echoed back");
+
+    ws_budget_t w;
+    memset(&w, 0, sizeof(w));
+    w.connection.fd = -1;
+    w.connection.buffer = w.buffer;
+    w.connection.buffer_size = sizeof(w.buffer);
+    w.connection.ctx = (connection_ctx_t*)&w.ctx;
+
+    static const char text[] = "{\"type\":\"chat\",\"room\":12,\"text\":\"hello from the budget test\"}";
+    static const unsigned char mask[4] = {0x12, 0x34, 0x56, 0x78};
+    const size_t length = sizeof(text) - 1;
+
+    w.frame[0] = 0x81;
+    w.frame[1] = 0x80 | (unsigned char)length;
+    memcpy(&w.frame[2], mask, 4);
+    for (size_t i = 0; i < length; i++)
+        w.frame[6 + i] = (unsigned char)text[i] ^ mask[i % 4];
+    w.frame_size = 6 + length;
+
+    w.parser = websocketsparser_create(&w.connection, websockets_protocol_default_create);
+    TEST_REQUIRE_NOT_NULL(w.parser, "parser created");
+
+    TEST_ASSERT_ALLOC_BUDGET(op_ws_text, &w, 8, 1024, "websocket text");
+
+    websocketsparser_free(w.parser);
+}
+
+// ============================================================================
+// model_list of 100 rows: an in-memory driver answers every query with the
+// same table, as a database driver materializes its result
+// ============================================================================
+
+#define MODEL_BUDGET_ROWS 100
+
+enum budget_item_column {
+    BUDGET_ITEM_COL_ID = 0,
+    BUDGET_ITEM_COL_NAME,
+    BUDGET_ITEM_COL_PRICE,
+    BUDGET_ITEM_COL_DESCRIPTION,
+    BUDGET_ITEM_COLUMNS_COUNT
+};
+
+static const mcolumn_t __budget_item_columns[BUDGET_ITEM_COLUMNS_COUNT] = {
+    [BUDGET_ITEM_COL_ID]          = { .name = "id",          .type = MODEL_INT, .is_primary = 1 },
+    [BUDGET_ITEM_COL_NAME]        = { .name = "name",        .type = MODEL_TEXT },
+    [BUDGET_ITEM_COL_PRICE]       = { .name = "price",       .type = MODEL_INT },
+    [BUDGET_ITEM_COL_DESCRIPTION] = { .name = "description", .type = MODEL_TEXT },
+};
+
+static const int __budget_item_primary_keys[] = { BUDGET_ITEM_COL_ID };
+
+static const mschema_t __budget_item_schema = {
+    .table = "items",
+    .columns = __budget_item_columns,
+    .columns_count = BUDGET_ITEM_COLUMNS_COUNT,
+    .primary_keys = __budget_item_primary_keys,
+    .primary_keys_count = 1,
+};
+
+static void* budget_item_instance(void) {
+    model_t* record = calloc(1, sizeof * record);
+    if (record == NULL) return NULL;
+
+    if (!model_init(record, &__budget_item_schema)) {
+        free(record);
+        return NULL;
+    }
+
+    return record;
+}
+
+static dbresult_t* __budget_execute_params(void* connection, const char* sql, array_t* params) {
+    (void)connection;
+    (void)sql;
+    (void)params;
+
+    dbresult_t* result = dbresult_create();
+    if (result == NULL) return NULL;
+
+    dbresultquery_t* query = dbresult_query_create(MODEL_BUDGET_ROWS, BUDGET_ITEM_COLUMNS_COUNT);
+    if (query == NULL) {
+        dbresult_free(result);
+        return NULL;
+    }
+
+    for (int col = 0; col < BUDGET_ITEM_COLUMNS_COUNT; col++)
+        dbresult_query_field_insert(query, __budget_item_columns[col].name, col);
+
+    for (int row = 0; row < MODEL_BUDGET_ROWS; row++) {
+        char value[64];
+        int size = snprintf(value, sizeof(value), "%d", row + 1);
+        dbresult_query_value_insert(query, value, size, row, BUDGET_ITEM_COL_ID);
+        size = snprintf(value, sizeof(value), "Item %d", row + 1);
+        dbresult_query_value_insert(query, value, size, row, BUDGET_ITEM_COL_NAME);
+        size = snprintf(value, sizeof(value), "%d", (row + 1) * 150);
+        dbresult_query_value_insert(query, value, size, row, BUDGET_ITEM_COL_PRICE);
+        size = snprintf(value, sizeof(value), "Description of item number %d", row + 1);
+        dbresult_query_value_insert(query, value, size, row, BUDGET_ITEM_COL_DESCRIPTION);
+    }
+
+    result->ok = 1;
+    result->query = query;
+    result->current = query;
+
+    return result;
+}
+
+static int __budget_is_active(void* connection) {
+    (void)connection;
+    return 1;
+}
+
+static void* __budget_connection_create(void* host) {
+    dbconnection_t* connection = calloc(1, sizeof * connection);
+    if (connection == NULL) return NULL;
+
+    connection->free = free;
+    connection->execute_params = __budget_execute_params;
+    connection->is_active = __budget_is_active;
+    connection->thread_id = gettid();
+    connection->host = host;
+
+    return connection;
+}
+
+static int op_model_list(void* arg) {
+    (void)arg;
+
+    array_t* list = model_list("budget", budget_item_instance, "SELECT id, name, price, description FROM items", NULL);
+    if (list == NULL) return 0;
+
+    char* data = model_list_stringify(list);
+    const int ok = array_size(list) == MODEL_BUDGET_ROWS && data != NULL;
+
+    free(data);
+    array_free(list);
+
+    return ok;
+}
+
+TEST(test_allocbudget_model_list) {
+    TEST_SUITE("allocation budgets");
+    TEST_CASE("model_list of 100 rows serialized to JSON");
+
+    dbhost_t host;
+    memset(&host, 0, sizeof(host));
+    host.id = "budget";
+    host.connection_create = __budget_connection_create;
+    host.connections = array_create();
+
+    db_t* db = db_create("budget");
+    array_t* databases = array_create();
+    TEST_REQUIRE_GOTO(host.connections != NULL && db != NULL && databases != NULL, "fake database", cleanup);
+
+    array_push_back(db->hosts, array_create_pointer(&host, array_nocopy, NULL));
+    array_push_back(databases, array_create_pointer(db, array_nocopy, db_free));
+    db = NULL;
+    appconfig()->databases = databases;
+
+    /* 408 of the allocations are the driver materializing its result */
+    TEST_ASSERT_ALLOC_BUDGET(op_model_list, NULL, 1170, 229376, "model_list 100 rows");
+
+    appconfig()->databases = NULL;
+
+    cleanup:
+
+    array_free(databases);
+    db_free(db);
+    array_free(host.connections);
+}
+
+// ============================================================================
+// View render
+// ============================================================================
+
+#define VIEW_BUDGET_STORAGE "allocbudget_storage"
+
+static const char view_budget_template[] =
+    "<!DOCTYPE html>\n"
+    "<html><head><title>{{ title }}</title></head>\n"
+    "<body>\n"
+    "<h1>{{ title }}</h1>\n"
+    "{% if user.admin %}<a href=\"/admin\">Admin</a>{% else %}<span>{{ user.name }}</span>{% endif %}\n"
+    "<table>\n"
+    "{% for item in items %}"
+    "<tr class=\"{% if item.active %}on{% else %}off{% endif %}\">"
+    "<td>{{ index + 1 }}</td><td>{{ item.name }}</td><td>{{ item.price }}</td></tr>\n"
+    "{% endfor %}"
+    "</table>\n"
+    "<footer>{{ footer }}</footer>\n"
+    "</body></html>\n";
+
+static int op_view_render(void* arg) {
+    char* page = render(arg, VIEW_BUDGET_STORAGE, "/page.html");
+    free(page);
+
+    return page != NULL;
+}
+
+TEST(test_allocbudget_view_render) {
+    TEST_SUITE("allocation budgets");
+    TEST_CASE("render of a cached template over 20 records");
+
+    char root[PATH_MAX];
+    char path[PATH_MAX + 16];
+    storagefs_t* fs = NULL;
+    viewstore_t* store = NULL;
+    json_doc_t* document = NULL;
+    path[0] = 0;
+
+    snprintf(root, sizeof(root), "/tmp/cwfr_allocbudget_XXXXXX");
+    TEST_REQUIRE(mkdtemp(root) != NULL, "temp dir");
+
+    snprintf(path, sizeof(path), "%s/page.html", root);
+    FILE* file = fopen(path, "w");
+    TEST_REQUIRE_GOTO(file != NULL, "template written", cleanup);
+    fwrite(view_budget_template, 1, sizeof(view_budget_template) - 1, file);
+    fclose(file);
+
+    fs = storage_create_fs(VIEW_BUDGET_STORAGE, root);
+    store = viewstore_create();
+    TEST_REQUIRE_GOTO(fs != NULL && store != NULL, "storage and viewstore", cleanup);
+
+    char text[4096];
+    size_t size = snprintf(text, sizeof(text),
+        "{\"title\":\"Catalog\",\"footer\":\"(c) 2026\",\"user\":{\"name\":\"Alex\",\"admin\":false},\"items\":[");
+    for (int i = 0; i < 20; i++)
+        size += snprintf(text + size, sizeof(text) - size,
+            "%s{\"name\":\"Item %d\",\"price\":%d,\"active\":%s}",
+            i > 0 ? "," : "", i, i * 100, i % 3 ? "true" : "false");
+    snprintf(text + size, sizeof(text) - size, "]}");
+
+    document = json_parse(text);
+    TEST_REQUIRE_GOTO(document != NULL, "document", cleanup);
+
+    appconfig()->storages = (storage_t*)fs;
+    appconfig()->viewstore = store;
+
+    TEST_ASSERT_ALLOC_BUDGET(op_view_render, document, 4, 8192, "view render");
+
+    cleanup:
+
+    appconfig()->storages = NULL;
+    appconfig()->viewstore = NULL;
+
+    json_free(document);
+    if (store != NULL) viewstore_destroy(store);
+    if (fs != NULL) fs->base.free(fs);
+    if (path[0] != 0) unlink(path);
+    rmdir(root);
+}
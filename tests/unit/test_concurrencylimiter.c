@@ -0,0 +1,103 @@
+/*
+ * Unit tests for src/ratelimiter/concurrencylimiter.c.
+ *
+ * The limiter admits up to `limit` requests, grows the limit by one after
+ * `limit` fast completions (up to max) and cuts it by 10% on overload,
+ * at most once per baseline latency and only once a baseline is known.
+ */
+
+#include "framework.h"
+#include "concurrencylimiter.h"
+
+#include <time.h>
+
+TEST(test_concurrencylimiter_acquire_release) {
+    TEST_CASE("acquire admits up to the limit, release frees a slot");
+
+    TEST_ASSERT_NULL(concurrencylimiter_create(0), "max 0 is rejected");
+    TEST_ASSERT_EQUAL(1, concurrencylimiter_acquire(NULL), "NULL limiter admits everything");
+
+    concurrencylimiter_t* limiter = concurrencylimiter_create(2);
+    TEST_REQUIRE_NOT_NULL(limiter, "limiter created");
+
+    TEST_ASSERT_EQUAL(2, concurrencylimiter_limit(limiter), "starts at max");
+    TEST_ASSERT_EQUAL(1, concurrencylimiter_acquire(limiter), "1st admitted");
+    TEST_ASSERT_EQUAL(1, concurrencylimiter_acquire(limiter), "2nd admitted");
+    TEST_ASSERT_EQUAL(0, concurrencylimiter_acquire(limiter), "3rd rejected");
+    TEST_ASSERT_EQUAL(1, atomic_load(&limiter->rejected), "rejection counted");
+
+    concurrencylimiter_release(limiter, 0);
+    TEST_ASSERT_EQUAL(1, concurrencylimiter_acquire(limiter), "slot reused after release");
+
+    concurrencylimiter_release(limiter, 0);
+    concurrencylimiter_release(limiter, 0);
+    TEST_ASSERT_EQUAL(0, atomic_load(&limiter->inflight), "all slots released");
+
+    concurrencylimiter_free(limiter);
+}
+
+TEST(test_concurrencylimiter_aimd) {
+    TEST_CASE("overload cuts the limit, fast completions restore it up to max");
+
+    concurrencylimiter_t* limiter = concurrencylimiter_create(20);
+    TEST_REQUIRE_NOT_NULL(limiter, "limiter created");
+
+    const uint64_t fast = 1000000;
+
+    /* without a baseline there is nothing to pace decreases by */
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT(concurrencylimiter_acquire(limiter), "admitted");
+        concurrencylimiter_release_overload(limiter);
+    }
+    TEST_ASSERT_EQUAL(20, concurrencylimiter_limit(limiter), "no decrease before the first sample");
+
+    TEST_ASSERT(concurrencylimiter_acquire(limiter), "admitted");
+    concurrencylimiter_release(limiter, fast);
+    TEST_ASSERT_EQUAL(fast, atomic_load(&limiter->baseline_ns), "first sample sets the baseline");
+
+    TEST_ASSERT(concurrencylimiter_acquire(limiter), "admitted");
+    concurrencylimiter_release_overload(limiter);
+    TEST_ASSERT_EQUAL(18, concurrencylimiter_limit(limiter), "overload cuts 10%");
+
+    /* a second overload within one baseline latency is ignored */
+    TEST_ASSERT(concurrencylimiter_acquire(limiter), "admitted");
+    concurrencylimiter_release(limiter, fast * 10);
+    TEST_ASSERT_EQUAL(18, concurrencylimiter_limit(limiter), "decrease is rate limited");
+
+    struct timespec delay = { .tv_sec = 0, .tv_nsec = 3000000 };
+    nanosleep(&delay, NULL);
+
+    TEST_ASSERT(concurrencylimiter_acquire(limiter), "admitted");
+    concurrencylimiter_release(limiter, fast * 10);
+    TEST_ASSERT_EQUAL(17, concurrencylimiter_limit(limiter), "slow completion is an overload signal");
+
+    for (int i = 0; i < 17; i++) {
+        concurrencylimiter_acquire(limiter);
+        concurrencylimiter_release(limiter, fast);
+    }
+    TEST_ASSERT_EQUAL(18, concurrencylimiter_limit(limiter), "limit fast completions add one");
+
+    for (int i = 0; i < 1000; i++) {
+        concurrencylimiter_acquire(limiter);
+        concurrencylimiter_release(limiter, fast);
+    }
+    TEST_ASSERT_EQUAL(20, concurrencylimiter_limit(limiter), "growth stops at max");
+    TEST_ASSERT_EQUAL(0, atomic_load(&limiter->inflight), "no slot leaked");
+
+    concurrencylimiter_free(limiter);
+}
+
+TEST(test_concurrencylimiter_floor) {
+    TEST_CASE("the limit never drops below one");
+
+    concurrencylimiter_t* limiter = concurrencylimiter_create(1);
+    TEST_REQUIRE_NOT_NULL(limiter, "limiter created");
+
+    TEST_ASSERT(concurrencylimiter_acquire(limiter), "admitted");
+    concurrencylimiter_release_overload(limiter);
+    TEST_ASSERT_EQUAL(1, concurrencylimiter_limit(limiter), "limit stays at 1");
+    TEST_ASSERT(concurrencylimiter_acquire(limiter), "still admits one request");
+    concurrencylimiter_release(limiter, 0);
+
+    concurrencylimiter_free(limiter);
+}
@@ -40,6 +40,7 @@
 #include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
@@ -594,6 +595,48 @@ TEST(test_connection_after_write_keepalive_pending_queue) {
     conn_harness_free(&h);
 }
 
+TEST(test_connection_resume_idle) {
+    TEST_CASE("resume with empty queues rearms MPXIN without resetting the request");
+
+    conn_harness_t h;
+    TEST_REQUIRE(conn_harness_init(&h, 0), "harness init");
+
+    connection_server_ctx_t* ctx = h.conn->ctx;
+    atomic_store(&ctx->broadcast_ref_count, 2);
+    ctx->request = &stub_request;
+
+    TEST_ASSERT_EQUAL(1, connection_resume(h.conn), "returns control_mod result");
+    TEST_ASSERT_EQUAL(MPXIN | MPXRDHUP, stub_control_mod_last_events, "rearmed for reading");
+    TEST_ASSERT_EQUAL(1, atomic_load(&ctx->broadcast_ref_count), "broadcast_ref_count released to 1");
+    TEST_ASSERT_EQUAL(0, stub_request_free_calls, "request is not reset");
+    TEST_ASSERT(ctx->request == &stub_request, "request kept");
+
+    ctx->request = NULL;
+    conn_harness_free(&h);
+}
+
+TEST(test_connection_resume_pending_queue) {
+    TEST_CASE("resume with a pending queue item requeues the connection");
+
+    conn_harness_t h;
+    TEST_REQUIRE(conn_harness_init(&h, 0), "harness init");
+
+    connection_server_ctx_t* ctx = h.conn->ctx;
+
+    connection_queue_item_t* item = connection_queue_item_create();
+    TEST_REQUIRE_NOT_NULL_GOTO(item, "queue item created", cleanup);
+    item->connection = h.conn;
+
+    TEST_REQUIRE_GOTO(cqueue_append(ctx->queue, item), "item staged in ctx->queue", cleanup);
+
+    TEST_ASSERT_EQUAL(1, connection_resume(h.conn), "returns control_mod result");
+    TEST_ASSERT_EQUAL(MPXONESHOT, stub_control_mod_last_events, "connection parked as ONESHOT");
+    TEST_ASSERT(conn_harness_drain_worker_queue() == h.conn, "worker queue yields this connection");
+
+    cleanup:
+    conn_harness_free(&h);
+}
+
 static int switch_protocol_calls = 0;
 static void* switch_protocol_last_data = NULL;
 static int switch_protocol_data_free_calls = 0;
@@ -912,6 +955,101 @@ TEST(test_connection_queue_guard_append_item_queues_connection) {
     conn_harness_free(&h);
 }
 
+static int queue_append_cb_calls = 0;
+static int queue_append_cb_depth = 0;
+
+static void stub_queue_append_cb(void) {
+    queue_append_cb_calls++;
+    queue_append_cb_depth = connection_queue_depth();
+}
+
+TEST(test_connection_queue_depth_wait_and_append_cb) {
+    TEST_CASE("queue reports depth and oldest wait, append callback sees the new entry");
+
+    conn_harness_t h;
+    TEST_REQUIRE(conn_harness_init(&h, 0), "harness init");
+
+    queue_append_cb_calls = 0;
+    queue_append_cb_depth = 0;
+    connection_queue_set_append_cb(stub_queue_append_cb);
+
+    TEST_ASSERT_EQUAL(0, connection_queue_depth(), "empty queue has depth 0");
+    TEST_ASSERT_EQUAL(0, connection_queue_wait(), "empty queue has no wait");
+
+    connection_queue_guard_append(h.conn);
+    TEST_ASSERT_EQUAL(1, queue_append_cb_calls, "callback called once per append");
+    TEST_ASSERT_EQUAL(1, queue_append_cb_depth, "callback runs after the entry is queued");
+    TEST_ASSERT_EQUAL(1, connection_queue_depth(), "depth counts the entry");
+
+    struct timespec delay = { .tv_sec = 0, .tv_nsec = 2000000 };
+    nanosleep(&delay, NULL);
+    TEST_ASSERT(connection_queue_wait() >= 2000000ULL, "wait grows with the age of the head");
+
+    connection_queue_set_append_cb(NULL);
+    TEST_ASSERT(conn_harness_drain_worker_queue() == h.conn, "pop yields the connection");
+    TEST_ASSERT_EQUAL(0, connection_queue_depth(), "depth drops after pop");
+    TEST_ASSERT_EQUAL(0, connection_queue_wait(), "wait resets after pop");
+
+    conn_harness_free(&h);
+}
+
+static int conn_harness_append_class(conn_harness_t* h, connection_queue_item_t** item, int priority) {
+    *item = connection_queue_item_create();
+    if (*item == NULL) return 0;
+
+    (*item)->connection = h->conn;
+    (*item)->priority = priority;
+    connection_queue_guard_append_item(*item);
+
+    return 1;
+}
+
+TEST(test_connection_queue_priority_drr) {
+    TEST_CASE("guard_pop serves priority classes by deficit round robin");
+
+    enum { HIGH_COUNT = 3 };
+    conn_harness_t high[HIGH_COUNT];
+    conn_harness_t low;
+    connection_queue_item_t* items[HIGH_COUNT + 1] = { NULL };
+    int ready = 0;
+
+    for (; ready < HIGH_COUNT; ready++)
+        TEST_REQUIRE_GOTO(conn_harness_init(&high[ready], 0), "high harness init", cleanup);
+    TEST_REQUIRE_GOTO(conn_harness_init(&low, 0), "low harness init", cleanup);
+    ready++;
+
+    const unsigned int weights[ROUTE_PRIORITY_COUNT] = { 2, 1, 1 };
+    connection_queue_set_weights(weights);
+
+    /* low is queued first, but high gets a quantum of 2 before low is visited */
+    TEST_REQUIRE_GOTO(conn_harness_append_class(&low, &items[HIGH_COUNT], ROUTE_PRIORITY_LOW), "low appended", cleanup);
+    for (int i = 0; i < HIGH_COUNT; i++)
+        TEST_REQUIRE_GOTO(conn_harness_append_class(&high[i], &items[i], ROUTE_PRIORITY_HIGH), "high appended", cleanup);
+
+    TEST_ASSERT_EQUAL(HIGH_COUNT + 1, connection_queue_depth(), "depth spans all classes");
+
+    TEST_ASSERT(conn_harness_drain_worker_queue() == high[0].conn, "1st: high");
+    TEST_ASSERT(conn_harness_drain_worker_queue() == high[1].conn, "2nd: high, quantum spent");
+    TEST_ASSERT(conn_harness_drain_worker_queue() == low.conn, "3rd: low gets its turn");
+    TEST_ASSERT(conn_harness_drain_worker_queue() == high[2].conn, "4th: back to high");
+    TEST_ASSERT_EQUAL(0, connection_queue_depth(), "queue drained");
+
+    cleanup:
+    {
+        const unsigned int defaults[ROUTE_PRIORITY_COUNT] = {
+            CONNECTION_QUEUE_WEIGHT_HIGH, CONNECTION_QUEUE_WEIGHT_NORMAL, CONNECTION_QUEUE_WEIGHT_LOW
+        };
+        connection_queue_set_weights(defaults);
+    }
+
+    for (int i = 0; i < HIGH_COUNT + 1; i++)
+        if (items[i] != NULL)
+            items[i]->free(items[i]);
+
+    for (int i = 0; i < ready; i++)
+        conn_harness_free(i < HIGH_COUNT ? &high[i] : &low);
+}
+
 TEST(test_connection_queue_pop_skips_destroyed) {
     TEST_CASE("guard_pop drops destroyed connections and releases the queue reference");
 
@@ -0,0 +1,162 @@
+/*
+ * Unit tests for misc/epoch.c.
+ *
+ * A retired version is freed only after every read that could have seen it
+ * has finished. Reads started after the retirement never hold it back, and
+ * read tokens may be released from a different thread.
+ */
+
+#include "framework.h"
+#include "epoch.h"
+
+#include <pthread.h>
+
+static int __freed = 0;
+
+static void __count_free(void* ptr) {
+    (void)ptr;
+    __freed++;
+}
+
+TEST(test_epoch_retire_without_readers) {
+    TEST_CASE("a version nobody reads is freed at once");
+
+    epoch_t epoch;
+    epoch_init(&epoch);
+    __freed = 0;
+
+    int version = 0;
+    epoch_retire(&epoch, &version, __count_free);
+
+    TEST_ASSERT_EQUAL(1, __freed, "freed on retire");
+    TEST_ASSERT_EQUAL(0, epoch_pending(&epoch), "nothing pending");
+
+    epoch_retire(&epoch, NULL, __count_free);
+    TEST_ASSERT_EQUAL(1, __freed, "NULL is ignored");
+
+    epoch_destroy(&epoch);
+}
+
+TEST(test_epoch_reader_holds_version) {
+    TEST_CASE("an active read keeps the version, its exit frees it");
+
+    epoch_t epoch;
+    epoch_init(&epoch);
+    __freed = 0;
+
+    const unsigned long old_reader = epoch_enter(&epoch);
+
+    int version = 0;
+    epoch_retire(&epoch, &version, __count_free);
+    TEST_ASSERT_EQUAL(0, __freed, "held by a read started before retire");
+
+    /* reads that start after retire see the new version and do not block */
+    const unsigned long new_reader = epoch_enter(&epoch);
+    epoch_reclaim(&epoch);
+    TEST_ASSERT_EQUAL(0, __freed, "still held by the old read");
+
+    epoch_exit(&epoch, old_reader);
+    TEST_ASSERT_EQUAL(1, __freed, "last old reader frees the version");
+
+    epoch_exit(&epoch, new_reader);
+    TEST_ASSERT_EQUAL(0, epoch_pending(&epoch), "nothing pending");
+
+    epoch_destroy(&epoch);
+}
+
+TEST(test_epoch_hold_extends_read) {
+    TEST_CASE("a held token keeps what the original read saw");
+
+    epoch_t epoch;
+    epoch_init(&epoch);
+    __freed = 0;
+
+    const unsigned long reader = epoch_enter(&epoch);
+    const unsigned long held = epoch_hold(&epoch, reader);
+    TEST_ASSERT_EQUAL(reader, held, "hold keeps the epoch of the read");
+
+    int version = 0;
+    epoch_retire(&epoch, &version, __count_free);
+
+    epoch_exit(&epoch, reader);
+    TEST_ASSERT_EQUAL(0, __freed, "held token keeps the version");
+
+    epoch_exit(&epoch, held);
+    TEST_ASSERT_EQUAL(1, __freed, "released with the held token");
+
+    epoch_destroy(&epoch);
+}
+
+TEST(test_epoch_successive_retires) {
+    TEST_CASE("versions retired one after another wait for their own readers");
+
+    epoch_t epoch;
+    epoch_init(&epoch);
+    __freed = 0;
+
+    int first = 0, second = 0;
+
+    const unsigned long reader_first = epoch_enter(&epoch);
+    epoch_retire(&epoch, &first, __count_free);
+
+    const unsigned long reader_second = epoch_enter(&epoch);
+    epoch_retire(&epoch, &second, __count_free);
+
+    TEST_ASSERT_EQUAL(0, __freed, "both held");
+
+    epoch_exit(&epoch, reader_first);
+    TEST_ASSERT_EQUAL(1, __freed, "first freed, second still read");
+
+    epoch_exit(&epoch, reader_second);
+    TEST_ASSERT_EQUAL(2, __freed, "second freed");
+
+    epoch_destroy(&epoch);
+}
+
+typedef struct {
+    epoch_t* epoch;
+    unsigned long token;
+} epoch_thread_arg_t;
+
+static void* __exit_in_thread(void* arg) {
+    epoch_thread_arg_t* data = arg;
+    epoch_exit(data->epoch, data->token);
+    return NULL;
+}
+
+TEST(test_epoch_exit_from_other_thread) {
+    TEST_CASE("a token taken in one thread is released in another");
+
+    epoch_t epoch;
+    epoch_init(&epoch);
+    __freed = 0;
+
+    epoch_thread_arg_t arg = { .epoch = &epoch, .token = epoch_enter(&epoch) };
+
+    int version = 0;
+    epoch_retire(&epoch, &version, __count_free);
+    TEST_ASSERT_EQUAL(0, __freed, "held");
+
+    pthread_t thread;
+    TEST_REQUIRE(pthread_create(&thread, NULL, __exit_in_thread, &arg) == 0, "thread started");
+    pthread_join(thread, NULL);
+
+    TEST_ASSERT_EQUAL(1, __freed, "freed after exit in the other thread");
+
+    epoch_destroy(&epoch);
+}
+
+TEST(test_epoch_destroy_frees_pending) {
+    TEST_CASE("destroy frees versions regardless of readers");
+
+    epoch_t epoch = EPOCH_INITIALIZER;
+    __freed = 0;
+
+    epoch_enter(&epoch);
+    int version = 0;
+    epoch_retire(&epoch, &version, __count_free);
+    TEST_ASSERT_EQUAL(1, epoch_pending(&epoch), "pending");
+
+    epoch_destroy(&epoch);
+    TEST_ASSERT_EQUAL(1, __freed, "freed on destroy");
+}
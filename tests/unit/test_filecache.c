@@ -0,0 +1,477 @@
+/*
+ * Unit tests for src/filecache/filecache.c
+ *
+ * The open file cache replaces the stat + open + fstat sequence of the static
+ * path with one open + fstat per TTL window and keeps the result (fd, size,
+ * mtime, resolved index, mimetype, Last-Modified, ETag) shared between
+ * in-flight responses.
+ *
+ * Covers:
+ *   - resolution without a cache (cache == NULL): regular file, missing file,
+ *     ENOTDIR, directory without index / with index / with a missing index;
+ *   - preformatted validators match http_not_modified_filter's formats
+ *     (IMF-fixdate and W/"mtime-size");
+ *   - mimetype is copied from the table (NULL for unknown extensions);
+ *   - hits return the same entry and take a reference; an entry expired by TTL
+ *     is replaced while the old one stays open for the response holding it;
+ *   - negative results are cached too;
+ *   - max_entries bounds the table: a full table makes room by evicting the
+ *     least recently used entry, so cached misses cannot crowd out hot files;
+ *   - file content is loaded into memory on the second use, with a gzip copy
+ *     when requested and smaller; content_max_size and content_memory bound
+ *     it, the least recently used content is dropped first;
+ *   - a revalidated entry keeps the content while mtime and size are
+ *     unchanged and drops it when mtime changes.
+ */
+
+#include "framework.h"
+#include "filecache.h"
+#include "mimetype.h"
+#include "helpers.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <linux/limits.h>
+
+#pragma GCC diagnostic ignored "-Wformat-truncation"
+
+typedef struct {
+    char root[PATH_MAX];
+    char file[PATH_MAX];
+    char sub[PATH_MAX];
+    char sub_index[PATH_MAX];
+    char emptydir[PATH_MAX];
+} filecache_fixture_t;
+
+static int __write_file(const char* path, const char* data) {
+    FILE* f = fopen(path, "w");
+    if (f == NULL) return 0;
+    fputs(data, f);
+    fclose(f);
+    return 1;
+}
+
+static int fixture_setup(filecache_fixture_t* fx) {
+    snprintf(fx->root, sizeof(fx->root), "/tmp/cwfr_filecache_XXXXXX");
+    if (mkdtemp(fx->root) == NULL) return 0;
+
+    snprintf(fx->file, sizeof(fx->file), "%s/app.js", fx->root);
+    snprintf(fx->sub, sizeof(fx->sub), "%s/sub", fx->root);
+    snprintf(fx->sub_index, sizeof(fx->sub_index), "%s/sub/index.html", fx->root);
+    snprintf(fx->emptydir, sizeof(fx->emptydir), "%s/emptydir", fx->root);
+
+    if (!__write_file(fx->file, "console.log(1);")) return 0;
+    if (mkdir(fx->sub, 0755) != 0) return 0;
+    if (mkdir(fx->emptydir, 0755) != 0) return 0;
+    if (!__write_file(fx->sub_index, "<h1>sub</h1>")) return 0;
+
+    return 1;
+}
+
+static void fixture_teardown(filecache_fixture_t* fx) {
+    unlink(fx->file);
+    unlink(fx->sub_index);
+    rmdir(fx->sub);
+    rmdir(fx->emptydir);
+    rmdir(fx->root);
+}
+
+static int fd_is_open(int fd) {
+    return fd > -1 && fcntl(fd, F_GETFD) != -1;
+}
+
+// ============================================================================
+// Resolution without a cache
+// ============================================================================
+
+TEST(test_filecache_resolve_uncached) {
+    TEST_SUITE("filecache: resolution");
+    TEST_CASE("filecache_get with NULL cache resolves files, directories and errors");
+
+    filecache_fixture_t fx;
+    TEST_REQUIRE(fixture_setup(&fx), "fixture created");
+
+    char path[PATH_MAX];
+
+    filecache_entry_t* entry = filecache_get(NULL, fx.file, NULL, NULL);
+    TEST_REQUIRE_NOT_NULL_GOTO(entry, "entry for regular file", cleanup);
+    TEST_ASSERT_EQUAL(FILECACHE_OK, entry->status, "regular file is ok");
+    TEST_ASSERT(entry->fd > -1, "fd opened");
+    TEST_ASSERT_EQUAL(15, (int)entry->size, "size from fstat");
+    TEST_ASSERT_STR_EQUAL(fx.file, entry->path, "path is the key itself");
+    TEST_ASSERT_NULL(entry->mimetype, "no mimetype table -> NULL mimetype");
+    TEST_ASSERT_EQUAL(1, atomic_load(&entry->ref_count), "caller owns the only reference");
+    const int fd = entry->fd;
+    filecache_release(entry);
+    TEST_ASSERT(!fd_is_open(fd), "last release closes fd");
+
+    snprintf(path, sizeof(path), "%s/missing.js", fx.root);
+    entry = filecache_get(NULL, path, "index.html", NULL);
+    TEST_REQUIRE_NOT_NULL_GOTO(entry, "entry for missing file", cleanup);
+    TEST_ASSERT_EQUAL(FILECACHE_NOTFOUND, entry->status, "missing file");
+    TEST_ASSERT_EQUAL(-1, entry->fd, "no fd for missing file");
+    filecache_release(entry);
+
+    snprintf(path, sizeof(path), "%s/deeper", fx.file);
+    entry = filecache_get(NULL, path, "index.html", NULL);
+    TEST_REQUIRE_NOT_NULL_GOTO(entry, "entry for ENOTDIR", cleanup);
+    TEST_ASSERT_EQUAL(FILECACHE_NOTFOUND, entry->status, "ENOTDIR is not found");
+    filecache_release(entry);
+
+    entry = filecache_get(NULL, fx.sub, NULL, NULL);
+    TEST_REQUIRE_NOT_NULL_GOTO(entry, "entry for directory", cleanup);
+    TEST_ASSERT_EQUAL(FILECACHE_FORBIDDEN, entry->status, "directory without index");
+    filecache_release(entry);
+
+    entry = filecache_get(NULL, fx.sub, "index.html", NULL);
+    TEST_REQUIRE_NOT_NULL_GOTO(entry, "entry for directory with index", cleanup);
+    TEST_ASSERT_EQUAL(FILECACHE_OK, entry->status, "directory resolves to its index");
+    TEST_ASSERT_STR_EQUAL(fx.sub_index, entry->path, "index appended after slash");
+    TEST_ASSERT_EQUAL(12, (int)entry->size, "size of the index file");
+    filecache_release(entry);
+
+    snprintf(path, sizeof(path), "%s/", fx.sub);
+    entry = filecache_get(NULL, path, "index.html", NULL);
+    TEST_REQUIRE_NOT_NULL_GOTO(entry, "entry for directory with trailing slash", cleanup);
+    TEST_ASSERT_STR_EQUAL(fx.sub_index, entry->path, "no double slash inserted");
+    filecache_release(entry);
+
+    entry = filecache_get(NULL, fx.emptydir, "index.html", NULL);
+    TEST_REQUIRE_NOT_NULL_GOTO(entry, "entry for directory without index file", cleanup);
+    TEST_ASSERT_EQUAL(FILECACHE_FORBIDDEN, entry->status, "missing index file is forbidden");
+    filecache_release(entry);
+
+    cleanup:
+    fixture_teardown(&fx);
+}
+
+TEST(test_filecache_metadata) {
+    TEST_CASE("filecache entry carries mimetype and preformatted validators");
+
+    filecache_fixture_t fx;
+    TEST_REQUIRE(fixture_setup(&fx), "fixture created");
+
+    mimetype_t* mimetype = mimetype_create();
+    TEST_REQUIRE_NOT_NULL_GOTO(mimetype, "mimetype table created", cleanup);
+    TEST_REQUIRE_GOTO(mimetype_add(mimetype, MIMETYPE_TABLE_EXT, "js", "application/javascript"), "js mapped", cleanup);
+
+    /* mtime = 1700000000 -> ETag W/"6553f100-f", Last-Modified Tue, 14 Nov 2023 */
+    struct timespec times[2] = {{ 1700000000, 0 }, { 1700000000, 0 }};
+    TEST_REQUIRE_GOTO(utimensat(AT_FDCWD, fx.file, times, 0) == 0, "mtime pinned", cleanup);
+
+    filecache_entry_t* entry = filecache_get(NULL, fx.file, NULL, mimetype);
+    TEST_REQUIRE_NOT_NULL_GOTO(entry, "entry created", cleanup);
+
+    TEST_ASSERT_STR_EQUAL("application/javascript", entry->mimetype, "mimetype copied");
+    TEST_ASSERT_EQUAL(22, (int)entry->mimetype_length, "mimetype length");
+    TEST_ASSERT_STR_EQUAL("W/\"6553f100-f\"", entry->etag, "weak etag mtime-size");
+    TEST_ASSERT_EQUAL((int)strlen(entry->etag), (int)entry->etag_length, "etag length");
+    TEST_ASSERT_STR_EQUAL("Tue, 14 Nov 2023 22:13:20 GMT", entry->last_modified, "IMF-fixdate");
+    TEST_ASSERT_EQUAL(29, (int)entry->last_modified_length, "last-modified length");
+
+    filecache_release(entry);
+
+    entry = filecache_get(NULL, fx.sub, "index.html", mimetype);
+    TEST_REQUIRE_NOT_NULL_GOTO(entry, "index entry created", cleanup);
+    TEST_ASSERT_NULL(entry->mimetype, "unknown extension -> NULL mimetype");
+    filecache_release(entry);
+
+    cleanup:
+    mimetype_destroy(mimetype);
+    fixture_teardown(&fx);
+}
+
+// ============================================================================
+// Caching, TTL and refcounting
+// ============================================================================
+
+TEST(test_filecache_hit_and_expire) {
+    TEST_SUITE("filecache: cache");
+    TEST_CASE("hits share one entry; expired entry stays open for its holder");
+
+    filecache_fixture_t fx;
+    TEST_REQUIRE(fixture_setup(&fx), "fixture created");
+
+    filecache_config_t config = { .max_entries = 16, .valid_s = 60 };
+    filecache_t* cache = filecache_create(&config);
+    TEST_REQUIRE_NOT_NULL_GOTO(cache, "cache created", cleanup);
+
+    filecache_entry_t* first = filecache_get(cache, fx.file, NULL, NULL);
+    TEST_REQUIRE_NOT_NULL_GOTO(first, "miss creates entry", cleanup);
+    TEST_ASSERT_EQUAL(2, atomic_load(&first->ref_count), "table + caller reference");
+
+    filecache_entry_t* second = filecache_get(cache, fx.file, NULL, NULL);
+    TEST_ASSERT(first == second, "hit returns the same entry");
+    TEST_ASSERT_EQUAL(3, atomic_load(&first->ref_count), "hit takes a reference");
+    filecache_release(second);
+
+    /* Истечение TTL без sleep: запись становится просроченной. */
+    first->valid_until_ns = 0;
+
+    filecache_entry_t* fresh = filecache_get(cache, fx.file, NULL, NULL);
+    TEST_REQUIRE_NOT_NULL_GOTO(fresh, "expired entry is rebuilt", cleanup_first);
+    TEST_ASSERT(fresh != first, "new entry after expiry");
+    TEST_ASSERT_EQUAL(1, atomic_load(&first->ref_count), "table dropped its reference");
+    TEST_ASSERT(fd_is_open(first->fd), "old fd stays open for the in-flight holder");
+    TEST_ASSERT_EQUAL(1, (int)hashmap_size(cache->entries), "one entry per key");
+    filecache_release(fresh);
+
+    cleanup_first:
+    filecache_release(first);
+
+    cleanup:
+    filecache_free(cache);
+    fixture_teardown(&fx);
+}
+
+TEST(test_filecache_negative_and_bound) {
+    TEST_CASE("negative results are cached; max_entries bounds the table");
+
+    filecache_fixture_t fx;
+    TEST_REQUIRE(fixture_setup(&fx), "fixture created");
+
+    filecache_config_t config = { .max_entries = 1, .valid_s = 60 };
+    filecache_t* cache = filecache_create(&config);
+    TEST_REQUIRE_NOT_NULL_GOTO(cache, "cache created", cleanup);
+
+    char missing[PATH_MAX];
+    snprintf(missing, sizeof(missing), "%s/missing.js", fx.root);
+
+    filecache_entry_t* entry = filecache_get(cache, missing, NULL, NULL);
+    TEST_REQUIRE_NOT_NULL_GOTO(entry, "negative entry", cleanup);
+    TEST_ASSERT_EQUAL(FILECACHE_NOTFOUND, entry->status, "missing file");
+    filecache_entry_t* again = filecache_get(cache, missing, NULL, NULL);
+    TEST_ASSERT(entry == again, "negative result served from cache");
+    filecache_release(again);
+    filecache_release(entry);
+
+    entry = filecache_get(cache, fx.file, NULL, NULL);
+    TEST_REQUIRE_NOT_NULL_GOTO(entry, "entry in a full table", cleanup);
+    TEST_ASSERT_EQUAL(FILECACHE_OK, entry->status, "entry resolved");
+    TEST_ASSERT_EQUAL(2, atomic_load(&entry->ref_count), "stored in place of the old entry");
+    TEST_ASSERT_EQUAL(1, (int)hashmap_size(cache->entries), "table stays bounded");
+    TEST_ASSERT_NULL(hashmap_find(cache->entries, missing), "least recently used entry evicted");
+    filecache_release(entry);
+
+    cleanup:
+    filecache_free(cache);
+    fixture_teardown(&fx);
+}
+
+TEST(test_filecache_lru) {
+    TEST_CASE("a full table evicts the least recently used entry");
+
+    filecache_fixture_t fx;
+    TEST_REQUIRE(fixture_setup(&fx), "fixture created");
+
+    filecache_config_t config = { .max_entries = 2, .valid_s = 60 };
+    filecache_t* cache = filecache_create(&config);
+    TEST_REQUIRE_NOT_NULL_GOTO(cache, "cache created", cleanup);
+
+    char missing_a[PATH_MAX];
+    char missing_b[PATH_MAX];
+    snprintf(missing_a, sizeof(missing_a), "%s/a.js", fx.root);
+    snprintf(missing_b, sizeof(missing_b), "%s/b.js", fx.root);
+
+    filecache_release(filecache_get(cache, fx.file, NULL, NULL));
+    filecache_release(filecache_get(cache, missing_a, NULL, NULL));
+
+    /* the hot file is used again, the miss is not */
+    filecache_release(filecache_get(cache, fx.file, NULL, NULL));
+    filecache_release(filecache_get(cache, missing_b, NULL, NULL));
+
+    TEST_ASSERT_EQUAL(2, (int)hashmap_size(cache->entries), "table stays bounded");
+    TEST_ASSERT_NOT_NULL(hashmap_find(cache->entries, fx.file), "hot file kept");
+    TEST_ASSERT_NULL(hashmap_find(cache->entries, missing_a), "least recently used miss evicted");
+    TEST_ASSERT_NOT_NULL(hashmap_find(cache->entries, missing_b), "new miss stored");
+
+    cleanup:
+    filecache_free(cache);
+    fixture_teardown(&fx);
+}
+
+// ============================================================================
+// File content in memory
+// ============================================================================
+
+static int __write_repeated(const char* path, char c, size_t size) {
+    FILE* f = fopen(path, "w");
+    if (f == NULL) return 0;
+    for (size_t i = 0; i < size; i++)
+        fputc(c, f);
+    fclose(f);
+    return 1;
+}
+
+static int __set_mtime(const char* path, time_t mtime) {
+    struct timeval times[2] = { { mtime, 0 }, { mtime, 0 } };
+    return utimes(path, times) == 0;
+}
+
+TEST(test_filecache_content_load) {
+    TEST_SUITE("filecache: content");
+    TEST_CASE("content is loaded on the second use with a gzip copy");
+
+    filecache_fixture_t fx;
+    TEST_REQUIRE(fixture_setup(&fx), "fixture created");
+
+    char big[PATH_MAX];
+    snprintf(big, sizeof(big), "%s/big.css", fx.root);
+    TEST_REQUIRE(__write_repeated(big, 'a', 4000), "big file written");
+
+    filecache_config_t config = {
+        .max_entries = 16,
+        .valid_s = 60,
+        .content_max_size = 4096,
+        .content_memory = 1024 * 1024
+    };
+    filecache_t* cache = filecache_create(&config);
+    TEST_REQUIRE_NOT_NULL_GOTO(cache, "cache created", cleanup);
+
+    filecache_entry_t* entry = filecache_get(cache, big, NULL, NULL);
+    TEST_REQUIRE_NOT_NULL_GOTO(entry, "entry created", cleanup);
+
+    TEST_ASSERT_NULL(filecache_content_get(cache, entry, 1), "first use is served from fd");
+
+    filecache_content_t* content = filecache_content_get(cache, entry, 1);
+    TEST_REQUIRE_NOT_NULL_GOTO(content, "second use loads content", cleanup_entry);
+    TEST_ASSERT_EQUAL(4000, (int)content->size, "whole file loaded");
+    TEST_ASSERT(content->data[0] == 'a' && content->data[3999] == 'a', "file bytes copied");
+    TEST_REQUIRE_NOT_NULL_GOTO(content->gzip, "gzip copy built", cleanup_content);
+    TEST_ASSERT(content->gzip_size < content->size, "gzip copy is smaller");
+    TEST_ASSERT((unsigned char)content->gzip[0] == 0x1f && (unsigned char)content->gzip[1] == 0x8b, "gzip magic");
+    TEST_ASSERT_EQUAL((int)(content->size + content->gzip_size), (int)cache->content_total, "memory accounted");
+
+    filecache_content_t* again = filecache_content_get(cache, entry, 1);
+    TEST_ASSERT(again == content, "content shared between responses");
+    TEST_ASSERT_EQUAL(3, atomic_load(&content->ref_count), "entry + two responses");
+    filecache_content_release(again);
+
+    filecache_entry_t* small = filecache_get(cache, fx.file, NULL, NULL);
+    TEST_REQUIRE_NOT_NULL_GOTO(small, "small entry created", cleanup_content);
+    filecache_content_release(filecache_content_get(cache, small, 0));
+    filecache_content_t* plain = filecache_content_get(cache, small, 0);
+    TEST_ASSERT_NOT_NULL(plain, "small file loaded");
+    if (plain != NULL)
+        TEST_ASSERT_NULL(plain->gzip, "no gzip copy without compress");
+    filecache_content_release(plain);
+    filecache_release(small);
+
+    cleanup_content:
+    filecache_content_release(content);
+
+    cleanup_entry:
+    filecache_release(entry);
+
+    cleanup:
+    filecache_free(cache);
+    unlink(big);
+    fixture_teardown(&fx);
+}
+
+TEST(test_filecache_content_bounds) {
+    TEST_CASE("content_max_size and content_memory bound the content, LRU first");
+
+    filecache_fixture_t fx;
+    TEST_REQUIRE(fixture_setup(&fx), "fixture created");
+
+    char paths[3][PATH_MAX];
+    for (int i = 0; i < 3; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "%s/f%d.bin", fx.root, i);
+        TEST_REQUIRE(__write_repeated(paths[i], 'x', 100), "file written");
+    }
+
+    filecache_config_t config = {
+        .max_entries = 16,
+        .valid_s = 60,
+        .content_max_size = 100,
+        .content_memory = 200
+    };
+    filecache_t* cache = filecache_create(&config);
+    TEST_REQUIRE_NOT_NULL_GOTO(cache, "cache created", cleanup);
+
+    filecache_entry_t* entries[3] = { NULL, NULL, NULL };
+    for (int i = 0; i < 3; i++) {
+        entries[i] = filecache_get(cache, paths[i], NULL, NULL);
+        TEST_REQUIRE_NOT_NULL_GOTO(entries[i], "entry created", cleanup_entries);
+        filecache_content_release(filecache_content_get(cache, entries[i], 0));
+        filecache_content_release(filecache_content_get(cache, entries[i], 0));
+    }
+
+    TEST_ASSERT_NULL(entries[0]->content, "least recently used content dropped");
+    TEST_ASSERT_NOT_NULL(entries[1]->content, "second content kept");
+    TEST_ASSERT_NOT_NULL(entries[2]->content, "newest content kept");
+    TEST_ASSERT_EQUAL(200, (int)cache->content_total, "memory budget respected");
+
+    TEST_REQUIRE(__write_repeated(paths[0], 'x', 101), "file grown");
+    entries[0]->valid_until_ns = 0;
+    filecache_entry_t* grown = filecache_get(cache, paths[0], NULL, NULL);
+    TEST_REQUIRE_NOT_NULL_GOTO(grown, "grown entry created", cleanup_entries);
+    filecache_content_release(filecache_content_get(cache, grown, 0));
+    TEST_ASSERT_NULL(filecache_content_get(cache, grown, 0), "file above content_max_size stays on fd");
+    filecache_release(grown);
+
+    cleanup_entries:
+    for (int i = 0; i < 3; i++)
+        filecache_release(entries[i]);
+
+    cleanup:
+    filecache_free(cache);
+    for (int i = 0; i < 3; i++)
+        unlink(paths[i]);
+    fixture_teardown(&fx);
+}
+
+TEST(test_filecache_content_revalidate) {
+    TEST_CASE("revalidation keeps content of an unchanged file, mtime change drops it");
+
+    filecache_fixture_t fx;
+    TEST_REQUIRE(fixture_setup(&fx), "fixture created");
+    TEST_REQUIRE(__set_mtime(fx.file, 1700000000), "mtime pinned");
+
+    filecache_config_t config = {
+        .max_entries = 16,
+        .valid_s = 60,
+        .content_max_size = 4096,
+        .content_memory = 4096
+    };
+    filecache_t* cache = filecache_create(&config);
+    TEST_REQUIRE_NOT_NULL_GOTO(cache, "cache created", cleanup);
+
+    filecache_entry_t* entry = filecache_get(cache, fx.file, NULL, NULL);
+    TEST_REQUIRE_NOT_NULL_GOTO(entry, "entry created", cleanup);
+    filecache_content_release(filecache_content_get(cache, entry, 0));
+    filecache_content_t* content = filecache_content_get(cache, entry, 0);
+    TEST_ASSERT_NOT_NULL(content, "content loaded");
+    filecache_content_release(content);
+
+    entry->valid_until_ns = 0;
+    filecache_release(entry);
+
+    entry = filecache_get(cache, fx.file, NULL, NULL);
+    TEST_REQUIRE_NOT_NULL_GOTO(entry, "entry revalidated", cleanup);
+    TEST_ASSERT(entry->content == content, "unchanged file keeps its content");
+    TEST_ASSERT_EQUAL(15, (int)cache->content_total, "content accounted once");
+
+    TEST_REQUIRE_GOTO(__set_mtime(fx.file, 1700000100), "mtime changed", cleanup_entry);
+    entry->valid_until_ns = 0;
+    filecache_release(entry);
+
+    entry = filecache_get(cache, fx.file, NULL, NULL);
+    TEST_REQUIRE_NOT_NULL_GOTO(entry, "entry revalidated after change", cleanup);
+    TEST_ASSERT_NULL(entry->content, "changed file drops content");
+    TEST_ASSERT_EQUAL(0, (int)cache->content_total, "memory returned");
+    TEST_ASSERT_NULL(filecache_content_get(cache, entry, 0), "changed file starts from the first use");
+
+    cleanup_entry:
+    filecache_release(entry);
+
+    cleanup:
+    filecache_free(cache);
+    fixture_teardown(&fx);
+}
@@ -0,0 +1,76 @@
+/*
+ * Unit tests for misc/gzip.c deflate stream pool.
+ *
+ * A released stream is reset and handed out again to the same thread:
+ * first for the same level, then for another level via deflateParams.
+ * A reused stream must produce a complete, independent gzip member.
+ */
+
+#include "framework.h"
+#include "gzip.h"
+
+#include <string.h>
+
+static int deflate_roundtrip(gzip_t* gzip, const char* data, size_t size) {
+    char compressed[4096];
+    char out[4096];
+
+    gzip_set_in(gzip, data, size);
+    const size_t compressed_size = gzip_deflate(gzip, compressed, sizeof(compressed), 1);
+    if (!gzip_is_end(gzip))
+        return 0;
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, MAX_WBITS + 16) != Z_OK)
+        return 0;
+
+    stream.next_in = (Bytef*)compressed;
+    stream.avail_in = (uInt)compressed_size;
+    stream.next_out = (Bytef*)out;
+    stream.avail_out = sizeof(out);
+
+    const int r = inflate(&stream, Z_FINISH);
+    const uLong produced = stream.total_out;
+    inflateEnd(&stream);
+
+    return r == Z_STREAM_END && produced == size && memcmp(out, data, size) == 0;
+}
+
+TEST(test_gzip_pool_reuses_stream) {
+    TEST_SUITE("gzip: deflate pool");
+    TEST_CASE("a released stream is reused for the same level and stays valid");
+
+    const char data[] = "pooled deflate stream pooled deflate stream pooled deflate stream";
+
+    gzip_t* first = gzip_deflate_acquire(1);
+    TEST_REQUIRE_NOT_NULL(first, "stream should be acquired");
+    TEST_ASSERT(deflate_roundtrip(first, data, sizeof(data)), "first response should round-trip");
+    gzip_deflate_release(first);
+
+    gzip_t* second = gzip_deflate_acquire(1);
+    TEST_ASSERT(second == first, "the pooled stream should be reused");
+    TEST_ASSERT(deflate_roundtrip(second, data, sizeof(data)), "reused stream should round-trip");
+    gzip_deflate_release(second);
+
+    gzip_pool_free();
+}
+
+TEST(test_gzip_pool_changes_level) {
+    TEST_SUITE("gzip: deflate pool");
+    TEST_CASE("a pooled stream with another level is retuned instead of reallocated");
+
+    const char data[] = "level change level change level change level change";
+
+    gzip_t* first = gzip_deflate_acquire(1);
+    TEST_REQUIRE_NOT_NULL(first, "stream should be acquired");
+    gzip_deflate_release(first);
+
+    gzip_t* second = gzip_deflate_acquire(9);
+    TEST_ASSERT(second == first, "the pooled stream should be reused");
+    TEST_ASSERT_EQUAL(9, second->level, "level should be updated");
+    TEST_ASSERT(deflate_roundtrip(second, data, sizeof(data)), "retuned stream should round-trip");
+    gzip_deflate_release(second);
+
+    gzip_pool_free();
+}
@@ -28,6 +28,19 @@
  *     routing through log_error, polluting production logs;
  *   - the unconditional `return CWF_ERROR` after the while(1) in __body was
  *     unreachable dead code.
+ *
+ * A response served from the open file cache content with a gzip copy
+ * switches the body to that copy in __header (Content-Length, no chunked)
+ * and __body forwards it without deflating.
+ *
+ * With a request the encoding is negotiated from Accept-Encoding (br > zstd >
+ * gzip at equal q, unless a cached gzip copy exists): the brotli/zstd output is validated with the library
+ * decoders when they are compiled in, and a client that accepts no coding
+ * gets the identity body with Content-Length instead of chunked.
+ *
+ * An in-memory body without explicit chunked is compressed in one pass into
+ * the response body and sent with Content-Length; main.gzip_min_length sets
+ * the size below which nothing is compressed.
  */
 
 #include "framework.h"
@@ -36,8 +49,15 @@
 #include "http_gzip_filter.h"
 #include "connection_s.h"
 #include "bufo.h"
+#include "appconfig.h"
 
 #include <zlib.h>
+#ifdef Brotli_FOUND
+#include <brotli/decode.h>
+#endif
+#ifdef Zstd_FOUND
+#include <zstd.h>
+#endif
 #include <string.h>
 #include <stdlib.h>
 
@@ -138,6 +158,7 @@ typedef struct {
     http_filter_t sink_filter;
     sink_module_t sink;
     http_module_gzip_t* module;
+    httprequest_t* request;
 } gzip_fixture_t;
 
 static int fixture_setup(gzip_fixture_t* fx, size_t sink_capacity) {
@@ -192,6 +213,9 @@ static void fixture_teardown(gzip_fixture_t* fx) {
 
     free(fx->sink.data);
 
+    if (fx->request != NULL)
+        httprequest_free(fx->request);
+
     if (fx->response != NULL)
         httpresponse_free(fx->response);
 
@@ -205,7 +229,21 @@ static int run_header(gzip_fixture_t* fx) {
 
 static int run_body(gzip_fixture_t* fx, bufo_t* parent) {
     fx->response->cur_filter = fx->gzip;
-    return fx->gzip->handler_body(NULL, fx->response, parent);
+    return fx->gzip->handler_body(fx->request, fx->response, parent);
+}
+
+/* Negotiated variant: header and body handlers see a request carrying the
+ * given Accept-Encoding (NULL - request without the header). */
+static int run_header_accept(gzip_fixture_t* fx, const char* accept_encoding) {
+    fx->request = httprequest_create(NULL);
+    if (fx->request == NULL)
+        return CWF_ERROR;
+
+    if (accept_encoding != NULL)
+        fx->request->add_header(fx->request, "Accept-Encoding", accept_encoding);
+
+    fx->response->cur_filter = fx->gzip;
+    return fx->gzip->handler_header(fx->request, fx->response);
 }
 
 static void parent_init(bufo_t* parent, char* data, size_t size, int is_last) {
@@ -225,6 +263,24 @@ static void body_set_size(httpresponse_t* response, size_t size) {
     response->body.pos = 0;
 }
 
+/* Streamed variant: the handler asked for chunked explicitly, so the filter
+ * deflates chunk by chunk instead of compressing the in-memory body once. */
+static int body_set_stream(httpresponse_t* response, size_t size) {
+    body_set_size(response, size);
+    return response->add_header(response, "Transfer-Encoding", "chunked");
+}
+
+static int body_set_data(httpresponse_t* response, const char* data, size_t size) {
+    bufo_clear(&response->body);
+    if (!bufo_alloc(&response->body, size))
+        return 0;
+
+    const int ok = bufo_append(&response->body, data, size) == (ssize_t)size;
+    bufo_reset_pos(&response->body);
+
+    return ok;
+}
+
 /* Strict gzip decoder. Returns the decoded size or -1 on malformed input. */
 static ssize_t inflate_gzip(const char* in, size_t in_size, char* out, size_t out_capacity) {
     z_stream stream;
@@ -425,7 +481,7 @@ TEST(test_gzip_header_adds_content_encoding_and_chunked) {
     gzip_fixture_t fx;
     TEST_REQUIRE(fixture_setup(&fx, 64), "fixture should be created");
 
-    body_set_size(fx.response, 4096);
+    body_set_stream(fx.response, 4096);
 
     const int r = run_header(&fx);
     TEST_ASSERT_EQUAL(CWF_OK, r, "header chain should finish with CWF_OK");
@@ -452,7 +508,7 @@ TEST(test_gzip_header_keeps_existing_content_encoding) {
 
     TEST_REQUIRE_GOTO(fx.response->add_header(fx.response, "Content-Encoding", "gzip"),
                       "precondition header should be added", cleanup);
-    body_set_size(fx.response, 4096);
+    body_set_stream(fx.response, 4096);
 
     const int r = run_header(&fx);
     TEST_ASSERT_EQUAL(CWF_OK, r, "header chain should finish with CWF_OK");
@@ -479,7 +535,7 @@ TEST(test_gzip_header_removes_stale_content_length) {
 
     TEST_REQUIRE_GOTO(fx.response->add_content_length(fx.response, 4096),
                       "precondition Content-Length should be added", cleanup);
-    body_set_size(fx.response, 4096);
+    body_set_stream(fx.response, 4096);
 
     const int r = run_header(&fx);
     TEST_ASSERT_EQUAL(CWF_OK, r, "header chain should finish with CWF_OK");
@@ -498,7 +554,7 @@ TEST(test_gzip_header_event_again_resume) {
     gzip_fixture_t fx;
     TEST_REQUIRE(fixture_setup(&fx, 64), "fixture should be created");
 
-    body_set_size(fx.response, 4096);
+    body_set_stream(fx.response, 4096);
     fx.sink.header_again_once = 1;
 
     int r = run_header(&fx);
@@ -531,7 +587,7 @@ TEST(test_gzip_body_single_chunk_roundtrip) {
     for (size_t i = 0; i < data_size; i++)
         data[i] = (char)('a' + i % 16);  /* repeating -> compresses well */
 
-    body_set_size(fx.response, data_size);
+    body_set_stream(fx.response, data_size);
     TEST_REQUIRE_GOTO(run_header(&fx) == CWF_OK, "header pass should succeed", cleanup);
 
     const int r = feed_chunks(&fx, data, data_size, data_size);
@@ -561,7 +617,7 @@ TEST(test_gzip_body_multi_chunk_roundtrip) {
     for (size_t i = 0; i < data_size; i++)
         data[i] = (char)('a' + i % 26);
 
-    body_set_size(fx.response, data_size);
+    body_set_stream(fx.response, data_size);
     TEST_REQUIRE_GOTO(run_header(&fx) == CWF_OK, "header pass should succeed", cleanup_buf);
 
     const int r = feed_chunks(&fx, data, data_size, 7000);  /* ~9 chunks */
@@ -596,7 +652,7 @@ TEST(test_gzip_body_incompressible_roundtrip) {
         data[i] = (char)(seed >> 16);
     }
 
-    body_set_size(fx.response, data_size);
+    body_set_stream(fx.response, data_size);
     TEST_REQUIRE_GOTO(run_header(&fx) == CWF_OK, "header pass should succeed", cleanup_buf);
 
     const int r = feed_chunks(&fx, data, data_size, GZIP_BUF_SIZE);
@@ -622,7 +678,7 @@ TEST(test_gzip_body_partial_write_resume) {
     for (size_t i = 0; i < data_size; i++)
         data[i] = (char)('a' + i % 10);
 
-    body_set_size(fx.response, data_size);
+    body_set_stream(fx.response, data_size);
     TEST_REQUIRE_GOTO(run_header(&fx) == CWF_OK, "header pass should succeed", cleanup);
 
     fx.sink.max_take_once = 100;  /* force many CWF_EVENT_AGAIN resumes */
@@ -706,6 +762,113 @@ TEST(test_gzip_body_last_modified_forwards_parent) {
     fixture_teardown(&fx);
 }
 
+// ============================================================================
+// Precompressed content from the open file cache
+// ============================================================================
+
+static filecache_content_t* make_content(const char* data, size_t size, const char* gzip, size_t gzip_size) {
+    filecache_content_t* content = malloc(sizeof * content + size);
+    if (content == NULL) return NULL;
+
+    atomic_init(&content->ref_count, 1);
+    content->size = size;
+    content->memory = size + gzip_size;
+    content->gzip_size = gzip_size;
+    content->gzip = malloc(gzip_size);
+    if (content->gzip == NULL) {
+        free(content);
+        return NULL;
+    }
+
+    memcpy(content->data, data, size);
+    memcpy(content->gzip, gzip, gzip_size);
+
+    return content;
+}
+
+TEST(test_gzip_precompressed_content) {
+    TEST_SUITE("http_gzip_filter: precompressed");
+    TEST_CASE("cached gzip copy replaces the body with Content-Length and no deflate");
+
+    gzip_fixture_t fx;
+    TEST_REQUIRE(fixture_setup(&fx, 64), "fixture should be created");
+
+    char data[2048];
+    memset(data, 'z', sizeof(data));
+    const char gzip[] = "precompressed-gzip";
+
+    filecache_content_t* content = make_content(data, sizeof(data), gzip, sizeof(gzip) - 1);
+    TEST_REQUIRE_NOT_NULL_GOTO(content, "content should be created", cleanup);
+
+    /* Так тело выставляет http_response_file_entry при попадании в кэш. */
+    fx.response->file_content = content;
+    fx.response->body.data = content->data;
+    fx.response->body.capacity = content->size;
+    fx.response->body.size = content->size;
+    fx.response->body.is_proxy = 1;
+    fx.response->transfer_encoding = TE_CHUNKED;
+
+    TEST_ASSERT_EQUAL(CWF_OK, run_header(&fx), "header chain should finish with CWF_OK");
+    TEST_ASSERT_EQUAL_UINT(1, fx.module->precompressed, "module should switch to precompressed");
+    TEST_ASSERT_EQUAL(TE_NONE, fx.response->transfer_encoding, "precompressed body is not chunked");
+    TEST_ASSERT(fx.response->body.data == content->gzip, "body should point at the gzip copy");
+    TEST_ASSERT_EQUAL_SIZE(sizeof(gzip) - 1, fx.response->body.size, "body size is the gzip size");
+
+    http_header_t* h = fx.response->get_header(fx.response, "Content-Length");
+    TEST_REQUIRE_NOT_NULL_GOTO(h, "Content-Length should be added", cleanup);
+    TEST_ASSERT_STR_EQUAL("18", h->value, "Content-Length should be the gzip size");
+    TEST_ASSERT_NOT_NULL(fx.response->get_header(fx.response, "Content-Encoding"), "Content-Encoding should be added");
+
+    bufo_t parent;
+    parent_init(&parent, content->gzip, content->gzip_size, 1);
+    TEST_ASSERT_EQUAL(CWF_DATA_AGAIN, run_body(&fx, &parent), "body should forward the sink result");
+    TEST_ASSERT_EQUAL_SIZE(sizeof(gzip) - 1, fx.sink.size, "gzip copy should be forwarded verbatim");
+    TEST_ASSERT(memcmp(fx.sink.data, gzip, sizeof(gzip) - 1) == 0, "bytes should match");
+
+    fx.module->base.reset(fx.module);
+    TEST_ASSERT_EQUAL_UINT(0, fx.module->precompressed, "reset should clear precompressed");
+
+    cleanup:
+    fixture_teardown(&fx);
+}
+
+static int run_precompressed_accept(gzip_fixture_t* fx, filecache_content_t* content, const char* accept_encoding) {
+    fx->response->file_content = content;
+    fx->response->body.data = content->data;
+    fx->response->body.capacity = content->size;
+    fx->response->body.size = content->size;
+    fx->response->body.is_proxy = 1;
+
+    return run_header_accept(fx, accept_encoding);
+}
+
+TEST(test_gzip_precompressed_preferred_at_equal_q) {
+    TEST_SUITE("http_gzip_filter: precompressed");
+    TEST_CASE("at equal q the cached gzip copy wins over compressing again");
+
+    gzip_fixture_t fx;
+    TEST_REQUIRE(fixture_setup(&fx, 64), "fixture should be created");
+
+    char data[2048];
+    memset(data, 'z', sizeof(data));
+    const char gzip[] = "precompressed-gzip";
+
+    filecache_content_t* content = make_content(data, sizeof(data), gzip, sizeof(gzip) - 1);
+    TEST_REQUIRE_NOT_NULL_GOTO(content, "content should be created", cleanup);
+
+    TEST_REQUIRE_GOTO(run_precompressed_accept(&fx, content, "gzip, deflate, br, zstd") == CWF_OK,
+        "header should succeed", cleanup);
+
+    http_header_t* h = fx.response->get_header(fx.response, "Content-Encoding");
+    TEST_REQUIRE_NOT_NULL_GOTO(h, "Content-Encoding should be added", cleanup);
+    TEST_ASSERT_STR_EQUAL("gzip", h->value, "gzip copy should be chosen");
+    TEST_ASSERT_EQUAL_UINT(1, fx.module->precompressed, "module should switch to precompressed");
+    TEST_ASSERT(fx.response->body.data == content->gzip, "body should point at the gzip copy");
+
+    cleanup:
+    fixture_teardown(&fx);
+}
+
 // ============================================================================
 // Reset and reuse
 // ============================================================================
@@ -745,7 +908,7 @@ TEST(test_gzip_reset_allows_reuse) {
     for (size_t i = 0; i < data_size; i++)
         data[i] = (char)('a' + i % 16);
 
-    body_set_size(fx.response, data_size);
+    body_set_stream(fx.response, data_size);
     TEST_REQUIRE_GOTO(run_header(&fx) == CWF_OK, "first header should succeed", cleanup);
     TEST_REQUIRE_GOTO(feed_chunks(&fx, data, data_size, data_size) == CWF_DATA_AGAIN,
                       "first body should drain", cleanup);
@@ -760,7 +923,7 @@ TEST(test_gzip_reset_allows_reuse) {
     fx.response->transfer_encoding = TE_NONE;
     fx.response->content_encoding = CE_GZIP;
 
-    body_set_size(fx.response, data_size);
+    body_set_stream(fx.response, data_size);
     TEST_REQUIRE_GOTO(run_header(&fx) == CWF_OK, "second header should succeed", cleanup);
     const int r = feed_chunks(&fx, data, data_size, data_size);
     TEST_ASSERT_EQUAL(CWF_DATA_AGAIN, r, "second body should drain after reset");
@@ -770,3 +933,252 @@ TEST(test_gzip_reset_allows_reuse) {
     cleanup:
     fixture_teardown(&fx);
 }
+
+// ============================================================================
+// Accept-Encoding negotiation
+// ============================================================================
+
+TEST(test_gzip_negotiate_identity) {
+    TEST_SUITE("http_gzip_filter: negotiation");
+    TEST_CASE("a client without an acceptable coding gets the identity body with Content-Length");
+
+    gzip_fixture_t fx;
+    TEST_REQUIRE(fixture_setup(&fx, 64), "fixture should be created");
+
+    fx.response->transfer_encoding = TE_CHUNKED;
+    body_set_size(fx.response, 4096);
+
+    const int r = run_header_accept(&fx, "identity, gzip;q=0");
+    TEST_ASSERT_EQUAL(CWF_OK, r, "header chain should finish with CWF_OK");
+    TEST_ASSERT_EQUAL(CE_NONE, fx.response->content_encoding, "content_encoding should become CE_NONE");
+    TEST_ASSERT_EQUAL(TE_NONE, fx.response->transfer_encoding, "implicit chunked should be dropped");
+    TEST_ASSERT_NULL(fx.response->get_header(fx.response, "Content-Encoding"), "Content-Encoding must not be sent");
+
+    http_header_t* length = fx.response->get_header(fx.response, "Content-Length");
+    TEST_REQUIRE_NOT_NULL_GOTO(length, "Content-Length should be added", cleanup);
+    TEST_ASSERT_STR_EQUAL("4096", length->value, "Content-Length should be the body size");
+
+    http_header_t* vary = fx.response->get_header(fx.response, "Vary");
+    TEST_REQUIRE_NOT_NULL_GOTO(vary, "Vary should be added", cleanup);
+    TEST_ASSERT_STR_EQUAL("Accept-Encoding", vary->value, "Vary should name Accept-Encoding");
+
+    cleanup:
+    fixture_teardown(&fx);
+}
+
+TEST(test_gzip_negotiate_missing_header) {
+    TEST_SUITE("http_gzip_filter: negotiation");
+    TEST_CASE("a request without Accept-Encoding is not compressed");
+
+    gzip_fixture_t fx;
+    TEST_REQUIRE(fixture_setup(&fx, 64), "fixture should be created");
+
+    body_set_size(fx.response, 4096);
+
+    TEST_ASSERT_EQUAL(CWF_OK, run_header_accept(&fx, NULL), "header chain should finish with CWF_OK");
+    TEST_ASSERT_EQUAL(CE_NONE, fx.response->content_encoding, "content_encoding should become CE_NONE");
+    TEST_ASSERT_NULL(fx.response->get_header(fx.response, "Content-Encoding"), "Content-Encoding must not be sent");
+
+    fixture_teardown(&fx);
+}
+
+TEST(test_gzip_negotiate_qvalue_gzip) {
+    TEST_SUITE("http_gzip_filter: negotiation");
+    TEST_CASE("q-values select gzip over lower-weighted codings and the body round-trips");
+
+    gzip_fixture_t fx;
+    TEST_REQUIRE(fixture_setup(&fx, 1 << 16), "fixture should be created");
+
+    enum { data_size = 4096 };
+    char data[data_size];
+    for (size_t i = 0; i < data_size; i++)
+        data[i] = (char)('a' + i % 7);
+
+    body_set_stream(fx.response, data_size);
+
+    TEST_REQUIRE_GOTO(run_header_accept(&fx, "br;q=0.2, zstd;q=0.1, gzip") == CWF_OK,
+                      "header should succeed", cleanup);
+
+    http_header_t* h = fx.response->get_header(fx.response, "Content-Encoding");
+    TEST_REQUIRE_NOT_NULL_GOTO(h, "Content-Encoding should be added", cleanup);
+    TEST_ASSERT_STR_EQUAL("gzip", h->value, "gzip has the highest q");
+    TEST_ASSERT_EQUAL(CE_GZIP, fx.response->content_encoding, "content_encoding should be CE_GZIP");
+
+    TEST_ASSERT_EQUAL(CWF_DATA_AGAIN, feed_chunks(&fx, data, data_size, 1000), "body should drain");
+    TEST_ASSERT(sink_inflates_to(&fx, data, data_size), "gzip output should round-trip");
+
+    cleanup:
+    fixture_teardown(&fx);
+}
+
+#ifdef Brotli_FOUND
+TEST(test_gzip_negotiate_brotli_roundtrip) {
+    TEST_SUITE("http_gzip_filter: negotiation");
+    TEST_CASE("br is preferred over zstd and gzip at equal q and decodes with the brotli decoder");
+
+    gzip_fixture_t fx;
+    TEST_REQUIRE(fixture_setup(&fx, 1 << 16), "fixture should be created");
+
+    enum { data_size = 40000 };
+    char* data = malloc(data_size);
+    char* out = malloc(data_size);
+    TEST_REQUIRE_NOT_NULL_GOTO(data, "data should be allocated", cleanup);
+    TEST_REQUIRE_NOT_NULL_GOTO(out, "out should be allocated", cleanup);
+    for (size_t i = 0; i < data_size; i++)
+        data[i] = (char)('a' + (i * 7) % 23);
+
+    body_set_stream(fx.response, data_size);
+
+    TEST_REQUIRE_GOTO(run_header_accept(&fx, "gzip, deflate, zstd, br") == CWF_OK, "header should succeed", cleanup);
+
+    http_header_t* h = fx.response->get_header(fx.response, "Content-Encoding");
+    TEST_REQUIRE_NOT_NULL_GOTO(h, "Content-Encoding should be added", cleanup);
+    TEST_ASSERT_STR_EQUAL("br", h->value, "br should be chosen");
+    TEST_ASSERT_EQUAL(TE_CHUNKED, fx.response->transfer_encoding, "br body should be chunked");
+
+    TEST_ASSERT_EQUAL(CWF_DATA_AGAIN, feed_chunks(&fx, data, data_size, 5000), "body should drain");
+    TEST_ASSERT_EQUAL_UINT(1, fx.sink.saw_last, "final buffer should be marked");
+
+    size_t decoded = data_size;
+    const BrotliDecoderResult result = BrotliDecoderDecompress(fx.sink.size, (const uint8_t*)fx.sink.data, &decoded, (uint8_t*)out);
+    TEST_ASSERT_EQUAL(BROTLI_DECODER_RESULT_SUCCESS, result, "brotli stream should decode");
+    TEST_ASSERT_EQUAL_SIZE(data_size, decoded, "decoded size should match");
+    TEST_ASSERT(memcmp(data, out, data_size) == 0, "decoded bytes should match");
+
+    cleanup:
+    free(data);
+    free(out);
+    fixture_teardown(&fx);
+}
+#endif
+
+#ifdef Zstd_FOUND
+TEST(test_gzip_negotiate_zstd_roundtrip) {
+    TEST_SUITE("http_gzip_filter: negotiation");
+    TEST_CASE("zstd is chosen by a higher q and decodes with the zstd decoder");
+
+    gzip_fixture_t fx;
+    TEST_REQUIRE(fixture_setup(&fx, 1 << 16), "fixture should be created");
+
+    enum { data_size = 40000 };
+    char* data = malloc(data_size);
+    char* out = malloc(data_size);
+    TEST_REQUIRE_NOT_NULL_GOTO(data, "data should be allocated", cleanup);
+    TEST_REQUIRE_NOT_NULL_GOTO(out, "out should be allocated", cleanup);
+    for (size_t i = 0; i < data_size; i++)
+        data[i] = (char)('a' + (i * 7) % 23);
+
+    body_set_stream(fx.response, data_size);
+
+    TEST_REQUIRE_GOTO(run_header_accept(&fx, "gzip;q=0.8, br;q=0.9, zstd") == CWF_OK, "header should succeed", cleanup);
+
+    http_header_t* h = fx.response->get_header(fx.response, "Content-Encoding");
+    TEST_REQUIRE_NOT_NULL_GOTO(h, "Content-Encoding should be added", cleanup);
+    TEST_ASSERT_STR_EQUAL("zstd", h->value, "zstd should be chosen");
+
+    TEST_ASSERT_EQUAL(CWF_DATA_AGAIN, feed_chunks(&fx, data, data_size, 5000), "body should drain");
+
+    /* Потоковые кадры без размера содержимого: декодируем потоком */
+    ZSTD_DCtx* dctx = ZSTD_createDCtx();
+    TEST_REQUIRE_NOT_NULL_GOTO(dctx, "decoder should be created", cleanup);
+
+    ZSTD_inBuffer input = { fx.sink.data, fx.sink.size, 0 };
+    ZSTD_outBuffer output = { out, data_size, 0 };
+    size_t remaining = 1;
+    while (input.pos < input.size && remaining != 0 && !ZSTD_isError(remaining))
+        remaining = ZSTD_decompressStream(dctx, &output, &input);
+    ZSTD_freeDCtx(dctx);
+
+    TEST_ASSERT_EQUAL_SIZE(0, remaining, "zstd frame should be complete");
+    TEST_ASSERT_EQUAL_SIZE(data_size, output.pos, "decoded size should match");
+    TEST_ASSERT(memcmp(data, out, data_size) == 0, "decoded bytes should match");
+
+    cleanup:
+    free(data);
+    free(out);
+    fixture_teardown(&fx);
+}
+#endif
+
+// ============================================================================
+// One-shot compression and size threshold
+// ============================================================================
+
+TEST(test_gzip_oneshot_content_length) {
+    TEST_SUITE("http_gzip_filter: one-shot");
+    TEST_CASE("an in-memory body is compressed once and sent with Content-Length");
+
+    gzip_fixture_t fx;
+    TEST_REQUIRE(fixture_setup(&fx, 1 << 16), "fixture should be created");
+
+    enum { data_size = 8192 };
+    char data[data_size];
+    for (size_t i = 0; i < data_size; i++)
+        data[i] = (char)('a' + i % 11);
+
+    TEST_REQUIRE_GOTO(body_set_data(fx.response, data, data_size), "body should be set", cleanup);
+    TEST_REQUIRE_GOTO(fx.response->add_content_length(fx.response, data_size),
+                      "precondition Content-Length should be added", cleanup);
+
+    TEST_ASSERT_EQUAL(CWF_OK, run_header(&fx), "header chain should finish with CWF_OK");
+    TEST_ASSERT_EQUAL(TE_NONE, fx.response->transfer_encoding, "one-shot body must not be chunked");
+    TEST_ASSERT_EQUAL_UINT(1, fx.module->precompressed, "body should be marked as compressed");
+    TEST_ASSERT_NULL(fx.module->gzip, "deflate stream should go back to the pool");
+    TEST_ASSERT_NULL(fx.module->buf->data, "streaming buffer should not be allocated");
+    TEST_ASSERT(fx.response->body.size < data_size, "body should shrink");
+
+    http_header_t* length = fx.response->get_header(fx.response, "Content-Length");
+    TEST_REQUIRE_NOT_NULL_GOTO(length, "Content-Length should be present", cleanup);
+    TEST_ASSERT_EQUAL_SIZE(fx.response->body.size, (size_t)strtoul(length->value, NULL, 10),
+                           "Content-Length should be the compressed size");
+    TEST_ASSERT_EQUAL(1, header_count(fx.response, "Content-Length"), "Content-Length should stay unique");
+
+    char out[data_size];
+    TEST_ASSERT_EQUAL(data_size, inflate_gzip(fx.response->body.data, fx.response->body.size, out, data_size),
+                      "compressed body should inflate");
+    TEST_ASSERT(memcmp(data, out, data_size) == 0, "inflated body should match");
+
+    /* The data filter then offers the compressed body as is. */
+    bufo_t parent;
+    parent_init(&parent, fx.response->body.data, fx.response->body.size, 1);
+    TEST_ASSERT_EQUAL(CWF_DATA_AGAIN, run_body(&fx, &parent), "body should be forwarded");
+    TEST_ASSERT(sink_inflates_to(&fx, data, data_size), "forwarded bytes should inflate");
+
+    cleanup:
+    fixture_teardown(&fx);
+}
+
+TEST(test_gzip_min_length_threshold) {
+    TEST_SUITE("http_gzip_filter: one-shot");
+    TEST_CASE("main.gzip_min_length decides which bodies are compressed");
+
+    gzip_fixture_t fx;
+    TEST_REQUIRE(fixture_setup(&fx, 1 << 12), "fixture should be created");
+
+    const unsigned int min_length = env()->main.gzip_min_length;
+    env()->main.gzip_min_length = 64;
+
+    char data[512];
+    memset(data, 'x', sizeof(data));
+
+    TEST_REQUIRE_GOTO(body_set_data(fx.response, data, sizeof(data)), "body should be set", cleanup);
+    TEST_ASSERT_EQUAL(CWF_OK, run_header(&fx), "header chain should finish with CWF_OK");
+    TEST_ASSERT_NOT_NULL(fx.response->get_header(fx.response, "Content-Encoding"),
+                         "a body above the lowered threshold should be compressed");
+
+    fx.module->base.reset(fx.module);
+    fx.response->remove_header(fx.response, "Content-Encoding");
+    fx.response->remove_header(fx.response, "Content-Length");
+    fx.response->content_encoding = CE_GZIP;
+    env()->main.gzip_min_length = 1024;
+
+    TEST_REQUIRE_GOTO(body_set_data(fx.response, data, sizeof(data)), "body should be set", cleanup);
+    TEST_ASSERT_EQUAL(CWF_OK, run_header(&fx), "header chain should finish with CWF_OK");
+    TEST_ASSERT_NULL(fx.response->get_header(fx.response, "Content-Encoding"),
+                     "a body below the threshold should pass through");
+    TEST_ASSERT_EQUAL_SIZE(sizeof(data), fx.response->body.size, "body should stay intact");
+
+    cleanup:
+    env()->main.gzip_min_length = min_length;
+    fixture_teardown(&fx);
+}
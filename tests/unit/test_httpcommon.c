@@ -2,7 +2,8 @@
  * Unit tests for protocols/http/httpcommon.c
  *
  * Covers the shared HTTP building blocks: header create/free/delete,
- * payload part/field, cookie, ranges and the Basic-auth header builder.
+ * payload part/field, cookie, ranges, the Basic-auth header builder and
+ * Accept-Encoding q-value weights.
  * Several cases are regression guards for bugs fixed alongside these tests
  * (each is marked REGRESSION below):
  *
@@ -572,3 +573,43 @@ TEST(test_basic_auth_utf8_credentials) {
     TEST_ASSERT_STR_EQUAL(expected, result, "UTF-8 credentials should round-trip through base64");
     free(result);
 }
+
+// ============================================================================
+// http_accept_encoding_weight
+// ============================================================================
+
+static int weight(const char* value, const char* coding) {
+    return http_accept_encoding_weight(value, strlen(value), coding);
+}
+
+TEST(test_accept_encoding_plain_list) {
+    TEST_SUITE("httpcommon: accept-encoding");
+    TEST_CASE("listed codings weigh 1000, unlisted -1");
+
+    TEST_ASSERT_EQUAL(1000, weight("br, gzip", "br"), "br listed");
+    TEST_ASSERT_EQUAL(1000, weight("br, gzip", "gzip"), "gzip listed");
+    TEST_ASSERT_EQUAL(-1, weight("br, gzip", "zstd"), "zstd not listed");
+    TEST_ASSERT_EQUAL(1000, weight("GZIP", "gzip"), "case-insensitive");
+    TEST_ASSERT_EQUAL(1000, weight("x-gzip", "gzip"), "x-gzip is gzip");
+    TEST_ASSERT_EQUAL(-1, weight("gzipx, brotli", "gzip"), "no prefix matches");
+    TEST_ASSERT_EQUAL(-1, weight("gzipx, brotli", "br"), "no prefix matches for br");
+    TEST_ASSERT_EQUAL(-1, weight("", "gzip"), "empty header");
+    TEST_ASSERT_EQUAL(-1, http_accept_encoding_weight(NULL, 0, "gzip"), "NULL header");
+}
+
+TEST(test_accept_encoding_qvalues) {
+    TEST_CASE("q parameters, wildcard and malformed values");
+
+    TEST_ASSERT_EQUAL(500, weight("gzip;q=0.5, br", "gzip"), "q=0.5");
+    TEST_ASSERT_EQUAL(1000, weight("gzip;q=0.5, br", "br"), "default q");
+    TEST_ASSERT_EQUAL(0, weight("br;q=0, gzip", "br"), "explicitly refused");
+    TEST_ASSERT_EQUAL(123, weight("zstd ; q=0.123", "zstd"), "spaces around parameters");
+    TEST_ASSERT_EQUAL(1000, weight("br;q=1.000", "br"), "q=1.000");
+    TEST_ASSERT_EQUAL(800, weight("br;level=1;Q=0.8", "br"), "q after another parameter");
+    TEST_ASSERT_EQUAL(300, weight("*;q=0.3", "zstd"), "wildcard applies to unlisted");
+    TEST_ASSERT_EQUAL(1000, weight("*;q=0, gzip", "gzip"), "explicit entry wins over wildcard");
+    TEST_ASSERT_EQUAL(0, weight("*;q=0, gzip", "br"), "wildcard refuses the rest");
+    TEST_ASSERT_EQUAL(0, weight("br;q=1.5", "br"), "q above 1 is malformed");
+    TEST_ASSERT_EQUAL(0, weight("br;q=0.1234", "br"), "more than three digits is malformed");
+    TEST_ASSERT_EQUAL(0, weight("br;q=abc", "br"), "non-numeric q is malformed");
+}
@@ -33,6 +33,7 @@ static void init_test_appconfig(void) {
             test_appconfig->env.main.workers = 1;
             test_appconfig->env.main.threads = 1;
             test_appconfig->env.main.gzip = NULL;
+            test_appconfig->env.main.gzip_min_length = ENV_GZIP_MIN_LENGTH_DEFAULT;
 
             // Initialize other fields to NULL/0
             test_appconfig->path = NULL;
@@ -77,12 +78,16 @@ static domain_t mock_domain = {
     .next = NULL
 };
 
+static server_routing_t mock_routing = {
+    .http = {.route = NULL, .ratelimiter = NULL, .redirect = NULL, .middleware = NULL},
+    .websockets = {.route = NULL, .ratelimiter = NULL, .default_handler = NULL, .middleware = NULL}
+};
+
 static server_t mock_server = {
     .ip = 0x0100007F,  // 127.0.0.1
     .port = 8080,
     .domain = &mock_domain,
-    .http = {.route = NULL, .ratelimiter = NULL, .redirect = NULL, .middleware = NULL},
-    .websockets = {.route = NULL, .ratelimiter = NULL, .default_handler = NULL, .middleware = NULL},
+    .routing = &mock_routing,
     .next = NULL
 };
 
@@ -26,12 +26,16 @@ static domain_t mock_domain = {
     .next = NULL
 };
 
+static server_routing_t mock_routing = {
+    .http = {.route = NULL, .ratelimiter = NULL, .redirect = NULL, .middleware = NULL},
+    .websockets = {.route = NULL, .ratelimiter = NULL, .default_handler = NULL, .middleware = NULL}
+};
+
 static server_t mock_server = {
     .ip = 0x0100007F,  // 127.0.0.1
     .port = 8080,
     .domain = &mock_domain,
-    .http = {.route = NULL, .ratelimiter = NULL, .redirect = NULL, .middleware = NULL},
-    .websockets = {.route = NULL, .ratelimiter = NULL, .default_handler = NULL, .middleware = NULL},
+    .routing = &mock_routing,
     .next = NULL
 };
 
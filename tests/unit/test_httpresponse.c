@@ -19,6 +19,12 @@
  *     response, so httpresponse_has_payload() lied on reused connections.
  *   - __httpresponse_headern_add ran strlen() on the key although the API
  *     receives explicit lengths (OOB read for non NUL-terminated slices).
+ *   - precompressed sidecars (file.br/.zst/.gz), when enabled per server, are
+ *     picked by Accept-Encoding q-values and served with Content-Encoding,
+ *     bypassing gzip; every negotiated response carries Vary.
+ *   - add_span/httpresponse_server_timing: custom spans are sanitized into
+ *     tokens and capped at HTTP_SPANS_MAX, phases without both ends are
+ *     left out of the Server-Timing value.
  *   - __httpresponse_payload_parse_plain leaked the previous payload part on
  *     repeated get_payload_file calls; get_payload_file reported ok=1 even
  *     when no payload file exists (dead `field` logic).
@@ -29,6 +35,7 @@
  */
 
 #include "framework.h"
+#include "httprequest.h"
 #include "httpresponse.h"
 #include "httpcommon.h"
 #include "connection_s.h"
@@ -863,6 +870,97 @@ TEST(test_http_get_file_full_path) {
     rmdir(root);
 }
 
+// ============================================================================
+// Precompressed sidecars
+// ============================================================================
+
+static const char* negotiate(httpresponse_t* response, const char* path, const char* accept) {
+    http_header_t* header = NULL;
+    if (accept != NULL)
+        header = http_header_create("Accept-Encoding", 15, accept, strlen(accept));
+
+    response->base.reset(response);
+    http_response_file_negotiate(response, path, header);
+    http_header_free(header);
+
+    http_header_t* encoding = response->get_header(response, "Content-Encoding");
+
+    return encoding != NULL ? encoding->value : NULL;
+}
+
+TEST(test_httpresponse_file_negotiate_sidecars) {
+    TEST_SUITE("httpresponse: precompressed sidecars");
+    TEST_CASE("the best accepted sidecar is served with Content-Encoding and Vary");
+
+    char root[] = "/tmp/cwfr_httpresponse_XXXXXX";
+    TEST_REQUIRE_NOT_NULL(mkdtemp(root), "test root created");
+
+    char file[PATH_MAX];
+    char br[PATH_MAX];
+    char gz[PATH_MAX];
+    snprintf(file, sizeof(file), "%s/app.js", root);
+    snprintf(br, sizeof(br), "%s/app.js.br", root);
+    snprintf(gz, sizeof(gz), "%s/app.js.gz", root);
+
+    TEST_REQUIRE(write_whole_file(file, "console.log('identity');"), "file written");
+    TEST_REQUIRE(write_whole_file(br, "brotli"), "br sidecar written");
+    TEST_REQUIRE(write_whole_file(gz, "gzip-bytes"), "gz sidecar written");
+
+    server_t server;
+    memset(&server, 0, sizeof(server));
+    server.root = root;
+    server.root_length = strlen(root);
+
+    connection_t* conn = NULL;
+    httpresponse_t* response = make_response(&conn);
+    TEST_REQUIRE_NOT_NULL_GOTO(response, "response allocated", cleanup);
+    test_response_ctx.server = &server;
+
+    const char* coding = negotiate(response, file, "br");
+    TEST_ASSERT_NULL(coding, "sidecars are not looked up unless enabled");
+    TEST_ASSERT_EQUAL_SIZE(24, response->file_.size, "identity served");
+    TEST_ASSERT_NULL(response->get_header(response, "Vary"), "no Vary without negotiation");
+
+    server.precompressed = 1;
+
+    coding = negotiate(response, file, "gzip, deflate, br");
+    TEST_ASSERT_STR_EQUAL("br", coding, "br preferred at equal q");
+    TEST_ASSERT_EQUAL_SIZE(6, response->file_.size, "br sidecar size served");
+    TEST_ASSERT_EQUAL(CE_NONE, response->content_encoding, "on-the-fly compression disabled");
+    TEST_ASSERT_EQUAL(TE_NONE, response->transfer_encoding, "sidecar is not chunked");
+    http_header_t* vary = response->get_header(response, "Vary");
+    TEST_ASSERT(vary != NULL && strcmp(vary->value, "Accept-Encoding") == 0, "Vary: Accept-Encoding");
+    TEST_ASSERT_STR_EQUAL("app.js", response->file_.name, "original file name kept");
+
+    coding = negotiate(response, file, "br;q=0.5, gzip");
+    TEST_ASSERT_STR_EQUAL("gzip", coding, "higher q wins");
+    TEST_ASSERT_EQUAL_SIZE(10, response->file_.size, "gz sidecar size served");
+
+    coding = negotiate(response, file, "zstd");
+    TEST_ASSERT_NULL(coding, "missing zstd sidecar falls back to identity");
+    TEST_ASSERT_EQUAL_SIZE(24, response->file_.size, "identity served");
+    vary = response->get_header(response, "Vary");
+    TEST_ASSERT(vary != NULL && strcmp(vary->value, "Accept-Encoding") == 0, "Vary also for negotiated identity");
+
+    coding = negotiate(response, file, NULL);
+    TEST_ASSERT_NULL(coding, "no Accept-Encoding serves identity");
+    TEST_ASSERT_NOT_NULL(response->get_header(response, "Vary"), "Vary without Accept-Encoding");
+
+    coding = negotiate(response, file, "br;q=0, gzip;q=0");
+    TEST_ASSERT_NULL(coding, "refused codings are not served");
+
+    coding = negotiate(response, br, "br");
+    TEST_ASSERT_NULL(coding, "no sidecar for the sidecar itself");
+
+    cleanup:
+    test_response_ctx.server = NULL;
+    free_response(response, conn);
+    unlink(gz);
+    unlink(br);
+    unlink(file);
+    rmdir(root);
+}
+
 // ============================================================================
 // Payload getters
 // ============================================================================
@@ -962,3 +1060,69 @@ TEST(test_httpresponse_payload_from_file) {
     cleanup_response:
     free_response(response, conn);
 }
+
+// ============================================================================
+// Phase timing and Server-Timing
+// ============================================================================
+
+TEST(test_httpresponse_spans) {
+    TEST_CASE("add_span keeps token names and stops at HTTP_SPANS_MAX");
+
+    connection_t* conn = NULL;
+    httpresponse_t* response = make_response(&conn);
+    TEST_REQUIRE(response != NULL, "response created");
+
+    response->add_span(response, "db query", http_span_start());
+    TEST_ASSERT_EQUAL(1, (int)response->spans_count, "span added");
+    TEST_ASSERT_STR_EQUAL("db_query", response->spans[0].name, "space replaced in the token");
+
+    response->add_span(response, "", http_span_start());
+    TEST_ASSERT_EQUAL(1, (int)response->spans_count, "empty name ignored");
+
+    for (int i = 0; i < HTTP_SPANS_MAX + 2; i++)
+        response->add_span(response, "render", http_span_start());
+    TEST_ASSERT_EQUAL(HTTP_SPANS_MAX, (int)response->spans_count, "capped");
+
+    response->base.reset(response);
+    TEST_ASSERT_EQUAL(0, (int)response->spans_count, "reset clears spans");
+    TEST_ASSERT(response->handler_started_at == 0 && response->first_byte_at == 0, "reset clears phases");
+
+    free_response(response, conn);
+}
+
+TEST(test_httpresponse_server_timing_value) {
+    TEST_CASE("Server-Timing lists parse, queue, app, spans and total in ms");
+
+    connection_t* conn = NULL;
+    httpresponse_t* response = make_response(&conn);
+    TEST_REQUIRE(response != NULL, "response created");
+
+    httprequest_t request;
+    memset(&request, 0, sizeof(request));
+    request.read_at = 1000000;
+    request.parsed_at = 1250000;
+
+    response->enqueued_at = 2000000;
+    response->handler_started_at = 3500000;
+    response->handler_finished_at = 7500000;
+    strcpy(response->spans[0].name, "db");
+    response->spans[0].duration_ns = 2125000;
+    response->spans_count = 1;
+
+    char value[256];
+    const size_t length = httpresponse_server_timing(response, &request, 11000000, value, sizeof(value));
+    TEST_ASSERT_STR_EQUAL("parse;dur=0.250, queue;dur=1.500, app;dur=4.000, db;dur=2.125, total;dur=10.000", value, "value");
+    TEST_ASSERT_EQUAL_SIZE(strlen(value), length, "length returned");
+
+    /* a static file never reaches the handler queue */
+    response->enqueued_at = 0;
+    response->handler_started_at = 0;
+    response->handler_finished_at = 0;
+    response->spans_count = 0;
+    httpresponse_server_timing(response, &request, 2000000, value, sizeof(value));
+    TEST_ASSERT_STR_EQUAL("parse;dur=0.250, total;dur=1.000", value, "only known phases");
+
+    TEST_ASSERT_EQUAL_SIZE(0, httpresponse_server_timing(response, &request, 2000000, value, 16), "too small buffer");
+
+    free_response(response, conn);
+}
@@ -0,0 +1,270 @@
+/*
+ * Unit tests for misc/log.c.
+ *
+ * In async mode a thread only formats the message into its own ring; the
+ * writer thread drains every ring and appends the lines in batches. A full
+ * ring drops the message instead of waiting, and the writer reports the
+ * number of dropped messages. After an external rotation the writer
+ * reopens the file on request.
+ */
+
+#include "framework.h"
+#include "log.h"
+#include "appconfig.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define LOG_TEST_THREADS 4
+#define LOG_TEST_MESSAGES 100
+
+typedef struct {
+    char dir[64];
+    char path[128];
+    env_log_t saved;
+} log_fixture_t;
+
+static void log_fixture_init(log_fixture_t* fixture, int level) {
+    strcpy(fixture->dir, "/tmp/cwfr_log_XXXXXX");
+    if (mkdtemp(fixture->dir) == NULL)
+        fixture->dir[0] = 0;
+
+    snprintf(fixture->path, sizeof(fixture->path), "%s/server.log", fixture->dir);
+
+    fixture->saved = env()->main.log;
+    env()->main.log.enabled = true;
+    env()->main.log.level = level;
+}
+
+static void log_fixture_free(log_fixture_t* fixture) {
+    log_close();
+    log_init();
+
+    env()->main.log = fixture->saved;
+
+    unlink(fixture->path);
+    rmdir(fixture->dir);
+}
+
+static char* log_read_file(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) return NULL;
+
+    char* data = calloc(1, 1 << 20);
+    if (data != NULL)
+        fread(data, 1, (1 << 20) - 1, file);
+
+    fclose(file);
+
+    return data;
+}
+
+static int log_count_lines(const char* data) {
+    int lines = 0;
+    for (; *data; data++)
+        if (*data == '\n') lines++;
+
+    return lines;
+}
+
+static void* log_thread(void* arg) {
+    const int id = (int)(long)arg;
+
+    for (int i = 0; i < LOG_TEST_MESSAGES; i++)
+        log_info("thread %d message %d\n", id, i);
+
+    return NULL;
+}
+
+TEST(test_log_async_threads) {
+    TEST_CASE("messages from several threads reach the file in per-thread order");
+
+    log_fixture_t fixture;
+    log_fixture_init(&fixture, LOG_DEBUG);
+
+    const unsigned long long dropped = log_dropped();
+    TEST_ASSERT(log_async_start(fixture.path), "writer started");
+
+    pthread_t threads[LOG_TEST_THREADS];
+    for (long i = 0; i < LOG_TEST_THREADS; i++)
+        pthread_create(&threads[i], NULL, log_thread, (void*)i);
+    for (int i = 0; i < LOG_TEST_THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    log_async_stop();
+
+    char* data = log_read_file(fixture.path);
+    TEST_ASSERT_NOT_NULL(data, "log file readable");
+
+    if (data != NULL) {
+        TEST_ASSERT_EQUAL(LOG_TEST_THREADS * LOG_TEST_MESSAGES, log_count_lines(data), "one line per message, no doubled newline");
+        TEST_ASSERT_NOT_NULL(strstr(data, "[info] thread 0 message 0\n"), "level tag before the message");
+
+        int next[LOG_TEST_THREADS] = {0};
+        int ordered = 1;
+        for (char* line = data; *line; ) {
+            int id = -1, n = -1;
+            const char* message = strstr(line, "] thread ");
+            if (message == NULL || sscanf(message, "] thread %d message %d", &id, &n) != 2 || id < 0 || id >= LOG_TEST_THREADS || next[id]++ != n) {
+                ordered = 0;
+                break;
+            }
+
+            char* end = strchr(line, '\n');
+            if (end == NULL) break;
+            line = end + 1;
+        }
+        TEST_ASSERT(ordered, "messages of a thread keep their order");
+
+        /* 2026-01-01 00:00:00.000 [info] ... */
+        int year = 0, month = 0, day = 0, hour = -1, minute = -1, second = -1, ms = -1;
+        TEST_ASSERT_EQUAL(7, sscanf(data, "%4d-%2d-%2d %2d:%2d:%2d.%3d [", &year, &month, &day, &hour, &minute, &second, &ms), "line starts with a timestamp");
+    }
+
+    TEST_ASSERT(log_dropped() == dropped, "nothing dropped");
+
+    free(data);
+    log_fixture_free(&fixture);
+}
+
+TEST(test_log_level_filter) {
+    TEST_CASE("messages above the level are skipped, sync mode writes after stop");
+
+    log_fixture_t fixture;
+    log_fixture_init(&fixture, LOG_ERR);
+
+    TEST_ASSERT(log_async_start(fixture.path), "writer started");
+
+    log_debug("debug is skipped\n");
+    log_warning("warning is skipped\n");
+    log_error("error is kept\n");
+
+    log_async_stop();
+
+    char* data = log_read_file(fixture.path);
+    TEST_ASSERT_NOT_NULL(data, "log file readable");
+    if (data != NULL) {
+        TEST_ASSERT_NULL(strstr(data, "skipped"), "filtered before the ring");
+        TEST_ASSERT_NOT_NULL(strstr(data, "[error] error is kept\n"), "error written");
+    }
+    free(data);
+
+    log_crit("written synchronously\n");
+
+    data = log_read_file(fixture.path);
+    TEST_ASSERT(data != NULL && strstr(data, "[crit] written synchronously\n") != NULL, "sync write goes to the same file");
+    free(data);
+
+    log_fixture_free(&fixture);
+}
+
+TEST(test_log_reopen) {
+    TEST_CASE("reopen starts a new file after an external rename");
+
+    log_fixture_t fixture;
+    log_fixture_init(&fixture, LOG_DEBUG);
+
+    TEST_ASSERT(log_async_start(fixture.path), "writer started");
+
+    log_info("before rotation\n");
+    usleep(300 * 1000);
+
+    char moved[160];
+    snprintf(moved, sizeof(moved), "%s.old", fixture.path);
+    TEST_ASSERT_EQUAL(0, rename(fixture.path, moved), "moved away");
+
+    /* what SIGHUP does: the writer thread reopens the file */
+    log_reopen();
+    usleep(300 * 1000);
+
+    log_info("after rotation\n");
+    log_async_stop();
+
+    char* old = log_read_file(moved);
+    char* current = log_read_file(fixture.path);
+
+    TEST_ASSERT(old != NULL && strstr(old, "before rotation") != NULL && strstr(old, "after rotation") == NULL, "old file keeps earlier messages");
+    TEST_ASSERT(current != NULL && strstr(current, "after rotation") != NULL && strstr(current, "before rotation") == NULL, "new file gets later messages");
+
+    free(old);
+    free(current);
+    unlink(moved);
+    log_fixture_free(&fixture);
+}
+
+static void* log_stop_thread(void* arg) {
+    log_async_stop();
+    atomic_store((atomic_bool*)arg, 1);
+
+    return NULL;
+}
+
+TEST(test_log_overflow_drops) {
+    TEST_CASE("a full ring drops messages instead of blocking the caller");
+
+    log_fixture_t fixture;
+    log_fixture_init(&fixture, LOG_DEBUG);
+
+    /* the writer blocks on a full pipe nobody reads yet */
+    TEST_ASSERT_EQUAL(0, mkfifo(fixture.path, 0600), "fifo created");
+    const int reader = open(fixture.path, O_RDONLY | O_NONBLOCK);
+    TEST_ASSERT(reader >= 0, "fifo opened for reading");
+
+    const unsigned long long dropped = log_dropped();
+    TEST_ASSERT(log_async_start(fixture.path), "writer started");
+
+    char padding[401];
+    memset(padding, 'x', sizeof(padding) - 1);
+    padding[sizeof(padding) - 1] = 0;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < 2000; i++)
+        log_info("message %d %s\n", i, padding);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    const double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    TEST_ASSERT(elapsed < 1.0, "logging did not wait for the writer");
+
+    /* drain the pipe until the writer reports the drops */
+    char* data = calloc(1, 4 << 20);
+    size_t size = 0;
+    int reported = 0;
+    for (int i = 0; data != NULL && i < 500 && !reported && size < (4 << 20) - 65536; i++) {
+        struct pollfd pfd = { .fd = reader, .events = POLLIN, .revents = 0 };
+        if (poll(&pfd, 1, 10) <= 0) continue;
+
+        const ssize_t readed = read(reader, data + size, 65536);
+        if (readed > 0) {
+            size += (size_t)readed;
+            reported = strstr(data, "messages dropped") != NULL;
+        }
+    }
+
+    TEST_ASSERT(reported, "writer reported the drops");
+    TEST_ASSERT(log_dropped() > dropped, "drops counted");
+    TEST_ASSERT(data != NULL && strstr(data, "[warning] log: ") != NULL, "drop report is a warning");
+
+    /* keep reading while the writer drains the rest on stop */
+    pthread_t stopper;
+    atomic_bool stopped = 0;
+    pthread_create(&stopper, NULL, log_stop_thread, &stopped);
+    char chunk[65536];
+    while (!atomic_load(&stopped)) {
+        struct pollfd pfd = { .fd = reader, .events = POLLIN, .revents = 0 };
+        if (poll(&pfd, 1, 10) > 0 && read(reader, chunk, sizeof(chunk)) < 0) break;
+    }
+    pthread_join(stopper, NULL);
+
+    close(reader);
+    free(data);
+    log_fixture_free(&fixture);
+}
@@ -0,0 +1,147 @@
+/*
+ * Unit tests for misc/memstat.c.
+ *
+ * Counters are kept per thread and summed on read; a thread that exits
+ * leaves its counters behind, so memory it allocated and another thread
+ * freed still sums to zero. Soft limits refuse new objects once a
+ * subsystem or the total is over the limit.
+ */
+
+#include "framework.h"
+#include "memstat.h"
+#include "bufo.h"
+#include "bufferdata.h"
+#include "json.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#define MEMSTAT_TEST_THREADS 4
+#define MEMSTAT_TEST_BYTES 1000
+
+static size_t memstat_test_bytes(memstat_subsystem_e subsystem) {
+    memstat_stats_t snapshot;
+    memstat_snapshot(&snapshot);
+
+    return snapshot.bytes[subsystem];
+}
+
+static void* memstat_test_add(void* arg) {
+    (void)arg;
+
+    memstat_add(MEMSTAT_HTTPCLIENT, MEMSTAT_TEST_BYTES);
+
+    return NULL;
+}
+
+TEST(test_memstat_threads) {
+    TEST_CASE("counters of all threads are summed, also after the threads exit");
+
+    const size_t before = memstat_test_bytes(MEMSTAT_HTTPCLIENT);
+
+    pthread_t threads[MEMSTAT_TEST_THREADS];
+    for (int i = 0; i < MEMSTAT_TEST_THREADS; i++)
+        pthread_create(&threads[i], NULL, memstat_test_add, NULL);
+    for (int i = 0; i < MEMSTAT_TEST_THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    TEST_ASSERT_EQUAL_SIZE(before + MEMSTAT_TEST_THREADS * MEMSTAT_TEST_BYTES, memstat_test_bytes(MEMSTAT_HTTPCLIENT), "bytes of exited threads kept");
+
+    /* freed by another thread: its own counter goes negative */
+    memstat_sub(MEMSTAT_HTTPCLIENT, MEMSTAT_TEST_THREADS * MEMSTAT_TEST_BYTES);
+    TEST_ASSERT_EQUAL_SIZE(before, memstat_test_bytes(MEMSTAT_HTTPCLIENT), "freed in another thread");
+
+    memstat_stats_t snapshot;
+    memstat_snapshot(&snapshot);
+
+    size_t total = 0;
+    for (int i = 0; i < MEMSTAT_COUNT; i++)
+        total += snapshot.bytes[i];
+
+    TEST_ASSERT_EQUAL_SIZE(total, snapshot.total, "total is the sum of subsystems");
+    TEST_ASSERT(snapshot.rss > 0, "resident memory read");
+}
+
+TEST(test_memstat_names) {
+    TEST_CASE("subsystems are found by name");
+
+    TEST_ASSERT_EQUAL(MEMSTAT_BROADCAST, memstat_find("broadcast"), "broadcast");
+    TEST_ASSERT_EQUAL(MEMSTAT_TOTAL, memstat_find("total"), "total");
+    TEST_ASSERT_EQUAL(-1, memstat_find("unknown"), "unknown name");
+    TEST_ASSERT_STR_EQUAL("connections", memstat_name(MEMSTAT_CONNECTIONS), "name of a subsystem");
+}
+
+TEST(test_memstat_limits) {
+    TEST_CASE("objects are refused over a subsystem or the total limit");
+
+    TEST_ASSERT(!memstat_should_shed(MEMSTAT_VIEWSTORE), "no limits, no shedding");
+
+    memstat_add(MEMSTAT_VIEWSTORE, MEMSTAT_TEST_BYTES);
+    const size_t held = memstat_test_bytes(MEMSTAT_VIEWSTORE);
+
+    memstat_set_limit(MEMSTAT_VIEWSTORE, held + 1);
+    TEST_ASSERT(!memstat_should_shed(MEMSTAT_VIEWSTORE), "under the limit");
+
+    memstat_set_limit(MEMSTAT_VIEWSTORE, held);
+    TEST_ASSERT(memstat_should_shed(MEMSTAT_VIEWSTORE), "at the limit");
+    TEST_ASSERT(!memstat_should_shed(MEMSTAT_JSON), "other subsystems unaffected");
+
+    memstat_stats_t snapshot;
+    memstat_snapshot(&snapshot);
+    TEST_ASSERT_EQUAL_SIZE(held, snapshot.limits[MEMSTAT_VIEWSTORE], "limit reported");
+    TEST_ASSERT(snapshot.shed[MEMSTAT_VIEWSTORE] > 0, "refusal counted");
+
+    memstat_reset_limits();
+    memstat_set_limit(MEMSTAT_TOTAL, 1);
+    TEST_ASSERT(memstat_should_shed(MEMSTAT_JSON), "total limit applies to every subsystem");
+
+    memstat_reset_limits();
+    TEST_ASSERT(!memstat_should_shed(MEMSTAT_VIEWSTORE), "limits removed");
+
+    memstat_sub(MEMSTAT_VIEWSTORE, MEMSTAT_TEST_BYTES);
+}
+
+TEST(test_memstat_buffers) {
+    TEST_CASE("bufo, bufferdata and json blocks are accounted");
+
+    const size_t bodies = memstat_test_bytes(MEMSTAT_BODIES);
+
+    bufo_t* buf = bufo_create();
+    bufo_alloc(buf, 1024);
+    TEST_ASSERT_EQUAL_SIZE(bodies + 1024, memstat_test_bytes(MEMSTAT_BODIES), "bufo_alloc");
+
+    bufo_ensure_capacity(buf, 5000);
+    TEST_ASSERT_EQUAL_SIZE(bodies + buf->capacity, memstat_test_bytes(MEMSTAT_BODIES), "bufo grown");
+
+    bufo_attach(buf, malloc(300), 300);
+    TEST_ASSERT_EQUAL_SIZE(bodies + 300, memstat_test_bytes(MEMSTAT_BODIES), "attached memory replaces the old one");
+
+    bufo_free(buf);
+    TEST_ASSERT_EQUAL_SIZE(bodies, memstat_test_bytes(MEMSTAT_BODIES), "bufo freed");
+
+    const size_t buffers = memstat_test_bytes(MEMSTAT_BUFFERS);
+
+    bufferdata_t* data = malloc(sizeof * data);
+    bufferdata_init(data);
+    for (int i = 0; i < BUFFERDATA_SIZE * 2; i++)
+        bufferdata_push(data, 'a');
+    bufferdata_complete(data);
+
+    TEST_ASSERT_EQUAL_SIZE(buffers + data->dbuffer_size, memstat_test_bytes(MEMSTAT_BUFFERS), "dynamic buffer counted");
+
+    bufferdata_clear(data);
+    TEST_ASSERT_EQUAL_SIZE(buffers, memstat_test_bytes(MEMSTAT_BUFFERS), "dynamic buffer released");
+    free(data);
+
+    const size_t json = memstat_test_bytes(MEMSTAT_JSON);
+
+    /* blocks of the thread manager outlive the document and serve the next one */
+    json_doc_t* document = json_parse("{\"a\":[1,2,3]}");
+    json_free(document);
+    const size_t held = memstat_test_bytes(MEMSTAT_JSON);
+    TEST_ASSERT(held > 0 && held >= json, "token blocks counted");
+
+    document = json_parse("{\"b\":[4,5,6]}");
+    json_free(document);
+    TEST_ASSERT_EQUAL_SIZE(held, memstat_test_bytes(MEMSTAT_JSON), "token blocks reused");
+}
@@ -0,0 +1,154 @@
+/*
+ * Unit tests for src/metrics/metrics.c.
+ *
+ * Values land in log-linear buckets, routes are interned by name, and the
+ * per-thread histograms of every thread are summed into one Prometheus
+ * text exposition on render.
+ */
+
+#include "framework.h"
+#include "metrics.h"
+
+#include <pthread.h>
+#include <string.h>
+
+TEST(test_metrics_bucket_mapping) {
+    TEST_CASE("buckets are linear below 4us and split each octave in four");
+
+    TEST_ASSERT_EQUAL(0, metrics_histogram_bucket(0), "0us");
+    TEST_ASSERT_EQUAL(3, metrics_histogram_bucket(3), "3us");
+    TEST_ASSERT_EQUAL(4, metrics_histogram_bucket(4), "4us opens the first octave");
+    TEST_ASSERT_EQUAL(7, metrics_histogram_bucket(7), "7us");
+    TEST_ASSERT_EQUAL(8, metrics_histogram_bucket(8), "8us opens the next octave");
+    TEST_ASSERT_EQUAL(8, metrics_histogram_bucket(9), "9us shares the bucket with 8us");
+    TEST_ASSERT_EQUAL(METRICS_BUCKETS - 1, metrics_histogram_bucket(UINT64_MAX), "huge values clamp");
+
+    for (uint64_t value = 1; value < (1ULL << 30); value = value * 3 + 1) {
+        const int bucket = metrics_histogram_bucket(value);
+        TEST_ASSERT(value < metrics_histogram_bucket_bound(bucket), "value below its bucket bound");
+        if (bucket > 0)
+            TEST_ASSERT(value >= metrics_histogram_bucket_bound(bucket - 1), "value above the previous bound");
+    }
+}
+
+TEST(test_metrics_histogram_merge) {
+    TEST_CASE("merge sums buckets, sum and count");
+
+    metrics_histogram_t a, b;
+    metrics_histogram_reset(&a);
+    metrics_histogram_reset(&b);
+
+    metrics_histogram_record(&a, 5);
+    metrics_histogram_record(&a, 100);
+    metrics_histogram_record(&b, 5);
+
+    metrics_histogram_merge(&a, &b);
+
+    TEST_ASSERT_EQUAL(3, (int)atomic_load(&a.count), "count");
+    TEST_ASSERT_EQUAL(110, (int)atomic_load(&a.sum), "sum");
+    TEST_ASSERT_EQUAL(2, (int)atomic_load(&a.buckets[metrics_histogram_bucket(5)]), "shared bucket");
+}
+
+TEST(test_metrics_route_register) {
+    TEST_CASE("a route name keeps its number across registrations");
+
+    const unsigned int first = metrics_route_register("/test/metrics/register");
+    TEST_ASSERT(first != METRICS_ROUTE_NONE, "route registered");
+    TEST_ASSERT_EQUAL(first, metrics_route_register("/test/metrics/register"), "same name, same number");
+    TEST_ASSERT(first != metrics_route_register("/test/metrics/other"), "other name, other number");
+    TEST_ASSERT_EQUAL(METRICS_ROUTE_NONE, metrics_route_register(NULL), "NULL is unmatched");
+}
+
+static void* __record_in_thread(void* arg) {
+    const unsigned int route = *(unsigned int*)arg;
+    metrics_record_request(route, 503, 2000000);
+    return NULL;
+}
+
+TEST(test_metrics_render) {
+    TEST_CASE("records of all threads are rendered in Prometheus format");
+
+    unsigned int route = metrics_route_register("/test/metrics/\"render\"");
+    TEST_REQUIRE(route != METRICS_ROUTE_NONE, "route registered");
+
+    metrics_record_request(route, 200, 1500000);
+    metrics_record_queue_wait(route, 20000);
+    metrics_record_handler(route, 900000);
+    metrics_record_first_byte(route, 1200000);
+
+    pthread_t thread;
+    TEST_REQUIRE(pthread_create(&thread, NULL, __record_in_thread, &route) == 0, "thread started");
+    pthread_join(thread, NULL);
+
+    str_t out;
+    str_init(&out, 4096);
+    TEST_REQUIRE(metrics_render(&out), "rendered");
+
+    const char* text = str_get(&out);
+    TEST_ASSERT(strstr(text, "# TYPE cwfr_http_request_duration_seconds histogram\n") != NULL, "type line");
+    TEST_ASSERT(strstr(text, "cwfr_http_request_duration_seconds_count{route=\"/test/metrics/\\\"render\\\"\",status=\"2xx\"} 1\n") != NULL, "2xx series with escaped route");
+    TEST_ASSERT(strstr(text, "cwfr_http_request_duration_seconds_count{route=\"/test/metrics/\\\"render\\\"\",status=\"5xx\"} 1\n") != NULL, "5xx series from the other thread");
+    TEST_ASSERT(strstr(text, "cwfr_http_request_duration_seconds_bucket{route=\"/test/metrics/\\\"render\\\"\",status=\"2xx\",le=\"+Inf\"} 1\n") != NULL, "+Inf bucket");
+    TEST_ASSERT(strstr(text, "cwfr_http_queue_wait_seconds_count{route=\"/test/metrics/\\\"render\\\"\"} 1\n") != NULL, "queue wait series");
+    TEST_ASSERT(strstr(text, "cwfr_http_handler_duration_seconds_sum{route=\"/test/metrics/\\\"render\\\"\"} 0.000900\n") != NULL, "handler sum in seconds");
+    TEST_ASSERT(strstr(text, "cwfr_http_first_byte_seconds_sum{route=\"/test/metrics/\\\"render\\\"\"} 0.001200\n") != NULL, "time to first byte series");
+
+    str_clear(&out);
+}
+
+static void* __record_loop_in_thread(void* arg) {
+    (void)arg;
+    metrics_record_wakeup(3, 40000);
+    metrics_record_bytes_in(100);
+    return NULL;
+}
+
+TEST(test_metrics_loop_stats) {
+    TEST_CASE("event loop and queue records are summed over threads");
+
+    metrics_loop_stats_t before;
+    metrics_loop_stats(&before);
+
+    metrics_record_wakeup(1, 10000);
+    metrics_record_queue_pop(5, 2000000);
+    metrics_record_handshake(3000000);
+    metrics_record_bytes_in(20);
+    metrics_record_bytes_out(300);
+
+    pthread_t thread;
+    TEST_REQUIRE(pthread_create(&thread, NULL, __record_loop_in_thread, NULL) == 0, "thread started");
+    pthread_join(thread, NULL);
+
+    metrics_loop_stats_t after;
+    metrics_loop_stats(&after);
+
+    TEST_ASSERT_EQUAL(2, (int)(atomic_load(&after.events.count) - atomic_load(&before.events.count)), "two wakeups");
+    TEST_ASSERT_EQUAL(4, (int)(atomic_load(&after.events.sum) - atomic_load(&before.events.sum)), "four events");
+    TEST_ASSERT_EQUAL(50, (int)(atomic_load(&after.callbacks.sum) - atomic_load(&before.callbacks.sum)), "callback time in us");
+    TEST_ASSERT_EQUAL(5, (int)(atomic_load(&after.queue_depth.sum) - atomic_load(&before.queue_depth.sum)), "queue depth");
+    TEST_ASSERT_EQUAL(1, (int)(atomic_load(&after.handshake.count) - atomic_load(&before.handshake.count)), "handshake");
+    TEST_ASSERT_EQUAL(120, (int)(atomic_load(&after.bytes_in) - atomic_load(&before.bytes_in)), "bytes in");
+    TEST_ASSERT_EQUAL(300, (int)(atomic_load(&after.bytes_out) - atomic_load(&before.bytes_out)), "bytes out");
+}
+
+TEST(test_metrics_render_values) {
+    TEST_CASE("value histograms use inclusive integer bounds");
+
+    metrics_histogram_t histogram;
+    metrics_histogram_reset(&histogram);
+    metrics_histogram_record(&histogram, 1);
+    metrics_histogram_record(&histogram, 3);
+
+    str_t out;
+    str_init(&out, 1024);
+    TEST_REQUIRE(metrics_render_histogram_values(&out, "events", NULL, &histogram), "rendered");
+
+    const char* text = str_get(&out);
+    TEST_ASSERT(strstr(text, "events_bucket{le=\"0\"} 0\n") != NULL, "nothing at zero");
+    TEST_ASSERT(strstr(text, "events_bucket{le=\"1\"} 1\n") != NULL, "one is counted at le=1");
+    TEST_ASSERT(strstr(text, "events_bucket{le=\"3\"} 2\n") != NULL, "three is counted at le=3");
+    TEST_ASSERT(strstr(text, "events_sum 4.000000\n") != NULL, "sum");
+    TEST_ASSERT(strstr(text, "events_count 2\n") != NULL, "count");
+
+    str_clear(&out);
+}
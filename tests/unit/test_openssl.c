@@ -8,7 +8,8 @@
 
 // ============================================================================
 // Test fixtures: a self-signed EC certificate (CN=test.local, expires 2126),
-// its matching private key and a second, non-matching key. Embedded so the
+// its matching private key and a second, non-matching key with its own
+// certificate (CN=other.local). Embedded so the
 // suite needs no network and no openssl CLI; written to a mkdtemp directory
 // on first use and removed via atexit.
 // ============================================================================
@@ -40,6 +41,19 @@ static const char TEST_OTHER_KEY_PEM[] =
     "GlBMrdB3wNA5w39dFqpfDy21OQjoHl1p4PehpiZ5T5i30hTYGjVapGmA\n"
     "-----END PRIVATE KEY-----\n";
 
+static const char TEST_OTHER_CERT_PEM[] =
+    "-----BEGIN CERTIFICATE-----\n"
+    "MIIBgjCCASmgAwIBAgIUayt5A/mSK9LpTQPTnU01eOZcDM0wCgYIKoZIzj0EAwIw\n"
+    "FjEUMBIGA1UEAwwLb3RoZXIubG9jYWwwIBcNMjYxMDE4MTMxODQ5WhgPMjEyNjA5\n"
+    "MjQxMzE4NDlaMBYxFDASBgNVBAMMC290aGVyLmxvY2FsMFkwEwYHKoZIzj0CAQYI\n"
+    "KoZIzj0DAQcDQgAENHMdbyA8/0YbLbVStX76Iz4GPfm6yhpQTK3Qd8DQOcN/XRaq\n"
+    "Xw8ttTkI6B5daeD3oaYmeU+Yt9IU2Bo1WqRpgKNTMFEwHQYDVR0OBBYEFC5A09bW\n"
+    "GrVgd2OUATPkvvGhuX+VMB8GA1UdIwQYMBaAFC5A09bWGrVgd2OUATPkvvGhuX+V\n"
+    "MA8GA1UdEwEB/wQFMAMBAf8wCgYIKoZIzj0EAwIDRwAwRAIgF3A+C3uTX75Z7j+T\n"
+    "2XQaNupSQjSIIXv84Yse1haiqh0CIEHhD9fuhNGiV/WyQhzT+wacdQ2POXl1BQP/\n"
+    "lL1vaujC\n"
+    "-----END CERTIFICATE-----\n";
+
 #define TEST_CIPHERS_VALID "DEFAULT"
 #define TEST_CIPHERS_INVALID "NOT-A-REAL-CIPHER"
 
@@ -47,6 +61,7 @@ static char certs_dir[64];
 static char cert_path[128];
 static char key_path[128];
 static char other_key_path[128];
+static char other_cert_path[128];
 static int certs_ready = 0;
 
 static void cleanup_certs(void) {
@@ -55,6 +70,7 @@ static void cleanup_certs(void) {
     unlink(cert_path);
     unlink(key_path);
     unlink(other_key_path);
+    unlink(other_cert_path);
     rmdir(certs_dir);
     certs_ready = 0;
 }
@@ -82,6 +98,7 @@ static int ensure_certs(void) {
     if (!write_pem(cert_path, sizeof(cert_path), "cert.pem", TEST_CERT_PEM)) return 0;
     if (!write_pem(key_path, sizeof(key_path), "key.pem", TEST_KEY_PEM)) return 0;
     if (!write_pem(other_key_path, sizeof(other_key_path), "otherkey.pem", TEST_OTHER_KEY_PEM)) return 0;
+    if (!write_pem(other_cert_path, sizeof(other_cert_path), "othercert.pem", TEST_OTHER_CERT_PEM)) return 0;
 
     certs_ready = 1;
     atexit(cleanup_certs);
@@ -134,6 +151,9 @@ TEST(test_openssl_create_defaults) {
     TEST_ASSERT_NULL(openssl->private, "private should be NULL after create");
     TEST_ASSERT_NULL(openssl->ciphers, "ciphers should be NULL after create");
     TEST_ASSERT_NULL(openssl->ctx, "ctx should be NULL after create");
+    TEST_ASSERT_EQUAL(1, openssl->session_tickets, "session tickets should be enabled by default");
+    TEST_ASSERT_EQUAL(0, openssl->session_cache, "session cache should be off by default");
+    TEST_ASSERT_EQUAL(OPENSSL_SESSION_TIMEOUT_DEFAULT, openssl->session_timeout, "session timeout should be the default");
 
     openssl_free(openssl);
 }
@@ -518,3 +538,190 @@ TEST(test_openssl_handshake_rejects_tls_1_1) {
     tls_pair_free(&pair);
     openssl_free(openssl);
 }
+
+// ============================================================================
+// Session resumption: shared ticket keys, rotation, session cache, stats
+// ============================================================================
+
+/* Both sides are marked shut down, as the server connection does on accept:
+ * an SSL freed without it invalidates its session for resumption. */
+static void tls_pair_close(tls_pair_t* pair) {
+    SSL_set_shutdown(pair->client, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+    SSL_set_shutdown(pair->server, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+    tls_pair_free(pair);
+}
+
+/* Full handshake at `version`, then the client drains the post-handshake
+ * NewSessionTicket (TLS 1.3) and returns its session, or NULL. */
+static SSL_SESSION* handshake_get_session(SSL_CTX* server_ctx, int version) {
+    tls_pair_t pair;
+    if (!tls_pair_setup(&pair, server_ctx)) return NULL;
+
+    SSL_SESSION* session = NULL;
+    SSL_set_max_proto_version(pair.client, version);
+
+    if (do_handshake(pair.client, pair.server)) {
+        char buffer[16];
+        openssl_write(pair.server, "x", 1);
+        if (openssl_read(pair.client, buffer, sizeof(buffer)) == 1)
+            session = SSL_get1_session(pair.client);
+    }
+
+    tls_pair_close(&pair);
+
+    return session;
+}
+
+/* Handshake offering `session`; returns 1 when the server resumed it, 0 on a
+ * full handshake, -1 when the handshake failed. */
+static int handshake_resume(SSL_CTX* server_ctx, SSL_SESSION* session, int version) {
+    tls_pair_t pair;
+    if (!tls_pair_setup(&pair, server_ctx)) return -1;
+
+    SSL_set_max_proto_version(pair.client, version);
+    SSL_set_session(pair.client, session);
+
+    int result = -1;
+    if (do_handshake(pair.client, pair.server)) {
+        openssl_handshake_done(pair.server);
+        result = SSL_session_reused(pair.server) ? 1 : 0;
+    }
+
+    tls_pair_close(&pair);
+
+    return result;
+}
+
+TEST(test_openssl_ticket_resumption) {
+    TEST_SUITE("openssl: session resumption");
+    TEST_CASE("TLS 1.2 and 1.3 tickets resume across contexts sharing the keys");
+
+    TEST_REQUIRE(ensure_certs(), "test certificates should be written");
+
+    openssl_t* first = make_openssl(cert_path, key_path, TEST_CIPHERS_VALID);
+    openssl_t* second = make_openssl(cert_path, key_path, TEST_CIPHERS_VALID);
+    SSL_SESSION* session12 = NULL;
+    SSL_SESSION* session13 = NULL;
+
+    TEST_REQUIRE_NOT_NULL_GOTO(first, "make_openssl should not return NULL", done);
+    TEST_REQUIRE_NOT_NULL_GOTO(second, "make_openssl should not return NULL", done);
+    TEST_REQUIRE_GOTO(openssl_init(first) == 1 && openssl_init(second) == 1, "contexts should initialize", done);
+    TEST_ASSERT(openssl_ticket_keys_interval() >= OPENSSL_SESSION_TIMEOUT_DEFAULT,
+                "rotation interval should cover the session timeout");
+
+    session12 = handshake_get_session(first->ctx, TLS1_2_VERSION);
+    session13 = handshake_get_session(first->ctx, TLS1_3_VERSION);
+    TEST_REQUIRE_NOT_NULL_GOTO(session12, "TLS 1.2 session should be issued", done);
+    TEST_REQUIRE_NOT_NULL_GOTO(session13, "TLS 1.3 session should be issued", done);
+
+    openssl_session_stats_t before;
+    openssl_session_stats(&before);
+
+    TEST_ASSERT_EQUAL(1, handshake_resume(second->ctx, session12, TLS1_2_VERSION),
+                      "TLS 1.2 ticket should resume on another context");
+    TEST_ASSERT_EQUAL(1, handshake_resume(second->ctx, session13, TLS1_3_VERSION),
+                      "TLS 1.3 ticket should resume on another context");
+
+    openssl_session_stats_t after;
+    openssl_session_stats(&after);
+    TEST_ASSERT(after.handshakes - before.handshakes == 2, "both handshakes should be counted");
+    TEST_ASSERT(after.resumed - before.resumed == 2, "both resumptions should be counted");
+
+    done:
+
+    if (session12 != NULL) SSL_SESSION_free(session12);
+    if (session13 != NULL) SSL_SESSION_free(session13);
+    openssl_free(first);
+    openssl_free(second);
+}
+
+TEST(test_openssl_ticket_other_certificate) {
+    TEST_SUITE("openssl: session resumption");
+    TEST_CASE("a ticket issued for one certificate does not resume on another");
+
+    TEST_REQUIRE(ensure_certs(), "test certificates should be written");
+
+    openssl_t* first = make_openssl(cert_path, key_path, TEST_CIPHERS_VALID);
+    openssl_t* other = make_openssl(other_cert_path, other_key_path, TEST_CIPHERS_VALID);
+    SSL_SESSION* session12 = NULL;
+    SSL_SESSION* session13 = NULL;
+
+    TEST_REQUIRE_NOT_NULL_GOTO(first, "make_openssl should not return NULL", done);
+    TEST_REQUIRE_NOT_NULL_GOTO(other, "make_openssl should not return NULL", done);
+    TEST_REQUIRE_GOTO(openssl_init(first) == 1 && openssl_init(other) == 1, "contexts should initialize", done);
+
+    session12 = handshake_get_session(first->ctx, TLS1_2_VERSION);
+    session13 = handshake_get_session(first->ctx, TLS1_3_VERSION);
+    TEST_REQUIRE_NOT_NULL_GOTO(session12, "TLS 1.2 session should be issued", done);
+    TEST_REQUIRE_NOT_NULL_GOTO(session13, "TLS 1.3 session should be issued", done);
+
+    TEST_ASSERT_EQUAL(0, handshake_resume(other->ctx, session12, TLS1_2_VERSION),
+                      "TLS 1.2 ticket should force a full handshake on another certificate");
+    TEST_ASSERT_EQUAL(0, handshake_resume(other->ctx, session13, TLS1_3_VERSION),
+                      "TLS 1.3 ticket should force a full handshake on another certificate");
+    TEST_ASSERT_EQUAL(1, handshake_resume(first->ctx, session12, TLS1_2_VERSION),
+                      "ticket should still resume on its own certificate");
+
+    done:
+
+    if (session12 != NULL) SSL_SESSION_free(session12);
+    if (session13 != NULL) SSL_SESSION_free(session13);
+    openssl_free(first);
+    openssl_free(other);
+}
+
+TEST(test_openssl_ticket_key_rotation) {
+    TEST_SUITE("openssl: session resumption");
+    TEST_CASE("a ticket survives one rotation and is rejected after two");
+
+    TEST_REQUIRE(ensure_certs(), "test certificates should be written");
+
+    openssl_t* openssl = make_openssl(cert_path, key_path, TEST_CIPHERS_VALID);
+    SSL_SESSION* session = NULL;
+
+    TEST_REQUIRE_NOT_NULL_GOTO(openssl, "make_openssl should not return NULL", done);
+    TEST_REQUIRE_GOTO(openssl_init(openssl) == 1, "server context should initialize", done);
+
+    session = handshake_get_session(openssl->ctx, TLS1_3_VERSION);
+    TEST_REQUIRE_NOT_NULL_GOTO(session, "session should be issued", done);
+
+    TEST_REQUIRE_GOTO(openssl_ticket_keys_rotate(), "keys should rotate", done);
+    TEST_ASSERT_EQUAL(1, handshake_resume(openssl->ctx, session, TLS1_3_VERSION),
+                      "previous key should still decrypt the ticket");
+
+    TEST_REQUIRE_GOTO(openssl_ticket_keys_rotate(), "keys should rotate", done);
+    TEST_ASSERT_EQUAL(0, handshake_resume(openssl->ctx, session, TLS1_3_VERSION),
+                      "dropped key should force a full handshake");
+
+    done:
+
+    if (session != NULL) SSL_SESSION_free(session);
+    openssl_free(openssl);
+}
+
+TEST(test_openssl_session_cache_without_tickets) {
+    TEST_SUITE("openssl: session resumption");
+    TEST_CASE("with tickets off a bounded session cache resumes TLS 1.2 sessions");
+
+    TEST_REQUIRE(ensure_certs(), "test certificates should be written");
+
+    openssl_t* openssl = make_openssl(cert_path, key_path, TEST_CIPHERS_VALID);
+    SSL_SESSION* session = NULL;
+
+    TEST_REQUIRE_NOT_NULL_GOTO(openssl, "make_openssl should not return NULL", done);
+    openssl->session_tickets = 0;
+    openssl->session_cache = 16;
+    TEST_REQUIRE_GOTO(openssl_init(openssl) == 1, "server context should initialize", done);
+    TEST_ASSERT_EQUAL(16, SSL_CTX_sess_get_cache_size(openssl->ctx), "cache should be bounded");
+    TEST_ASSERT(SSL_CTX_get_options(openssl->ctx) & SSL_OP_NO_TICKET, "tickets should be disabled");
+
+    session = handshake_get_session(openssl->ctx, TLS1_2_VERSION);
+    TEST_REQUIRE_NOT_NULL_GOTO(session, "session should be issued", done);
+    TEST_ASSERT_EQUAL(1, handshake_resume(openssl->ctx, session, TLS1_2_VERSION),
+                      "cached session should resume");
+
+    done:
+
+    if (session != NULL) SSL_SESSION_free(session);
+    openssl_free(openssl);
+}
@@ -0,0 +1,156 @@
+/*
+ * Unit tests for src/profiler/profiler.c.
+ *
+ * A busy thread burns CPU in an exported function while the profiler
+ * samples the process; its stacks must come back folded under the thread
+ * name, root first, with a count per unique stack.
+ */
+
+#define _GNU_SOURCE
+#include "framework.h"
+#include "profiler.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+static atomic_bool profiler_test_stop = 0;
+static atomic_bool profiler_test_busy = 0;
+
+__attribute__((noinline)) unsigned long profiler_test_burn(unsigned long seed) {
+    for (int i = 0; i < 100000; i++)
+        seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+
+    return seed;
+}
+
+static void* profiler_test_thread(void* arg) {
+    if (arg != NULL)
+        profiler_thread_init();
+
+    volatile unsigned long sink = 1;
+    while (!atomic_load(&profiler_test_stop))
+        sink = profiler_test_burn(sink);
+
+    return NULL;
+}
+
+static void* profiler_test_second_run(void* arg) {
+    str_t out;
+    str_init(&out, 1024);
+
+    while (!profiler_running() && !atomic_load(&profiler_test_stop));
+
+    *(profiler_result_e*)arg = profiler_run(100, 99, &out, NULL);
+    atomic_store(&profiler_test_busy, 1);
+
+    str_clear(&out);
+
+    return NULL;
+}
+
+// every line is "frame;frame;... count"
+static int profiler_test_folded(const char* data, size_t* total) {
+    *total = 0;
+
+    while (*data) {
+        const char* end = strchr(data, '\n');
+        if (end == NULL) return 0;
+
+        const char* space = end;
+        while (space > data && *space != ' ') space--;
+        if (space == data) return 0;
+
+        char* count_end = NULL;
+        const unsigned long count = strtoul(space + 1, &count_end, 10);
+        if (count == 0 || count_end != end) return 0;
+
+        *total += count;
+        data = end + 1;
+    }
+
+    return 1;
+}
+
+// deepest stack among the lines starting with prefix
+static int profiler_test_depth(const char* data, const char* prefix) {
+    int depth = 0;
+
+    for (const char* line = strstr(data, prefix); line != NULL; line = strstr(line + 1, prefix)) {
+        if (line != data && line[-1] != '\n') continue;
+
+        int frames = 0;
+        for (const char* p = line; *p != '\n' && *p != 0; p++)
+            frames += *p == ';';
+
+        if (frames > depth) depth = frames;
+    }
+
+    return depth;
+}
+
+TEST(test_profiler_folded_stacks) {
+    TEST_CASE("samples of a busy thread come back as folded stacks");
+
+    atomic_store(&profiler_test_stop, 0);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, profiler_test_thread, (void*)(intptr_t)1);
+    pthread_setname_np(thread, "cwfr_busy");
+
+    /* no profiler_thread_init: the stack bounds are unknown */
+    pthread_t bare;
+    pthread_create(&bare, NULL, profiler_test_thread, NULL);
+    pthread_setname_np(bare, "cwfr_bare");
+
+    str_t out;
+    str_init(&out, 4096);
+
+    profiler_stats_t profile;
+    TEST_ASSERT_EQUAL(PROFILER_OK, profiler_run(400, 200, &out, &profile), "profile taken");
+    TEST_ASSERT(!profiler_running(), "not running after return");
+
+    atomic_store(&profiler_test_stop, 1);
+    pthread_join(thread, NULL);
+    pthread_join(bare, NULL);
+
+    const char* data = str_get(&out);
+    size_t total = 0;
+
+    TEST_ASSERT(profile.samples > 10, "busy thread sampled");
+    TEST_ASSERT(profile.stacks > 0 && profile.stacks <= profile.samples, "samples folded into stacks");
+    TEST_ASSERT(profiler_test_folded(data, &total), "folded stack format");
+    TEST_ASSERT(total > 0 && total <= profile.samples, "counts add up to the samples");
+    TEST_ASSERT_NOT_NULL(strstr(data, "cwfr_busy;"), "thread name is the root frame");
+    TEST_ASSERT_NOT_NULL(strstr(data, ";profiler_test_burn"), "exported function resolved by name");
+    TEST_ASSERT_NULL(strstr(data, "cwfr_busy;profiler_test_burn "), "callers unwound through frame pointers");
+    TEST_ASSERT_NOT_NULL(strstr(data, "cwfr_bare;profiler_test_burn "), "leaf only without known stack bounds");
+    TEST_ASSERT_EQUAL(1, profiler_test_depth(data, "cwfr_bare;"), "no frames read outside known bounds");
+    TEST_ASSERT_NULL(strstr(data, "__profiler_signal"), "signal handler frames skipped");
+
+    str_clear(&out);
+}
+
+TEST(test_profiler_busy) {
+    TEST_CASE("a second profile while one is running is refused");
+
+    atomic_store(&profiler_test_stop, 0);
+    atomic_store(&profiler_test_busy, 0);
+
+    profiler_result_e second = PROFILER_OK;
+    pthread_t thread;
+    pthread_create(&thread, NULL, profiler_test_second_run, &second);
+
+    str_t out;
+    str_init(&out, 1024);
+
+    TEST_ASSERT_EQUAL(PROFILER_OK, profiler_run(200, 99, &out, NULL), "first profile taken");
+    atomic_store(&profiler_test_stop, 1);
+    pthread_join(thread, NULL);
+
+    TEST_ASSERT_EQUAL(PROFILER_BUSY, second, "second profile refused");
+    TEST_ASSERT_EQUAL(PROFILER_ERROR, profiler_run(0, 99, &out, NULL), "zero duration rejected");
+
+    str_clear(&out);
+}
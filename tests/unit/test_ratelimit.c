@@ -0,0 +1,209 @@
+/*
+ * Unit tests for framework/ratelimit/ratelimit.c.
+ *
+ * Keys are arbitrary strings. Without a store the buckets are kept in
+ * the process; with one, tokens are leased from the shared bucket in
+ * batches, so several limiters (nodes) never exceed it together and
+ * ask the store once per batch rather than once per request.
+ */
+
+#include "framework.h"
+#include "ratelimit.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define RATELIMIT_TEST_THREADS 4
+
+/* shared bucket standing in for Redis; never refills during a test */
+typedef struct ratelimit_test_bucket {
+    atomic_int tokens;
+    atomic_int calls;
+} ratelimit_test_bucket_t;
+
+typedef struct ratelimit_test_store {
+    ratelimitstore_t base;
+    ratelimit_test_bucket_t* bucket;
+    int unreachable;
+} ratelimit_test_store_t;
+
+static int64_t ratelimit_test_lease(ratelimitstore_t* store, ratelimit_t* limiter, const char* key, uint32_t count) {
+    (void)limiter;
+    (void)key;
+
+    ratelimit_test_store_t* test_store = (ratelimit_test_store_t*)store;
+    ratelimit_test_bucket_t* bucket = test_store->bucket;
+
+    atomic_fetch_add(&bucket->calls, 1);
+    if (test_store->unreachable) return -1;
+
+    int tokens = atomic_load(&bucket->tokens);
+    int granted = 0;
+    do {
+        granted = tokens < (int)count ? tokens : (int)count;
+    } while (!atomic_compare_exchange_weak(&bucket->tokens, &tokens, tokens - granted));
+
+    return granted;
+}
+
+static void ratelimit_test_store_free(ratelimitstore_t* store) {
+    free(store);
+}
+
+static ratelimitstore_t* ratelimit_test_store_create(ratelimit_test_bucket_t* bucket, int unreachable) {
+    ratelimit_test_store_t* store = malloc(sizeof * store);
+    if (store == NULL) return NULL;
+
+    store->base.lease = ratelimit_test_lease;
+    store->base.free = ratelimit_test_store_free;
+    store->bucket = bucket;
+    store->unreachable = unreachable;
+
+    return &store->base;
+}
+
+static ratelimit_t* ratelimit_test_create(uint32_t burst, uint32_t lease, ratelimitstore_t* store) {
+    ratelimitconfig_t config = {
+        .burst = burst,
+        .rate = 1,
+        .lease = lease,
+        .idle_timeout_s = 60,
+        .host_id = ""
+    };
+
+    return ratelimit_create("test", &config, store);
+}
+
+static void* ratelimit_test_thread(void* arg) {
+    ratelimit_t* limiter = arg;
+    int allowed = 0;
+
+    for (int i = 0; i < 1000; i++)
+        allowed += ratelimit_take(limiter, "user:42", 1);
+
+    return (void*)(intptr_t)allowed;
+}
+
+TEST(test_ratelimit_memory) {
+    TEST_CASE("a burst is allowed per string key");
+
+    TEST_ASSERT_EQUAL(1, ratelimit_take(NULL, "key", 1), "NULL limiter allows everything");
+
+    ratelimitconfig_t invalid = { .burst = 0, .rate = 1 };
+    TEST_ASSERT_NULL(ratelimit_create("test", &invalid, NULL), "empty bucket rejected");
+
+    ratelimit_t* limiter = ratelimit_test_create(2, 1, NULL);
+    TEST_REQUIRE_NOT_NULL(limiter, "limiter created");
+
+    TEST_ASSERT_EQUAL(1, ratelimit_take(limiter, "api-key-a", 1), "1st allowed");
+    TEST_ASSERT_EQUAL(1, ratelimit_take(limiter, "api-key-a", 1), "2nd allowed");
+    TEST_ASSERT_EQUAL(0, ratelimit_take(limiter, "api-key-a", 1), "3rd denied");
+    TEST_ASSERT_EQUAL(1, ratelimit_take(limiter, "api-key-b", 1), "other key has its own bucket");
+    TEST_ASSERT_EQUAL(0, ratelimit_take(limiter, "api-key-b", 2), "more tokens than left denied");
+    TEST_ASSERT_EQUAL(1, ratelimit_take(limiter, "api-key-b", 1), "denied request took nothing");
+    TEST_ASSERT_EQUAL_SIZE(2, ratelimit_size(limiter), "two keys");
+
+    ratelimit_free(limiter);
+}
+
+TEST(test_ratelimit_cleanup) {
+    TEST_CASE("idle keys are removed a few per access, not in one pass");
+
+    ratelimitconfig_t config = { .burst = 1, .rate = 1, .lease = 1, .idle_timeout_s = 0, .host_id = "" };
+    ratelimit_t* limiter = ratelimit_create("test", &config, NULL);
+    TEST_REQUIRE_NOT_NULL(limiter, "limiter created");
+
+    char key[32];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "key-%d", i);
+        ratelimit_take(limiter, key, 1);
+    }
+
+    const size_t size = ratelimit_size(limiter);
+    TEST_ASSERT(size > 1 && size < 1000, "idle keys removed along the way");
+
+    /* a few keys reach every shard */
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, sizeof(key), "live-%d", i % 64);
+        ratelimit_take(limiter, key, 1);
+    }
+
+    TEST_ASSERT(ratelimit_size(limiter) <= 64, "cursor keeps removing idle keys");
+
+    ratelimit_free(limiter);
+}
+
+TEST(test_ratelimit_leased) {
+    TEST_CASE("nodes lease batches from the shared bucket and never exceed it");
+
+    ratelimit_test_bucket_t bucket = { .tokens = 100, .calls = 0 };
+
+    ratelimit_t* node_a = ratelimit_test_create(100, 10, ratelimit_test_store_create(&bucket, 0));
+    ratelimit_t* node_b = ratelimit_test_create(100, 10, ratelimit_test_store_create(&bucket, 0));
+    TEST_REQUIRE_NOT_NULL(node_a, "node a created");
+    TEST_REQUIRE_NOT_NULL(node_b, "node b created");
+
+    int allowed = 0;
+    for (int i = 0; i < 100; i++) {
+        allowed += ratelimit_take(node_a, "user:1", 1);
+        allowed += ratelimit_take(node_b, "user:1", 1);
+    }
+
+    TEST_ASSERT_EQUAL(100, allowed, "shared bucket spent exactly once");
+    TEST_ASSERT_EQUAL(0, atomic_load(&bucket.tokens), "bucket empty");
+
+    /* 10 batches of 10, plus one denied lease per node */
+    TEST_ASSERT_EQUAL(12, atomic_load(&bucket.calls), "one round trip per batch");
+
+    for (int i = 0; i < 100; i++)
+        allowed += ratelimit_take(node_a, "user:1", 1);
+
+    TEST_ASSERT_EQUAL(100, allowed, "still denied");
+    TEST_ASSERT_EQUAL(12, atomic_load(&bucket.calls), "denied key not asked again before a refill");
+
+    ratelimit_free(node_a);
+    ratelimit_free(node_b);
+}
+
+TEST(test_ratelimit_unreachable) {
+    TEST_CASE("an unreachable store fails open once per batch");
+
+    ratelimit_test_bucket_t bucket = { .tokens = 0, .calls = 0 };
+
+    ratelimit_t* limiter = ratelimit_test_create(100, 10, ratelimit_test_store_create(&bucket, 1));
+    TEST_REQUIRE_NOT_NULL(limiter, "limiter created");
+
+    int allowed = 0;
+    for (int i = 0; i < 30; i++)
+        allowed += ratelimit_take(limiter, "user:2", 1);
+
+    TEST_ASSERT_EQUAL(30, allowed, "requests allowed");
+    TEST_ASSERT_EQUAL(3, atomic_load(&bucket.calls), "store asked once per batch");
+
+    ratelimit_free(limiter);
+}
+
+TEST(test_ratelimit_threads) {
+    TEST_CASE("threads share the bucket of one key");
+
+    ratelimit_t* limiter = ratelimit_test_create(1000, 1, NULL);
+    TEST_REQUIRE_NOT_NULL(limiter, "limiter created");
+
+    pthread_t threads[RATELIMIT_TEST_THREADS];
+    for (int i = 0; i < RATELIMIT_TEST_THREADS; i++)
+        pthread_create(&threads[i], NULL, ratelimit_test_thread, limiter);
+
+    intptr_t allowed = 0;
+    for (int i = 0; i < RATELIMIT_TEST_THREADS; i++) {
+        void* result = NULL;
+        pthread_join(threads[i], &result);
+        allowed += (intptr_t)result;
+    }
+
+    /* at 1 token per second a refill during the run adds at most one more */
+    TEST_ASSERT(allowed >= 1000 && allowed <= 1001, "exactly the burst allowed");
+
+    ratelimit_free(limiter);
+}
@@ -0,0 +1,171 @@
+/*
+ * Unit tests for src/ratelimiter/ratelimiter.c.
+ *
+ * Buckets live in a sharded open-addressing table. They must be found
+ * again after the table grows and after idle neighbours are removed by
+ * the incremental cleanup; tokens of one address are shared by all
+ * threads.
+ */
+
+#include "framework.h"
+#include "ratelimiter.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+#define RATELIMITER_TEST_IPS 1000
+#define RATELIMITER_TEST_THREADS 4
+
+static ratelimiter_t* ratelimiter_test_create(uint32_t max_tokens, uint32_t cleanup_interval_s) {
+    ratelimiter_config_t config = {
+        .max_tokens = max_tokens,
+        .refill_rate = 1,
+        .time_window_ns = 1000000000ULL,
+        .cleanup_interval_s = cleanup_interval_s
+    };
+
+    return ratelimiter_init(&config);
+}
+
+static void* ratelimiter_test_thread(void* arg) {
+    ratelimiter_t* limiter = arg;
+    int allowed = 0;
+
+    for (int i = 0; i < 1000; i++)
+        allowed += ratelimiter_allow(limiter, 0x0100007f, 1);
+
+    return (void*)(intptr_t)allowed;
+}
+
+TEST(test_ratelimiter_burst) {
+    TEST_CASE("a burst of max_tokens is allowed per address");
+
+    TEST_ASSERT_EQUAL(1, ratelimiter_allow(NULL, 1, 1), "NULL limiter allows everything");
+
+    ratelimiter_t* limiter = ratelimiter_test_create(3, 60);
+    TEST_REQUIRE_NOT_NULL(limiter, "limiter created");
+
+    TEST_ASSERT_EQUAL(1, ratelimiter_allow(limiter, 10, 1), "1st allowed");
+    TEST_ASSERT_EQUAL(1, ratelimiter_allow(limiter, 10, 1), "2nd allowed");
+    TEST_ASSERT_EQUAL(1, ratelimiter_allow(limiter, 10, 1), "3rd allowed");
+    TEST_ASSERT_EQUAL(0, ratelimiter_allow(limiter, 10, 1), "4th denied");
+    TEST_ASSERT_EQUAL(1, ratelimiter_allow(limiter, 11, 1), "other address has its own bucket");
+    TEST_ASSERT_EQUAL(0, ratelimiter_allow(limiter, 11, 3), "more tokens than left denied");
+    TEST_ASSERT_EQUAL_SIZE(2, ratelimiter_size(limiter), "two buckets");
+
+    ratelimiter_free(limiter);
+}
+
+TEST(test_ratelimiter_growth) {
+    TEST_CASE("buckets are found again after the table grows");
+
+    ratelimiter_t* limiter = ratelimiter_test_create(1, 60);
+    TEST_REQUIRE_NOT_NULL(limiter, "limiter created");
+
+    int allowed = 0;
+    for (in_addr_t ip = 0; ip < 100000; ip++)
+        allowed += ratelimiter_allow(limiter, ip, 1);
+
+    TEST_ASSERT_EQUAL(100000, allowed, "first request of every address allowed");
+    TEST_ASSERT_EQUAL_SIZE(100000, ratelimiter_size(limiter), "one bucket per address");
+
+    int denied = 0;
+    for (in_addr_t ip = 0; ip < 100000; ip++)
+        denied += !ratelimiter_allow(limiter, ip, 1);
+
+    TEST_ASSERT_EQUAL(100000, denied, "second request of every address denied");
+
+    ratelimiter_free(limiter);
+}
+
+TEST(test_ratelimiter_cleanup) {
+    TEST_CASE("idle buckets are removed incrementally, live ones stay");
+
+    ratelimiter_t* limiter = ratelimiter_test_create(1, 1);
+    TEST_REQUIRE_NOT_NULL(limiter, "limiter created");
+
+    for (in_addr_t ip = 0; ip < RATELIMITER_TEST_IPS * 20; ip++)
+        ratelimiter_allow(limiter, ip, 1);
+
+    /* let the first addresses go idle; the rounds below give every shard
+     * enough calls for a full cleanup pass */
+    usleep(1100000);
+
+    int allowed_first = 0;
+    int allowed_later = 0;
+    for (int round = 0; round < 200; round++) {
+        for (in_addr_t ip = 1000000; ip < 1000000 + RATELIMITER_TEST_IPS; ip++) {
+            if (round == 0)
+                allowed_first += ratelimiter_allow(limiter, ip, 1);
+            else
+                allowed_later += ratelimiter_allow(limiter, ip, 1);
+        }
+    }
+
+    TEST_ASSERT_EQUAL(RATELIMITER_TEST_IPS, allowed_first, "new addresses allowed once");
+    TEST_ASSERT_EQUAL(0, allowed_later, "live buckets survive removal of their neighbours");
+    TEST_ASSERT_EQUAL_SIZE(RATELIMITER_TEST_IPS, ratelimiter_size(limiter), "idle buckets removed");
+
+    size_t capacity = 0;
+    for (int i = 0; i < RATELIMITER_SHARDS; i++)
+        capacity += limiter->shards[i].capacity;
+
+    TEST_ASSERT(capacity <= RATELIMITER_SHARDS * RATELIMITER_SHARD_CAPACITY_MIN, "shards shrunk after a full pass");
+
+    ratelimiter_free(limiter);
+}
+
+/* a bucket touched by a thread that read the clock later than the caller */
+static ratelimiter_bucket_t* ratelimiter_test_find(ratelimiter_t* limiter, in_addr_t ip) {
+    for (int i = 0; i < RATELIMITER_SHARDS; i++)
+        for (uint32_t j = 0; j < limiter->shards[i].capacity; j++)
+            if (limiter->shards[i].slots[j].last_access_ns != 0 && limiter->shards[i].slots[j].ip == ip)
+                return &limiter->shards[i].slots[j];
+
+    return NULL;
+}
+
+TEST(test_ratelimiter_clock_order) {
+    TEST_CASE("a bucket stamped later than now is neither refilled nor expired");
+
+    ratelimiter_t* limiter = ratelimiter_test_create(1, 60);
+    TEST_REQUIRE_NOT_NULL(limiter, "limiter created");
+
+    TEST_ASSERT_EQUAL(1, ratelimiter_allow(limiter, 10, 1), "burst allowed");
+
+    ratelimiter_bucket_t* bucket = ratelimiter_test_find(limiter, 10);
+    TEST_REQUIRE_NOT_NULL(bucket, "bucket found");
+    bucket->last_access_ns = ratelimiter_get_time_ns() + 10000000000ULL;
+    bucket->last_refill_ns = bucket->last_access_ns;
+
+    for (in_addr_t ip = 1000000; ip < 1000000 + RATELIMITER_TEST_IPS; ip++)
+        ratelimiter_allow(limiter, ip, 1);
+
+    TEST_ASSERT_EQUAL_SIZE(RATELIMITER_TEST_IPS + 1, ratelimiter_size(limiter), "bucket not expired");
+    TEST_ASSERT_EQUAL(0, ratelimiter_allow(limiter, 10, 1), "bucket not refilled");
+
+    ratelimiter_free(limiter);
+}
+
+TEST(test_ratelimiter_threads) {
+    TEST_CASE("threads share the tokens of one address");
+
+    ratelimiter_t* limiter = ratelimiter_test_create(1000, 60);
+    TEST_REQUIRE_NOT_NULL(limiter, "limiter created");
+
+    pthread_t threads[RATELIMITER_TEST_THREADS];
+    for (int i = 0; i < RATELIMITER_TEST_THREADS; i++)
+        pthread_create(&threads[i], NULL, ratelimiter_test_thread, limiter);
+
+    intptr_t allowed = 0;
+    for (int i = 0; i < RATELIMITER_TEST_THREADS; i++) {
+        void* result = NULL;
+        pthread_join(threads[i], &result);
+        allowed += (intptr_t)result;
+    }
+
+    /* at 1 token per second a refill during the run adds at most one more */
+    TEST_ASSERT(allowed >= 1000 && allowed <= 1001, "exactly the burst allowed");
+
+    ratelimiter_free(limiter);
+}
@@ -233,6 +233,28 @@ TEST(test_route_set_http_handler_methods) {
     routes_free(r);
 }
 
+TEST(test_route_set_priority) {
+    TEST_CASE("route_set_priority maps class names per method, defaults to normal");
+
+    route_t* r = route_create("/health");
+    TEST_REQUIRE_NOT_NULL(r, "route_create should succeed");
+
+    TEST_ASSERT_EQUAL(ROUTE_PRIORITY_NORMAL, r->priority[ROUTE_GET], "Default priority is normal");
+
+    TEST_ASSERT_EQUAL(1, route_set_priority(r, "GET", "high"), "high should be accepted");
+    TEST_ASSERT_EQUAL(ROUTE_PRIORITY_HIGH, r->priority[ROUTE_GET], "GET is high");
+    TEST_ASSERT_EQUAL(ROUTE_PRIORITY_NORMAL, r->priority[ROUTE_POST], "POST keeps normal");
+
+    TEST_ASSERT_EQUAL(1, route_set_priority(r, "POST", "low"), "low should be accepted");
+    TEST_ASSERT_EQUAL(ROUTE_PRIORITY_LOW, r->priority[ROUTE_POST], "POST is low");
+
+    TEST_ASSERT_EQUAL(0, route_set_priority(r, "GET", "urgent"), "Unknown class should be rejected");
+    TEST_ASSERT_EQUAL(ROUTE_PRIORITY_HIGH, r->priority[ROUTE_GET], "Rejected class keeps previous value");
+    TEST_ASSERT_EQUAL(0, route_set_priority(r, "FETCH", "high"), "Unknown method should be rejected");
+
+    routes_free(r);
+}
+
 TEST(test_route_set_http_handler_ratelimiter_ownership) {
     TEST_CASE("Ratelimiter ownership: no leaks, no NULL overwrite");
 
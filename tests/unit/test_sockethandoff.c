@@ -0,0 +1,115 @@
+/*
+ * Unit tests for src/socket/sockethandoff.c.
+ *
+ * Listening sockets are sent over a unix socketpair with SCM_RIGHTS and
+ * claimed back by ip:port, the way a new process picks up the listeners of
+ * the one it replaces. The sender counts them as handed off only after the
+ * receiver acknowledges.
+ */
+
+#include "framework.h"
+#include "socket.h"
+#include "sockethandoff.h"
+
+#include <unistd.h>
+#include <sys/socket.h>
+
+static unsigned short int __listening_port(int fd) {
+    struct sockaddr_in sa;
+    socklen_t len = sizeof(sa);
+    if (getsockname(fd, (struct sockaddr*)&sa, &len) == -1) return 0;
+
+    return ntohs(sa.sin_port);
+}
+
+TEST(test_sockethandoff_no_ack) {
+    TEST_CASE("sockets stay ours until the new process acknowledges them");
+
+    const int listener = socket_listen_create(inet_addr("127.0.0.1"), 0);
+    TEST_REQUIRE(listener != -1, "listener created");
+
+    int channel[2];
+    TEST_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, channel) == 0, "channel created");
+
+    /* the receiver went away before acknowledging */
+    shutdown(channel[1], SHUT_WR);
+
+    TEST_ASSERT_EQUAL(-1, socket_handoff_send(channel[0]), "transfer without ack fails");
+    TEST_ASSERT_EQUAL(0, socket_handoff_sent(), "sent flag stays down");
+
+    close(channel[0]);
+    close(channel[1]);
+    close(listener);
+}
+
+TEST(test_sockethandoff_roundtrip) {
+    TEST_CASE("listening socket is transferred and claimed by ip:port");
+
+    const in_addr_t ip = inet_addr("127.0.0.1");
+    const int listener = socket_listen_create(ip, 0);
+    TEST_REQUIRE(listener != -1, "listener created");
+
+    const unsigned short int port = __listening_port(listener);
+    TEST_REQUIRE(port != 0, "ephemeral port assigned");
+
+    int channel[2];
+    TEST_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, channel) == 0, "channel created");
+
+    /* the ack is queued up front so the sender does not block this thread */
+    TEST_REQUIRE(socket_handoff_ack(channel[1]), "ack sent");
+
+    const int sent = socket_handoff_send(channel[0]);
+    TEST_ASSERT(sent >= 1, "at least our listener is sent");
+    TEST_ASSERT_EQUAL(1, socket_handoff_sent(), "sent flag is raised");
+
+    const int received = socket_handoff_receive(channel[1]);
+    TEST_ASSERT_EQUAL(sent, received, "every socket received");
+    TEST_ASSERT_EQUAL(received, socket_handoff_unclaimed(), "received sockets wait in stock");
+
+    TEST_ASSERT_EQUAL(-1, socket_handoff_take(ip, 1), "no socket on a foreign port");
+
+    const int inherited = socket_handoff_take(ip, port);
+    TEST_REQUIRE(inherited != -1, "socket claimed by address");
+    TEST_ASSERT(inherited != listener, "claimed socket is a new descriptor");
+    TEST_ASSERT_EQUAL(port, __listening_port(inherited), "same address");
+    TEST_ASSERT_EQUAL(-1, socket_handoff_take(ip, port), "socket is claimed only once");
+
+    /* the inherited descriptor accepts connections queued on the original */
+    const int client = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in sa = {0};
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    sa.sin_addr.s_addr = ip;
+    TEST_REQUIRE(connect(client, (struct sockaddr*)&sa, sizeof(sa)) == 0, "client connected");
+
+    close(listener);
+
+    int accepted = -1;
+    for (int i = 0; i < 100 && accepted == -1; i++) {
+        accepted = accept(inherited, NULL, NULL);
+        if (accepted == -1) usleep(1000);
+    }
+    TEST_ASSERT(accepted != -1, "queued connection accepted through inherited socket");
+
+    socket_handoff_close_unclaimed();
+    TEST_ASSERT_EQUAL(0, socket_handoff_unclaimed(), "stock is empty");
+
+    if (accepted != -1) close(accepted);
+    close(client);
+    close(inherited);
+    close(channel[0]);
+    close(channel[1]);
+}
+
+TEST(test_sockethandoff_empty_transfer) {
+    TEST_CASE("closed channel is an error, not an empty transfer");
+
+    int channel[2];
+    TEST_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, channel) == 0, "channel created");
+
+    close(channel[0]);
+    TEST_ASSERT_EQUAL(-1, socket_handoff_receive(channel[1]), "EOF before terminator fails");
+    TEST_ASSERT_EQUAL(0, socket_handoff_unclaimed(), "nothing stocked");
+
+    close(channel[1]);
+}
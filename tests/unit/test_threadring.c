@@ -0,0 +1,104 @@
+/*
+ * Unit tests for misc/threadring.c.
+ *
+ * Each thread gets its own ring on first use. A ring of a finished thread
+ * is freed only once the reader has drained it, drops are reported once,
+ * and a notify wakes the reader only after it has announced its sleep.
+ */
+
+#include "framework.h"
+#include "threadring.h"
+
+#include <pthread.h>
+#include <time.h>
+
+typedef struct test_ring {
+    threadring_t base;
+    int values[16];
+} test_ring_t;
+
+static threadrings_t __test_rings = THREADRINGS_INITIALIZER;
+static _Thread_local threadring_t* __test_ring = NULL;
+
+static size_t threadring_test_count(void) {
+    size_t count = 0;
+    for (threadring_t* ring = atomic_load(&__test_rings.rings); ring != NULL; ring = ring->next)
+        count++;
+
+    return count;
+}
+
+static void* threadring_test_thread(void* arg) {
+    (void)arg;
+
+    threadring_t* ring = threadrings_attach(&__test_rings, &__test_ring, sizeof(test_ring_t));
+    if (ring == NULL) return NULL;
+
+    ((test_ring_t*)ring)->values[0] = 42;
+    atomic_store_explicit(&ring->head, 1, memory_order_release);
+    atomic_fetch_add(&ring->dropped, 3);
+
+    return ring;
+}
+
+static double threadring_test_elapsed_ms(const struct timespec* start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (end.tv_sec - start->tv_sec) * 1000.0 + (end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+TEST(test_threadring_lifecycle) {
+    TEST_CASE("a finished thread's ring is freed after it is drained");
+
+    const size_t before = threadring_test_count();
+
+    pthread_t thread;
+    void* result = NULL;
+    pthread_create(&thread, NULL, threadring_test_thread, NULL);
+    pthread_join(thread, &result);
+
+    threadring_t* ring = result;
+    TEST_REQUIRE_NOT_NULL(ring, "ring attached");
+    TEST_ASSERT_EQUAL(1, atomic_load(&ring->closed), "ring closed on thread exit");
+    TEST_ASSERT_EQUAL(1, threadrings_pending(&__test_rings), "unread record is pending");
+
+    threadrings_collect(&__test_rings);
+    TEST_ASSERT_EQUAL_SIZE(before + 1, threadring_test_count(), "undrained ring kept");
+
+    TEST_ASSERT_EQUAL(42, ((test_ring_t*)ring)->values[0], "record readable");
+    TEST_ASSERT_EQUAL(3, (int)threadring_dropped(ring), "drops reported");
+    TEST_ASSERT_EQUAL(0, (int)threadring_dropped(ring), "drops reported once");
+
+    atomic_store(&ring->tail, atomic_load(&ring->head));
+    TEST_ASSERT_EQUAL(0, threadrings_pending(&__test_rings), "nothing pending");
+
+    threadrings_collect(&__test_rings);
+    TEST_ASSERT_EQUAL_SIZE(before, threadring_test_count(), "drained ring freed");
+}
+
+TEST(test_threadring_sleep) {
+    TEST_CASE("notify wakes a sleeping reader, wakeup is never lost");
+
+    TEST_REQUIRE(threadrings_open(&__test_rings), "eventfd created");
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    threadrings_sleep(&__test_rings, 50, 0);
+    TEST_ASSERT(threadring_test_elapsed_ms(&start) >= 40, "sleeps until the timeout");
+
+    /* not sleeping: notify does not touch the eventfd */
+    threadrings_notify(&__test_rings);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    threadrings_sleep(&__test_rings, 50, 0);
+    TEST_ASSERT(threadring_test_elapsed_ms(&start) >= 40, "notify without a sleeper is skipped");
+
+    /* an explicit wakeup stays armed until the next sleep */
+    threadrings_wakeup(&__test_rings);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    threadrings_sleep(&__test_rings, 1000, 0);
+    TEST_ASSERT(threadring_test_elapsed_ms(&start) < 500, "armed wakeup ends the sleep");
+
+    threadrings_close(&__test_rings);
+    TEST_ASSERT_EQUAL(-1, atomic_load(&__test_rings.wakeup_fd), "eventfd closed");
+}
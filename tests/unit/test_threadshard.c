@@ -0,0 +1,70 @@
+/*
+ * Unit tests for misc/threadshard.c.
+ *
+ * Each thread gets its own zeroed, cache-line aligned shard on first use.
+ * A shard of a finished thread keeps its counters and passes to the next
+ * new thread, so the sums never go down.
+ */
+
+#include "framework.h"
+#include "threadshard.h"
+
+#include <pthread.h>
+#include <stdint.h>
+
+typedef struct test_shard {
+    threadshard_t base;
+    long counter;
+} test_shard_t;
+
+static threadshards_t __test_shards = THREADSHARDS_INITIALIZER;
+static _Thread_local threadshard_t* __test_shard = NULL;
+
+static size_t threadshard_test_count(void) {
+    size_t count = 0;
+    for (threadshard_t* shard = atomic_load(&__test_shards.shards); shard != NULL; shard = shard->next)
+        count++;
+
+    return count;
+}
+
+static void* threadshard_test_thread(void* arg) {
+    (void)arg;
+
+    threadshard_t* shard = threadshards_attach(&__test_shards, &__test_shard, sizeof(test_shard_t));
+    if (shard == NULL) return NULL;
+
+    ((test_shard_t*)shard)->counter += 5;
+
+    return shard;
+}
+
+TEST(test_threadshard_reuse) {
+    TEST_CASE("a finished thread's shard passes to the next thread");
+
+    pthread_t thread;
+    void* first = NULL;
+    pthread_create(&thread, NULL, threadshard_test_thread, NULL);
+    pthread_join(thread, &first);
+
+    threadshard_t* shard = first;
+    TEST_REQUIRE_NOT_NULL(shard, "shard attached");
+    TEST_ASSERT_EQUAL(0, (int)((uintptr_t)shard % THREADSHARD_ALIGN), "shard aligned");
+    TEST_ASSERT_EQUAL(0, atomic_load(&shard->owned), "shard released on thread exit");
+    TEST_ASSERT_EQUAL(5, (int)((test_shard_t*)shard)->counter, "counter kept");
+
+    const size_t count = threadshard_test_count();
+
+    void* second = NULL;
+    pthread_create(&thread, NULL, threadshard_test_thread, NULL);
+    pthread_join(thread, &second);
+
+    TEST_ASSERT(second == first, "free shard reused");
+    TEST_ASSERT_EQUAL_SIZE(count, threadshard_test_count(), "no new shard");
+    TEST_ASSERT_EQUAL(10, (int)((test_shard_t*)shard)->counter, "counter keeps growing");
+
+    threadshard_t* own = threadshards_attach(&__test_shards, &__test_shard, sizeof(test_shard_t));
+    TEST_ASSERT(own == shard, "calling thread takes the free shard");
+    TEST_ASSERT(__test_shard == own, "shard stored in the thread variable");
+    TEST_ASSERT_EQUAL(1, atomic_load(&shard->owned), "shard owned again");
+}
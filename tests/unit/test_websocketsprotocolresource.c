@@ -698,6 +698,7 @@ typedef struct {
     connection_t connection;
     connection_server_ctx_t ctx;
     server_t server;
+    server_routing_t routing;
     int sentinel;
 } dispatch_harness_t;
 
@@ -705,8 +706,10 @@ static int dispatch_setup(dispatch_harness_t* harness, route_t* routes) {
     memset(&harness->connection, 0, sizeof harness->connection);
     memset(&harness->ctx, 0, sizeof harness->ctx);
     memset(&harness->server, 0, sizeof harness->server);
+    memset(&harness->routing, 0, sizeof harness->routing);
 
-    harness->server.websockets.route = routes;
+    harness->routing.websockets.route = routes;
+    atomic_store(&harness->server.routing, &harness->routing);
     harness->ctx.server = &harness->server;
     harness->ctx.queue = cqueue_create();
     if (harness->ctx.queue == NULL) return 0;
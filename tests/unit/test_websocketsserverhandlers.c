@@ -88,6 +88,7 @@ typedef struct {
     connection_t* conn;
     connection_server_ctx_t ctx;
     server_t server;
+    server_routing_t routing;
     listener_t listener;
     mpxapi_t api;
 
@@ -162,6 +163,7 @@ static int wsh_harness_init_sized(wsh_harness_t* h, size_t buffer_size) {
 
     h->ctx.base.reset = wsh_ctx_reset;
     h->ctx.listener = &h->listener;
+    atomic_store(&h->server.routing, &h->routing);
     h->ctx.server = &h->server;
     h->ctx.queue = cqueue_create();
     h->ctx.broadcast_queue = cqueue_create();
@@ -814,7 +816,7 @@ TEST(test_wsh_read_unknown_route_frees_request_regression) {
     TEST_REQUIRE(wsh_harness_init(&h), "harness init");
     TEST_REQUIRE_GOTO(wsh_attach_parser(&h, websockets_protocol_resource_create), "parser attach", teardown);
 
-    /* server.websockets.route == NULL: no route can match. */
+    /* routing.websockets.route == NULL: no route can match. */
     const char* message = "GET /nope";
     unsigned char frame[64];
     const size_t frame_size = wsh_build_frame(frame, 0x01, 1, (const unsigned char*)message, strlen(message));
@@ -1169,7 +1171,7 @@ TEST(test_wsh_queue_request_handler_middleware_denies) {
     TEST_REQUIRE(wsh_harness_init(&h), "harness init");
 
     middleware_item_t deny = { .fn = wsh_deny_middleware, .next = NULL };
-    h.server.websockets.middleware = &deny;
+    h.routing.websockets.middleware = &deny;
 
     connection_queue_item_t* item = wsh_make_request_item(&h, NULL);
     TEST_REQUIRE_NOT_NULL_GOTO(item, "item built", teardown);